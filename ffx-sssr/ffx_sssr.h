@@ -57,12 +57,22 @@ bool FFX_SSSR_AdvanceRay(float3 origin, float3 direction, float3 inv_direction,
     // Choose nearest intersection with a boundary.
     float t_min = min(min(t.x, t.y), t.z);
 
+#ifdef FFX_SSSR_DEPTH_TOLERANCE
+    // Low precision hierarchies round the surface towards the camera to stay conservative.
+    // Rays that are behind the stored surface by less than the tolerance still count as above it.
+#ifdef FFX_SSSR_INVERTED_DEPTH_RANGE
+    bool above_surface = surface_z - FFX_SSSR_DEPTH_TOLERANCE < position.z;
+#else
+    bool above_surface = surface_z + FFX_SSSR_DEPTH_TOLERANCE > position.z;
+#endif
+#else
 #ifdef FFX_SSSR_INVERTED_DEPTH_RANGE
     // Larger z means closer to the camera.
     bool above_surface = surface_z < position.z;
 #else
     // Smaller z means closer to the camera.
     bool above_surface = surface_z > position.z;
+#endif
 #endif
 
     // Decide whether we are able to advance the ray until we hit the xy boundaries or if we had to clamp it at the surface.
@@ -70,7 +80,12 @@ bool FFX_SSSR_AdvanceRay(float3 origin, float3 direction, float3 inv_direction,
     bool skipped_tile = asuint(t_min) != asuint(t.z) && above_surface; 
 
     // Make sure to only advance the ray if we're still above the surface.
+#ifdef FFX_SSSR_DEPTH_TOLERANCE
+    // Within the tolerance the surface plane may lie behind the ray already. Never move the ray backwards.
+    current_t = above_surface ? max(t_min, current_t) : current_t;
+#else
     current_t = above_surface ? t_min : current_t;
+#endif
 
     // Advance ray
     position = origin + current_t * direction;
@@ -78,6 +93,18 @@ bool FFX_SSSR_AdvanceRay(float3 origin, float3 direction, float3 inv_direction,
     return skipped_tile;
 }
 
+#ifdef FFX_SSSR_LINEAR_DEPTH_HIERARCHY
+// FFX_SSSR_LoadDepth returns linear depth. The ray is still marched in screen space where it is a straight line,
+// so each surface is converted with FFX_SSSR_LinearDepthToScreenSpaceDepth before intersecting it.
+float FFX_SSSR_LoadScreenSpaceDepth(int2 pixel_coordinate, int mip) {
+    return FFX_SSSR_LinearDepthToScreenSpaceDepth(FFX_SSSR_LoadDepth(pixel_coordinate, mip));
+}
+#else
+float FFX_SSSR_LoadScreenSpaceDepth(int2 pixel_coordinate, int mip) {
+    return FFX_SSSR_LoadDepth(pixel_coordinate, mip);
+}
+#endif
+
 float2 FFX_SSSR_GetMipResolution(float2 screen_dimensions, int mip_level) {
     return screen_dimensions * pow(0.5, mip_level);
 }
@@ -108,17 +135,37 @@ float3 FFX_SSSR_HierarchicalRaymarch(float3 origin, float3 direction, bool is_mi
 
     bool exit_due_to_low_occupancy = false;
     int i = 0;
+#ifdef FFX_SSSR_TRACK_MIP_USAGE
+    int coarsest_mip = current_mip;
+#endif
     while (i < max_traversal_intersections && current_mip >= most_detailed_mip && !exit_due_to_low_occupancy) {
         float2 current_mip_position = current_mip_resolution * position.xy;
-        float surface_z = FFX_SSSR_LoadDepth(current_mip_position, current_mip);
+        float surface_z = FFX_SSSR_LoadScreenSpaceDepth(current_mip_position, current_mip);
         exit_due_to_low_occupancy = !is_mirror && WaveActiveCountBits(true) <= min_traversal_occupancy;
         bool skipped_tile = FFX_SSSR_AdvanceRay(origin, direction, inv_direction, current_mip_position, current_mip_resolution_inv, floor_offset, uv_offset, surface_z, position, current_t);
+#ifdef FFX_SSSR_MAX_MIP
+        // The hierarchy ends at FFX_SSSR_MAX_MIP. Keep marching on that mip instead of climbing past it.
+        bool climb = skipped_tile && current_mip < FFX_SSSR_MAX_MIP;
+        bool descend = !skipped_tile;
+        current_mip += climb ? 1 : (descend ? -1 : 0);
+        current_mip_resolution *= climb ? 0.5 : (descend ? 2 : 1);
+        current_mip_resolution_inv *= climb ? 2 : (descend ? 0.5 : 1);
+#else
         current_mip += skipped_tile ? 1 : -1;
         current_mip_resolution *= skipped_tile ? 0.5 : 2;
         current_mip_resolution_inv *= skipped_tile ? 2 : 0.5;
+#endif
+#ifdef FFX_SSSR_TRACK_MIP_USAGE
+        coarsest_mip = max(coarsest_mip, current_mip);
+#endif
         ++i;
     }
 
+#ifdef FFX_SSSR_TRACK_MIP_USAGE
+    // Lets the application gather how far up the hierarchy the rays climb.
+    FFX_SSSR_TrackMipUsage(coarsest_mip);
+#endif
+
     valid_hit = (i <= max_traversal_intersections);
 
     return position;
@@ -139,7 +186,9 @@ float FFX_SSSR_ValidateHit(float3 hit, float2 uv, float3 world_space_ray_directi
     // Don't lookup radiance from the background.
     int2 texel_coords = int2(screen_size * hit.xy);
     float surface_z = FFX_SSSR_LoadDepth(texel_coords / 2, 1);
-#ifdef FFX_SSSR_INVERTED_DEPTH_RANGE
+#if defined(FFX_SSSR_LINEAR_DEPTH_HIERARCHY)
+    if (surface_z >= FFX_SSSR_LINEAR_FAR_DEPTH) {
+#elif defined(FFX_SSSR_INVERTED_DEPTH_RANGE)
     if (surface_z == 0.0) {
 #else
     if (surface_z == 1.0) {
@@ -153,8 +202,14 @@ float FFX_SSSR_ValidateHit(float3 hit, float2 uv, float3 world_space_ray_directi
         return 0;
     }
 
+#ifdef FFX_SSSR_LINEAR_DEPTH_HIERARCHY
+    // Avoids the full inverse projection. Only the hit itself needs to be linearized.
+    float3 view_space_surface = FFX_SSSR_LinearDepthToViewSpace(hit.xy, surface_z);
+    float3 view_space_hit = FFX_SSSR_LinearDepthToViewSpace(hit.xy, FFX_SSSR_ScreenSpaceDepthToLinearDepth(hit.z));
+#else
     float3 view_space_surface = FFX_SSSR_ScreenSpaceToViewSpace(float3(hit.xy, surface_z));
     float3 view_space_hit = FFX_SSSR_ScreenSpaceToViewSpace(hit);
+#endif
     float distance = length(view_space_surface - view_space_hit);
 
     // Fade out hits near the screen borders
@@ -0,0 +1,251 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "Autotuner.h"
+
+#include <cstddef>
+
+// The accumulated reference averages this many frames of samples. The one rendered with the most expensive settings only lets the denoiser converge.
+static const uint32_t g_accumulatedReferenceFrameCount = 256;
+static const uint32_t g_referenceFrameCount = 240;
+// Frames each candidate renders before it is timed, so the denoiser settles and the timings of the previous candidate are flushed.
+static const uint32_t g_warmupFrameCount = 60;
+static const uint32_t g_measuredFrameCount = 120;
+// A candidate may be this much further from the reference than the baseline.
+static const float g_errorTolerance = 1.1f;
+// A candidate has to be this much faster than the best one so far to replace it. Keeps the timing noise from picking settings.
+static const float g_minSpeedup = 0.98f;
+
+// Values tried per setting, from the cheapest to the most expensive one.
+static const int g_samplesPerQuadValues[] = { 1, 2, 4 };
+static const int g_mostDetailedMipValues[] = { 2, 1, 0 };
+static const int g_maxTraversalIntersectionsValues[] = { 32, 64, 128 };
+static const int g_minTraversalOccupancyValues[] = { 8, 4, 2, 0 };
+static const uint32_t g_settingCount = 6;
+
+template<size_t N>
+static bool SetFromTable(int& value, const int(&values)[N], uint32_t valueIndex)
+{
+	if (valueIndex >= N)
+	{
+		return false;
+	}
+	value = values[valueIndex];
+	return true;
+}
+
+static bool SetFlag(bool& value, uint32_t valueIndex)
+{
+	if (valueIndex >= 2)
+	{
+		return false;
+	}
+	value = valueIndex == 0;
+	return true;
+}
+
+// Returns false once valueIndex is past the last value of the setting.
+static bool SetValue(SSSR_SAMPLE_COMMON::TuningSettings& settings, uint32_t setting, uint32_t valueIndex)
+{
+	switch (setting)
+	{
+	case 0: return SetFromTable(settings.samplesPerQuad, g_samplesPerQuadValues, valueIndex);
+	case 1: return SetFromTable(settings.mostDetailedMip, g_mostDetailedMipValues, valueIndex);
+	case 2: return SetFromTable(settings.maxTraversalIntersections, g_maxTraversalIntersectionsValues, valueIndex);
+	case 3: return SetFromTable(settings.minTraversalOccupancy, g_minTraversalOccupancyValues, valueIndex);
+	case 4: return SetFlag(settings.temporalVarianceGuidedTracing, valueIndex);
+	case 5: return SetFlag(settings.skipConvergedRays, valueIndex);
+	default: return false;
+	}
+}
+
+static bool IsSameSettings(const SSSR_SAMPLE_COMMON::TuningSettings& a, const SSSR_SAMPLE_COMMON::TuningSettings& b)
+{
+	return a.samplesPerQuad == b.samplesPerQuad
+		&& a.mostDetailedMip == b.mostDetailedMip
+		&& a.maxTraversalIntersections == b.maxTraversalIntersections
+		&& a.minTraversalOccupancy == b.minTraversalOccupancy
+		&& a.temporalVarianceGuidedTracing == b.temporalVarianceGuidedTracing
+		&& a.skipConvergedRays == b.skipConvergedRays;
+}
+
+namespace SSSR_SAMPLE_COMMON
+{
+	void Autotuner::Begin(const TuningSettings& baseline, bool accumulateReference)
+	{
+		m_phase = Phase::Reference;
+		m_accumulateReference = accumulateReference;
+		m_needsReadback = false;
+		m_frameCount = 0;
+		m_setting = 0;
+		m_valueIndex = 0;
+		m_candidateCount = 0;
+		m_best = baseline;
+
+		// The accumulation mode ignores the settings that trade quality for speed.
+		m_settings = baseline;
+		if (!accumulateReference)
+		{
+			m_settings.samplesPerQuad = 4;
+			m_settings.mostDetailedMip = 0;
+			m_settings.maxTraversalIntersections = 256;
+			m_settings.minTraversalOccupancy = 0;
+			m_settings.temporalVarianceGuidedTracing = false;
+			m_settings.skipConvergedRays = false;
+		}
+	}
+
+	void Autotuner::Update(float sssrMicroseconds, const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height)
+	{
+		m_needsReadback = false;
+		switch (m_phase)
+		{
+		case Phase::Reference:
+			if (++m_frameCount == (m_accumulateReference ? g_accumulatedReferenceFrameCount : g_referenceFrameCount))
+			{
+				m_phase = Phase::ReferenceReadback;
+				m_needsReadback = true;
+			}
+			break;
+
+		case Phase::ReferenceReadback:
+			if (pReadback)
+			{
+				m_reference.Store(pReadback, rowPitch, width, height);
+				// The baseline goes first. Its error bounds the error of all other candidates.
+				m_settings = m_best;
+				m_phase = Phase::Candidate;
+				m_frameCount = 0;
+				m_microseconds = 0.0f;
+			}
+			break;
+
+		case Phase::Candidate:
+			if (++m_frameCount > g_warmupFrameCount)
+			{
+				m_microseconds += sssrMicroseconds;
+			}
+			if (m_frameCount == g_warmupFrameCount + g_measuredFrameCount)
+			{
+				m_phase = Phase::CandidateReadback;
+				m_needsReadback = true;
+			}
+			break;
+
+		case Phase::CandidateReadback:
+			if (pReadback)
+			{
+				// A resize during the sweep invalidates the reference. The remaining candidates are rejected with an infinite error, as are NaNs in their output.
+				ScoreCandidate(m_microseconds / g_measuredFrameCount, m_reference.ComputeError(pReadback, rowPitch, width, height));
+				NextCandidate();
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	bool Autotuner::IsRunning() const
+	{
+		return m_phase != Phase::Idle;
+	}
+
+	const TuningSettings& Autotuner::GetSettings() const
+	{
+		return m_settings;
+	}
+
+	bool Autotuner::IsAccumulatingReference() const
+	{
+		return m_accumulateReference && (m_phase == Phase::Reference || m_phase == Phase::ReferenceReadback);
+	}
+
+	bool Autotuner::NeedsReadback() const
+	{
+		return m_needsReadback;
+	}
+
+	const TuningSettings& Autotuner::GetBestSettings() const
+	{
+		return m_best;
+	}
+
+	float Autotuner::GetBestMicroseconds() const
+	{
+		return m_bestMicroseconds;
+	}
+
+	float Autotuner::GetBaselineMicroseconds() const
+	{
+		return m_baselineMicroseconds;
+	}
+
+	uint32_t Autotuner::GetCandidateCount() const
+	{
+		return m_candidateCount;
+	}
+
+	void Autotuner::ScoreCandidate(float microseconds, float error)
+	{
+		++m_candidateCount;
+		if (m_candidateCount == 1)
+		{
+			m_baselineMicroseconds = microseconds;
+			m_bestMicroseconds = microseconds;
+			m_baselineError = error;
+			return;
+		}
+
+		if (error <= m_baselineError * g_errorTolerance && microseconds < m_bestMicroseconds * g_minSpeedup)
+		{
+			m_best = m_settings;
+			m_bestMicroseconds = microseconds;
+		}
+	}
+
+	void Autotuner::NextCandidate()
+	{
+		while (m_setting < g_settingCount)
+		{
+			TuningSettings candidate = m_best;
+			if (!SetValue(candidate, m_setting, m_valueIndex))
+			{
+				++m_setting;
+				m_valueIndex = 0;
+				continue;
+			}
+
+			++m_valueIndex;
+			if (!IsSameSettings(candidate, m_best))
+			{
+				m_settings = candidate;
+				m_phase = Phase::Candidate;
+				m_frameCount = 0;
+				m_microseconds = 0.0f;
+				return;
+			}
+		}
+
+		m_settings = m_best;
+		m_phase = Phase::Idle;
+	}
+}
@@ -0,0 +1,103 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "ReflectionsImage.h"
+
+#include <cstdint>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	// The reflection settings the autotuner sweeps. Mirrors the reflection controls of the UI.
+	struct TuningSettings
+	{
+		int samplesPerQuad = 1;
+		int mostDetailedMip = 0;
+		int maxTraversalIntersections = 128;
+		int minTraversalOccupancy = 4;
+		bool temporalVarianceGuidedTracing = true;
+		bool skipConvergedRays = true;
+	};
+
+	/**
+		The Autotuner class picks the fastest reflection settings whose output stays about as close to a reference as the baseline settings.
+
+		It first renders the reference, then sweeps one setting at a time while the others keep the best value found so far.
+		Each candidate is rendered for a while so the temporal denoiser settles, then scored by the GPU time of the effect and the RMSE of its output against the reference.
+		The caller renders a static scene with GetSettings and feeds the timings and the output readbacks back through Update once per frame.
+	*/
+	class Autotuner
+	{
+	public:
+		// The reference accumulates many samples per pixel if accumulateReference is set. Otherwise it is rendered with the most expensive settings.
+		void Begin(const TuningSettings& baseline, bool accumulateReference);
+		// sssrMicroseconds is the GPU time of the effect in the last timed frame.
+		// pReadback is the output requested by the last NeedsReadback as RGBA16F rows of rowPitch bytes, or null while the copy is in flight.
+		void Update(float sssrMicroseconds, const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height);
+
+		bool IsRunning() const;
+		// Settings to render the next frame with.
+		const TuningSettings& GetSettings() const;
+		// Set while the reference is rendered in the accumulation mode.
+		bool IsAccumulatingReference() const;
+		// Set if the output of the next frame has to be read back.
+		bool NeedsReadback() const;
+
+		// Valid once the autotuner stopped running.
+		const TuningSettings& GetBestSettings() const;
+		float GetBestMicroseconds() const;
+		float GetBaselineMicroseconds() const;
+		uint32_t GetCandidateCount() const;
+
+	private:
+		enum class Phase
+		{
+			Idle,
+			Reference,
+			ReferenceReadback,
+			Candidate,
+			CandidateReadback,
+		};
+
+		void ScoreCandidate(float microseconds, float error);
+		// Moves on to the next value of the current setting, or to the next setting. Stops after the last one.
+		void NextCandidate();
+
+		Phase m_phase = Phase::Idle;
+		bool m_accumulateReference = false;
+		bool m_needsReadback = false;
+		uint32_t m_frameCount = 0;
+		float m_microseconds = 0.0f;
+
+		TuningSettings m_settings;
+		uint32_t m_setting = 0;
+		uint32_t m_valueIndex = 0;
+		uint32_t m_candidateCount = 0;
+
+		ReflectionsImage m_reference;
+
+		TuningSettings m_best;
+		float m_bestMicroseconds = 0.0f;
+		float m_baselineMicroseconds = 0.0f;
+		float m_baselineError = 0.0f;
+	};
+}
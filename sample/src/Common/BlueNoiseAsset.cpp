@@ -0,0 +1,157 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "BlueNoiseAsset.h"
+
+namespace SSSR_SAMPLE_COMMON
+{
+	bool BlueNoiseAsset::Open(const char* path)
+	{
+		if (!m_file.Open(path) || !m_file.Contains(0, sizeof(BlueNoiseAssetHeader)))
+		{
+			Close();
+			return false;
+		}
+
+		// Validate all offsets once, so the accessors can trust them.
+		const BlueNoiseAssetHeader* pHeader = Header();
+		bool valid = pHeader->magic == BLUE_NOISE_ASSET_MAGIC
+			&& pHeader->version == BLUE_NOISE_ASSET_VERSION
+			&& pHeader->variantCount > 0
+			&& m_file.Contains(sizeof(BlueNoiseAssetHeader), (uint64_t)pHeader->variantCount * sizeof(BlueNoiseAssetVariant))
+			&& m_file.Contains(pHeader->sobolOffset, BLUE_NOISE_SOBOL_SIZE);
+		for (uint32_t i = 0; valid && i < pHeader->variantCount; ++i)
+		{
+			const BlueNoiseAssetVariant& variant = Variants()[i];
+			valid = m_file.Contains(variant.rankingTileOffset, BLUE_NOISE_TILE_SIZE) && m_file.Contains(variant.scramblingTileOffset, BLUE_NOISE_TILE_SIZE);
+		}
+		if (!valid)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void BlueNoiseAsset::Close()
+	{
+		m_file.Close();
+	}
+
+	bool BlueNoiseAsset::GetTables(uint32_t samplesPerPixel, BlueNoiseTables* pTables) const
+	{
+		if (!m_file.Data())
+		{
+			return false;
+		}
+
+		for (uint32_t i = 0; i < Header()->variantCount; ++i)
+		{
+			const BlueNoiseAssetVariant& variant = Variants()[i];
+			if (variant.samplesPerPixel == samplesPerPixel)
+			{
+				pTables->samplesPerPixel = samplesPerPixel;
+				pTables->sobolBuffer = m_file.Data() + Header()->sobolOffset;
+				pTables->rankingTileBuffer = m_file.Data() + variant.rankingTileOffset;
+				pTables->scramblingTileBuffer = m_file.Data() + variant.scramblingTileOffset;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	uint32_t BlueNoiseAsset::GetVariantCount() const
+	{
+		return m_file.Data() ? Header()->variantCount : 0;
+	}
+
+	uint32_t BlueNoiseAsset::GetSamplesPerPixel(uint32_t variant) const
+	{
+		return Variants()[variant].samplesPerPixel;
+	}
+
+	const BlueNoiseAssetHeader* BlueNoiseAsset::Header() const
+	{
+		return reinterpret_cast<const BlueNoiseAssetHeader*>(m_file.Data());
+	}
+
+	const BlueNoiseAssetVariant* BlueNoiseAsset::Variants() const
+	{
+		return reinterpret_cast<const BlueNoiseAssetVariant*>(m_file.Data() + sizeof(BlueNoiseAssetHeader));
+	}
+
+	bool SpatiotemporalBlueNoiseAsset::Open(const char* path)
+	{
+		if (!m_file.Open(path) || !m_file.Contains(0, sizeof(SpatiotemporalBlueNoiseAssetHeader)))
+		{
+			Close();
+			return false;
+		}
+
+		const SpatiotemporalBlueNoiseAssetHeader* pHeader = Header();
+		bool valid = pHeader->magic == SPATIOTEMPORAL_BLUE_NOISE_ASSET_MAGIC
+			&& pHeader->version == SPATIOTEMPORAL_BLUE_NOISE_ASSET_VERSION
+			&& pHeader->channelCount == SPATIOTEMPORAL_BLUE_NOISE_CHANNEL_COUNT
+			&& pHeader->width > 0 && pHeader->height > 0 && pHeader->frameCount > 0
+			&& m_file.Contains(pHeader->dataOffset, (uint64_t)pHeader->width * pHeader->height * pHeader->channelCount * pHeader->frameCount);
+		if (!valid)
+		{
+			Close();
+			return false;
+		}
+		return true;
+	}
+
+	void SpatiotemporalBlueNoiseAsset::Close()
+	{
+		m_file.Close();
+	}
+
+	uint32_t SpatiotemporalBlueNoiseAsset::GetWidth() const
+	{
+		return Header()->width;
+	}
+
+	uint32_t SpatiotemporalBlueNoiseAsset::GetHeight() const
+	{
+		return Header()->height;
+	}
+
+	uint32_t SpatiotemporalBlueNoiseAsset::GetFrameCount() const
+	{
+		return Header()->frameCount;
+	}
+
+	uint32_t SpatiotemporalBlueNoiseAsset::GetSliceSize() const
+	{
+		return Header()->width * Header()->height * Header()->channelCount;
+	}
+
+	const uint8_t* SpatiotemporalBlueNoiseAsset::GetSlice(uint32_t frame) const
+	{
+		return m_file.Data() + Header()->dataOffset + (size_t)frame * GetSliceSize();
+	}
+
+	const SpatiotemporalBlueNoiseAssetHeader* SpatiotemporalBlueNoiseAsset::Header() const
+	{
+		return reinterpret_cast<const SpatiotemporalBlueNoiseAssetHeader*>(m_file.Data());
+	}
+}
@@ -0,0 +1,137 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "MappedFile.h"
+
+namespace SSSR_SAMPLE_COMMON
+{
+	// Layout of the blue noise asset written by BlueNoiseConverter. All fields are little endian.
+	//  BlueNoiseAssetHeader
+	//  BlueNoiseAssetVariant[variantCount]
+	//  Sobol sequence shared by all variants, 256 samples x 256 dimensions.
+	//  Ranking tile and scrambling tile of each variant, 128x128x8 each.
+	// Each table entry is stored in a single byte as none of them exceeds 255.
+	static const uint32_t BLUE_NOISE_ASSET_MAGIC = 0x4E425353; // "SSBN"
+	// Bump on any change of the layout above. Older assets are rejected.
+	static const uint32_t BLUE_NOISE_ASSET_VERSION = 1;
+	static const uint32_t BLUE_NOISE_SOBOL_SIZE = 256 * 256;
+	static const uint32_t BLUE_NOISE_TILE_SIZE = 128 * 128 * 8;
+
+	struct BlueNoiseAssetHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t variantCount;
+		// Byte offset of the Sobol sequence from the start of the file.
+		uint32_t sobolOffset;
+	};
+
+	struct BlueNoiseAssetVariant
+	{
+		// The sampler is optimized for this many samples per pixel.
+		uint32_t samplesPerPixel;
+		// Byte offsets of the tiles from the start of the file.
+		uint32_t rankingTileOffset;
+		uint32_t scramblingTileOffset;
+		uint32_t reserved;
+	};
+
+	// The tables of one variant. Points into the mapped file and stays valid until the asset is closed.
+	struct BlueNoiseTables
+	{
+		uint32_t samplesPerPixel;
+		const uint8_t* sobolBuffer;
+		const uint8_t* rankingTileBuffer;
+		const uint8_t* scramblingTileBuffer;
+	};
+
+	/**
+		The BlueNoiseAsset class maps a blue noise asset into memory and hands out the tables of its variants.
+
+		\note The tables are the samplers by Eric Heitz: https://eheitzresearch.wordpress.com/762-2/
+	*/
+	class BlueNoiseAsset
+	{
+	public:
+		// Returns false if the file is missing or not a valid asset of this version.
+		bool Open(const char* path);
+		void Close();
+
+		// Returns false if the asset holds no variant optimized for samplesPerPixel.
+		bool GetTables(uint32_t samplesPerPixel, BlueNoiseTables* pTables) const;
+		// Variants are stored in ascending order of their sample count.
+		uint32_t GetVariantCount() const;
+		uint32_t GetSamplesPerPixel(uint32_t variant) const;
+
+	private:
+		const BlueNoiseAssetHeader* Header() const;
+		const BlueNoiseAssetVariant* Variants() const;
+
+		MappedFile m_file;
+	};
+
+	// Layout of the spatiotemporal blue noise asset written by BlueNoiseConverter --stbn. All fields are little endian.
+	//  SpatiotemporalBlueNoiseAssetHeader
+	//  frameCount slices of width x height texels, two UNORM8 channels per texel.
+	// Each slice is blue in space, and each texel is blue over the slices (Wolfe et al., Spatiotemporal Blue Noise Masks).
+	static const uint32_t SPATIOTEMPORAL_BLUE_NOISE_ASSET_MAGIC = 0x4E425453; // "STBN"
+	// Bump on any change of the layout above. Older assets are rejected.
+	static const uint32_t SPATIOTEMPORAL_BLUE_NOISE_ASSET_VERSION = 1;
+	static const uint32_t SPATIOTEMPORAL_BLUE_NOISE_CHANNEL_COUNT = 2;
+
+	struct SpatiotemporalBlueNoiseAssetHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t width;
+		uint32_t height;
+		uint32_t frameCount;
+		uint32_t channelCount;
+		// Byte offset of the first slice from the start of the file.
+		uint32_t dataOffset;
+		uint32_t reserved;
+	};
+
+	/**
+		The SpatiotemporalBlueNoiseAsset class maps a spatiotemporal blue noise asset into memory.
+	*/
+	class SpatiotemporalBlueNoiseAsset
+	{
+	public:
+		// Returns false if the file is missing or not a valid asset of this version.
+		bool Open(const char* path);
+		void Close();
+
+		uint32_t GetWidth() const;
+		uint32_t GetHeight() const;
+		uint32_t GetFrameCount() const;
+		uint32_t GetSliceSize() const;
+		// Points into the mapped file and stays valid until the asset is closed.
+		const uint8_t* GetSlice(uint32_t frame) const;
+
+	private:
+		const SpatiotemporalBlueNoiseAssetHeader* Header() const;
+
+		MappedFile m_file;
+	};
+}
@@ -0,0 +1,134 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "DepthHierarchyComparison.h"
+
+// Same frame counts as the reference of the autotuner.
+static const uint32_t g_accumulatedFrameCount = 256;
+static const uint32_t g_frameCount = 240;
+
+namespace SSSR_SAMPLE_COMMON
+{
+	void DepthHierarchyComparison::Begin(bool accumulate, const char* errorImagePath)
+	{
+		m_isRunning = true;
+		m_accumulate = accumulate;
+		m_errorImagePath = errorImagePath;
+		m_run = Run::Reference;
+		m_frameCount = 0;
+		m_needsRestart = true;
+		m_needsReadback = false;
+		m_isReadbackPending = false;
+		m_errorFloor = 0.0f;
+		m_halfPrecisionError = 0.0f;
+		m_isErrorImageSaved = false;
+	}
+
+	void DepthHierarchyComparison::Update(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height)
+	{
+		m_needsRestart = false;
+		m_needsReadback = false;
+		if (!m_isRunning)
+		{
+			return;
+		}
+
+		if (m_isReadbackPending)
+		{
+			if (pReadback)
+			{
+				m_isReadbackPending = false;
+				NextRun(pReadback, rowPitch, width, height);
+			}
+		}
+		else if (++m_frameCount == (m_accumulate ? g_accumulatedFrameCount : g_frameCount))
+		{
+			m_needsReadback = true;
+			m_isReadbackPending = true;
+		}
+	}
+
+	bool DepthHierarchyComparison::IsRunning() const
+	{
+		return m_isRunning;
+	}
+
+	bool DepthHierarchyComparison::NeedsRestart() const
+	{
+		return m_needsRestart;
+	}
+
+	bool DepthHierarchyComparison::IsHalfPrecision() const
+	{
+		return m_run == Run::HalfPrecision;
+	}
+
+	bool DepthHierarchyComparison::IsAccumulating() const
+	{
+		return m_isRunning && m_accumulate;
+	}
+
+	bool DepthHierarchyComparison::NeedsReadback() const
+	{
+		return m_needsReadback;
+	}
+
+	float DepthHierarchyComparison::GetErrorFloor() const
+	{
+		return m_errorFloor;
+	}
+
+	float DepthHierarchyComparison::GetHalfPrecisionError() const
+	{
+		return m_halfPrecisionError;
+	}
+
+	bool DepthHierarchyComparison::IsErrorImageSaved() const
+	{
+		return m_isErrorImageSaved;
+	}
+
+	void DepthHierarchyComparison::NextRun(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height)
+	{
+		switch (m_run)
+		{
+		case Run::Reference:
+			m_reference.Store(pReadback, rowPitch, width, height);
+			m_run = Run::Repeat;
+			break;
+
+		case Run::Repeat:
+			m_errorFloor = m_reference.ComputeError(pReadback, rowPitch, width, height);
+			m_run = Run::HalfPrecision;
+			break;
+
+		case Run::HalfPrecision:
+			m_halfPrecisionError = m_reference.ComputeError(pReadback, rowPitch, width, height);
+			m_isErrorImageSaved = m_reference.SaveErrorImage(m_errorImagePath.c_str(), pReadback, rowPitch, width, height);
+			m_run = Run::Reference;
+			m_isRunning = false;
+			return;
+		}
+
+		m_frameCount = 0;
+		m_needsRestart = true;
+	}
+}
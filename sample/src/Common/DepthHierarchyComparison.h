@@ -0,0 +1,86 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include "ReflectionsImage.h"
+
+#include <cstdint>
+#include <string>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	/**
+		The DepthHierarchyComparison class measures how far the reflections traced against the 16 bit depth hierarchy are from those traced against the 32 bit one.
+
+		It renders the same frame three times, each time from a freshly created renderer so the frame index and the noise sequence start over.
+		The first run with the 32 bit hierarchy is the reference. A second one with the same hierarchy gives the error floor of the effect itself,
+		so the error of the last run with the 16 bit hierarchy can be told apart from nondeterminism. The per pixel error of the last run is saved as an image
+		that shows where the 16 bit hierarchy breaks down.
+		The caller renders a static scene and feeds the output readbacks back through Update once per frame.
+	*/
+	class DepthHierarchyComparison
+	{
+	public:
+		// The runs accumulate many samples per pixel if accumulate is set. Otherwise they only let the denoiser converge.
+		void Begin(bool accumulate, const char* errorImagePath);
+		// pReadback is the output requested by the last NeedsReadback as RGBA16F rows of rowPitch bytes, or null while the copy is in flight.
+		void Update(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height);
+
+		bool IsRunning() const;
+		// Set if the renderer has to be recreated with IsHalfPrecision before the next frame.
+		bool NeedsRestart() const;
+		bool IsHalfPrecision() const;
+		bool IsAccumulating() const;
+		// Set if the output of the next frame has to be read back.
+		bool NeedsReadback() const;
+
+		// Valid once the comparison stopped running. RMSE against the reference.
+		float GetErrorFloor() const;
+		float GetHalfPrecisionError() const;
+		bool IsErrorImageSaved() const;
+
+	private:
+		enum class Run
+		{
+			Reference,
+			Repeat,
+			HalfPrecision,
+		};
+
+		// Moves on to the next run, or stops after the last one.
+		void NextRun(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height);
+
+		bool m_isRunning = false;
+		bool m_accumulate = false;
+		bool m_needsRestart = false;
+		bool m_needsReadback = false;
+		bool m_isReadbackPending = false;
+		Run m_run = Run::Reference;
+		uint32_t m_frameCount = 0;
+		std::string m_errorImagePath;
+
+		ReflectionsImage m_reference;
+		float m_errorFloor = 0.0f;
+		float m_halfPrecisionError = 0.0f;
+		bool m_isErrorImageSaved = false;
+	};
+}
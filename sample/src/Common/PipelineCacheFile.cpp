@@ -0,0 +1,72 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "PipelineCacheFile.h"
+#include "MappedFile.h"
+
+#include <string>
+#include <windows.h>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	bool LoadPipelineCacheFile(const char* path, std::vector<uint8_t>& data)
+	{
+		MappedFile file;
+		if (!file.Open(path))
+		{
+			data.clear();
+			return false;
+		}
+		data.assign(file.Data(), file.Data() + file.Size());
+		return true;
+	}
+
+	bool SavePipelineCacheFile(const char* path, const void* pData, size_t size)
+	{
+		std::string temporaryPath = std::string(path) + ".tmp";
+		HANDLE file = CreateFileA(temporaryPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+
+		DWORD writtenSize = 0;
+		bool written = size <= MAXDWORD && WriteFile(file, pData, (DWORD)size, &writtenSize, nullptr) && writtenSize == size;
+		CloseHandle(file);
+		if (!written || !MoveFileExA(temporaryPath.c_str(), path, MOVEFILE_REPLACE_EXISTING))
+		{
+			DeleteFileA(temporaryPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	uint64_t HashPipelineData(const void* pData, size_t size)
+	{
+		const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash = (hash ^ pBytes[i]) * 1099511628211ull;
+		}
+		return hash;
+	}
+}
@@ -0,0 +1,49 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	/**
+		Counts the pipelines that were found in the persistent pipeline cache and those the driver had to compile.
+	*/
+	struct PipelineCacheStatistics
+	{
+		uint32_t hits = 0;
+		uint32_t misses = 0;
+		// Pipelines the driver did not report as either. Vulkan only tells them apart through the creation feedback.
+		uint32_t unknown = 0;
+		// Time spent by the driver creating pipelines, hits included. Summed over all threads that create pipelines.
+		double creationMilliseconds = 0.0;
+	};
+
+	// Returns false if the file is missing or empty.
+	bool LoadPipelineCacheFile(const char* path, std::vector<uint8_t>& data);
+	// Writes a temporary file that then replaces the cache, so a crash never leaves a truncated cache behind.
+	bool SavePipelineCacheFile(const char* path, const void* pData, size_t size);
+	// FNV-1a hash of the data. Tells pipelines apart by their shaders.
+	uint64_t HashPipelineData(const void* pData, size_t size);
+}
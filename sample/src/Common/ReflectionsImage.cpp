@@ -0,0 +1,165 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "ReflectionsImage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+static float HalfToFloat(uint16_t value)
+{
+	uint32_t sign = (value & 0x8000u) << 16;
+	uint32_t exponent = (value >> 10) & 0x1Fu;
+	uint32_t mantissa = value & 0x3FFu;
+	uint32_t bits;
+	if (exponent == 0x1Fu)
+	{
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	else if (mantissa != 0)
+	{
+		// Denormals are normalized for single precision.
+		exponent = 127 - 15 + 1;
+		while ((mantissa & 0x400u) == 0)
+		{
+			mantissa <<= 1;
+			--exponent;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+	}
+	else
+	{
+		bits = sign;
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
+
+static const uint16_t* GetPixel(const uint16_t* pReadback, uint32_t rowPitch, uint32_t x, uint32_t y)
+{
+	return reinterpret_cast<const uint16_t*>(reinterpret_cast<const uint8_t*>(pReadback) + y * rowPitch) + 4 * x;
+}
+
+namespace SSSR_SAMPLE_COMMON
+{
+	void ReflectionsImage::Store(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height)
+	{
+		m_width = width;
+		m_height = height;
+		m_rgb.resize(3ull * width * height);
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				const uint16_t* pPixel = GetPixel(pReadback, rowPitch, x, y);
+				for (uint32_t channel = 0; channel < 3; ++channel)
+				{
+					float value = HalfToFloat(pPixel[channel]);
+					m_rgb[3ull * (y * width + x) + channel] = std::isfinite(value) ? value : 0.0f;
+				}
+			}
+		}
+	}
+
+	float ReflectionsImage::ComputeError(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height) const
+	{
+		if (width != m_width || height != m_height)
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+
+		double squaredErrorSum = 0.0;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				double error = GetPixelError(pReadback, rowPitch, x, y);
+				squaredErrorSum += error * error;
+			}
+		}
+		return static_cast<float>(sqrt(squaredErrorSum / (3.0 * width * height)));
+	}
+
+	bool ReflectionsImage::SaveErrorImage(const char* path, const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height) const
+	{
+		if (width != m_width || height != m_height)
+		{
+			return false;
+		}
+
+		std::vector<float> errors(static_cast<size_t>(width) * height);
+		float maxError = 0.0f;
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				float error = GetPixelError(pReadback, rowPitch, x, y);
+				if (std::isfinite(error))
+				{
+					maxError = std::max(maxError, error);
+				}
+				else
+				{
+					// Non finite pixels are the worst ones.
+					error = std::numeric_limits<float>::max();
+				}
+				errors[static_cast<size_t>(y) * width + x] = error;
+			}
+		}
+
+		std::vector<uint8_t> pixels(errors.size());
+		for (size_t i = 0; i < errors.size(); ++i)
+		{
+			float normalized = maxError > 0.0f ? std::min(errors[i] / maxError, 1.0f) : 0.0f;
+			pixels[i] = static_cast<uint8_t>(normalized * 255.0f + 0.5f);
+		}
+
+		std::ofstream f(path, std::ios::binary);
+		if (!f)
+		{
+			return false;
+		}
+		f << "P5\n" << width << " " << height << "\n255\n";
+		f.write(reinterpret_cast<const char*>(pixels.data()), pixels.size());
+		return f.good();
+	}
+
+	float ReflectionsImage::GetPixelError(const uint16_t* pReadback, uint32_t rowPitch, uint32_t x, uint32_t y) const
+	{
+		const uint16_t* pPixel = GetPixel(pReadback, rowPitch, x, y);
+		double squaredError = 0.0;
+		for (uint32_t channel = 0; channel < 3; ++channel)
+		{
+			double difference = HalfToFloat(pPixel[channel]) - m_rgb[3ull * (y * m_width + x) + channel];
+			squaredError += difference * difference;
+		}
+		return static_cast<float>(sqrt(squaredError));
+	}
+}
@@ -0,0 +1,54 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	/**
+		The ReflectionsImage class keeps the RGB of a reflection output read back from the GPU, so later outputs can be compared against it.
+		Readbacks are RGBA16F rows of rowPitch bytes.
+	*/
+	class ReflectionsImage
+	{
+	public:
+		// NaNs and infinities in the readback are stored as zero.
+		void Store(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height);
+
+		// RMSE of the RGB channels of the readback against the stored image.
+		// Infinite if the sizes differ. NaNs and infinities in the readback propagate.
+		float ComputeError(const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height) const;
+		// Writes the per pixel error of the readback against the stored image as a binary PGM. The largest error is white.
+		bool SaveErrorImage(const char* path, const uint16_t* pReadback, uint32_t rowPitch, uint32_t width, uint32_t height) const;
+
+	private:
+		// Euclidean distance of the RGB of a readback pixel to the stored one.
+		float GetPixelError(const uint16_t* pReadback, uint32_t rowPitch, uint32_t x, uint32_t y) const;
+
+		// RGB, width * height pixels.
+		std::vector<float> m_rgb;
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+	};
+}
@@ -0,0 +1,159 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "RenderGraph.h"
+
+#include <cassert>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	static bool IsWriteState(ResourceState state)
+	{
+		return state == ResourceState::UnorderedAccess || state == ResourceState::CopyDestination;
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::Read(RenderGraphResource resource, ResourceState state)
+	{
+		assert(!IsWriteState(state));
+		m_accesses.push_back({ resource, state });
+		return *this;
+	}
+
+	RenderGraph::Pass& RenderGraph::Pass::Write(RenderGraphResource resource, ResourceState state)
+	{
+		assert(IsWriteState(state));
+		m_accesses.push_back({ resource, state });
+		return *this;
+	}
+
+	void RenderGraph::SetSplitBarriers(bool enabled)
+	{
+		m_splitBarriers = enabled;
+	}
+
+	RenderGraphResource RenderGraph::AddResource(ResourceState state)
+	{
+		m_resources.push_back({ state, 0 });
+		return (RenderGraphResource)(m_resources.size() - 1);
+	}
+
+	void RenderGraph::RemoveResources()
+	{
+		assert(m_passCount == 0 && m_exports.empty());
+		m_resources.clear();
+	}
+
+	ResourceState RenderGraph::GetState(RenderGraphResource resource) const
+	{
+		return m_resources[resource].state;
+	}
+
+	RenderGraph::Pass& RenderGraph::AddPass(std::function<void()> execute)
+	{
+		if (m_passCount == m_passes.size())
+		{
+			m_passes.emplace_back();
+		}
+		Pass& pass = m_passes[m_passCount++];
+		pass.m_execute = std::move(execute);
+		pass.m_accesses.clear();
+		return pass;
+	}
+
+	void RenderGraph::Export(RenderGraphResource resource, ResourceState state)
+	{
+		m_exports.push_back({ resource, state });
+	}
+
+	void RenderGraph::Execute(const BarrierCallback& issueBarriers)
+	{
+		if (m_batches.size() < m_passCount + 1)
+		{
+			m_batches.resize(m_passCount + 1);
+		}
+		for (uint32_t i = 0; i <= m_passCount; ++i)
+		{
+			m_batches[i].clear();
+		}
+
+		for (uint32_t i = 0; i < m_passCount; ++i)
+		{
+			for (const Pass::Access& access : m_passes[i].m_accesses)
+			{
+				Schedule(access.resource, access.state, i, false);
+			}
+		}
+		for (const Pass::Access& access : m_exports)
+		{
+			Schedule(access.resource, access.state, m_passCount, true);
+		}
+
+		for (uint32_t i = 0; i <= m_passCount; ++i)
+		{
+			if (!m_batches[i].empty())
+			{
+				issueBarriers(m_batches[i].data(), (uint32_t)m_batches[i].size());
+			}
+			if (i < m_passCount)
+			{
+				m_passes[i].m_execute();
+				// Releases whatever the pass captured.
+				m_passes[i].m_execute = nullptr;
+			}
+		}
+
+		// The next frame starts with the states left behind by this one.
+		for (Resource& resource : m_resources)
+		{
+			resource.nextBatch = 0;
+		}
+		m_passCount = 0;
+		m_exports.clear();
+	}
+
+	void RenderGraph::Schedule(RenderGraphResource resource, ResourceState state, uint32_t batch, bool exported)
+	{
+		Resource& tracked = m_resources[resource];
+		if (tracked.state != state)
+		{
+			// A pass may only access a resource in a single state.
+			assert(tracked.nextBatch <= batch);
+
+			// The passes in between neither read nor write the resource, so they can overlap with its transition.
+			if (m_splitBarriers && tracked.nextBatch < batch)
+			{
+				m_batches[tracked.nextBatch].push_back({ resource, tracked.state, state, BarrierPhase::Begin });
+				m_batches[batch].push_back({ resource, tracked.state, state, BarrierPhase::End });
+			}
+			else
+			{
+				m_batches[batch].push_back({ resource, tracked.state, state, BarrierPhase::Full });
+			}
+		}
+		else if (IsWriteState(state) && !exported && tracked.nextBatch <= batch)
+		{
+			// Writes of earlier passes have to finish first. Also covers the writes of the last frame.
+			m_batches[batch].push_back({ resource, state, state, BarrierPhase::Full });
+		}
+		tracked.state = state;
+		tracked.nextBatch = batch + 1;
+	}
+}
@@ -0,0 +1,131 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	/**
+		The ways a pass accesses a resource. The backends map them to resource states or to image layouts, access masks and pipeline stages.
+	*/
+	enum class ResourceState : uint32_t
+	{
+		ShaderResource,
+		UnorderedAccess,
+		IndirectArgument,
+		CopySource,
+		// Also the target of clears that are not done by a shader.
+		CopyDestination,
+	};
+
+	// Index of a resource in its render graph.
+	using RenderGraphResource = uint32_t;
+
+	enum class BarrierPhase : uint32_t
+	{
+		// Done right in front of the pass that needs the new state.
+		Full,
+		// Starts a split transition right after the last pass that used the old state.
+		Begin,
+		// Finishes a split transition in front of the pass that needs the new state.
+		End,
+	};
+
+	/**
+		Before and after are the same if a write has to finish before the resource is accessed again in the same state, like a UAV barrier.
+	*/
+	struct RenderGraphBarrier
+	{
+		RenderGraphResource resource;
+		ResourceState before;
+		ResourceState after;
+		BarrierPhase phase;
+	};
+
+	/**
+		Runs the passes of a frame with the barriers their resource accesses need in between.
+		Each pass gets at most one batch of barriers in front of it. A resource is only transitioned if its state changes
+		or after it was written, so repeated reads in the same state cost nothing. The states carry over from frame to frame.
+		With split barriers, a transition begins right after the last pass that used the old state and ends in front of the
+		pass that needs the new one, so the hardware can overlap it with the passes in between.
+	*/
+	class RenderGraph
+	{
+	public:
+		using BarrierCallback = std::function<void(const RenderGraphBarrier* pBarriers, uint32_t barrierCount)>;
+
+		class Pass
+		{
+		public:
+			Pass& Read(RenderGraphResource resource, ResourceState state = ResourceState::ShaderResource);
+			Pass& Write(RenderGraphResource resource, ResourceState state = ResourceState::UnorderedAccess);
+
+		private:
+			friend class RenderGraph;
+
+			struct Access
+			{
+				RenderGraphResource resource;
+				ResourceState state;
+			};
+
+			std::function<void()> m_execute;
+			std::vector<Access> m_accesses;
+		};
+
+		// Without split barriers every transition is done in full in front of the pass that needs it.
+		void SetSplitBarriers(bool enabled);
+		RenderGraphResource AddResource(ResourceState state);
+		// Forgets all resources. Needed once they are recreated.
+		void RemoveResources();
+		ResourceState GetState(RenderGraphResource resource) const;
+
+		// The pass executes once its barriers are done. It is valid until the next AddPass.
+		Pass& AddPass(std::function<void()> execute);
+		// Leaves the resource in this state after the last pass, for its users outside of the graph.
+		void Export(RenderGraphResource resource, ResourceState state);
+		// Issues the barriers and executes the passes added since the last call. Then forgets the passes and the exports.
+		void Execute(const BarrierCallback& issueBarriers);
+
+	private:
+		struct Resource
+		{
+			ResourceState state;
+			// Index of the first batch after the last access in the current state. Zero if the state comes from an earlier frame.
+			uint32_t nextBatch;
+		};
+
+		void Schedule(RenderGraphResource resource, ResourceState state, uint32_t batch, bool exported);
+
+		std::vector<Resource> m_resources;
+		// Passes are reused from frame to frame to keep their access lists allocated.
+		std::vector<Pass> m_passes;
+		uint32_t m_passCount = 0;
+		std::vector<Pass::Access> m_exports;
+		// Barriers in front of each pass. The last batch follows the last pass.
+		std::vector<std::vector<RenderGraphBarrier>> m_batches;
+		bool m_splitBarriers = false;
+	};
+}
@@ -0,0 +1,114 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#include "ShaderBlobLibrary.h"
+
+#include <fstream>
+#include <sstream>
+
+namespace SSSR_SAMPLE_COMMON
+{
+	bool ShaderBlobLibrary::Open(const char* directory)
+	{
+		Close();
+
+		m_directory = directory;
+		std::ifstream manifest(m_directory + "/ShaderPermutations.txt");
+		if (!manifest)
+		{
+			return false;
+		}
+
+		// One permutation per line: <blob file> <shader> [<define>=<value> ...]
+		std::string line;
+		while (std::getline(manifest, line))
+		{
+			std::istringstream tokens(line);
+			std::string blobFile;
+			std::string shader;
+			if (!(tokens >> blobFile >> shader))
+			{
+				continue;
+			}
+
+			std::map<std::string, std::string> defines;
+			std::string define;
+			while (tokens >> define)
+			{
+				size_t separator = define.find('=');
+				if (separator == std::string::npos)
+				{
+					defines[define] = "";
+				}
+				else
+				{
+					defines[define.substr(0, separator)] = define.substr(separator + 1);
+				}
+			}
+
+			std::string key = shader;
+			for (const auto& entry : defines)
+			{
+				AppendDefine(key, entry.first, entry.second);
+			}
+			m_blobFiles[key] = blobFile;
+		}
+		return !m_blobFiles.empty();
+	}
+
+	void ShaderBlobLibrary::Close()
+	{
+		m_blobs.clear();
+		m_blobFiles.clear();
+		m_directory.clear();
+	}
+
+	void ShaderBlobLibrary::AppendDefine(std::string& key, const std::string& name, const std::string& value)
+	{
+		key += ' ';
+		key += name;
+		key += '=';
+		key += value;
+	}
+
+	const MappedFile* ShaderBlobLibrary::Find(const std::string& key)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto blob = m_blobs.find(key);
+		if (blob != m_blobs.end())
+		{
+			return blob->second.get();
+		}
+
+		auto blobFile = m_blobFiles.find(key);
+		if (blobFile == m_blobFiles.end())
+		{
+			return nullptr;
+		}
+
+		std::unique_ptr<MappedFile> file(new MappedFile());
+		if (!file->Open((m_directory + "/" + blobFile->second).c_str()))
+		{
+			return nullptr;
+		}
+		return (m_blobs[key] = std::move(file)).get();
+	}
+}
@@ -0,0 +1,69 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+#pragma once
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "MappedFile.h"
+
+namespace SSSR_SAMPLE_COMMON
+{
+	/**
+		The ShaderBlobLibrary class loads the shader permutations that were compiled ahead of time, see Shaders/ShaderPermutations.cmake.
+		Its manifest maps the shader and the defines of each permutation to the file of its blob.
+	*/
+	class ShaderBlobLibrary
+	{
+	public:
+		// Returns false if the directory holds no manifest, e.g. because DXC was not found at build time.
+		bool Open(const char* directory);
+		void Close();
+
+		// Returns the blob of the permutation compiled with exactly these defines, or nullptr if it was not compiled ahead of time.
+		// The blob stays mapped until the library is closed. May be called from several threads at once.
+		template<typename DefineMap>
+		const MappedFile* Find(const char* shader, const DefineMap& defines)
+		{
+			std::string key = shader;
+			for (const auto& define : defines)
+			{
+				AppendDefine(key, define.first, define.second);
+			}
+			return Find(key);
+		}
+
+	private:
+		// Defines are appended in the order of their names, so the key does not depend on the order in the manifest.
+		static void AppendDefine(std::string& key, const std::string& name, const std::string& value);
+		const MappedFile* Find(const std::string& key);
+
+		std::string m_directory;
+		// Blob file by permutation key.
+		std::map<std::string, std::string> m_blobFiles;
+		std::map<std::string, std::unique_ptr<MappedFile>> m_blobs;
+		// Guards the blobs mapped on first use.
+		std::mutex m_mutex;
+	};
+}
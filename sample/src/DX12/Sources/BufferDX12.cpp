@@ -41,13 +41,15 @@ namespace  SSSR_SAMPLE_DX12
 
 		m_numElements = 0;
 		m_elementSize = 0;
+		m_format = DXGI_FORMAT_UNKNOWN;
 	}
 
-	void BufferDX12::InitFromMem(CAULDRON_DX12::Device* pDevice, const char* pDebugName, UploadHeapBuffersDX12* pUploadHeap, const void* pData, int numElements, int elementSize)
+	void BufferDX12::InitFromMem(CAULDRON_DX12::Device* pDevice, const char* pDebugName, UploadHeapBuffersDX12* pUploadHeap, const void* pData, int numElements, int elementSize, DXGI_FORMAT format)
 	{
 		m_pDevice = pDevice;
 		m_numElements = numElements;
 		m_elementSize = elementSize;
+		m_format = format;
 
 		uint32_t size = numElements * elementSize;
 
@@ -73,11 +75,11 @@ namespace  SSSR_SAMPLE_DX12
 	void BufferDX12::CreateSRV(uint32_t index, CAULDRON_DX12::CBV_SRV_UAV* pRV)
 	{
 		D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-		srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		srvDesc.Format = m_format;
 		srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
 		srvDesc.Buffer.FirstElement = 0;
 		srvDesc.Buffer.NumElements = m_numElements;
-		srvDesc.Buffer.StructureByteStride = m_elementSize;
+		srvDesc.Buffer.StructureByteStride = m_format == DXGI_FORMAT_UNKNOWN ? m_elementSize : 0;
 		srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;// D3D12_BUFFER_SRV_FLAG_RAW;
 		srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
 		m_pDevice->GetDevice()->CreateShaderResourceView(m_pBuffer, &srvDesc, pRV->GetCPU(index));
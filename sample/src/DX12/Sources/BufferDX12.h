@@ -32,7 +32,8 @@ namespace SSSR_SAMPLE_DX12
 	{
 	public:
 		BufferDX12();
-		void InitFromMem(Device* pDevice, const char* pDebugName, UploadHeapBuffersDX12* pUploadHeap, const void* pData, int numElements, int elementSize);
+		// Creates typed views if format is given, structured views otherwise.
+		void InitFromMem(Device* pDevice, const char* pDebugName, UploadHeapBuffersDX12* pUploadHeap, const void* pData, int numElements, int elementSize, DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN);
 		void Release();
 		void CreateSRV(uint32_t index, CBV_SRV_UAV* pRV);
 
@@ -42,5 +43,6 @@ namespace SSSR_SAMPLE_DX12
 
 		int m_numElements;
 		int m_elementSize;
+		DXGI_FORMAT m_format;
 	};
 }
\ No newline at end of file
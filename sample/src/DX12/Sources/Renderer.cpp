@@ -27,14 +27,38 @@ THE SOFTWARE.
 #undef max
 #undef min
 
+/**
+	Screen space depth is a hyperbolic function of the linear depth (the clip space w): depth = parameters[0] + parameters[1] / w.
+	parameters[2] receives the linear depth of the far plane.
+*/
+static void GetLinearDepthParameters(const math::Matrix4& proj, float parameters[3])
+{
+	// Matrix4::getElem takes the column first.
+	const float p22 = proj.getElem(2, 2);
+	const float p23 = proj.getElem(3, 2);
+	const float p32 = proj.getElem(2, 3);
+	const float p33 = proj.getElem(3, 3);
+	parameters[0] = p22 / p32;
+	parameters[1] = p23 - p22 * p33 / p32;
+	parameters[2] = parameters[1] / (1.0f - parameters[0]);
+}
+
 //--------------------------------------------------------------------------------------
 //
 // OnCreate
 //
 //--------------------------------------------------------------------------------------
-void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize)
+void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize, bool HalfPrecisionDepthHierarchy, bool LinearDepthHierarchy, uint32_t MaxDepthHierarchyMipLevel, bool FusedDepthDownsample, uint32_t BlueNoiseSamplesPerPixel, bool SpatiotemporalBlueNoise, uint32_t AccumulationSamplesPerPixel, bool LowPrecisionHistory)
 {
 	m_pDevice = pDevice;
+	m_bHalfPrecisionDepthHierarchy = HalfPrecisionDepthHierarchy && !LinearDepthHierarchy;
+	m_bLinearDepthHierarchy = LinearDepthHierarchy;
+	m_bFusedDepthDownsample = FusedDepthDownsample && !LinearDepthHierarchy;
+	m_bAccumulationAvailable = AccumulationSamplesPerPixel > 0;
+	m_bLowPrecisionHistory = LowPrecisionHistory;
+	// Rough tiles start the traversal one mip above the most detailed one, so keep at least mip 1 around.
+	m_MaxDepthHierarchyMipLevel = std::max(1u, std::min(MaxDepthHierarchyMipLevel, DEPTH_HIERARCHY_MAX_MIP_COUNT - 1));
+	m_FrameIndex = 0;
 
 	// Initialize helpers
 
@@ -142,7 +166,7 @@ void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize)
 	ID3D12GraphicsCommandList* cl;
 	ThrowIfFailed(m_pDevice->GetDevice()->CreateCommandList(0, D3D12_COMMAND_LIST_TYPE_DIRECT, ca, nullptr, IID_PPV_ARGS(&cl)));
 
-	m_Sssr.OnCreate(m_pDevice, m_CpuVisibleHeap, m_ResourceViewHeaps, m_UploadHeap, m_ConstantBufferRing, backBufferCount, true);
+	m_Sssr.OnCreate(m_pDevice, m_CpuVisibleHeap, m_ResourceViewHeaps, m_UploadHeap, m_ConstantBufferRing, backBufferCount, true, m_bLinearDepthHierarchy, m_bHalfPrecisionDepthHierarchy, m_bFusedDepthDownsample, BlueNoiseSamplesPerPixel, SpatiotemporalBlueNoise, AccumulationSamplesPerPixel, &m_AsyncPool);
 
 	// Wait for the upload to finish;
 	ThrowIfFailed(cl->Close());
@@ -152,8 +176,8 @@ void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize)
 	ca->Release();
 
 	// Desctriptor table for apply pass
-	m_ResourceViewHeaps.AllocCBV_SRV_UAVDescriptor(4, &m_ApplyPassDescriptorTable[0]);
-	m_ResourceViewHeaps.AllocCBV_SRV_UAVDescriptor(4, &m_ApplyPassDescriptorTable[1]);
+	m_ResourceViewHeaps.AllocCBV_SRV_UAVDescriptor(5, &m_ApplyPassDescriptorTable[0]);
+	m_ResourceViewHeaps.AllocCBV_SRV_UAVDescriptor(5, &m_ApplyPassDescriptorTable[1]);
 
 
 	// Make sure upload heap has finished uploading before continuing
@@ -194,6 +218,8 @@ void Renderer::OnDestroy()
 		m_ApplyPipelineState->Release();
 	if (m_ApplyRootSignature != nullptr)
 		m_ApplyRootSignature->Release();
+	if (m_ApplyCommandSignature != nullptr)
+		m_ApplyCommandSignature->Release();
 	if (m_DownsamplePipelineState != nullptr)
 		m_DownsamplePipelineState->Release();
 	if (m_DownsampleRootSignature != nullptr)
@@ -250,15 +276,29 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 
 	// Depth downsampling pass with single CS
 	{
-		m_DepthMipLevelCount = static_cast<uint32_t>(std::log2(std::max(m_Width, m_Height))) + 1;
+		// The SSSR passes read mip 0 from the depth buffer. Only linear depth differs from it and needs its own copy.
+		m_DepthHierarchyFirstMip = m_bLinearDepthHierarchy ? 0 : 1;
+		m_DepthMipLevelCount = std::min(static_cast<uint32_t>(std::log2(std::max(m_Width, m_Height))) + 1, m_MaxDepthHierarchyMipLevel + 1) - m_DepthHierarchyFirstMip;
+		const uint32_t hierarchyWidth = std::max(m_Width >> m_DepthHierarchyFirstMip, 1u);
+		const uint32_t hierarchyHeight = std::max(m_Height >> m_DepthHierarchyFirstMip, 1u);
 
 		// Downsampled depth buffer
-		CD3DX12_RESOURCE_DESC dsResDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_FLOAT, m_Width, m_Height, 1, m_DepthMipLevelCount, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		CD3DX12_RESOURCE_DESC dsResDesc = CD3DX12_RESOURCE_DESC::Tex2D(m_bHalfPrecisionDepthHierarchy ? DXGI_FORMAT_R16_UNORM : DXGI_FORMAT_R32_FLOAT, hierarchyWidth, hierarchyHeight, 1, m_DepthMipLevelCount, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 		m_DepthHierarchy.Init(m_pDevice, "m_DepthHierarchy", &dsResDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
-		UINT i = 0;
-		for (; i < 13u; ++i)
+		CD3DX12_RESOURCE_DESC dummyResDesc = CD3DX12_RESOURCE_DESC::Tex2D(dsResDesc.Format, 1, 1, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		m_DepthHierarchyDummy.Init(m_pDevice, "m_DepthHierarchyDummy", &dummyResDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+		// The downsampling writes up to the coarsest mip, which is the last one created.
+		assert(std::min(static_cast<uint32_t>(std::log2(std::max(m_Width, m_Height))), m_MaxDepthHierarchyMipLevel) == GetDepthHierarchyMaxMip());
+		for (UINT i = 0; i < 13u; ++i)
 		{
-			m_DepthHierarchy.CreateUAV(0, &m_DepthHierarchyDescriptors[i], std::min(i, m_DepthMipLevelCount - 1));
+			if (i < m_DepthMipLevelCount)
+			{
+				m_DepthHierarchy.CreateUAV(0, &m_DepthHierarchyDescriptors[i], i);
+			}
+			else
+			{
+				m_DepthHierarchyDummy.CreateUAV(0, &m_DepthHierarchyDescriptors[i]);
+			}
 		}
 
 		// Atomic counter
@@ -274,10 +314,16 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 	sssr_input_textures.NormalBuffer = &m_GBuffer.m_NormalBuffer;
 	sssr_input_textures.MotionVectors = &m_GBuffer.m_MotionVectors;
 	sssr_input_textures.DepthHierarchy = &m_DepthHierarchy;
+	sssr_input_textures.DepthBuffer = m_DepthHierarchyFirstMip == 0 ? &m_DepthHierarchy : &m_GBuffer.m_DepthBuffer;
+	sssr_input_textures.DepthHierarchyAtomicCounter = &m_AtomicCounter;
+	sssr_input_textures.DepthHierarchyMipCount = m_DepthMipLevelCount;
+	sssr_input_textures.DepthHierarchyDummy = &m_DepthHierarchyDummy;
 	sssr_input_textures.SpecularRoughness = &m_GBuffer.m_SpecularRoughness;
+	sssr_input_textures.BrdfLut = &m_BrdfLut;
 	sssr_input_textures.SkyDome = &m_SkyDome;
 	sssr_input_textures.outputWidth = Width;
 	sssr_input_textures.outputHeight = Height;
+	sssr_input_textures.lowPrecisionHistory = m_bLowPrecisionHistory;
 	m_Sssr.OnCreateWindowSizeDependentResources(sssr_input_textures);
 
 	// Fill descriptor table for apply pass
@@ -287,6 +333,7 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 		m_GBuffer.m_NormalBuffer.CreateSRV(1, &m_ApplyPassDescriptorTable[i]);
 		m_GBuffer.m_SpecularRoughness.CreateSRV(2, &m_ApplyPassDescriptorTable[i]);
 		m_BrdfLut.CreateSRV(3, &m_ApplyPassDescriptorTable[i]);
+		m_Sssr.GetReflectionTileList()->CreateSRV(4, &m_ApplyPassDescriptorTable[i]);
 	}
 }
 
@@ -313,6 +360,7 @@ void Renderer::OnDestroyWindowSizeDependentResources()
 	m_Sssr.OnDestroyWindowSizeDependentResources();
 
 	m_DepthHierarchy.OnDestroy();
+	m_DepthHierarchyDummy.OnDestroy();
 	m_AtomicCounter.OnDestroy();
 }
 
@@ -440,6 +488,9 @@ int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int Stage)
 //--------------------------------------------------------------------------------------
 void Renderer::UnloadScene()
 {
+	// The next scene must not reuse the reflections of this one.
+	++m_SceneRevision;
+
 	// wait for all the async loading operations to finish
 	m_AsyncPool.Flush();
 
@@ -534,14 +585,18 @@ void Renderer::StallFrame(float targetFrametime)
 	}
 }
 
-void Renderer::DownsampleDepthBuffer(ID3D12GraphicsCommandList* pCmdLst1)
+void Renderer::DownsampleDepthBuffer(ID3D12GraphicsCommandList* pCmdLst1, const Camera& Cam)
 {
 	UserMarker marker(pCmdLst1, "Downsample Depth");
 
+	float linearDepthParameters[3];
+	GetLinearDepthParameters(Cam.GetProjection(), linearDepthParameters);
+
 	ID3D12DescriptorHeap* descriptorHeaps[] = { m_ResourceViewHeaps.GetCBV_SRV_UAVHeap() };
 	pCmdLst1->SetDescriptorHeaps(1, descriptorHeaps);
 	pCmdLst1->SetComputeRootSignature(m_DownsampleRootSignature);
 	pCmdLst1->SetComputeRootDescriptorTable(0, m_DownsampleDescriptorTable);
+	pCmdLst1->SetComputeRoot32BitConstants(1, _countof(linearDepthParameters), linearDepthParameters, 0);
 	pCmdLst1->SetPipelineState(m_DownsamplePipelineState);
 
 	// Each threadgroup works on 64x64 texels
@@ -564,17 +619,40 @@ void Renderer::RenderScreenSpaceReflections(ID3D12GraphicsCommandList* pCmdLst1,
 	sssrConstants.frameIndex = m_FrameIndex;
 	sssrConstants.maxTraversalIntersections = pState->maxTraversalIterations;
 	sssrConstants.minTraversalOccupancy = pState->minTraversalOccupancy;
-	sssrConstants.mostDetailedMip = pState->mostDetailedDepthHierarchyMipLevel;
+	sssrConstants.maxTraversalMip = GetDepthHierarchyMaxMip();
+	// Rough tiles start one mip above the most detailed one, which has to exist.
+	sssrConstants.mostDetailedMip = std::min<uint32_t>(pState->mostDetailedDepthHierarchyMipLevel, sssrConstants.maxTraversalMip - 1);
+	sssrConstants.mipUsageStatisticsEnabled = pState->bCollectMipUsageStatistics ? 1 : 0;
 	sssrConstants.temporalStabilityFactor = pState->temporalStability;
 	sssrConstants.depthBufferThickness = pState->depthBufferThickness;
-	sssrConstants.samplesPerQuad = pState->samplesPerQuad;
-	sssrConstants.temporalVarianceGuidedTracingEnabled = pState->bEnableTemporalVarianceGuidedTracing ? 1 : 0;
+	// The accumulation traces every reflective pixel in every frame and skips the denoiser.
+	const bool accumulate = pState->bAccumulateSamples && m_bAccumulationAvailable;
+	sssrConstants.samplesPerQuad = accumulate ? 4 : pState->samplesPerQuad;
+	sssrConstants.temporalVarianceGuidedTracingEnabled = pState->bEnableTemporalVarianceGuidedTracing && !accumulate ? 1 : 0;
 	sssrConstants.varianceThreshold = pState->temporalVarianceThreshold;
+	sssrConstants.maxSampleCount = pState->maxSampleCount;
+	sssrConstants.disocclusionThreshold = pState->disocclusionThreshold;
+	sssrConstants.spatialFilterNormalSigma = pState->spatialFilterNormalSigma;
+	sssrConstants.spatialFilterDepthSigma = pState->spatialFilterDepthSigma;
+	sssrConstants.spatialFilterLuminanceSigma = pState->spatialFilterLuminanceSigma;
+	sssrConstants.neighborhoodClampSigma = pState->neighborhoodClampSigma;
 	sssrConstants.roughnessThreshold = pState->roughnessThreshold;
+	sssrConstants.roughReflectionFraction = pState->roughReflectionFraction;
+	// The debug views rely on the separate apply pass.
+	sssrConstants.applyReflectionsInResolve = pState->bApplyReflectionsInResolve && pState->bApplyScreenSpaceReflections && !pState->bShowReflectionTarget && !pState->bShowIntersectionResults && !accumulate ? 1 : 0;
+	sssrConstants.convergedRaySkippingEnabled = pState->bSkipConvergedRays && !accumulate ? 1 : 0;
+	// One step of the 16 bit UNORM hierarchy. DepthDownsample.hlsl rounds towards the camera by at most this much.
+	sssrConstants.depthHierarchyTolerance = m_bHalfPrecisionDepthHierarchy ? 1.0f / 65535.0f : 0.0f;
 
 	math::Matrix4 view = Cam.GetView();
 	math::Matrix4 proj = Cam.GetProjection();
 
+	float linearDepthParameters[3];
+	GetLinearDepthParameters(proj, linearDepthParameters);
+	sssrConstants.linearDepthParameters[0] = linearDepthParameters[0];
+	sssrConstants.linearDepthParameters[1] = linearDepthParameters[1];
+	sssrConstants.linearFarDepth = linearDepthParameters[2];
+
 	sssrConstants.projection = proj;
 	sssrConstants.invProjection = math::inverse(proj);
 	sssrConstants.view = view;
@@ -582,7 +660,27 @@ void Renderer::RenderScreenSpaceReflections(ID3D12GraphicsCommandList* pCmdLst1,
 	sssrConstants.prevViewProjection = pPerFrame->mCameraPrevViewProj;
 	sssrConstants.invViewProjection = pPerFrame->mInverseCameraCurrViewProj;
 
-	m_Sssr.Draw(pCmdLst1, sssrConstants, m_GPUTimer, pState->bShowIntersectionResults);
+	// Without animations only camera movement, lighting and UI changes alter the reflections. SSSR detects changed constants on its own, the lighting is tracked by the scene revision.
+	// The accumulation has to know about animations even if static frames are not reused.
+	bool isSceneStatic = !pState->bIsAnimationPlaying;
+	bool reuseStaticFrames = pState->bReuseStaticFrames && !pState->bDisableStaticFrameReuse;
+	UpdateSceneRevision(pPerFrame);
+	m_Sssr.Draw(pCmdLst1, sssrConstants, m_GPUTimer, pState->bShowIntersectionResults, pState->bUseFusedDenoiser, isSceneStatic, reuseStaticFrames, m_SceneRevision, accumulate);
+}
+
+void Renderer::UpdateSceneRevision(const per_frame* pPerFrame)
+{
+	// Everything the shading of a static scene depends on apart from the camera, which SSSR compares on its own.
+	const size_t lightsSize = pPerFrame->lightCount * sizeof(pPerFrame->lights[0]);
+	m_Lighting.swap(m_PreviousLighting);
+	m_Lighting.resize(2 * sizeof(float) + lightsSize);
+	memcpy(m_Lighting.data(), &pPerFrame->iblFactor, sizeof(float));
+	memcpy(m_Lighting.data() + sizeof(float), &pPerFrame->emmisiveFactor, sizeof(float));
+	memcpy(m_Lighting.data() + 2 * sizeof(float), pPerFrame->lights, lightsSize);
+	if (m_Lighting != m_PreviousLighting)
+	{
+		++m_SceneRevision;
+	}
 }
 
 void Renderer::ApplyReflectionTarget(ID3D12GraphicsCommandList* pCmdLst1, const Camera& Cam, const UIState* pState)
@@ -605,7 +703,7 @@ void Renderer::ApplyReflectionTarget(ID3D12GraphicsCommandList* pCmdLst1, const
 	ID3D12DescriptorHeap* descriptorHeaps[] = { m_ResourceViewHeaps.GetCBV_SRV_UAVHeap() };
 	pCmdLst1->SetDescriptorHeaps(1, descriptorHeaps);
 	pCmdLst1->SetGraphicsRootSignature(m_ApplyRootSignature);
-	pCmdLst1->SetGraphicsRootDescriptorTable(0, m_ApplyPassDescriptorTable[m_FrameIndex % 2].GetGPU());
+	pCmdLst1->SetGraphicsRootDescriptorTable(0, m_ApplyPassDescriptorTable[m_Sssr.GetOutputIndex()].GetGPU());
 	pCmdLst1->SetGraphicsRootConstantBufferView(1, cb);
 	pCmdLst1->SetPipelineState(m_ApplyPipelineState);
 	pCmdLst1->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
@@ -623,7 +721,15 @@ void Renderer::ApplyReflectionTarget(ID3D12GraphicsCommandList* pCmdLst1, const
 
 	D3D12_CPU_DESCRIPTOR_HANDLE rtvHandle = m_ApplyPipelineRTV.GetCPU();
 	pCmdLst1->OMSetRenderTargets(1, &rtvHandle, false, nullptr);
-	pCmdLst1->DrawInstanced(3, 1, 0, 0);
+
+	// Only tiles containing reflections are drawn. Clear the rest of the screen when showing the reflection target alone.
+	if (pState->bShowReflectionTarget)
+	{
+		float clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		pCmdLst1->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
+	}
+
+	pCmdLst1->ExecuteIndirect(m_ApplyCommandSignature, 1, m_Sssr.GetReflectionTileDrawArgs(), m_Sssr.GetReflectionTileDrawArgsOffset(), nullptr, 0);
 
 	m_GPUTimer.GetTimeStamp(pCmdLst1, "Apply Reflection View");
 }
@@ -852,20 +958,23 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 	};
 	pCmdLst1->ResourceBarrier(_countof(preResolve), preResolve);
 
-	// Downsample depth buffer
-	if (m_GLTFPBR && pPerFrame != NULL)
+	// Downsample depth buffer. If it is fused into the tile classification, SSSR transitions the hierarchy itself.
+	if (m_GLTFPBR && pPerFrame != NULL && !m_bFusedDepthDownsample)
 	{
-		DownsampleDepthBuffer(pCmdLst1);
+		DownsampleDepthBuffer(pCmdLst1, Cam);
 	}
 
-	Barriers(pCmdLst1, {
-		CD3DX12_RESOURCE_BARRIER::UAV(m_DepthHierarchy.GetResource()),
-		CD3DX12_RESOURCE_BARRIER::Transition(m_DepthHierarchy.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_DepthBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE),
+	std::vector<D3D12_RESOURCE_BARRIER> preReflectionBarriers = {
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_NormalBuffer.GetResource(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0),
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_SpecularRoughness.GetResource(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0),
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_MotionVectors.GetResource(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, 0),
-		});
+	};
+	if (!m_bFusedDepthDownsample)
+	{
+		preReflectionBarriers.push_back(CD3DX12_RESOURCE_BARRIER::UAV(m_DepthHierarchy.GetResource()));
+		preReflectionBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_DepthHierarchy.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE));
+	}
+	Barriers(pCmdLst1, preReflectionBarriers);
 
 	// Stochastic Screen Space Reflections
 	if (m_GLTFPBR && pPerFrame != NULL) // Only draw reflections if we draw objects
@@ -873,12 +982,17 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 		RenderScreenSpaceReflections(pCmdLst1, Cam, pPerFrame, pState);
 	}
 
-	Barriers(pCmdLst1, {
-		CD3DX12_RESOURCE_BARRIER::Transition(m_Sssr.GetOutputTexture(m_FrameIndex % 2)->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE), // Wait for reflection target to be written
-		CD3DX12_RESOURCE_BARRIER::Transition(m_DepthHierarchy.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
+	std::vector<D3D12_RESOURCE_BARRIER> postReflectionBarriers = {
+		CD3DX12_RESOURCE_BARRIER::Transition(m_Sssr.GetOutputTexture(m_Sssr.GetOutputIndex())->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE), // Wait for reflection target to be written
+		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_DepthBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_DEPTH_WRITE), // Read as mip 0 of the depth hierarchy
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_HDR.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET, 0),
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_MotionVectors.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET, 0)
-		});
+	};
+	if (!m_bFusedDepthDownsample)
+	{
+		postReflectionBarriers.push_back(CD3DX12_RESOURCE_BARRIER::Transition(m_DepthHierarchy.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS));
+	}
+	Barriers(pCmdLst1, postReflectionBarriers);
 
 	// Apply the result of SSSR
 	if (m_GLTFPBR && pPerFrame != NULL) // Only reflect if we draw objects
@@ -889,7 +1003,7 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 	// Bloom, takes HDR as input and applies bloom to it.
 	Barriers(pCmdLst1, {
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_HDR.GetResource(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE),
-		CD3DX12_RESOURCE_BARRIER::Transition(m_Sssr.GetOutputTexture(m_FrameIndex % 2)->GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		CD3DX12_RESOURCE_BARRIER::Transition(m_Sssr.GetOutputTexture(m_Sssr.GetOutputIndex())->GetResource(), D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_SpecularRoughness.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET),
 		CD3DX12_RESOURCE_BARRIER::Transition(m_GBuffer.m_NormalBuffer.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_RENDER_TARGET)
 		});
@@ -1055,11 +1169,12 @@ void Renderer::CreateApplyReflectionsPipeline()
 
 	CD3DX12_ROOT_PARAMETER root[2];
 
-	CD3DX12_DESCRIPTOR_RANGE descTable[4];
+	CD3DX12_DESCRIPTOR_RANGE descTable[5];
 	descTable[0].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 	descTable[1].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 1);
 	descTable[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 2);
 	descTable[3].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 3);
+	descTable[4].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 4);
 	root[0].InitAsDescriptorTable(ARRAYSIZE(descTable), descTable);
 	root[1].InitAsConstantBufferView(0);
 
@@ -1164,6 +1279,23 @@ void Renderer::CreateApplyReflectionsPipeline()
 		ThrowIfFailed(hr);
 	}
 
+	// Draws one quad per tile containing reflections. The arguments are written by SSSR.
+	D3D12_INDIRECT_ARGUMENT_DESC draw = {};
+	draw.Type = D3D12_INDIRECT_ARGUMENT_TYPE_DRAW;
+
+	D3D12_COMMAND_SIGNATURE_DESC commandSignatureDesc = {};
+	commandSignatureDesc.ByteStride = sizeof(D3D12_DRAW_ARGUMENTS);
+	commandSignatureDesc.NodeMask = 0;
+	commandSignatureDesc.NumArgumentDescs = 1;
+	commandSignatureDesc.pArgumentDescs = &draw;
+
+	hr = device->CreateCommandSignature(&commandSignatureDesc, nullptr, IID_PPV_ARGS(&m_ApplyCommandSignature));
+	if (FAILED(hr))
+	{
+		Trace("Failed to create command signature for apply pipeline.\n");
+		ThrowIfFailed(hr);
+	}
+
 	rs->Release();
 }
 
@@ -1171,7 +1303,7 @@ void Renderer::CreateDepthDownsamplePipeline()
 {
 	HRESULT hr;
 
-	static constexpr uint32_t numRootParameters = 1;
+	static constexpr uint32_t numRootParameters = 2;
 	CD3DX12_ROOT_PARAMETER root[numRootParameters];
 
 	CD3DX12_DESCRIPTOR_RANGE ranges[3] = {};
@@ -1180,6 +1312,8 @@ void Renderer::CreateDepthDownsamplePipeline()
 	ranges[2].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 13);
 
 	root[0].InitAsDescriptorTable(3, ranges);
+	// Parameters to linearize the depth, see GetLinearDepthParameters.
+	root[1].InitAsConstants(3, 0);
 
 	D3D12_ROOT_SIGNATURE_DESC rsDesc = {};
 	rsDesc.NumParameters = numRootParameters;
@@ -1211,6 +1345,11 @@ void Renderer::CreateDepthDownsamplePipeline()
 
 	D3D12_SHADER_BYTECODE shaderByteCode = {};
 	DefineList defines;
+	if (m_bHalfPrecisionDepthHierarchy)
+		defines["HALF_PRECISION_DEPTH_HIERARCHY"] = "1";
+	if (m_bLinearDepthHierarchy)
+		defines["LINEAR_DEPTH_HIERARCHY"] = "1";
+	defines["DEPTH_HIERARCHY_MAX_MIP"] = std::to_string(m_MaxDepthHierarchyMipLevel);
 	CompileShaderFromFile("DepthDownsample.hlsl", &defines, "main", "-T cs_6_0", &shaderByteCode);
 
 	D3D12_COMPUTE_PIPELINE_STATE_DESC desc = {};
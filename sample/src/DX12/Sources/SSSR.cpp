@@ -23,20 +23,163 @@ THE SOFTWARE.
 
 #include "SSSR.h"
 #include "Base\ShaderCompilerHelper.h"
-#include "Utils.h"
+#include <chrono>
+
+// Written next to the executable by BlueNoiseConverter.
+static const char* g_blueNoiseAssetPath = "BlueNoise.bin";
+// Not part of the repository. Created by BlueNoiseConverter --stbn from a precomputed spatiotemporal blue noise texture.
+static const char* g_spatiotemporalBlueNoiseAssetPath = "STBN.bin";
+// Written by the ShaderBlobs target of the build, see Shaders/ShaderPermutations.cmake.
+static const char* g_shaderBlobDirectory = "ShaderBlobsDX12";
+// Written on exit, so the next run creates its pipelines without compiling them in the driver.
+static const char* g_pipelineLibraryPath = "SSSRPipelineCacheDX12.bin";
+// Size of the upload heap used for the blue noise tables. The slices of the spatiotemporal blue noise are added on top.
+static const SIZE_T g_uploadHeapSize = 1024 * 1024;
+
+/**
+	Names and shader defines of the intersection pass permutations, indexed by tile class.
+*/
+static const char* g_tileClassNames[] = { "Mirror", "Glossy", "Rough" };
+static const char* g_tileClassDefines[] = { "TILE_CLASS_MIRROR", "TILE_CLASS_GLOSSY", "TILE_CLASS_ROUGH" };
+
+/**
+	Byte offset of the denoiser dispatch arguments. They follow the intersection arguments of every tile class.
+*/
+static const uint32_t g_denoiserIndirectArgsOffset = SSSR_SAMPLE_DX12::TILE_CLASS_COUNT * sizeof(D3D12_DISPATCH_ARGUMENTS);
+
+/**
+	Byte offset of the environment map dispatch arguments. They follow the denoiser arguments.
+*/
+static const uint32_t g_environmentMapIndirectArgsOffset = g_denoiserIndirectArgsOffset + sizeof(D3D12_DISPATCH_ARGUMENTS);
+
+/**
+	Byte offset of the draw arguments covering the tiles that contain reflections. They follow the environment map arguments.
+*/
+static const uint32_t g_reflectionTileDrawArgsOffset = g_environmentMapIndirectArgsOffset + sizeof(D3D12_DISPATCH_ARGUMENTS);
+
+/**
+	Byte offset of the prefilter dispatch arguments covering the tiles that still need the spatial filter. They follow the reflection tile draw arguments.
+*/
+static const uint32_t g_spatialFilterIndirectArgsOffset = g_reflectionTileDrawArgsOffset + sizeof(D3D12_DRAW_ARGUMENTS);
+
+/**
+	Byte offset of the prefilter pass through arguments covering the converged tiles. They follow the spatial filter arguments.
+*/
+static const uint32_t g_convergedIndirectArgsOffset = g_spatialFilterIndirectArgsOffset + sizeof(D3D12_DISPATCH_ARGUMENTS);
+
+/**
+	Byte offset of the mip usage counters in the ray counter buffer. They follow the tile and pixel counters, see Common.hlsl.
+*/
+static const uint32_t g_mipUsageCounterOffset = (2 * SSSR_SAMPLE_DX12::TILE_CLASS_COUNT + 10) * sizeof(uint32_t);
+
+/**
+	Options of the constant buffer that can be compiled into the permutations of a pass. A permutation key holds one bit per option,
+	except for the samples per quad that take two bits (0: 1, 1: 2, 2: 4 samples per quad).
+*/
+static const uint32_t g_permutationSamplesPerQuad = 0x3;
+static const uint32_t g_permutationTemporalVarianceGuidedTracing = 1 << 2;
+static const uint32_t g_permutationApplyReflectionsInResolve = 1 << 3;
+static const uint32_t g_permutationConvergedRaySkipping = 1 << 4;
+static const uint32_t g_permutationMipUsageStatistics = 1 << 5;
+
+/**
+	Options read by the tile classification and the intersection passes respectively.
+*/
+static const uint32_t g_classifyTilesPermutationMask = g_permutationSamplesPerQuad | g_permutationTemporalVarianceGuidedTracing | g_permutationApplyReflectionsInResolve | g_permutationConvergedRaySkipping;
+static const uint32_t g_intersectPermutationMask = g_permutationMipUsageStatistics;
+
+/**
+	Wave widths the tile classification and the intersection passes are written for, see SSSR::GetWaveSize. Must match ShaderPermutations.cmake.
+	The traversal loop of the intersection diverges a lot, so narrow waves retire their finished lanes sooner.
+	The tile classification appends its rays per wave, so wide waves need fewer atomics on the ray counters.
+*/
+static const uint32_t g_intersectWaveSize = 32;
+static const uint32_t g_classifyTilesWaveSize = 64;
+
+/**
+	Number of frames with unchanged inputs before the output is reused. Gives the history time to accumulate its samples.
+*/
+static const uint32_t g_staticFramesBeforeReuse = 32;
+
+/**
+	Checks if two frames have the same inputs. Only the view matrix is compared as the projection matrices change with the TAA jitter every frame.
+*/
+static bool HasSameInputs(const SSSR_SAMPLE_DX12::SSSRConstants& lhs, const SSSR_SAMPLE_DX12::SSSRConstants& rhs)
+{
+	const size_t parametersBegin = offsetof(SSSR_SAMPLE_DX12::SSSRConstants, bufferDimensions);
+	const size_t frameIndexBegin = offsetof(SSSR_SAMPLE_DX12::SSSRConstants, frameIndex);
+	const size_t frameIndexEnd = frameIndexBegin + sizeof(lhs.frameIndex);
+	const size_t parametersEnd = offsetof(SSSR_SAMPLE_DX12::SSSRConstants, maxTraversalMip) + sizeof(lhs.maxTraversalMip);
+	const char* pLhs = reinterpret_cast<const char*>(&lhs);
+	const char* pRhs = reinterpret_cast<const char*>(&rhs);
+	return memcmp(&lhs.view, &rhs.view, sizeof(lhs.view)) == 0
+		&& memcmp(pLhs + parametersBegin, pRhs + parametersBegin, frameIndexBegin - parametersBegin) == 0
+		&& memcmp(pLhs + frameIndexEnd, pRhs + frameIndexEnd, parametersEnd - frameIndexEnd) == 0;
+}
+
+/**
+	Builds the permutation key of all options from the constants of a frame.
+*/
+static uint32_t GetPermutationKey(const SSSR_SAMPLE_DX12::SSSRConstants& constants)
+{
+	uint32_t key = constants.samplesPerQuad >= 4 ? 2 : constants.samplesPerQuad >= 2 ? 1 : 0;
+	key |= constants.temporalVarianceGuidedTracingEnabled ? g_permutationTemporalVarianceGuidedTracing : 0;
+	key |= constants.applyReflectionsInResolve ? g_permutationApplyReflectionsInResolve : 0;
+	key |= constants.convergedRaySkippingEnabled ? g_permutationConvergedRaySkipping : 0;
+	key |= constants.mipUsageStatisticsEnabled ? g_permutationMipUsageStatistics : 0;
+	return key;
+}
 
-namespace _1spp
+/**
+	Adds the defines of the options in mask, see Common.hlsl. The shaders read the remaining options from the constant buffer.
+*/
+static void AddPermutationDefines(uint32_t key, uint32_t mask, DefineList& defines)
 {
-#include "../../../samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_1spp.cpp"
+	if (mask & g_permutationSamplesPerQuad)
+	{
+		defines["SAMPLES_PER_QUAD"] = std::to_string(1u << (key & g_permutationSamplesPerQuad));
+	}
+	if (mask & g_permutationTemporalVarianceGuidedTracing)
+	{
+		defines["TEMPORAL_VARIANCE_GUIDED_TRACING_ENABLED"] = (key & g_permutationTemporalVarianceGuidedTracing) ? "1" : "0";
+	}
+	if (mask & g_permutationApplyReflectionsInResolve)
+	{
+		defines["APPLY_REFLECTIONS_IN_RESOLVE"] = (key & g_permutationApplyReflectionsInResolve) ? "1" : "0";
+	}
+	if (mask & g_permutationConvergedRaySkipping)
+	{
+		defines["CONVERGED_RAY_SKIPPING_ENABLED"] = (key & g_permutationConvergedRaySkipping) ? "1" : "0";
+	}
+	if (mask & g_permutationMipUsageStatistics)
+	{
+		defines["MIP_USAGE_STATISTICS_ENABLED"] = (key & g_permutationMipUsageStatistics) ? "1" : "0";
+	}
 }
 
-struct
+using SSSR_SAMPLE_COMMON::BarrierPhase;
+using SSSR_SAMPLE_COMMON::RenderGraph;
+using SSSR_SAMPLE_COMMON::RenderGraphBarrier;
+using SSSR_SAMPLE_COMMON::ResourceState;
+
+static D3D12_RESOURCE_STATES GetD3D12ResourceState(ResourceState state)
 {
-	std::int32_t const (&sobolBuffer)[256 * 256];
-	std::int32_t const (&rankingTileBuffer)[128 * 128 * 8];
-	std::int32_t const (&scramblingTileBuffer)[128 * 128 * 8];
+	switch (state)
+	{
+	case ResourceState::ShaderResource:
+		return D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+	case ResourceState::UnorderedAccess:
+		return D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	case ResourceState::IndirectArgument:
+		return D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT;
+	case ResourceState::CopySource:
+		return D3D12_RESOURCE_STATE_COPY_SOURCE;
+	case ResourceState::CopyDestination:
+		return D3D12_RESOURCE_STATE_COPY_DEST;
+	}
+	assert(false);
+	return D3D12_RESOURCE_STATE_COMMON;
 }
-const g_blueNoiseSamplerState = { _1spp::sobol_256spp_256d,  _1spp::rankingTile,  _1spp::scramblingTile };
 
 using namespace CAULDRON_DX12;
 namespace SSSR_SAMPLE_DX12
@@ -77,28 +220,141 @@ namespace SSSR_SAMPLE_DX12
 		m_screenWidth = 0;
 		m_screenHeight = 0;
 		m_bufferIndex = 0;
+		m_previousConstants = {};
+		m_staticFrameCount = 0;
+		m_previousSceneRevision = 0;
 		m_environmentMapSamplerDesc = {};
 	}
 
-	void SSSR_SAMPLE_DX12::SSSR::OnCreate(Device* pDevice, StaticResourceViewHeap& cpuVisibleHeap, ResourceViewHeaps& resourceHeap, UploadHeap& uploadHeap, DynamicBufferRing& constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters)
+	void SSSR_SAMPLE_DX12::SSSR::OnCreate(Device* pDevice, StaticResourceViewHeap& cpuVisibleHeap, ResourceViewHeaps& resourceHeap, UploadHeap& uploadHeap, DynamicBufferRing& constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters, bool linearDepthHierarchy, bool halfPrecisionDepthHierarchy, bool fusedDepthDownsample, uint32_t blueNoiseSamplesPerPixel, bool spatiotemporalBlueNoise, uint32_t accumulationSamplesPerPixel, AsyncPool* pAsyncPool)
 	{
 		m_pDevice = pDevice;
+		m_pAsyncPool = pAsyncPool;
 		m_pConstantBufferRing = &constantBufferRing;
 		m_pCpuVisibleHeap = &cpuVisibleHeap;
 		m_pResourceViewHeaps = &resourceHeap;
 		m_pUploadHeap = &uploadHeap;
-		m_uploadHeapBuffers.OnCreate(pDevice, 1024 * 1024);
+		m_linearDepthHierarchy = linearDepthHierarchy;
+		m_halfPrecisionDepthHierarchy = halfPrecisionDepthHierarchy;
+		m_fusedDepthDownsample = fusedDepthDownsample;
+		// The tile classification reads mip 0 of a linear hierarchy, so it cannot build it at the same time.
+		assert(!(fusedDepthDownsample && linearDepthHierarchy));
+		m_frameCountBeforeReuse = frameCountBeforeReuse;
+		// All uploads of OnCreate have to fit at once. Otherwise the heap would flush and wait for the GPU in the middle of them.
+		SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset spatiotemporalBlueNoiseAsset;
+		SIZE_T spatiotemporalBlueNoiseUploadSize = 0;
+		spatiotemporalBlueNoise = spatiotemporalBlueNoise && OpenSpatiotemporalBlueNoiseAsset(spatiotemporalBlueNoiseAsset, &spatiotemporalBlueNoiseUploadSize);
+		m_uploadHeapBuffers.OnCreate(pDevice, g_uploadHeapSize + spatiotemporalBlueNoiseUploadSize);
+		// Transitions start right after the last access and end right before the next one.
+		m_renderGraph.SetSplitBarriers(true);
+
+		// [WaveSize] needs shader model 6.6. Without it the driver picks the wave width of every pass.
+		D3D12_FEATURE_DATA_SHADER_MODEL shaderModel = { D3D_SHADER_MODEL_6_6 };
+		D3D12_FEATURE_DATA_D3D12_OPTIONS1 options1 = {};
+		if (SUCCEEDED(pDevice->GetDevice()->CheckFeatureSupport(D3D12_FEATURE_SHADER_MODEL, &shaderModel, sizeof(shaderModel))) && shaderModel.HighestShaderModel >= D3D_SHADER_MODEL_6_6
+			&& SUCCEEDED(pDevice->GetDevice()->CheckFeatureSupport(D3D12_FEATURE_D3D12_OPTIONS1, &options1, sizeof(options1))) && options1.WaveOps)
+		{
+			m_minWaveLaneCount = options1.WaveLaneCountMin;
+			m_maxWaveLaneCount = options1.WaveLaneCountMax;
+		}
+
+		{
+			Profile p("SSSR - Open pipeline library and shaders");
+			CreatePipelineLibrary();
+			if (!m_shaderBlobs.Open(g_shaderBlobDirectory))
+			{
+				Trace("No precompiled shaders in %s, compiling them at runtime", g_shaderBlobDirectory);
+			}
+		}
 
 		cpuVisibleHeap.AllocDescriptor(1, &m_environmentMapSRV);
 
-		CreateResources();
-		SetupClassifyTilesPass(true);
-		SetupPrepareIndirectArgsPass(true);
-		SetupIntersectionPass(true);
-		SetupResolveTemporalPass(true);
-		SetupPrefilterPass(true);
-		SetupReprojectPass(true);
-		SetupBlueNoisePass(true);
+		// From here on the pipelines are compiled on the async pool and the uploads are only recorded.
+		// WaitForCreation submits them in one go, so nothing below waits for the GPU.
+		m_creationPending = true;
+
+		// The accumulation passes are compiled for the sample count of the sampler that is actually available.
+		if (accumulationSamplesPerPixel > 0)
+		{
+			Profile p("SSSR - Accumulation noise");
+			m_accumulationSamplesPerPixel = BakeBlueNoiseTexture(m_accumulationNoiseTexture, accumulationSamplesPerPixel, true);
+			cpuVisibleHeap.AllocDescriptor(1, &m_accumulatedRadianceCpuUAV);
+			resourceHeap.AllocCBV_SRV_UAVDescriptor(1, &m_accumulatedRadianceUAV);
+		}
+
+		{
+			Profile p("SSSR - Create resources");
+			CreateResources();
+		}
+		{
+			Profile p("SSSR - Setup passes");
+			SetupClassifyTilesPass(true);
+			SetupPrepareIndirectArgsPass(true);
+			SetupIntersectionPass(true);
+			SetupEnvironmentMapPass(true);
+			SetupResolveTemporalPass(true);
+			SetupPrefilterPass(true);
+			SetupReprojectPass(true);
+			SetupFusedDenoiserPass(true);
+			SetupCopyDenoiserTilesPass(true);
+		}
+		{
+			Profile p("SSSR - Blue noise");
+			if (spatiotemporalBlueNoise)
+			{
+				LoadSpatiotemporalBlueNoiseTexture(spatiotemporalBlueNoiseAsset);
+			}
+			else
+			{
+				BakeBlueNoiseTexture(m_blueNoiseTexture, blueNoiseSamplesPerPixel, false);
+			}
+		}
+	}
+
+	void SSSR::WaitForCreation()
+	{
+		if (!m_creationPending)
+		{
+			return;
+		}
+		m_creationPending = false;
+
+		{
+			Profile p("SSSR - Wait for pipelines");
+			m_pipelineSync.Wait();
+		}
+
+		Profile p("SSSR - Upload");
+		ID3D12GraphicsCommandList* pCommandList = m_uploadHeapBuffers.GetCommandList();
+		m_uploadHeapBuffers.RecordCopies();
+
+		if (m_blueNoiseBakeCount > 0)
+		{
+			ID3D12DescriptorHeap* descriptorHeaps[] = { m_pResourceViewHeaps->GetCBV_SRV_UAVHeap() };
+			pCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+
+			D3D12_RESOURCE_BARRIER barriers[_countof(m_blueNoiseBakes)];
+			for (uint32_t i = 0; i < m_blueNoiseBakeCount; ++i)
+			{
+				BlueNoiseBake& bake = m_blueNoiseBakes[i];
+				UserMarker marker(pCommandList, "FFX DNSR PrepareBlueNoise");
+				pCommandList->SetComputeRootSignature(bake.pass.pRootSignature);
+				pCommandList->SetComputeRootDescriptorTable(0, bake.pass.descriptorTables_CBV_SRV_UAV[0].GetGPU());
+				pCommandList->SetPipelineState(bake.pass.pPipeline);
+				pCommandList->Dispatch(128u / 8u, 128u / 8u, bake.sliceCount);
+				barriers[i] = CD3DX12_RESOURCE_BARRIER::Transition(bake.pTexture->GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			}
+			pCommandList->ResourceBarrier(m_blueNoiseBakeCount, barriers);
+		}
+		m_uploadHeapBuffers.FlushAndFinish();
+
+		// The noise of all frames is baked now. The sampler tables and the passes are not needed anymore.
+		for (uint32_t i = 0; i < m_blueNoiseBakeCount; ++i)
+		{
+			m_blueNoiseBakes[i].pass.OnDestroy();
+			m_blueNoiseBakes[i].sampler.OnDestroy();
+		}
+		m_blueNoiseBakeCount = 0;
 	}
 
 	void SSSR::OnCreateWindowSizeDependentResources(const SSSRCreationInfo& input)
@@ -107,15 +363,19 @@ namespace SSSR_SAMPLE_DX12
 		assert(input.outputHeight > 0);
 		assert(input.HDR != nullptr);
 		assert(input.DepthHierarchy != nullptr);
+		assert(input.DepthBuffer != nullptr);
 		assert(input.MotionVectors != nullptr);
 		assert(input.NormalBuffer != nullptr);
 		assert(input.SpecularRoughness != nullptr);
+		assert(input.BrdfLut != nullptr);
 		assert(input.SkyDome != nullptr);
+		assert(!m_fusedDepthDownsample || input.DepthHierarchyAtomicCounter != nullptr);
 
 		m_screenWidth = input.outputWidth;
 		m_screenHeight = input.outputHeight;
-		m_depthBuffer = input.DepthHierarchy;
-		m_normalBuffer = input.NormalBuffer;
+		m_hdr = input.HDR;
+		m_depthHierarchy = input.DepthHierarchy;
+		m_lowPrecisionHistory = input.lowPrecisionHistory;
 
 		D3D12_STATIC_SAMPLER_DESC environmentSamplerDesc = {};
 		input.SkyDome->SetDescriptorSpec(0, &m_environmentMapSRV, 0, &environmentSamplerDesc);
@@ -132,24 +392,48 @@ namespace SSSR_SAMPLE_DX12
 
 		CreateWindowSizeDependentResources();
 		InitializeDescriptorTableData(input);
+		AddGraphResources();
 	}
 
 	void SSSR_SAMPLE_DX12::SSSR::OnDestroy()
 	{
+		// The pipelines may still be compiling if no frame was drawn.
+		WaitForCreation();
+
 		m_uploadHeapBuffers.OnDestroy();
+		m_shaderBlobs.Close();
+		SavePipelineLibrary();
 
 		m_classifyTilesPass.OnDestroy();
 		m_prepareIndirectArgsPass.OnDestroy();
-		m_intersectPass.OnDestroy();
+		m_preparePrefilterArgsPass.OnDestroy();
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			m_intersectPass[tileClass].OnDestroy();
+			m_accumulatePass[tileClass].OnDestroy();
+		}
+		m_environmentMapPass.OnDestroy();
 		m_resolveTemporalPass.OnDestroy();
+		m_resolveTemporalApplyPass.OnDestroy();
 		m_prefilterPass.OnDestroy();
+		m_prefilterPassThroughPass.OnDestroy();
 		m_reprojectPass.OnDestroy();
-		m_blueNoisePass.OnDestroy();
+		m_fusedDenoiserPass.OnDestroy();
+		m_fusedDenoiserApplyPass.OnDestroy();
+		m_copyDenoiserTilesPass.OnDestroy();
 
 		m_rayCounter.OnDestroy();
 		m_intersectionPassIndirectArgs.OnDestroy();
+		if (m_pMipUsageReadback)
+		{
+			m_pMipUsageReadback->Release();
+			m_pMipUsageReadback = nullptr;
+		}
 		m_blueNoiseTexture.OnDestroy();
-		m_blueNoiseSampler.OnDestroy();
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			m_accumulationNoiseTexture.OnDestroy();
+		}
 
 		if (m_pCommandSignature)
 		{
@@ -159,83 +443,136 @@ namespace SSSR_SAMPLE_DX12
 
 	void SSSR::OnDestroyWindowSizeDependentResources()
 	{
-		m_rayList.OnDestroy();
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			m_rayList[tileClass].OnDestroy();
+		}
 		m_denoiserTileList.OnDestroy();
-		m_extractedRoughness.OnDestroy();
-		m_depthHistory.OnDestroy();
-		m_normalHistory.OnDestroy();
-		m_roughnessHistory.OnDestroy();
+		m_environmentMapList.OnDestroy();
+		m_reflectionTileList.OnDestroy();
+		m_spatialFilterTileList.OnDestroy();
+		m_convergedTileList.OnDestroy();
+		m_tileHistory.OnDestroy();
+		if (m_pOutputReadback)
+		{
+			m_pOutputReadback->Unmap(0, &CD3DX12_RANGE(0, 0));
+			m_pOutputReadback->Release();
+			m_pOutputReadback = nullptr;
+			m_pOutputReadbackData = nullptr;
+		}
+		m_outputReadbackPending = false;
+		m_outputReadbackReady = false;
+		m_extractedRoughness[0].OnDestroy();
+		m_extractedRoughness[1].OnDestroy();
+		m_depthHistory[0].OnDestroy();
+		m_depthHistory[1].OnDestroy();
+		m_normalHistory[0].OnDestroy();
+		m_normalHistory[1].OnDestroy();
 		m_radiance[0].OnDestroy();
 		m_radiance[1].OnDestroy();
-		m_variance[0].OnDestroy();
-		m_variance[1].OnDestroy();
-		m_sampleCount[0].OnDestroy();
-		m_sampleCount[1].OnDestroy();
+		m_varianceSampleCount[0].OnDestroy();
+		m_varianceSampleCount[1].OnDestroy();
 		m_averageRadiance[0].OnDestroy();
 		m_averageRadiance[1].OnDestroy();
 		m_reprojectedRadiance.OnDestroy();
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			m_accumulatedRadiance.OnDestroy();
+		}
 	}
 
-	void SSSR_SAMPLE_DX12::SSSR::Draw(ID3D12GraphicsCommandList* pCommandList, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult)
+	void SSSR_SAMPLE_DX12::SSSR::Draw(ID3D12GraphicsCommandList* pCommandList, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult, bool useFusedDenoiser, bool isSceneStatic, bool reuseStaticFrames, uint32_t sceneRevision, bool accumulate)
 	{
-		//Set Constantbuffer data
-		D3D12_GPU_VIRTUAL_ADDRESS constantbufferAddress = m_pConstantBufferRing->AllocConstantBuffer(sizeof(SSSRConstants), (void*)&sssrConstants);
-
-		//Render
-		ID3D12DescriptorHeap* descriptorHeaps[] = { m_pResourceViewHeaps->GetCBV_SRV_UAVHeap(), m_pResourceViewHeaps->GetSamplerHeap() };
-		pCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
+		WaitForCreation();
 
-		// Ensure that the ray list is in UA state
+		// The mip usage in this slot was copied m_frameCountBeforeReuse frames ago, so the copy has finished by now.
+		uint32_t readbackIndex = sssrConstants.frameIndex % m_frameCountBeforeReuse;
+		if (m_mipUsageReadbackPending[readbackIndex])
 		{
-			D3D12_RESOURCE_BARRIER barriers[] = {
-					CD3DX12_RESOURCE_BARRIER::Transition(m_rayList.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_denoiserTileList.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_extractedRoughness.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_blueNoiseTexture.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-			};
-			pCommandList->ResourceBarrier(_countof(barriers), barriers);
+			D3D12_RANGE readRange = { readbackIndex * sizeof(m_mipUsage), (readbackIndex + 1) * sizeof(m_mipUsage) };
+			D3D12_RANGE writtenRange = { 0, 0 };
+			uint8_t* pData = nullptr;
+			ThrowIfFailed(m_pMipUsageReadback->Map(0, &readRange, reinterpret_cast<void**>(&pData)));
+			memcpy(m_mipUsage, pData + readRange.Begin, sizeof(m_mipUsage));
+			m_pMipUsageReadback->Unmap(0, &writtenRange);
+			m_mipUsageReadbackPending[readbackIndex] = false;
 		}
-
+		if (m_outputReadbackPending && sssrConstants.frameIndex - m_outputReadbackFrameIndex >= m_frameCountBeforeReuse)
 		{
-			UserMarker marker(pCommandList, "FFX DNSR ClassifyTiles");
-			pCommandList->SetComputeRootSignature(m_classifyTilesPass.pRootSignature);
-			pCommandList->SetComputeRootDescriptorTable(0, m_classifyTilesPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
-			pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
-			pCommandList->SetComputeRootDescriptorTable(2, m_classifyTilesPass.descriptorTables_Sampler[m_bufferIndex].GetGPU());
-			pCommandList->SetPipelineState(m_classifyTilesPass.pPipeline);
-			uint32_t dim_x = DivideRoundingUp(m_screenWidth, 8u);
-			uint32_t dim_y = DivideRoundingUp(m_screenHeight, 8u);
-			pCommandList->Dispatch(dim_x, dim_y, 1);
+			m_outputReadbackPending = false;
+			m_outputReadbackReady = true;
 		}
 
-		// At the same time prepare the blue noise texture for intersection
+		// A new scene revision invalidates the last output and the accumulated samples just like changed constants.
+		const bool isSceneUnchanged = isSceneStatic && sceneRevision == m_previousSceneRevision;
+		m_previousSceneRevision = sceneRevision;
+
+		// The accumulation keeps refining a static frame, so it never reuses the last output. Any change starts it over.
+		const bool accumulating = accumulate && m_accumulationSamplesPerPixel > 0;
+		if (accumulating)
 		{
-			UserMarker marker(pCommandList, "FFX DNSR PrepareBlueNoise");
-			pCommandList->SetComputeRootSignature(m_blueNoisePass.pRootSignature);
-			pCommandList->SetComputeRootDescriptorTable(0, m_blueNoisePass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
-			pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
-			pCommandList->SetPipelineState(m_blueNoisePass.pPipeline);
-			uint32_t dim_x = 128u / 8u;
-			uint32_t dim_y = 128u / 8u;
-			pCommandList->Dispatch(dim_x, dim_y, 1);
+			if (!isSceneUnchanged || !HasSameInputs(sssrConstants, m_previousConstants))
+			{
+				m_accumulatedBatchCount = 0;
+			}
+			m_previousConstants = sssrConstants;
+			m_staticFrameCount = 0;
 		}
+		else
+		{
+			m_accumulatedBatchCount = 0;
+
+			// Nothing moved for a while. The output of the last frame is still valid.
+			if (IsStaticFrame(sssrConstants, showIntersectResult, reuseStaticFrames && isSceneUnchanged))
+			{
+				return;
+			}
+		}
+
+		//Set Constantbuffer data
+		D3D12_GPU_VIRTUAL_ADDRESS constantbufferAddress = m_pConstantBufferRing->AllocConstantBuffer(sizeof(SSSRConstants), (void*)&sssrConstants);
+
+		//Render
+		ID3D12DescriptorHeap* descriptorHeaps[] = { m_pResourceViewHeaps->GetCBV_SRV_UAVHeap(), m_pResourceViewHeaps->GetSamplerHeap() };
+		pCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
 
-		gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR ClassifyTiles + PrepareBlueNoise");
+		// The temporal accumulation optionally applies the reflections of the denoised tiles to the lit scene right away.
+		const bool applyReflections = sssrConstants.applyReflectionsInResolve != 0;
+		const GraphResources& resources = m_graphResources;
 
-		// Ensure that the tile classification pass finished
+		// Each pass declares the resources it accesses. The render graph places the barriers in between and splits them where it can.
 		{
-			D3D12_RESOURCE_BARRIER barriers[] = {
-					CD3DX12_RESOURCE_BARRIER::UAV(m_rayCounter.GetResource()),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_rayList.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_denoiserTileList.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_intersectionPassIndirectArgs.GetResource(), D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_extractedRoughness.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_blueNoiseTexture.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-			};
-			pCommandList->ResourceBarrier(_countof(barriers), barriers);
+			RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+			{
+				{
+					UserMarker marker(pCommandList, m_fusedDepthDownsample ? "FFX DNSR ClassifyTiles + Downsample Depth" : "FFX DNSR ClassifyTiles");
+					pCommandList->SetComputeRootSignature(m_classifyTilesPass.pRootSignature);
+					pCommandList->SetComputeRootDescriptorTable(0, m_classifyTilesPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+					pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+					pCommandList->SetPipelineState(GetPipeline(m_classifyTilesPass, sssrConstants));
+					// The fused pass works on the 64x64 regions of the depth downsampling.
+					uint32_t tileSize = m_fusedDepthDownsample ? 64u : 8u;
+					uint32_t dim_x = DivideRoundingUp(m_screenWidth, tileSize);
+					uint32_t dim_y = DivideRoundingUp(m_screenHeight, tileSize);
+					pCommandList->Dispatch(dim_x, dim_y, 1);
+				}
+
+				gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR ClassifyTiles");
+			});
+			pass.Read(resources.varianceSampleCount[1 - m_bufferIndex]).Read(resources.radiance[1 - m_bufferIndex]);
+			pass.Write(resources.radiance[m_bufferIndex]).Write(resources.extractedRoughness[m_bufferIndex]).Write(resources.depthHistory[m_bufferIndex]).Write(resources.normalHistory[m_bufferIndex]);
+			pass.Write(resources.rayCounter).Write(resources.denoiserTileList).Write(resources.environmentMapList).Write(resources.tileHistory).Write(resources.reflectionTileList);
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+			{
+				pass.Write(resources.rayList[tileClass]);
+			}
+			if (m_fusedDepthDownsample)
+			{
+				pass.Write(resources.depthHierarchy);
+			}
 		}
 
+		m_renderGraph.AddPass([&]()
 		{
 			UserMarker marker(pCommandList, "FFX SSSR PrepareIndirectArgs");
 			pCommandList->SetComputeRootSignature(m_prepareIndirectArgsPass.pRootSignature);
@@ -243,160 +580,361 @@ namespace SSSR_SAMPLE_DX12
 			pCommandList->SetPipelineState(m_prepareIndirectArgsPass.pPipeline);
 			pCommandList->Dispatch(1, 1, 1);
 			gpuTimer.GetTimeStamp(pCommandList, "FFX SSSR PrepareIndirectArgs");
-		}
+		}).Write(resources.rayCounter).Write(resources.intersectionPassIndirectArgs);
 
-		// Ensure that the arguments are written
+		if (accumulating)
 		{
-			D3D12_RESOURCE_BARRIER barriers[] = {
-				CD3DX12_RESOURCE_BARRIER::Transition(m_intersectionPassIndirectArgs.GetResource(),	D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT),
-			};
-			pCommandList->ResourceBarrier(_countof(barriers), barriers);
+			if (m_accumulatedBatchCount == 0)
+			{
+				m_renderGraph.AddPass([&]()
+				{
+					const float clearValue[4] = {};
+					pCommandList->ClearUnorderedAccessViewFloat(m_accumulatedRadianceUAV.GetGPU(), m_accumulatedRadianceCpuUAV.GetCPU(), m_accumulatedRadiance.GetResource(), clearValue, 0, nullptr);
+				}).Write(resources.accumulatedRadiance);
+			}
+			++m_accumulatedBatchCount;
 		}
 
 		{
-			UserMarker marker(pCommandList, "FFX SSSR Intersection");
-			pCommandList->SetComputeRootSignature(m_intersectPass.pRootSignature);
-			pCommandList->SetComputeRootDescriptorTable(0, m_intersectPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
-			pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
-			pCommandList->SetComputeRootDescriptorTable(2, m_intersectPass.descriptorTables_Sampler[m_bufferIndex].GetGPU());
-			pCommandList->SetPipelineState(m_intersectPass.pPipeline);
-			pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), 0, nullptr, 0);
-			gpuTimer.GetTimeStamp(pCommandList, "FFX SSSR Intersection");
-		}
+			RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+			{
+				// One specialized dispatch per tile class. The passes write disjoint pixels, so no barriers are needed in between.
+				{
+					UserMarker marker(pCommandList, accumulating ? "FFX SSSR Accumulation" : "FFX SSSR Intersection");
+					for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+					{
+						ShaderPass& intersectPass = accumulating ? m_accumulatePass[tileClass] : m_intersectPass[tileClass];
+						UserMarker classMarker(pCommandList, g_tileClassNames[tileClass]);
+						pCommandList->SetComputeRootSignature(intersectPass.pRootSignature);
+						pCommandList->SetComputeRootDescriptorTable(0, intersectPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+						pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+						pCommandList->SetComputeRootDescriptorTable(2, intersectPass.descriptorTables_Sampler[m_bufferIndex].GetGPU());
+						pCommandList->SetPipelineState(GetPipeline(intersectPass, sssrConstants));
+						pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), tileClass * sizeof(D3D12_DISPATCH_ARGUMENTS), nullptr, 0);
+					}
+					gpuTimer.GetTimeStamp(pCommandList, "FFX SSSR Intersection");
+				}
 
-		if (showIntersectResult)
-		{
-			// Ensure that the intersection pass is done.
+				// Writes the pixels that are too rough to be traced. These are disjoint from the intersection results.
+				{
+					UserMarker marker(pCommandList, "FFX SSSR EnvironmentMap");
+					pCommandList->SetComputeRootSignature(m_environmentMapPass.pRootSignature);
+					pCommandList->SetComputeRootDescriptorTable(0, m_environmentMapPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+					pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+					pCommandList->SetComputeRootDescriptorTable(2, m_environmentMapPass.descriptorTables_Sampler[m_bufferIndex].GetGPU());
+					pCommandList->SetPipelineState(m_environmentMapPass.pPipeline);
+					pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_environmentMapIndirectArgsOffset, nullptr, 0);
+					gpuTimer.GetTimeStamp(pCommandList, "FFX SSSR EnvironmentMap");
+				}
+			});
+			pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument);
+			pass.Read(resources.hdr).Read(resources.depthHierarchy).Read(resources.extractedRoughness[m_bufferIndex]).Read(resources.environmentMapList);
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
 			{
-				D3D12_RESOURCE_BARRIER barriers[] = {
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-				};
-				pCommandList->ResourceBarrier(_countof(barriers), barriers);
+				pass.Read(resources.rayList[tileClass]);
 			}
-		}
-		else
-		{
-			// Ensure that the intersection pass is done.
-			{
-				D3D12_RESOURCE_BARRIER barriers[] = {
-					// Transition to SRV
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					// Transition to UAV
-					CD3DX12_RESOURCE_BARRIER::Transition(m_reprojectedRadiance.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_averageRadiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_variance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_sampleCount[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-				};
-				pCommandList->ResourceBarrier(_countof(barriers), barriers);
+			pass.Write(resources.radiance[m_bufferIndex]).Write(resources.rayCounter);
+			if (accumulating)
+			{
+				pass.Write(resources.accumulatedRadiance);
 			}
+		}
 
-			// Reproject pass
+		// The accumulated samples already converged, so they skip the denoiser just like the raw intersection results.
+		if (!showIntersectResult && !accumulating)
+		{
+			if (useFusedDenoiser)
 			{
-				UserMarker marker(pCommandList, "FFX DNSR Reproject");
-				pCommandList->SetComputeRootSignature(m_reprojectPass.pRootSignature);
-				pCommandList->SetComputeRootDescriptorTable(0, m_reprojectPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
-				pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
-				pCommandList->SetPipelineState(m_reprojectPass.pPipeline);
-				pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), 12, nullptr, 0);
-				gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Reproject");
-			}
+				// Reprojection, spatial filter and temporal resolve in a single pass. The intermediate results never leave groupshared memory.
+				{
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						ShaderPass& fusedDenoiserPass = applyReflections ? m_fusedDenoiserApplyPass : m_fusedDenoiserPass;
+						UserMarker marker(pCommandList, "FFX DNSR Fused Denoiser");
+						pCommandList->SetComputeRootSignature(fusedDenoiserPass.pRootSignature);
+						pCommandList->SetComputeRootDescriptorTable(0, fusedDenoiserPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+						pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+						pCommandList->SetPipelineState(fusedDenoiserPass.pPipeline);
+						pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_denoiserIndirectArgsOffset, nullptr, 0);
+						gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Fused Denoiser");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList);
+					pass.Read(resources.extractedRoughness[m_bufferIndex]).Read(resources.extractedRoughness[1 - m_bufferIndex]).Read(resources.depthHistory[1 - m_bufferIndex]).Read(resources.normalHistory[1 - m_bufferIndex]);
+					pass.Read(resources.radiance[m_bufferIndex]).Read(resources.radiance[1 - m_bufferIndex]).Read(resources.varianceSampleCount[1 - m_bufferIndex]);
+					pass.Write(resources.reprojectedRadiance).Write(resources.averageRadiance[m_bufferIndex]).Write(resources.varianceSampleCount[m_bufferIndex]);
+					if (applyReflections)
+					{
+						pass.Write(resources.hdr);
+					}
+				}
 
-			// Ensure that the Reproject pass is done
-			{
-				D3D12_RESOURCE_BARRIER barriers[] = {
-					// Transition to SRV
-					CD3DX12_RESOURCE_BARRIER::Transition(m_averageRadiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_variance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_sampleCount[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					// Transition to UAV
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[1 - m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_variance[1 - m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_sampleCount[1 - m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-				};
-				pCommandList->ResourceBarrier(_countof(barriers), barriers);
+				// Copy the denoised tiles over the intersection results
+				m_renderGraph.AddPass([&]()
+				{
+					UserMarker marker(pCommandList, "FFX DNSR Copy Denoiser Tiles");
+					pCommandList->SetComputeRootSignature(m_copyDenoiserTilesPass.pRootSignature);
+					pCommandList->SetComputeRootDescriptorTable(0, m_copyDenoiserTilesPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+					pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+					pCommandList->SetPipelineState(m_copyDenoiserTilesPass.pPipeline);
+					pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_denoiserIndirectArgsOffset, nullptr, 0);
+					gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Copy Denoiser Tiles");
+				}).Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList).Read(resources.reprojectedRadiance).Write(resources.radiance[m_bufferIndex]);
 			}
-
-			// Prefilter pass
+			else
 			{
-				UserMarker marker(pCommandList, "FFX DNSR Prefilter");
-				pCommandList->SetComputeRootSignature(m_prefilterPass.pRootSignature);
-				pCommandList->SetComputeRootDescriptorTable(0, m_prefilterPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
-				pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
-				pCommandList->SetPipelineState(m_prefilterPass.pPipeline);
-				pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), 12, nullptr, 0);
-				gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Prefilter");
-			}
+				// Reproject pass
+				{
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						UserMarker marker(pCommandList, "FFX DNSR Reproject");
+						pCommandList->SetComputeRootSignature(m_reprojectPass.pRootSignature);
+						pCommandList->SetComputeRootDescriptorTable(0, m_reprojectPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+						pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+						pCommandList->SetPipelineState(m_reprojectPass.pPipeline);
+						pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_denoiserIndirectArgsOffset, nullptr, 0);
+						gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Reproject");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList);
+					pass.Read(resources.extractedRoughness[m_bufferIndex]).Read(resources.extractedRoughness[1 - m_bufferIndex]).Read(resources.depthHistory[1 - m_bufferIndex]).Read(resources.normalHistory[1 - m_bufferIndex]);
+					pass.Read(resources.radiance[m_bufferIndex]).Read(resources.radiance[1 - m_bufferIndex]).Read(resources.averageRadiance[1 - m_bufferIndex]).Read(resources.varianceSampleCount[1 - m_bufferIndex]);
+					pass.Write(resources.reprojectedRadiance).Write(resources.averageRadiance[m_bufferIndex]).Write(resources.varianceSampleCount[m_bufferIndex]);
+					pass.Write(resources.rayCounter).Write(resources.spatialFilterTileList).Write(resources.convergedTileList);
+				}
 
-			// Ensure that the Prefilter pass is done
-			{
-				D3D12_RESOURCE_BARRIER barriers[] = {
-					// Transition to SRV
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[1 - m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_reprojectedRadiance.GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_variance[1 - m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_sampleCount[1 - m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					// Transition to UAV
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_variance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_sampleCount[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_UNORDERED_ACCESS),
-				};
-				pCommandList->ResourceBarrier(_countof(barriers), barriers);
-			}
+				// Prepare the prefilter args from the tiles the reprojection split by their convergence
+				m_renderGraph.AddPass([&]()
+				{
+					UserMarker marker(pCommandList, "FFX DNSR PreparePrefilterArgs");
+					pCommandList->SetComputeRootSignature(m_preparePrefilterArgsPass.pRootSignature);
+					pCommandList->SetComputeRootDescriptorTable(0, m_preparePrefilterArgsPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+					pCommandList->SetPipelineState(m_preparePrefilterArgsPass.pPipeline);
+					pCommandList->Dispatch(1, 1, 1);
+				}).Write(resources.rayCounter).Write(resources.intersectionPassIndirectArgs);
+
+				// Prefilter pass
+				{
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						UserMarker marker(pCommandList, "FFX DNSR Prefilter");
+						pCommandList->SetComputeRootSignature(m_prefilterPass.pRootSignature);
+						pCommandList->SetComputeRootDescriptorTable(0, m_prefilterPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+						pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+						pCommandList->SetPipelineState(m_prefilterPass.pPipeline);
+						pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_spatialFilterIndirectArgsOffset, nullptr, 0);
+
+						// Converged tiles only forward their inputs. Both passes write disjoint tiles, so no barrier is needed in between.
+						pCommandList->SetComputeRootSignature(m_prefilterPassThroughPass.pRootSignature);
+						pCommandList->SetComputeRootDescriptorTable(0, m_prefilterPassThroughPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+						pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+						pCommandList->SetPipelineState(m_prefilterPassThroughPass.pPipeline);
+						pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_convergedIndirectArgsOffset, nullptr, 0);
+						gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Prefilter");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.spatialFilterTileList).Read(resources.convergedTileList);
+					pass.Read(resources.extractedRoughness[m_bufferIndex]).Read(resources.averageRadiance[m_bufferIndex]).Read(resources.radiance[m_bufferIndex]).Read(resources.varianceSampleCount[m_bufferIndex]);
+					pass.Write(resources.radiance[1 - m_bufferIndex]).Write(resources.varianceSampleCount[1 - m_bufferIndex]);
+				}
 
-			// Temporal accumulation passes
-			{
-				UserMarker marker(pCommandList, "FFX DNSR Resolve Temporal");
-				pCommandList->SetComputeRootSignature(m_resolveTemporalPass.pRootSignature);
-				pCommandList->SetComputeRootDescriptorTable(0, m_resolveTemporalPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
-				pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
-				pCommandList->SetPipelineState(m_resolveTemporalPass.pPipeline);
-				pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), 12, nullptr, 0);
-				gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Resolve Temporal");
+				{
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						ShaderPass& resolveTemporalPass = applyReflections ? m_resolveTemporalApplyPass : m_resolveTemporalPass;
+						UserMarker marker(pCommandList, "FFX DNSR Resolve Temporal");
+						pCommandList->SetComputeRootSignature(resolveTemporalPass.pRootSignature);
+						pCommandList->SetComputeRootDescriptorTable(0, resolveTemporalPass.descriptorTables_CBV_SRV_UAV[m_bufferIndex].GetGPU());
+						pCommandList->SetComputeRootConstantBufferView(1, constantbufferAddress);
+						pCommandList->SetPipelineState(resolveTemporalPass.pPipeline);
+						pCommandList->ExecuteIndirect(m_pCommandSignature, 1, m_intersectionPassIndirectArgs.GetResource(), g_denoiserIndirectArgsOffset, nullptr, 0);
+						gpuTimer.GetTimeStamp(pCommandList, "FFX DNSR Resolve Temporal");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList);
+					pass.Read(resources.extractedRoughness[m_bufferIndex]).Read(resources.averageRadiance[m_bufferIndex]).Read(resources.radiance[1 - m_bufferIndex]).Read(resources.reprojectedRadiance).Read(resources.varianceSampleCount[1 - m_bufferIndex]);
+					pass.Write(resources.radiance[m_bufferIndex]).Write(resources.varianceSampleCount[m_bufferIndex]);
+					if (applyReflections)
+					{
+						pass.Write(resources.hdr);
+					}
+				}
 			}
+		}
 
-			// Ensure that the temporal accumulation finished
+		if (sssrConstants.mipUsageStatisticsEnabled)
+		{
+			m_renderGraph.AddPass([&]()
 			{
-				D3D12_RESOURCE_BARRIER barriers[] = { 
-					CD3DX12_RESOURCE_BARRIER::Transition(m_radiance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_variance[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					CD3DX12_RESOURCE_BARRIER::Transition(m_sampleCount[m_bufferIndex].GetResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-				};
-				pCommandList->ResourceBarrier(_countof(barriers), barriers);
-			}
+				CopyMipUsage(pCommandList, readbackIndex);
+			}).Read(resources.rayCounter, ResourceState::CopySource);
+		}
 
-			// Also, copy the depth buffer for the next frame. This is optional if the engine already keeps a copy around. 
+		if (m_outputReadbackRequested)
+		{
+			m_renderGraph.AddPass([&]()
 			{
-				{
-					D3D12_RESOURCE_BARRIER barriers[] = {
-						CD3DX12_RESOURCE_BARRIER::Transition(m_depthHistory.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_depthBuffer->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_normalHistory.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_normalBuffer->GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_roughnessHistory.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_extractedRoughness.GetResource(), D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_SOURCE),
-					};
-					pCommandList->ResourceBarrier(_countof(barriers), barriers);
-				}
+				CopyOutput(pCommandList, sssrConstants.frameIndex);
+			}).Read(resources.radiance[m_bufferIndex], ResourceState::CopySource);
+		}
+
+		// The caller samples the output and draws the reflection tiles. The lit scene and the depth hierarchy are handed back
+		// in their original states, the ray counter in the one the next frame writes it in.
+		m_renderGraph.Export(resources.radiance[m_bufferIndex], ResourceState::ShaderResource);
+		m_renderGraph.Export(resources.reflectionTileList, ResourceState::ShaderResource);
+		m_renderGraph.Export(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument);
+		m_renderGraph.Export(resources.rayCounter, ResourceState::UnorderedAccess);
+		m_renderGraph.Export(resources.hdr, ResourceState::ShaderResource);
+		m_renderGraph.Export(resources.depthHierarchy, m_fusedDepthDownsample ? ResourceState::UnorderedAccess : ResourceState::ShaderResource);
+
+		m_renderGraph.Execute([&](const RenderGraphBarrier* pBarriers, uint32_t barrierCount)
+		{
+			IssueBarriers(pCommandList, pBarriers, barrierCount);
+		});
 
-				CopyToTexture(pCommandList, m_depthBuffer->GetResource(), m_depthHistory.GetResource(), m_screenWidth, m_screenHeight);
-				CopyToTexture(pCommandList, m_normalBuffer->GetResource(), m_normalHistory.GetResource(), m_screenWidth, m_screenHeight);
-				CopyToTexture(pCommandList, m_extractedRoughness.GetResource(), m_roughnessHistory.GetResource(), m_screenWidth, m_screenHeight);
+		m_bufferIndex = 1 - m_bufferIndex;
+	}
 
+	void SSSR::IssueBarriers(ID3D12GraphicsCommandList* pCommandList, const RenderGraphBarrier* pBarriers, uint32_t barrierCount)
+	{
+		D3D12_RESOURCE_BARRIER barriers[64];
+		uint32_t count = 0;
+		for (uint32_t i = 0; i < barrierCount; ++i)
+		{
+			const RenderGraphBarrier& barrier = pBarriers[i];
+			ID3D12Resource* pResource = m_graphResourceObjects[barrier.resource];
+			if (barrier.before == barrier.after)
+			{
+				// Back to back writes only wait for each other. There is no transition to split.
+				if (barrier.phase != BarrierPhase::Begin)
 				{
-					D3D12_RESOURCE_BARRIER barriers[] = {
-						CD3DX12_RESOURCE_BARRIER::Transition(m_depthHistory.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_depthBuffer->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_normalHistory.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_normalBuffer->GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_roughnessHistory.GetResource(), D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-						CD3DX12_RESOURCE_BARRIER::Transition(m_extractedRoughness.GetResource(), D3D12_RESOURCE_STATE_COPY_SOURCE, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
-					};
-					pCommandList->ResourceBarrier(_countof(barriers), barriers);
+					assert(count < _countof(barriers));
+					barriers[count++] = CD3DX12_RESOURCE_BARRIER::UAV(pResource);
 				}
+				continue;
+			}
+
+			D3D12_RESOURCE_BARRIER_FLAGS flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+			if (barrier.phase == BarrierPhase::Begin)
+			{
+				flags = D3D12_RESOURCE_BARRIER_FLAG_BEGIN_ONLY;
 			}
+			else if (barrier.phase == BarrierPhase::End)
+			{
+				flags = D3D12_RESOURCE_BARRIER_FLAG_END_ONLY;
+			}
+			assert(count < _countof(barriers));
+			barriers[count++] = CD3DX12_RESOURCE_BARRIER::Transition(pResource, GetD3D12ResourceState(barrier.before), GetD3D12ResourceState(barrier.after), D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES, flags);
 		}
 
-		m_bufferIndex = 1 - m_bufferIndex;
+		if (count > 0)
+		{
+			pCommandList->ResourceBarrier(count, barriers);
+		}
+	}
+
+	void SSSR::AddGraphResources()
+	{
+		m_renderGraph.RemoveResources();
+		m_graphResourceObjects.clear();
+
+		auto addResource = [this](Texture& resource, ResourceState state)
+		{
+			m_graphResourceObjects.push_back(resource.GetResource());
+			return m_renderGraph.AddResource(state);
+		};
+
+		// The states CreateResources and CreateWindowSizeDependentResources put them in. Draw leaves the ray counter and
+		// the indirect arguments in the same states.
+		GraphResources& resources = m_graphResources;
+		resources.rayCounter = addResource(m_rayCounter, ResourceState::UnorderedAccess);
+		resources.intersectionPassIndirectArgs = addResource(m_intersectionPassIndirectArgs, ResourceState::IndirectArgument);
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			resources.rayList[tileClass] = addResource(m_rayList[tileClass], ResourceState::ShaderResource);
+		}
+		resources.denoiserTileList = addResource(m_denoiserTileList, ResourceState::ShaderResource);
+		resources.environmentMapList = addResource(m_environmentMapList, ResourceState::ShaderResource);
+		resources.tileHistory = addResource(m_tileHistory, ResourceState::UnorderedAccess);
+		resources.reflectionTileList = addResource(m_reflectionTileList, ResourceState::ShaderResource);
+		resources.spatialFilterTileList = addResource(m_spatialFilterTileList, ResourceState::UnorderedAccess);
+		resources.convergedTileList = addResource(m_convergedTileList, ResourceState::UnorderedAccess);
+
+		for (int i = 0; i < 2; ++i)
+		{
+			resources.radiance[i] = addResource(m_radiance[i], ResourceState::ShaderResource);
+			resources.varianceSampleCount[i] = addResource(m_varianceSampleCount[i], ResourceState::ShaderResource);
+			resources.averageRadiance[i] = addResource(m_averageRadiance[i], ResourceState::ShaderResource);
+			resources.extractedRoughness[i] = addResource(m_extractedRoughness[i], ResourceState::ShaderResource);
+			resources.depthHistory[i] = addResource(m_depthHistory[i], ResourceState::ShaderResource);
+			resources.normalHistory[i] = addResource(m_normalHistory[i], ResourceState::ShaderResource);
+		}
+		resources.reprojectedRadiance = addResource(m_reprojectedRadiance, ResourceState::ShaderResource);
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			resources.accumulatedRadiance = addResource(m_accumulatedRadiance, ResourceState::UnorderedAccess);
+		}
+
+		resources.hdr = addResource(*m_hdr, ResourceState::ShaderResource);
+		resources.depthHierarchy = addResource(*m_depthHierarchy, m_fusedDepthDownsample ? ResourceState::UnorderedAccess : ResourceState::ShaderResource);
+	}
+
+	void SSSR::CopyMipUsage(ID3D12GraphicsCommandList* pCommandList, uint32_t readbackIndex)
+	{
+		UserMarker marker(pCommandList, "FFX SSSR Copy Mip Usage");
+		pCommandList->CopyBufferRegion(m_pMipUsageReadback, readbackIndex * sizeof(m_mipUsage), m_rayCounter.GetResource(), g_mipUsageCounterOffset, sizeof(m_mipUsage));
+
+		m_mipUsageReadbackPending[readbackIndex] = true;
+	}
+
+	void SSSR::CopyOutput(ID3D12GraphicsCommandList* pCommandList, uint32_t frameIndex)
+	{
+		UserMarker marker(pCommandList, "FFX SSSR Copy Output");
+
+		ID3D12Resource* pOutput = m_radiance[m_bufferIndex].GetResource();
+		if (!m_pOutputReadback)
+		{
+			// Rows of the readback are padded to D3D12_TEXTURE_DATA_PITCH_ALIGNMENT.
+			D3D12_RESOURCE_DESC outputDesc = pOutput->GetDesc();
+			UINT64 readbackSize = 0;
+			m_pDevice->GetDevice()->GetCopyableFootprints(&outputDesc, 0, 1, 0, &m_outputReadbackFootprint, nullptr, nullptr, &readbackSize);
+
+			ThrowIfFailed(m_pDevice->GetDevice()->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(readbackSize),
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(&m_pOutputReadback)));
+			m_pOutputReadback->SetName(L"SSSR - Output Readback");
+			ThrowIfFailed(m_pOutputReadback->Map(0, nullptr, reinterpret_cast<void**>(&m_pOutputReadbackData)));
+		}
+
+		CD3DX12_TEXTURE_COPY_LOCATION destination(m_pOutputReadback, m_outputReadbackFootprint);
+		CD3DX12_TEXTURE_COPY_LOCATION source(pOutput, 0);
+		pCommandList->CopyTextureRegion(&destination, 0, 0, 0, &source, nullptr);
+
+		m_outputReadbackRequested = false;
+		m_outputReadbackPending = true;
+		m_outputReadbackFrameIndex = frameIndex;
+	}
+
+	bool SSSR::IsStaticFrame(const SSSRConstants& sssrConstants, bool showIntersectResult, bool isSceneStatic)
+	{
+		// Reflections applied by the temporal resolve end up in the lit scene, which is rendered anew every frame.
+		bool canReuseOutput = isSceneStatic && !showIntersectResult && sssrConstants.applyReflectionsInResolve == 0;
+		m_staticFrameCount = canReuseOutput && HasSameInputs(sssrConstants, m_previousConstants) ? std::min(m_staticFrameCount + 1, g_staticFramesBeforeReuse) : 0;
+		m_previousConstants = sssrConstants;
+		return m_staticFrameCount == g_staticFramesBeforeReuse;
+	}
+
+	void SSSR::RequestOutputReadback()
+	{
+		m_outputReadbackRequested = true;
+		m_outputReadbackPending = false;
+		m_outputReadbackReady = false;
+	}
+
+	const uint16_t* SSSR::GetOutputReadback(uint32_t* pRowPitch) const
+	{
+		*pRowPitch = m_outputReadbackFootprint.Footprint.RowPitch;
+		return m_outputReadbackReady ? m_pOutputReadbackData : nullptr;
 	}
 
 	Texture* SSSR::GetOutputTexture(int frame)
@@ -404,24 +942,76 @@ namespace SSSR_SAMPLE_DX12
 		return &m_radiance[frame % 2];
 	}
 
+	uint32_t SSSR::GetOutputIndex() const
+	{
+		return 1 - m_bufferIndex;
+	}
+
+	Texture* SSSR::GetReflectionTileList()
+	{
+		return &m_reflectionTileList;
+	}
+
+	ID3D12Resource* SSSR::GetReflectionTileDrawArgs()
+	{
+		return m_intersectionPassIndirectArgs.GetResource();
+	}
+
+	UINT64 SSSR::GetReflectionTileDrawArgsOffset() const
+	{
+		return g_reflectionTileDrawArgsOffset;
+	}
+
+	const uint32_t* SSSR::GetMipUsage() const
+	{
+		return m_mipUsage;
+	}
+
+	uint32_t SSSR::GetAccumulatedSampleCount() const
+	{
+		return m_accumulatedBatchCount * m_accumulationSamplesPerPixel;
+	}
+
+	const SSSR_SAMPLE_COMMON::PipelineCacheStatistics& SSSR::GetPipelineCacheStatistics() const
+	{
+		return m_pipelineCacheStatistics;
+	}
+
 	void SSSR::Recompile()
 	{
+		WaitForCreation();
 		m_pDevice->GPUFlush();
+		m_staticFrameCount = 0;
+		// Recompiling picks up edits of the shader sources, which the precompiled blobs do not have.
+		m_shaderBlobs.Close();
 		m_classifyTilesPass.DestroyPipeline();
 		m_prepareIndirectArgsPass.DestroyPipeline();
-		m_intersectPass.DestroyPipeline();
+		m_preparePrefilterArgsPass.DestroyPipeline();
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			m_intersectPass[tileClass].DestroyPipeline();
+			m_accumulatePass[tileClass].DestroyPipeline();
+		}
+		m_environmentMapPass.DestroyPipeline();
 		m_resolveTemporalPass.DestroyPipeline();
+		m_resolveTemporalApplyPass.DestroyPipeline();
 		m_reprojectPass.DestroyPipeline();
+		m_fusedDenoiserPass.DestroyPipeline();
+		m_fusedDenoiserApplyPass.DestroyPipeline();
+		m_copyDenoiserTilesPass.DestroyPipeline();
 		m_prefilterPass.DestroyPipeline();
-		m_blueNoisePass.DestroyPipeline();
+		m_prefilterPassThroughPass.DestroyPipeline();
 
 		SetupClassifyTilesPass(false);
 		SetupPrepareIndirectArgsPass(false);
 		SetupIntersectionPass(false);
+		SetupEnvironmentMapPass(false);
 		SetupResolveTemporalPass(false);
 		SetupReprojectPass(false);
+		SetupFusedDenoiserPass(false);
+		SetupCopyDenoiserTilesPass(false);
 		SetupPrefilterPass(false);
-		SetupBlueNoisePass(false);
+		m_pipelineSync.Wait();
 	}
 
 	void SSSR::CreateResources()
@@ -429,11 +1019,23 @@ namespace SSSR_SAMPLE_DX12
 		uint32_t elementSize = 4;
 		//==============================Create Tile Classification-related buffers============================================
 		{
-			m_rayCounter.InitBuffer(m_pDevice, "SSSR - Ray Counter", &CD3DX12_RESOURCE_DESC::Buffer(4ull * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			// Two counters per tile class plus two each for the denoiser tiles, the environment map pixels, the reflection tiles and the spatial filter and converged tiles, followed by the mip usage counters. See Common.hlsl.
+			m_rayCounter.InitBuffer(m_pDevice, "SSSR - Ray Counter", &CD3DX12_RESOURCE_DESC::Buffer((2ull * TILE_CLASS_COUNT + 10 + DEPTH_HIERARCHY_MAX_MIP_COUNT) * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+		}
+		//==============================Create mip usage readback buffer============================================
+		{
+			ThrowIfFailed(m_pDevice->GetDevice()->CreateCommittedResource(
+				&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_READBACK),
+				D3D12_HEAP_FLAG_NONE,
+				&CD3DX12_RESOURCE_DESC::Buffer(1ull * m_frameCountBeforeReuse * DEPTH_HIERARCHY_MAX_MIP_COUNT * elementSize),
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(&m_pMipUsageReadback)));
+			m_pMipUsageReadback->SetName(L"SSSR - Mip Usage Readback");
 		}
 		//==============================Create PrepareIndirectArgs-related buffers============================================
 		{
-			m_intersectionPassIndirectArgs.InitBuffer(m_pDevice, "SSSR - Intersect Indirect Args", &CD3DX12_RESOURCE_DESC::Buffer(6ull * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
+			m_intersectionPassIndirectArgs.InitBuffer(m_pDevice, "SSSR - Intersect Indirect Args", &CD3DX12_RESOURCE_DESC::Buffer((3ull * (TILE_CLASS_COUNT + 4) + 4) * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_INDIRECT_ARGUMENT);
 		}
 		//==============================Command Signature==========================================
 		{
@@ -448,18 +1050,6 @@ namespace SSSR_SAMPLE_DX12
 
 			ThrowIfFailed(m_pDevice->GetDevice()->CreateCommandSignature(&desc, nullptr, IID_PPV_ARGS(&m_pCommandSignature)));
 		}
-		//==============================Blue Noise buffers============================================
-		{
-			auto const& sampler_state = g_blueNoiseSamplerState;
-			BlueNoiseSamplerD3D12& sampler = m_blueNoiseSampler;
-			sampler.sobolBuffer.InitFromMem(m_pDevice, "SSSR - Sobol Buffer", &m_uploadHeapBuffers, &sampler_state.sobolBuffer, _countof(sampler_state.sobolBuffer), sizeof(std::int32_t));
-			sampler.rankingTileBuffer.InitFromMem(m_pDevice, "SSSR - Ranking Tile Buffer", &m_uploadHeapBuffers, &sampler_state.rankingTileBuffer, _countof(sampler_state.rankingTileBuffer), sizeof(std::int32_t));
-			sampler.scramblingTileBuffer.InitFromMem(m_pDevice, "SSSR - Scrambling Tile Buffer", &m_uploadHeapBuffers, &sampler_state.scramblingTileBuffer, _countof(sampler_state.scramblingTileBuffer), sizeof(std::int32_t));
-			m_uploadHeapBuffers.FlushAndFinish();
-
-			CD3DX12_RESOURCE_DESC blueNoiseDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8_UNORM, 128, 128, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-			m_blueNoiseTexture.Init(m_pDevice, "Reflection Denoiser - Blue Noise Texture", &blueNoiseDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-		}
 	}
 
 	void SSSR::CreateWindowSizeDependentResources()
@@ -468,51 +1058,265 @@ namespace SSSR_SAMPLE_DX12
 		//==============================Create Tile Classification-related buffers============================================
 		{
 			UINT64 num_pixels = (UINT64)m_screenWidth * m_screenHeight;
-			m_rayList.InitBuffer(m_pDevice, "SSSR - Ray List", &CD3DX12_RESOURCE_DESC::Buffer(num_pixels * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			m_rayList[TILE_CLASS_MIRROR].InitBuffer(m_pDevice, "SSSR - Ray List Mirror", &CD3DX12_RESOURCE_DESC::Buffer(num_pixels * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			m_rayList[TILE_CLASS_GLOSSY].InitBuffer(m_pDevice, "SSSR - Ray List Glossy", &CD3DX12_RESOURCE_DESC::Buffer(num_pixels * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			m_rayList[TILE_CLASS_ROUGH].InitBuffer(m_pDevice, "SSSR - Ray List Rough", &CD3DX12_RESOURCE_DESC::Buffer(num_pixels * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 			m_denoiserTileList.InitBuffer(m_pDevice, "SSSR - Denoiser Tile List", &CD3DX12_RESOURCE_DESC::Buffer(num_pixels * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			m_environmentMapList.InitBuffer(m_pDevice, "SSSR - Environment Map List", &CD3DX12_RESOURCE_DESC::Buffer(num_pixels * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+
+			// Committed resources start out zeroed, matching the zeroed radiance targets. Only ClassifyTiles accesses it, so it stays in UA state.
+			UINT64 num_tiles = (UINT64)DivideRoundingUp(m_screenWidth, 8u) * DivideRoundingUp(m_screenHeight, 8u);
+			m_tileHistory.InitBuffer(m_pDevice, "SSSR - Tile History", &CD3DX12_RESOURCE_DESC::Buffer(num_tiles * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			m_reflectionTileList.InitBuffer(m_pDevice, "SSSR - Reflection Tile List", &CD3DX12_RESOURCE_DESC::Buffer(num_tiles * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+			// Written by the reprojection and only read as SRV by the prefilter passes, so they rest in UA state.
+			m_spatialFilterTileList.InitBuffer(m_pDevice, "SSSR - Spatial Filter Tile List", &CD3DX12_RESOURCE_DESC::Buffer(num_tiles * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+			m_convergedTileList.InitBuffer(m_pDevice, "SSSR - Converged Tile List", &CD3DX12_RESOURCE_DESC::Buffer(num_tiles * elementSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS), elementSize, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 		}
 		//==============================Create denoising-related resources==============================
 		{
 			CD3DX12_RESOURCE_DESC radianceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16B16A16_FLOAT, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 			CD3DX12_RESOURCE_DESC averageRadianceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R11G11B10_FLOAT, DivideRoundingUp(m_screenWidth, 8u), DivideRoundingUp(m_screenHeight, 8u), 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-			CD3DX12_RESOURCE_DESC varianceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16_FLOAT, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-			CD3DX12_RESOURCE_DESC sampleCountDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16_FLOAT, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-			
-			CD3DX12_RESOURCE_DESC depthHistoryDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32_FLOAT, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-			CD3DX12_RESOURCE_DESC normalHistoryDesc = CD3DX12_RESOURCE_DESC::Tex2D(m_normalBuffer->GetFormat(), m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+			// Variance and sample count are read together, so they share one texel.
+			CD3DX12_RESOURCE_DESC varianceSampleCountDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R16G16_FLOAT, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+
+			// The history holds view space depth and octahedral normals. See EncodeHistoryDepth and EncodeOctahedralNormal in Common.hlsl.
+			DXGI_FORMAT depthHistoryFormat = m_lowPrecisionHistory ? DXGI_FORMAT_R16_FLOAT : DXGI_FORMAT_R32_FLOAT;
+			DXGI_FORMAT normalHistoryFormat = m_lowPrecisionHistory ? DXGI_FORMAT_R8G8_UNORM : DXGI_FORMAT_R16G16_UNORM;
+			CD3DX12_RESOURCE_DESC depthHistoryDesc = CD3DX12_RESOURCE_DESC::Tex2D(depthHistoryFormat, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+			CD3DX12_RESOURCE_DESC normalHistoryDesc = CD3DX12_RESOURCE_DESC::Tex2D(normalHistoryFormat, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 			CD3DX12_RESOURCE_DESC roughnessTextureDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8_UNORM, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
-			m_extractedRoughness.Init(m_pDevice, "Reflection Denoiser - Extracted Roughness Texture", &roughnessTextureDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_depthHistory.Init(m_pDevice, "Reflection Denoiser - Depth Buffer History", &depthHistoryDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_normalHistory.Init(m_pDevice, "Reflection Denoiser - Normal Buffer History", &normalHistoryDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_roughnessHistory.Init(m_pDevice, "Reflection Denoiser - Extracted Roughness History Texture", &roughnessTextureDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_extractedRoughness[0].Init(m_pDevice, "Reflection Denoiser - Extracted Roughness Texture 0", &roughnessTextureDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_extractedRoughness[1].Init(m_pDevice, "Reflection Denoiser - Extracted Roughness Texture 1", &roughnessTextureDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_depthHistory[0].Init(m_pDevice, "Reflection Denoiser - Depth Buffer History 0", &depthHistoryDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_depthHistory[1].Init(m_pDevice, "Reflection Denoiser - Depth Buffer History 1", &depthHistoryDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_normalHistory[0].Init(m_pDevice, "Reflection Denoiser - Normal Buffer History 0", &normalHistoryDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_normalHistory[1].Init(m_pDevice, "Reflection Denoiser - Normal Buffer History 1", &normalHistoryDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 
 			m_radiance[0].Init(m_pDevice, "Reflection Denoiser - Radiance 0", &radianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 			m_radiance[1].Init(m_pDevice, "Reflection Denoiser - Radiance 1", &radianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_variance[0].Init(m_pDevice, "Reflection Denoiser - Variance 0", &varianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_variance[1].Init(m_pDevice, "Reflection Denoiser - Variance 1", &varianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_sampleCount[0].Init(m_pDevice, "Reflection Denoiser - Variance 0", &sampleCountDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
-			m_sampleCount[1].Init(m_pDevice, "Reflection Denoiser - Variance 1", &sampleCountDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_varianceSampleCount[0].Init(m_pDevice, "Reflection Denoiser - Variance and Sample Count 0", &varianceSampleCountDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+			m_varianceSampleCount[1].Init(m_pDevice, "Reflection Denoiser - Variance and Sample Count 1", &varianceSampleCountDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 			m_averageRadiance[0].Init(m_pDevice, "Reflection Denoiser - Average Radiance 0", &averageRadianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 			m_averageRadiance[1].Init(m_pDevice, "Reflection Denoiser - Average Radiance 1", &averageRadianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
 			m_reprojectedRadiance.Init(m_pDevice, "Reflection Denoiser - Reprojected Radiance", &radianceDesc, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, nullptr);
+
+			// Stays in the unordered access state. It is only ever cleared and accessed by the accumulation passes.
+			if (m_accumulationSamplesPerPixel > 0)
+			{
+				CD3DX12_RESOURCE_DESC accumulatedRadianceDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R32G32B32A32_FLOAT, m_screenWidth, m_screenHeight, 1, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+				m_accumulatedRadiance.Init(m_pDevice, "SSSR - Accumulated Radiance", &accumulatedRadianceDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+			}
 		}
 
 		m_bufferIndex = 0;
+		m_staticFrameCount = 0;
+		m_accumulatedBatchCount = 0;
+	}
+
+	/**
+		Compiles the shader of a pass. Adds the defines shared by all passes.
+		Takes the blob compiled at build time instead if there is one. It stays valid until OnDestroy.
+	*/
+	void SSSR::CompilePassShader(const char* shader, DefineList& defines, D3D12_SHADER_BYTECODE* pShaderByteCode)
+	{
+		if (m_linearDepthHierarchy)
+		{
+			defines["LINEAR_DEPTH_HIERARCHY"] = "1";
+		}
+		const SSSR_SAMPLE_COMMON::MappedFile* pBlob = m_shaderBlobs.Find(shader, defines);
+		if (pBlob)
+		{
+			pShaderByteCode->pShaderBytecode = pBlob->Data();
+			pShaderByteCode->BytecodeLength = pBlob->Size();
+			return;
+		}
+		// [WaveSize] needs shader model 6.6.
+		const char* params = defines.count("WAVE_SIZE") ? "-enable-16bit-types -T cs_6_6 /Zi /Zss" : "-enable-16bit-types -T cs_6_2 /Zi /Zss";
+		CompileShaderFromFile(shader, &defines, "main", params, pShaderByteCode);
+	}
+
+	void SSSR::CreatePipelineLibrary()
+	{
+		m_pipelineCacheStatistics = {};
+		ID3D12Device1* pDevice1 = nullptr;
+		if (FAILED(m_pDevice->GetDevice()->QueryInterface(IID_PPV_ARGS(&pDevice1))))
+		{
+			return;
+		}
+
+		// The runtime keys the library by adapter and driver version. The shaders are part of the pipeline names, see CreatePipelineState.
+		SSSR_SAMPLE_COMMON::LoadPipelineCacheFile(g_pipelineLibraryPath, m_pipelineLibraryData);
+		HRESULT hr = pDevice1->CreatePipelineLibrary(m_pipelineLibraryData.data(), m_pipelineLibraryData.size(), IID_PPV_ARGS(&m_pPipelineLibrary));
+		if (hr == D3D12_ERROR_ADAPTER_NOT_FOUND || hr == D3D12_ERROR_DRIVER_VERSION_MISMATCH || hr == E_INVALIDARG)
+		{
+			Trace("Discarding %s, it was written by another device or driver", g_pipelineLibraryPath);
+			m_pipelineLibraryData.clear();
+			hr = pDevice1->CreatePipelineLibrary(nullptr, 0, IID_PPV_ARGS(&m_pPipelineLibrary));
+		}
+		if (FAILED(hr))
+		{
+			Trace("Pipeline libraries are not supported, the SSSR pipelines are compiled on every run");
+			m_pPipelineLibrary = nullptr;
+			m_pipelineLibraryData.clear();
+		}
+		pDevice1->Release();
+	}
+
+	void SSSR::SavePipelineLibrary()
+	{
+		Trace("SSSR pipeline cache: %u hits, %u misses, %.2f ms creating pipelines",
+			m_pipelineCacheStatistics.hits, m_pipelineCacheStatistics.misses, m_pipelineCacheStatistics.creationMilliseconds);
+		if (!m_pPipelineLibrary)
+		{
+			return;
+		}
+
+		// Nothing to write if no pipeline was added to the data loaded from the file. Misses whose store failed add nothing.
+		std::vector<uint8_t> data(m_pPipelineLibrary->GetSerializedSize());
+		if (FAILED(m_pPipelineLibrary->Serialize(data.data(), data.size())) || (data != m_pipelineLibraryData && !SSSR_SAMPLE_COMMON::SavePipelineCacheFile(g_pipelineLibraryPath, data.data(), data.size())))
+		{
+			Trace("Failed to save %s", g_pipelineLibraryPath);
+		}
+		m_pPipelineLibrary->Release();
+		m_pPipelineLibrary = nullptr;
+		m_pipelineLibraryData.clear();
+	}
+
+	ID3D12PipelineState* SSSR::CreatePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, const std::string& name)
+	{
+		ID3D12Device* pDevice = m_pDevice->GetDevice();
+		ID3D12PipelineState* pPipeline = nullptr;
+		bool isCacheHit = false;
+		auto start = std::chrono::high_resolution_clock::now();
+		if (m_pPipelineLibrary)
+		{
+			// The hash of the shader is part of the name, so an edited shader never loads the pipeline of its old version.
+			char hash[17];
+			snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)SSSR_SAMPLE_COMMON::HashPipelineData(desc.CS.pShaderBytecode, desc.CS.BytecodeLength));
+			std::string libraryName = name + " " + hash;
+			std::wstring wideLibraryName(libraryName.begin(), libraryName.end());
+
+			// Fails with E_INVALIDARG if the library has no pipeline of that name.
+			isCacheHit = SUCCEEDED(m_pPipelineLibrary->LoadComputePipeline(wideLibraryName.c_str(), &desc, IID_PPV_ARGS(&pPipeline)));
+			if (!isCacheHit)
+			{
+				ThrowIfFailed(pDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pPipeline)));
+				// Fails if a pipeline with that name but another description is stored already. It is then compiled on every run.
+				m_pPipelineLibrary->StorePipeline(wideLibraryName.c_str(), pPipeline);
+			}
+		}
+		else
+		{
+			ThrowIfFailed(pDevice->CreateComputePipelineState(&desc, IID_PPV_ARGS(&pPipeline)));
+		}
+		double creationMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		{
+			std::lock_guard<std::mutex> lock(m_pipelineCacheStatisticsMutex);
+			m_pipelineCacheStatistics.creationMilliseconds += creationMilliseconds;
+			if (isCacheHit)
+			{
+				++m_pipelineCacheStatistics.hits;
+			}
+			else
+			{
+				++m_pipelineCacheStatistics.misses;
+			}
+		}
+		CAULDRON_DX12::SetName(pPipeline, name.c_str());
+		return pPipeline;
+	}
+
+	ID3D12PipelineState* SSSR::GetPipeline(ShaderPass& pass, const SSSRConstants& sssrConstants)
+	{
+		if (pass.permutationMask == 0)
+		{
+			return pass.pPipeline;
+		}
+
+		uint32_t key = GetPermutationKey(sssrConstants) & pass.permutationMask;
+		auto it = pass.permutations.find(key);
+		if (it != pass.permutations.end())
+		{
+			return it->second;
+		}
+
+		DefineList defines = pass.defines;
+		AddPermutationDefines(key, pass.permutationMask, defines);
+		ID3D12PipelineState* pPipeline = CreatePipeline(pass, defines, pass.pipelineName + " " + std::to_string(key));
+		pass.permutations[key] = pPipeline;
+		return pPipeline;
+	}
+
+	ID3D12PipelineState* SSSR::CreatePipeline(const ShaderPass& pass, const DefineList& defines, const std::string& name)
+	{
+		D3D12_SHADER_BYTECODE shaderByteCode = {};
+		DefineList shaderDefines = defines;
+		CompilePassShader(pass.shader.c_str(), shaderDefines, &shaderByteCode);
+
+		D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
+		descPso.CS = shaderByteCode;
+		descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
+		descPso.pRootSignature = pass.pRootSignature;
+		descPso.NodeMask = 0;
+		return CreatePipelineState(descPso, name);
+	}
+
+	uint32_t SSSR::GetWaveSize(uint32_t preferredWaveSize) const
+	{
+		if (preferredWaveSize < m_minWaveLaneCount || preferredWaveSize > m_maxWaveLaneCount)
+		{
+			return 0;
+		}
+		return preferredWaveSize;
+	}
+
+	void SSSR::CreatePipelineAsync(ShaderPass& pass)
+	{
+		// The pass itself is not touched by anyone else until WaitForCreation.
+		auto job = [this, &pass]()
+		{
+			pass.pPipeline = CreatePipeline(pass, pass.defines, pass.pipelineName);
+		};
+		if (m_pAsyncPool)
+		{
+			m_pAsyncPool->AddAsyncTask(job, &m_pipelineSync);
+		}
+		else
+		{
+			job();
+		}
 	}
 
 	void SSSR::SetupClassifyTilesPass(bool allocateDescriptorTable)
 	{
 		ShaderPass& shaderpass = m_classifyTilesPass;
 
-		const UINT srvCount = 5;
-		const UINT uavCount = 5;
+		const UINT srvCount = 6;
+		// The fused depth downsample also writes every mip of the depth hierarchy and the atomic counter of the downsampling lib.
+		const UINT uavCount = m_fusedDepthDownsample ? 12 + DEPTH_HIERARCHY_MAX_MIP_COUNT + 1 : 12;
 
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
-		//==============================Compile Shaders============================================
+		//==============================Shader Permutations============================================
 		{
 			DefineList defines;
-			CompileShaderFromFile("ClassifyTiles.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
+			if (m_fusedDepthDownsample)
+			{
+				defines["FUSED_DEPTH_DOWNSAMPLE"] = "1";
+				if (m_halfPrecisionDepthHierarchy)
+				{
+					defines["HALF_PRECISION_DEPTH_HIERARCHY"] = "1";
+				}
+			}
+			const uint32_t waveSize = GetWaveSize(g_classifyTilesWaveSize);
+			if (waveSize != 0)
+			{
+				defines["WAVE_SIZE"] = std::to_string(waveSize);
+			}
+			// Compiled on first use, see GetPipeline.
+			shaderpass.permutationMask = g_classifyTilesPermutationMask;
+			shaderpass.shader = "ClassifyTiles.hlsl";
+			shaderpass.pipelineName = "Reflection Denoiser - ClassifyTiles Pso";
+			shaderpass.defines = defines;
 		}
 		//==============================Allocate Descriptor Table=========================================
 		if (allocateDescriptorTable)
@@ -520,13 +1324,11 @@ namespace SSSR_SAMPLE_DX12
 			for (size_t i = 0; i < 2; i++)
 			{
 				m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
-				//Descriptor Table - Sampler
-				m_pResourceViewHeaps->AllocSamplerDescriptor(1, &shaderpass.descriptorTables_Sampler[i]);
 			}
 		}
 		//==============================RootSignature============================================
 		{
-			CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
+			CD3DX12_ROOT_PARAMETER RTSlot[2] = {};
 
 			int parameterCount = 0;
 			CD3DX12_DESCRIPTOR_RANGE DescRange_1[2] = {};
@@ -539,13 +1341,6 @@ namespace SSSR_SAMPLE_DX12
 			}
 			//Param 1
 			RTSlot[parameterCount++].InitAsConstantBufferView(0);
-			CD3DX12_DESCRIPTOR_RANGE DescRange_2[1] = {};
-			{
-				//Param 2
-				int rangeCount = 0;
-				DescRange_2[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0, 0, 0);
-				RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange_2[0], D3D12_SHADER_VISIBILITY_ALL); // g_environment_map_sampler
-			}
 
 			CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
 			descRootSignature.NumParameters = parameterCount;
@@ -567,100 +1362,177 @@ namespace SSSR_SAMPLE_DX12
 			if (pErrorBlob)
 				pErrorBlob->Release();
 		}
-		//==============================PipelineStates============================================
-		{
-			D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-			descPso.CS = shaderByteCode;
-			descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-			descPso.pRootSignature = shaderpass.pRootSignature;
-			descPso.NodeMask = 0;
-
-			ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-			CAULDRON_DX12::SetName(shaderpass.pPipeline, "Reflection Denoiser - ClassifyTiles Pso");
-		}
 	}
 
 	void SSSR::SetupPrepareIndirectArgsPass(bool allocateDescriptorTable)
 	{
-		ShaderPass& shaderpass = m_prepareIndirectArgsPass;
-
-		const UINT srvCount = 0;
-		const UINT uavCount = 2;
+		// The second variant runs after the reprojection and prepares the prefilter arguments.
+		for (int preparePrefilterArgs = 0; preparePrefilterArgs < 2; ++preparePrefilterArgs)
+		{
+			ShaderPass& shaderpass = preparePrefilterArgs ? m_preparePrefilterArgsPass : m_prepareIndirectArgsPass;
 
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
+			const UINT srvCount = 0;
+			const UINT uavCount = 2;
 
-		//==============================Compile Shaders============================================
-		{
-			DefineList defines;
-			CompileShaderFromFile("PrepareIndirectArgs.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
-		}
-		//==============================DescriptorTable==========================================
-		if (allocateDescriptorTable)
-		{
-			for (size_t i = 0; i < 2; i++)
+			//==============================Shader Defines============================================
 			{
-				m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+				DefineList defines;
+				if (preparePrefilterArgs)
+				{
+					defines["PREPARE_PREFILTER_ARGS"] = "1";
+				}
+				shaderpass.shader = "PrepareIndirectArgs.hlsl";
+				shaderpass.defines = defines;
+			}
+			//==============================DescriptorTable==========================================
+			if (allocateDescriptorTable)
+			{
+				for (size_t i = 0; i < 2; i++)
+				{
+					m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+				}
+			}
+			//==============================RootSignature============================================
+			{
+				CD3DX12_ROOT_PARAMETER RTSlot[1] = {};
+
+				int parameterCount = 0;
+				CD3DX12_DESCRIPTOR_RANGE DescRange[1] = {};
+				{
+					int rangeCount = 0;
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
+					RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
+				}
+
+				CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
+				descRootSignature.NumParameters = parameterCount;
+				descRootSignature.pParameters = RTSlot;
+				descRootSignature.NumStaticSamplers = 0;
+				descRootSignature.pStaticSamplers = nullptr;
+				// deny uneccessary access to certain pipeline stages   
+				descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+				ID3DBlob* pOutBlob = nullptr;
+				ID3DBlob* pErrorBlob = nullptr;
+				ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+				ThrowIfFailed(
+					m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
+				);
+				CAULDRON_DX12::SetName(shaderpass.pRootSignature, preparePrefilterArgs ? "PreparePrefilterArgs Rootsignature" : "PrepareIndirectArgs Rootsignature");
+
+				pOutBlob->Release();
+				if (pErrorBlob)
+					pErrorBlob->Release();
+				//==============================PipelineStates============================================
+				shaderpass.pipelineName = preparePrefilterArgs ? "PreparePrefilterArgs Pso" : "PrepareIndirectArgs Pso";
+				CreatePipelineAsync(shaderpass);
 			}
 		}
-		//==============================RootSignature============================================
+	}
+
+	void SSSR::SetupIntersectionPass(bool allocateDescriptorTable)
+	{
+		// The accumulation passes follow the intersection passes. They additionally write the accumulated radiance.
+		const uint32_t passCount = m_accumulationSamplesPerPixel > 0 ? 2 * TILE_CLASS_COUNT : TILE_CLASS_COUNT;
+		for (uint32_t passIndex = 0; passIndex < passCount; ++passIndex)
 		{
-			CD3DX12_ROOT_PARAMETER RTSlot[1] = {};
+			const uint32_t tileClass = passIndex % TILE_CLASS_COUNT;
+			const bool accumulate = passIndex >= TILE_CLASS_COUNT;
+			ShaderPass& shaderpass = accumulate ? m_accumulatePass[tileClass] : m_intersectPass[tileClass];
+			const char* passName = accumulate ? "SSSR - Accumulation" : "SSSR - Intersection";
 
-			int parameterCount = 0;
-			CD3DX12_DESCRIPTOR_RANGE DescRange[1] = {};
+			const UINT srvCount = 8;
+			const UINT uavCount = accumulate ? 3 : 2;
+
+			//==============================Shader Permutations============================================
 			{
-				int rangeCount = 0;
-				DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
-				RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
+				DefineList defines;
+				defines["TILE_CLASS"] = g_tileClassDefines[tileClass];
+				if (accumulate)
+				{
+					defines["ACCUMULATION_SAMPLE_COUNT"] = std::to_string(m_accumulationSamplesPerPixel);
+				}
+				const uint32_t waveSize = GetWaveSize(g_intersectWaveSize);
+				if (waveSize != 0)
+				{
+					defines["WAVE_SIZE"] = std::to_string(waveSize);
+				}
+				// Compiled on first use, see GetPipeline.
+				shaderpass.permutationMask = g_intersectPermutationMask;
+				shaderpass.shader = "Intersect.hlsl";
+				shaderpass.pipelineName = std::string(passName) + " Pso " + g_tileClassNames[tileClass];
+				shaderpass.defines = defines;
 			}
 
-			CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
-			descRootSignature.NumParameters = parameterCount;
-			descRootSignature.pParameters = RTSlot;
-			descRootSignature.NumStaticSamplers = 0;
-			descRootSignature.pStaticSamplers = nullptr;
-			// deny uneccessary access to certain pipeline stages   
-			descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
-
-			ID3DBlob* pOutBlob = nullptr;
-			ID3DBlob* pErrorBlob = nullptr;
-			ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
-			ThrowIfFailed(
-				m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
-			);
-			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "PrepareIndirectArgs Rootsignature");
-
-			pOutBlob->Release();
-			if (pErrorBlob)
-				pErrorBlob->Release();
-			//==============================PipelineStates============================================
+			//==============================DescriptorTable==========================================
+			if (allocateDescriptorTable)
 			{
-				D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-				descPso.CS = shaderByteCode;
-				descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-				descPso.pRootSignature = shaderpass.pRootSignature;
-				descPso.NodeMask = 0;
+				for (size_t i = 0; i < 2; i++)
+				{
+					//Descriptor Table - CBV_SRV_UAV
+					m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+					//Descriptor Table - Sampler
+					m_pResourceViewHeaps->AllocSamplerDescriptor(1, &shaderpass.descriptorTables_Sampler[i]);
+				}
+			}
+			//==============================RootSignature============================================
+			{
+				CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
+
+				int parameterCount = 0;
+				CD3DX12_DESCRIPTOR_RANGE DescRange_1[3] = {};
+				CD3DX12_DESCRIPTOR_RANGE DescRange_2[1] = {};
+				{
+					//Param 0
+					int rangeCount = 0;
+					DescRange_1[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, srvCount, 0, 0, 0);
+					DescRange_1[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
+					RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange_1[0], D3D12_SHADER_VISIBILITY_ALL);
+				}
+				//Param 1
+				RTSlot[parameterCount++].InitAsConstantBufferView(0);
+				{
+					//Param 2
+					int rangeCount = 0;
+					DescRange_2[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SAMPLER, 1, 0, 0, 0);
+					RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange_2[0], D3D12_SHADER_VISIBILITY_ALL); // g_environment_map_sampler
+				}
 
-				ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-				CAULDRON_DX12::SetName(shaderpass.pPipeline, "PrepareIndirectArgs Pso");
+				CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
+				descRootSignature.NumParameters = parameterCount;
+				descRootSignature.pParameters = RTSlot;
+				descRootSignature.NumStaticSamplers = 0;
+				descRootSignature.pStaticSamplers = nullptr;
+				// deny uneccessary access to certain pipeline stages   
+				descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+				ID3DBlob* pOutBlob = nullptr;
+				ID3DBlob* pErrorBlob = nullptr;
+				ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+				ThrowIfFailed(
+					m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
+				);
+				CAULDRON_DX12::SetName(shaderpass.pRootSignature, (std::string(passName) + " Root Signature " + g_tileClassNames[tileClass]).c_str());
+
+				pOutBlob->Release();
+				if (pErrorBlob)
+					pErrorBlob->Release();
 			}
 		}
 	}
 
-	void SSSR::SetupIntersectionPass(bool allocateDescriptorTable)
+	void SSSR::SetupEnvironmentMapPass(bool allocateDescriptorTable)
 	{
-		ShaderPass& shaderpass = m_intersectPass;
+		ShaderPass& shaderpass = m_environmentMapPass;
 
-		const UINT srvCount = 7;
+		const UINT srvCount = 5;
 		const UINT uavCount = 2;
 
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
-		ID3D12Device* device = m_pDevice->GetDevice();
-
-		//==============================Compile Shaders============================================
+		//==============================Shader Defines============================================
 		{
 			DefineList defines;
-			CompileShaderFromFile("Intersect.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
+			shaderpass.shader = "SampleEnvironmentMap.hlsl";
+			shaderpass.defines = defines;
 		}
 
 		//==============================DescriptorTable==========================================
@@ -679,7 +1551,7 @@ namespace SSSR_SAMPLE_DX12
 			CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
 
 			int parameterCount = 0;
-			CD3DX12_DESCRIPTOR_RANGE DescRange_1[3] = {};
+			CD3DX12_DESCRIPTOR_RANGE DescRange_1[2] = {};
 			CD3DX12_DESCRIPTOR_RANGE DescRange_2[1] = {};
 			{
 				//Param 0
@@ -711,115 +1583,181 @@ namespace SSSR_SAMPLE_DX12
 			ThrowIfFailed(
 				m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
 			);
-			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "SSSR - Intersection Root Signature");
+			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "SSSR - EnvironmentMap Root Signature");
 
 			pOutBlob->Release();
 			if (pErrorBlob)
 				pErrorBlob->Release();
 		}
 		//==============================PipelineStates============================================
-		{
-			D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-			descPso.CS = shaderByteCode;
-			descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-			descPso.pRootSignature = shaderpass.pRootSignature;
-			descPso.NodeMask = 0;
-
-			ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-			CAULDRON_DX12::SetName(shaderpass.pPipeline, "SSSR - Intersection Pso");
-		}
+		shaderpass.pipelineName = "SSSR - EnvironmentMap Pso";
+		CreatePipelineAsync(shaderpass);
 	}
 
 	void SSSR::SetupResolveTemporalPass(bool allocateDescriptorTable)
 	{
-		ShaderPass& shaderpass = m_resolveTemporalPass;
+		// The second variant also composites the reflections into the lit scene.
+		for (int applyReflections = 0; applyReflections < 2; ++applyReflections)
+		{
+			ShaderPass& shaderpass = applyReflections ? m_resolveTemporalApplyPass : m_resolveTemporalPass;
 
-		const UINT srvCount = 7;
-		const UINT uavCount = 3;
+			const UINT srvCount = applyReflections ? 9 : 6;
+			const UINT uavCount = applyReflections ? 3 : 2;
 
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
+			//==============================Shader Defines============================================
+			{
+				DefineList defines;
+				if (applyReflections)
+				{
+					defines["APPLY_REFLECTIONS"] = "1";
+				}
+				shaderpass.shader = "ResolveTemporal.hlsl";
+				shaderpass.defines = defines;
+			}
 
-		//==============================Compile Shaders============================================
-		{
-			DefineList defines;
-			CompileShaderFromFile("ResolveTemporal.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
-		}
+			//==============================DescriptorTable==========================================
 
-		//==============================DescriptorTable==========================================
+			//Descriptor Table - CBV_SRV_UAV
+			if (allocateDescriptorTable)
+			{
+				for (size_t i = 0; i < 2; i++)
+				{
+					m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+				}
+			}
 
-		//Descriptor Table - CBV_SRV_UAV
-		if (allocateDescriptorTable)
-		{
-			for (size_t i = 0; i < 2; i++)
+			//==============================RootSignature============================================
 			{
-				m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+				CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
+
+				int parameterCount = 0;
+				CD3DX12_DESCRIPTOR_RANGE DescRange[3] = {};
+				{
+					//Param 0
+					int rangeCount = 0;
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, srvCount, 0, 0, 0);
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
+					RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
+				}
+				//Param 1
+				RTSlot[parameterCount++].InitAsConstantBufferView(0);
+
+				D3D12_STATIC_SAMPLER_DESC samplerDescs[] = { InitLinearSampler(0) }; // g_linear_sampler
+
+				CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
+				descRootSignature.NumParameters = parameterCount;
+				descRootSignature.pParameters = RTSlot;
+				descRootSignature.NumStaticSamplers = _countof(samplerDescs);
+				descRootSignature.pStaticSamplers = samplerDescs;
+				// deny uneccessary access to certain pipeline stages   
+				descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+				ID3DBlob* pOutBlob = nullptr;
+				ID3DBlob* pErrorBlob = nullptr;
+				ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+				ThrowIfFailed(
+					m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
+				);
+				CAULDRON_DX12::SetName(shaderpass.pRootSignature, applyReflections ? "Reflection Denoiser - Temporal Resolve Apply Root Signature" : "Reflection Denoiser - Temporal Resolve Root Signature");
+
+				pOutBlob->Release();
+				if (pErrorBlob)
+					pErrorBlob->Release();
 			}
+			//==============================PipelineStates============================================
+			shaderpass.pipelineName = applyReflections ? "Reflection Denoiser - Temporal Resolve Apply Pso" : "Reflection Denoiser - Temporal Resolve Pso";
+			CreatePipelineAsync(shaderpass);
 		}
+	}
 
-		//==============================RootSignature============================================
+	void SSSR::SetupPrefilterPass(bool allocateDescriptorTable)
+	{
+		// The second variant skips the spatial filter for converged tiles and only forwards its inputs.
+		for (int passThrough = 0; passThrough < 2; ++passThrough)
 		{
-			CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
+			ShaderPass& shaderpass = passThrough ? m_prefilterPassThroughPass : m_prefilterPass;
 
-			int parameterCount = 0;
-			CD3DX12_DESCRIPTOR_RANGE DescRange[3] = {};
+			const UINT srvCount = 7;
+			const UINT uavCount = 2;
+
+			//==============================Shader Defines============================================
 			{
-				//Param 0
-				int rangeCount = 0;
-				DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, srvCount, 0, 0, 0);
-				DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
-				RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
+				DefineList defines;
+				if (passThrough)
+				{
+					defines["PASS_THROUGH"] = "1";
+				}
+				shaderpass.shader = "Prefilter.hlsl";
+				shaderpass.defines = defines;
 			}
-			//Param 1
-			RTSlot[parameterCount++].InitAsConstantBufferView(0);
-
-			D3D12_STATIC_SAMPLER_DESC samplerDescs[] = { InitLinearSampler(0) }; // g_linear_sampler
-
-			CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
-			descRootSignature.NumParameters = parameterCount;
-			descRootSignature.pParameters = RTSlot;
-			descRootSignature.NumStaticSamplers = _countof(samplerDescs);
-			descRootSignature.pStaticSamplers = samplerDescs;
-			// deny uneccessary access to certain pipeline stages   
-			descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
-			ID3DBlob* pOutBlob = nullptr;
-			ID3DBlob* pErrorBlob = nullptr;
-			ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
-			ThrowIfFailed(
-				m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
-			);
-			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "Reflection Denoiser - Temporal Resolve Root Signature");
+			//==============================DescriptorTable==========================================
+			if (allocateDescriptorTable)
+			{
+				ID3D12Device* device = m_pDevice->GetDevice();
 
-			pOutBlob->Release();
-			if (pErrorBlob)
-				pErrorBlob->Release();
-		}
-		//==============================PipelineStates============================================
-		{
-			D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-			descPso.CS = shaderByteCode;
-			descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-			descPso.pRootSignature = shaderpass.pRootSignature;
-			descPso.NodeMask = 0;
+				//Descriptor Table - CBV_SRV_UAV
+				for (size_t i = 0; i < 2; i++)
+				{
+					m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+				}
+			}
+			//==============================RootSignature============================================
+			{
+				CD3DX12_ROOT_PARAMETER RTSlot[2] = {};
 
-			ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-			CAULDRON_DX12::SetName(shaderpass.pPipeline, "Reflection Denoiser - Temporal Resolve Pso");
+				int parameterCount = 0;
+				CD3DX12_DESCRIPTOR_RANGE DescRange[2] = {};
+				{
+					//Param 0
+					int rangeCount = 0;
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, srvCount, 0, 0, 0);
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
+					RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
+				}
+				//Param 1
+				RTSlot[parameterCount++].InitAsConstantBufferView(0);
+
+				D3D12_STATIC_SAMPLER_DESC samplerDescs[] = { InitLinearSampler(0) }; // g_linear_sampler
+
+				CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
+				descRootSignature.NumParameters = parameterCount;
+				descRootSignature.pParameters = RTSlot;
+				descRootSignature.NumStaticSamplers = _countof(samplerDescs);
+				descRootSignature.pStaticSamplers = samplerDescs;
+				// deny uneccessary access to certain pipeline stages   
+				descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+				ID3DBlob* pOutBlob = nullptr;
+				ID3DBlob* pErrorBlob = nullptr;
+				ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+				ThrowIfFailed(
+					m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
+				);
+				CAULDRON_DX12::SetName(shaderpass.pRootSignature, passThrough ? "Reflection Denoiser - Prefilter Pass Through Root Signature" : "Reflection Denoiser - Prefilter Root Signature");
+
+				pOutBlob->Release();
+				if (pErrorBlob)
+					pErrorBlob->Release();
+			}
+			//==============================PipelineStates============================================
+			shaderpass.pipelineName = passThrough ? "Reflection Denoiser - Prefilter Pass Through Pso" : "Reflection Denoiser - Prefilter Pso";
+			CreatePipelineAsync(shaderpass);
 		}
 	}
 
-	void SSSR::SetupPrefilterPass(bool allocateDescriptorTable)
+	void SSSR::SetupReprojectPass(bool allocateDescriptorTable)
 	{
-		ShaderPass& shaderpass = m_prefilterPass;
-
-		const UINT srvCount = 8;
-		const UINT uavCount = 3;
+		ShaderPass& shaderpass = m_reprojectPass;
 
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
+		const UINT srvCount = 13;
+		const UINT uavCount = 6;
 
-		//==============================Compile Shaders============================================
+		//==============================Shader Defines============================================
 		{
 			DefineList defines;
-			CompileShaderFromFile("Prefilter.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
+			shaderpass.shader = "Reproject.hlsl";
+			shaderpass.defines = defines;
 		}
 
 		//==============================DescriptorTable==========================================
@@ -835,10 +1773,10 @@ namespace SSSR_SAMPLE_DX12
 		}
 		//==============================RootSignature============================================
 		{
-			CD3DX12_ROOT_PARAMETER RTSlot[2] = {};
+			CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
 
 			int parameterCount = 0;
-			CD3DX12_DESCRIPTOR_RANGE DescRange[2] = {};
+			CD3DX12_DESCRIPTOR_RANGE DescRange[3] = {};
 			{
 				//Param 0
 				int rangeCount = 0;
@@ -865,45 +1803,110 @@ namespace SSSR_SAMPLE_DX12
 			ThrowIfFailed(
 				m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
 			);
-			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "Reflection Denoiser - Prefilter Root Signature");
+			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "Reflection Denoiser - Reproject Root Signature");
 
 			pOutBlob->Release();
 			if (pErrorBlob)
 				pErrorBlob->Release();
 		}
 		//==============================PipelineStates============================================
+		shaderpass.pipelineName = "Reflection Denoiser - Reproject Pso";
+		CreatePipelineAsync(shaderpass);
+	}
+
+	void SSSR::SetupFusedDenoiserPass(bool allocateDescriptorTable)
+	{
+		// The second variant also composites the reflections into the lit scene.
+		for (int applyReflections = 0; applyReflections < 2; ++applyReflections)
 		{
-			D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-			descPso.CS = shaderByteCode;
-			descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-			descPso.pRootSignature = shaderpass.pRootSignature;
-			descPso.NodeMask = 0;
+			ShaderPass& shaderpass = applyReflections ? m_fusedDenoiserApplyPass : m_fusedDenoiserPass;
+
+			const UINT srvCount = applyReflections ? 13 : 11;
+			const UINT uavCount = applyReflections ? 4 : 3;
+
+			//==============================Shader Defines============================================
+			{
+				DefineList defines;
+				if (applyReflections)
+				{
+					defines["APPLY_REFLECTIONS"] = "1";
+				}
+				shaderpass.shader = "FusedDenoiser.hlsl";
+				shaderpass.defines = defines;
+			}
+
+			//==============================DescriptorTable==========================================
+
+			//Descriptor Table - CBV_SRV_UAV
+			if (allocateDescriptorTable)
+			{
+				for (size_t i = 0; i < 2; i++)
+				{
+					m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
+				}
+			}
 
-			ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-			CAULDRON_DX12::SetName(shaderpass.pPipeline, "Reflection Denoiser - Prefilter Pso");
+			//==============================RootSignature============================================
+			{
+				CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
+
+				int parameterCount = 0;
+				CD3DX12_DESCRIPTOR_RANGE DescRange[3] = {};
+				{
+					//Param 0
+					int rangeCount = 0;
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, srvCount, 0, 0, 0);
+					DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
+					RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
+				}
+				//Param 1
+				RTSlot[parameterCount++].InitAsConstantBufferView(0);
+
+				D3D12_STATIC_SAMPLER_DESC samplerDescs[] = { InitLinearSampler(0) }; // g_linear_sampler
+
+				CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
+				descRootSignature.NumParameters = parameterCount;
+				descRootSignature.pParameters = RTSlot;
+				descRootSignature.NumStaticSamplers = _countof(samplerDescs);
+				descRootSignature.pStaticSamplers = samplerDescs;
+				// deny uneccessary access to certain pipeline stages   
+				descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
+
+				ID3DBlob* pOutBlob = nullptr;
+				ID3DBlob* pErrorBlob = nullptr;
+				ThrowIfFailed(D3D12SerializeRootSignature(&descRootSignature, D3D_ROOT_SIGNATURE_VERSION_1, &pOutBlob, &pErrorBlob));
+				ThrowIfFailed(
+					m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
+				);
+				CAULDRON_DX12::SetName(shaderpass.pRootSignature, applyReflections ? "Reflection Denoiser - Fused Denoiser Apply Root Signature" : "Reflection Denoiser - Fused Denoiser Root Signature");
+
+				pOutBlob->Release();
+				if (pErrorBlob)
+					pErrorBlob->Release();
+			}
+			//==============================PipelineStates============================================
+			shaderpass.pipelineName = applyReflections ? "Reflection Denoiser - Fused Denoiser Apply Pso" : "Reflection Denoiser - Fused Denoiser Pso";
+			CreatePipelineAsync(shaderpass);
 		}
 	}
 
-	void SSSR::SetupReprojectPass(bool allocateDescriptorTable)
+	void SSSR::SetupCopyDenoiserTilesPass(bool allocateDescriptorTable)
 	{
-		ShaderPass& shaderpass = m_reprojectPass;
+		ShaderPass& shaderpass = m_copyDenoiserTilesPass;
 
-		const UINT srvCount = 14;
-		const UINT uavCount = 4;
-
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
+		const UINT srvCount = 2;
+		const UINT uavCount = 1;
 
-		//==============================Compile Shaders============================================
+		//==============================Shader Defines============================================
 		{
 			DefineList defines;
-			CompileShaderFromFile("Reproject.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
+			shaderpass.shader = "CopyDenoiserTiles.hlsl";
+			shaderpass.defines = defines;
 		}
 
 		//==============================DescriptorTable==========================================
 		if (allocateDescriptorTable)
 		{
-			ID3D12Device* device = m_pDevice->GetDevice();
-
 			//Descriptor Table - CBV_SRV_UAV
 			for (size_t i = 0; i < 2; i++)
 			{
@@ -926,13 +1929,11 @@ namespace SSSR_SAMPLE_DX12
 			//Param 1
 			RTSlot[parameterCount++].InitAsConstantBufferView(0);
 
-			D3D12_STATIC_SAMPLER_DESC samplerDescs[] = { InitLinearSampler(0) }; // g_linear_sampler
-
 			CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
 			descRootSignature.NumParameters = parameterCount;
 			descRootSignature.pParameters = RTSlot;
-			descRootSignature.NumStaticSamplers = _countof(samplerDescs);
-			descRootSignature.pStaticSamplers = samplerDescs;
+			descRootSignature.NumStaticSamplers = 0;
+			descRootSignature.pStaticSamplers = nullptr;
 			// deny uneccessary access to certain pipeline stages   
 			descRootSignature.Flags = D3D12_ROOT_SIGNATURE_FLAG_NONE;
 
@@ -942,57 +1943,44 @@ namespace SSSR_SAMPLE_DX12
 			ThrowIfFailed(
 				m_pDevice->GetDevice()->CreateRootSignature(0, pOutBlob->GetBufferPointer(), pOutBlob->GetBufferSize(), IID_PPV_ARGS(&shaderpass.pRootSignature))
 			);
-			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "Reflection Denoiser - Reproject Root Signature");
+			CAULDRON_DX12::SetName(shaderpass.pRootSignature, "Reflection Denoiser - Copy Denoiser Tiles Root Signature");
 
 			pOutBlob->Release();
 			if (pErrorBlob)
 				pErrorBlob->Release();
 		}
 		//==============================PipelineStates============================================
-		{
-			D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-			descPso.CS = shaderByteCode;
-			descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-			descPso.pRootSignature = shaderpass.pRootSignature;
-			descPso.NodeMask = 0;
-
-			ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-			CAULDRON_DX12::SetName(shaderpass.pPipeline, "Reflection Denoiser - Reproject Pso");
-		}
+		shaderpass.pipelineName = "Reflection Denoiser - Copy Denoiser Tiles Pso";
+		CreatePipelineAsync(shaderpass);
 	}
 
-	void SSSR::SetupBlueNoisePass(bool allocateDescriptorTable)
+	void SSSR::SetupBlueNoisePass(ShaderPass& shaderpass, bool sampleSet)
 	{
-		ShaderPass& shaderpass = m_blueNoisePass;
-
 		const UINT srvCount = 3;
 		const UINT uavCount = 1;
 
-		D3D12_SHADER_BYTECODE shaderByteCode = {};
-
-		//==============================Compile Shaders============================================
+		//==============================Shader Defines============================================
 		{
 			DefineList defines;
-			CompileShaderFromFile("PrepareBlueNoiseTexture.hlsl", &defines, "main", "-enable-16bit-types -T cs_6_2 /Zi /Zss", &shaderByteCode);
+			if (sampleSet)
+			{
+				defines["SAMPLE_SET"] = "1";
+			}
+			shaderpass.shader = "PrepareBlueNoiseTexture.hlsl";
+			shaderpass.defines = defines;
 		}
 
 		//==============================DescriptorTable==========================================
-		if (allocateDescriptorTable)
 		{
-			ID3D12Device* device = m_pDevice->GetDevice();
-
-			//Descriptor Table - CBV_SRV_UAV
-			for (size_t i = 0; i < 2; i++)
-			{
-				m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[i]);
-			}
+			// The pass only runs once, so a single table is enough.
+			m_pResourceViewHeaps->AllocCBV_SRV_UAVDescriptor(srvCount + uavCount, &shaderpass.descriptorTables_CBV_SRV_UAV[0]);
 		}
 		//==============================RootSignature============================================
 		{
-			CD3DX12_ROOT_PARAMETER RTSlot[3] = {};
+			CD3DX12_ROOT_PARAMETER RTSlot[1] = {};
 
 			int parameterCount = 0;
-			CD3DX12_DESCRIPTOR_RANGE DescRange[3] = {};
+			CD3DX12_DESCRIPTOR_RANGE DescRange[2] = {};
 			{
 				//Param 0
 				int rangeCount = 0;
@@ -1000,8 +1988,6 @@ namespace SSSR_SAMPLE_DX12
 				DescRange[rangeCount++].Init(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, uavCount, 0, 0, srvCount);
 				RTSlot[parameterCount++].InitAsDescriptorTable(rangeCount, &DescRange[0], D3D12_SHADER_VISIBILITY_ALL);
 			}
-			//Param 1
-			RTSlot[parameterCount++].InitAsConstantBufferView(0);
 
 			CD3DX12_ROOT_SIGNATURE_DESC descRootSignature = CD3DX12_ROOT_SIGNATURE_DESC();
 			descRootSignature.NumParameters = parameterCount;
@@ -1024,16 +2010,110 @@ namespace SSSR_SAMPLE_DX12
 				pErrorBlob->Release();
 		}
 		//==============================PipelineStates============================================
+		shaderpass.pipelineName = "Reflection Denoiser - Prepare Blue Noise Texture Pso";
+		CreatePipelineAsync(shaderpass);
+	}
+
+	uint32_t SSSR::BakeBlueNoiseTexture(Texture& texture, uint32_t samplesPerPixel, bool sampleSet)
+	{
+		// The noise of all frames is baked once. The sampler tables and the pass are only needed until then.
+		SSSR_SAMPLE_COMMON::BlueNoiseAsset asset;
+		if (!asset.Open(g_blueNoiseAssetPath))
+		{
+			Trace("Failed to open the blue noise asset %s", g_blueNoiseAssetPath);
+			assert(false);
+			return 0;
+		}
+		SSSR_SAMPLE_COMMON::BlueNoiseTables tables;
+		if (!asset.GetTables(samplesPerPixel, &tables))
+		{
+			Trace("No blue noise sampler for %u spp, falling back to %u spp", samplesPerPixel, asset.GetSamplesPerPixel(0));
+			asset.GetTables(asset.GetSamplesPerPixel(0), &tables);
+		}
+		const uint32_t sliceCount = sampleSet ? tables.samplesPerPixel : BLUE_NOISE_FRAME_COUNT;
+
+		// The asset stores one byte per entry, which the shader reads as is through R8_UINT views.
+		// The tables are copied straight out of the mapped file. All three fit into the upload heap at once.
+		using SSSR_SAMPLE_COMMON::BLUE_NOISE_SOBOL_SIZE;
+		using SSSR_SAMPLE_COMMON::BLUE_NOISE_TILE_SIZE;
+		// The baking itself is recorded by WaitForCreation, once the pipeline of the pass is compiled.
+		assert(m_blueNoiseBakeCount < _countof(m_blueNoiseBakes));
+		BlueNoiseBake& bake = m_blueNoiseBakes[m_blueNoiseBakeCount++];
+		bake.pTexture = &texture;
+		bake.sliceCount = sliceCount;
+
+		BlueNoiseSamplerD3D12& sampler = bake.sampler;
+		sampler.sobolBuffer.InitFromMem(m_pDevice, "SSSR - Sobol Buffer", &m_uploadHeapBuffers, tables.sobolBuffer, BLUE_NOISE_SOBOL_SIZE, sizeof(uint8_t), DXGI_FORMAT_R8_UINT);
+		sampler.rankingTileBuffer.InitFromMem(m_pDevice, "SSSR - Ranking Tile Buffer", &m_uploadHeapBuffers, tables.rankingTileBuffer, BLUE_NOISE_TILE_SIZE, sizeof(uint8_t), DXGI_FORMAT_R8_UINT);
+		sampler.scramblingTileBuffer.InitFromMem(m_pDevice, "SSSR - Scrambling Tile Buffer", &m_uploadHeapBuffers, tables.scramblingTileBuffer, BLUE_NOISE_TILE_SIZE, sizeof(uint8_t), DXGI_FORMAT_R8_UINT);
+		asset.Close();
+
+		// One slice per frame, which Intersect and Reproject pick by the frame index. Or one slice per sample for the accumulation passes.
+		CD3DX12_RESOURCE_DESC blueNoiseDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8_UNORM, 128, 128, sliceCount, 1, 1, 0, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+		texture.Init(m_pDevice, sampleSet ? "SSSR - Accumulation Noise Texture" : "Reflection Denoiser - Blue Noise Texture", &blueNoiseDesc, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, nullptr);
+
+		ShaderPass& blueNoisePass = bake.pass;
+		SetupBlueNoisePass(blueNoisePass, sampleSet);
+
+		auto& table = blueNoisePass.descriptorTables_CBV_SRV_UAV[0];
+		int tableSlot = 0;
+		sampler.sobolBuffer.CreateSRV(tableSlot++, &table);
+		sampler.rankingTileBuffer.CreateSRV(tableSlot++, &table);
+		sampler.scramblingTileBuffer.CreateSRV(tableSlot++, &table);
+		texture.CreateUAV(tableSlot++, &table);
+		return tables.samplesPerPixel;
+	}
+
+	bool SSSR::OpenSpatiotemporalBlueNoiseAsset(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset, SIZE_T* pUploadSize)
+	{
+		if (!asset.Open(g_spatiotemporalBlueNoiseAssetPath))
+		{
+			Trace("Failed to open the spatiotemporal blue noise asset %s, falling back to the baked blue noise", g_spatiotemporalBlueNoiseAssetPath);
+			return false;
+		}
+		if (asset.GetFrameCount() > D3D12_REQ_TEXTURE2D_ARRAY_AXIS_DIMENSION)
+		{
+			Trace("%s has more slices than a texture array can hold, falling back to the baked blue noise", g_spatiotemporalBlueNoiseAssetPath);
+			asset.Close();
+			return false;
+		}
+
+		// Every slice is suballocated on its own with the placement alignment of textures.
+		CD3DX12_RESOURCE_DESC blueNoiseDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8_UNORM, asset.GetWidth(), asset.GetHeight(), (UINT16)asset.GetFrameCount(), 1);
+		UINT64 sliceSize;
+		m_pDevice->GetDevice()->GetCopyableFootprints(&blueNoiseDesc, 0, 1, 0, nullptr, nullptr, nullptr, &sliceSize);
+		*pUploadSize = asset.GetFrameCount() * AlignUp((SIZE_T)sliceSize, (SIZE_T)D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+		return true;
+	}
+
+	void SSSR::LoadSpatiotemporalBlueNoiseTexture(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset)
+	{
+		// The asset already holds one slice per frame, so it is copied as is.
+		CD3DX12_RESOURCE_DESC blueNoiseDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8_UNORM, asset.GetWidth(), asset.GetHeight(), (UINT16)asset.GetFrameCount(), 1);
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT layout;
+		UINT numRows;
+		UINT64 rowSize;
+		UINT64 sliceSize;
+		m_pDevice->GetDevice()->GetCopyableFootprints(&blueNoiseDesc, 0, 1, 0, &layout, &numRows, &rowSize, &sliceSize);
+		m_blueNoiseTexture.Init(m_pDevice, "Reflection Denoiser - Spatiotemporal Blue Noise Texture", &blueNoiseDesc, D3D12_RESOURCE_STATE_COPY_DEST, nullptr);
+
+		// The upload heap was sized for all slices in OnCreate.
+		for (uint32_t i = 0; i < asset.GetFrameCount(); ++i)
 		{
-			D3D12_COMPUTE_PIPELINE_STATE_DESC descPso = {};
-			descPso.CS = shaderByteCode;
-			descPso.Flags = D3D12_PIPELINE_STATE_FLAG_NONE;
-			descPso.pRootSignature = shaderpass.pRootSignature;
-			descPso.NodeMask = 0;
+			UINT8* pDest = m_uploadHeapBuffers.BeginSuballocate((SIZE_T)sliceSize, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT);
+			const uint8_t* pSlice = asset.GetSlice(i);
+			for (UINT row = 0; row < numRows; ++row)
+			{
+				memcpy(pDest + row * layout.Footprint.RowPitch, pSlice + row * rowSize, (size_t)rowSize);
+			}
+			m_uploadHeapBuffers.EndSuballocate();
 
-			ThrowIfFailed(m_pDevice->GetDevice()->CreateComputePipelineState(&descPso, IID_PPV_ARGS(&shaderpass.pPipeline)));
-			CAULDRON_DX12::SetName(shaderpass.pPipeline, "Reflection Denoiser - Prepare Blue Noise Texture Pso");
+			layout.Offset = pDest - m_uploadHeapBuffers.BasePtr();
+			m_uploadHeapBuffers.AddCopy(CD3DX12_TEXTURE_COPY_LOCATION(m_uploadHeapBuffers.GetResource(), layout), CD3DX12_TEXTURE_COPY_LOCATION(m_blueNoiseTexture.GetResource(), i));
 		}
+		// The copies and the transition for the compute passes are submitted by WaitForCreation.
+		m_uploadHeapBuffers.AddBarrier(m_blueNoiseTexture.GetResource());
+		asset.Close();
 	}
 
 	void SSSR::InitializeDescriptorTableData(const SSSRCreationInfo& input)
@@ -1045,59 +2125,80 @@ namespace SSSR_SAMPLE_DX12
 			//==============================ClassifyTiles==========================================
 			{
 				auto& table = m_classifyTilesPass.descriptorTables_CBV_SRV_UAV[i];
-				auto& table_sampler = m_classifyTilesPass.descriptorTables_Sampler[i];
 				int tableSlot = 0;
 
 				input.SpecularRoughness->CreateSRV(tableSlot++, &table);
-				input.DepthHierarchy->CreateSRV(tableSlot++, &table);
-				m_variance[1 - i].CreateSRV(tableSlot++, &table);
-				input.NormalBuffer->CreateSRV(tableSlot++, &table);
-				device->CopyDescriptorsSimple(1, table.GetCPU(tableSlot++), m_environmentMapSRV.GetCPU(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
-
-				m_pDevice->GetDevice()->CreateSampler(&m_environmentMapSamplerDesc, table_sampler.GetCPU(0));
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
+				m_varianceSampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_variance_sample_count_history
+				input.MotionVectors->CreateSRV(tableSlot++, &table); // g_motion_vector
+				m_radiance[1 - i].CreateSRV(tableSlot++, &table); // g_radiance_history
+				input.NormalBuffer->CreateSRV(tableSlot++, &table); // g_normal
 
-				m_rayList.CreateBufferUAV(tableSlot++, nullptr, &table);
+				m_rayList[TILE_CLASS_MIRROR].CreateBufferUAV(tableSlot++, nullptr, &table); // g_ray_list_mirror
+				m_rayList[TILE_CLASS_GLOSSY].CreateBufferUAV(tableSlot++, nullptr, &table); // g_ray_list_glossy
+				m_rayList[TILE_CLASS_ROUGH].CreateBufferUAV(tableSlot++, nullptr, &table); // g_ray_list_rough
 				m_rayCounter.CreateBufferUAV(tableSlot++, nullptr, &table);
 
 				// Clear intersection result
 				m_radiance[i].CreateUAV(tableSlot++, &table);
-				m_extractedRoughness.CreateUAV(tableSlot++, &table);
+				m_extractedRoughness[i].CreateUAV(tableSlot++, &table);
 
 				m_denoiserTileList.CreateBufferUAV(tableSlot++, nullptr, &table); // g_denoiser_tile_list
+				m_environmentMapList.CreateBufferUAV(tableSlot++, nullptr, &table); // g_environment_map_list
+				m_tileHistory.CreateBufferUAV(tableSlot++, nullptr, &table); // g_tile_history
+				m_reflectionTileList.CreateBufferUAV(tableSlot++, nullptr, &table); // g_reflection_tile_list
+				m_depthHistory[i].CreateUAV(tableSlot++, &table); // g_depth_history_output
+				m_normalHistory[i].CreateUAV(tableSlot++, &table); // g_normal_history_output
+
+				if (m_fusedDepthDownsample)
+				{
+					// Map the mips past the last one to the dummy
+					for (uint32_t mip = 0; mip < DEPTH_HIERARCHY_MAX_MIP_COUNT; ++mip)
+					{
+						if (mip < input.DepthHierarchyMipCount)
+						{
+							input.DepthHierarchy->CreateUAV(tableSlot++, &table, mip); // g_downsampled_depth_buffer
+						}
+						else
+						{
+							input.DepthHierarchyDummy->CreateUAV(tableSlot++, &table);
+						}
+					}
+					input.DepthHierarchyAtomicCounter->CreateBufferUAV(tableSlot++, nullptr, &table); // g_global_atomic
+				}
 			}
-			//==============================PrepareBlueNoiseTexture==========================================
+			//==============================PrepareIndirectArgs==========================================
 			{
-				auto& table = m_blueNoisePass.descriptorTables_CBV_SRV_UAV[i];
+				auto& table = m_prepareIndirectArgsPass.descriptorTables_CBV_SRV_UAV[i];
 				int tableSlot = 0;
 
-				m_blueNoiseSampler.sobolBuffer.CreateSRV(tableSlot++, &table);
-				m_blueNoiseSampler.rankingTileBuffer.CreateSRV(tableSlot++, &table);
-				m_blueNoiseSampler.scramblingTileBuffer.CreateSRV(tableSlot++, &table);
-
-				m_blueNoiseTexture.CreateUAV(tableSlot++, &table);
+				m_rayCounter.CreateBufferUAV(tableSlot++, nullptr, &table);
+				m_intersectionPassIndirectArgs.CreateBufferUAV(tableSlot++, nullptr, &table);
 			}
-			//==============================PrepareIndirectArgs==========================================
+			//==============================PreparePrefilterArgs==========================================
 			{
-				auto& table = m_prepareIndirectArgsPass.descriptorTables_CBV_SRV_UAV[i];
+				auto& table = m_preparePrefilterArgsPass.descriptorTables_CBV_SRV_UAV[i];
 				int tableSlot = 0;
 
 				m_rayCounter.CreateBufferUAV(tableSlot++, nullptr, &table);
 				m_intersectionPassIndirectArgs.CreateBufferUAV(tableSlot++, nullptr, &table);
 			}
 			//==============================Intersection==========================================
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
 			{
-				auto& table = m_intersectPass.descriptorTables_CBV_SRV_UAV[i];
-				auto& table_sampler = m_intersectPass.descriptorTables_Sampler[i];
+				auto& table = m_intersectPass[tileClass].descriptorTables_CBV_SRV_UAV[i];
+				auto& table_sampler = m_intersectPass[tileClass].descriptorTables_Sampler[i];
 
 				int tableSlot = 0;
 
 				input.HDR->CreateSRV(tableSlot++, &table);
 				input.DepthHierarchy->CreateSRV(tableSlot++, &table);
 				input.NormalBuffer->CreateSRV(tableSlot++, &table);
-				m_extractedRoughness.CreateSRV(tableSlot++, &table);
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table);
 				device->CopyDescriptorsSimple(1, table.GetCPU(tableSlot++), m_environmentMapSRV.GetCPU(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 				m_blueNoiseTexture.CreateSRV(tableSlot++, &table);
-				m_rayList.CreateSRV(tableSlot++, &table);
+				m_rayList[tileClass].CreateSRV(tableSlot++, &table);
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
 
 				// Intersection result
 				m_radiance[i].CreateUAV(tableSlot++, &table);
@@ -1105,68 +2206,176 @@ namespace SSSR_SAMPLE_DX12
 
 				m_pDevice->GetDevice()->CreateSampler(&m_environmentMapSamplerDesc, table_sampler.GetCPU(0));
 			}
+			//==============================Accumulation==========================================
+			// Same as the intersection passes, but with the sample set instead of the per frame noise.
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT && m_accumulationSamplesPerPixel > 0; ++tileClass)
+			{
+				auto& table = m_accumulatePass[tileClass].descriptorTables_CBV_SRV_UAV[i];
+				auto& table_sampler = m_accumulatePass[tileClass].descriptorTables_Sampler[i];
+
+				int tableSlot = 0;
+
+				input.HDR->CreateSRV(tableSlot++, &table);
+				input.DepthHierarchy->CreateSRV(tableSlot++, &table);
+				input.NormalBuffer->CreateSRV(tableSlot++, &table);
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table);
+				device->CopyDescriptorsSimple(1, table.GetCPU(tableSlot++), m_environmentMapSRV.GetCPU(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
+				m_accumulationNoiseTexture.CreateSRV(tableSlot++, &table);
+				m_rayList[tileClass].CreateSRV(tableSlot++, &table);
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
+
+				m_radiance[i].CreateUAV(tableSlot++, &table);
+				m_rayCounter.CreateBufferUAV(tableSlot++, nullptr, &table);
+				m_accumulatedRadiance.CreateUAV(tableSlot++, &table); // g_accumulated_radiance
+
+				m_pDevice->GetDevice()->CreateSampler(&m_environmentMapSamplerDesc, table_sampler.GetCPU(0));
+			}
+			//==============================EnvironmentMap==========================================
+			{
+				auto& table = m_environmentMapPass.descriptorTables_CBV_SRV_UAV[i];
+				auto& table_sampler = m_environmentMapPass.descriptorTables_Sampler[i];
+
+				int tableSlot = 0;
+
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table); // g_roughness
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
+				input.NormalBuffer->CreateSRV(tableSlot++, &table); // g_normal
+				device->CopyDescriptorsSimple(1, table.GetCPU(tableSlot++), m_environmentMapSRV.GetCPU(), D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV); // g_environment_map
+				m_environmentMapList.CreateSRV(tableSlot++, &table); // g_environment_map_list
+
+				m_radiance[i].CreateUAV(tableSlot++, &table); // g_intersection_output
+				m_rayCounter.CreateBufferUAV(tableSlot++, nullptr, &table); // g_ray_counter
+
+				m_pDevice->GetDevice()->CreateSampler(&m_environmentMapSamplerDesc, table_sampler.GetCPU(0));
+			}
 			//==============================Reproject==========================================
 			{
 				auto& table = m_reprojectPass.descriptorTables_CBV_SRV_UAV[i];
 				int tableSlot = 0;
 
-				input.DepthHierarchy->CreateSRV(tableSlot++, &table); // g_depth_buffer
-				m_extractedRoughness.CreateSRV(tableSlot++, &table); // g_roughness
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table); // g_roughness
 				input.NormalBuffer->CreateSRV(tableSlot++, &table); // g_normal
-				m_depthHistory.CreateSRV(tableSlot++, &table); // g_depth_buffer_history
-				m_roughnessHistory.CreateSRV(tableSlot++, &table); // g_roughness_history
-				m_normalHistory.CreateSRV(tableSlot++, &table); // g_normal_history
+				m_depthHistory[1 - i].CreateSRV(tableSlot++, &table); // g_depth_buffer_history
+				m_extractedRoughness[1 - i].CreateSRV(tableSlot++, &table); // g_roughness_history
+				m_normalHistory[1 - i].CreateSRV(tableSlot++, &table); // g_normal_history
 
 				m_radiance[i].CreateSRV(tableSlot++, &table); // g_in_radiance
 				m_radiance[1 - i].CreateSRV(tableSlot++, &table); // g_radiance_history
 				input.MotionVectors->CreateSRV(tableSlot++, &table); // g_motion_vector
 
 				m_averageRadiance[1 - i].CreateSRV(tableSlot++, &table); // g_average_radiance_history
-				m_variance[1 - i].CreateSRV(tableSlot++, &table); // g_variance_history
-				m_sampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_sample_count_history
+				m_varianceSampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_variance_sample_count_history
 				m_blueNoiseTexture.CreateSRV(tableSlot++, &table);
 				m_denoiserTileList.CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
 
 				m_reprojectedRadiance.CreateUAV(tableSlot++, &table); // g_out_reprojected_radiance
 				m_averageRadiance[i].CreateUAV(tableSlot++, &table); // g_out_average_radiance
-				m_variance[i].CreateUAV(tableSlot++, &table); // g_out_variance
-				m_sampleCount[i].CreateUAV(tableSlot++, &table); // g_out_sample_count
+				m_varianceSampleCount[i].CreateUAV(tableSlot++, &table); // g_out_variance_sample_count
+				m_rayCounter.CreateBufferUAV(tableSlot++, nullptr, &table); // g_ray_counter
+				m_spatialFilterTileList.CreateBufferUAV(tableSlot++, nullptr, &table); // g_spatial_filter_tile_list
+				m_convergedTileList.CreateBufferUAV(tableSlot++, nullptr, &table); // g_converged_tile_list
 			}
 			//==============================Prefilter==========================================
+			// The pass through only differs in the tile list it consumes.
+			for (int passThrough = 0; passThrough < 2; ++passThrough)
 			{
-				auto& table = m_prefilterPass.descriptorTables_CBV_SRV_UAV[i];
+				auto& table = (passThrough ? m_prefilterPassThroughPass : m_prefilterPass).descriptorTables_CBV_SRV_UAV[i];
 				int tableSlot = 0;
 
-				input.DepthHierarchy->CreateSRV(tableSlot++, &table); // g_depth_buffer
-				m_extractedRoughness.CreateSRV(tableSlot++, &table); // g_roughness
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table); // g_roughness
 				input.NormalBuffer->CreateSRV(tableSlot++, &table); // g_normal
 				m_averageRadiance[i].CreateSRV(tableSlot++, &table); // g_average_radiance
 				m_radiance[i].CreateSRV(tableSlot++, &table); // g_in_radiance
-				m_variance[i].CreateSRV(tableSlot++, &table); // g_in_variance
-				m_sampleCount[i].CreateSRV(tableSlot++, &table); // g_in_sample_count
-				m_denoiserTileList.CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
+				m_varianceSampleCount[i].CreateSRV(tableSlot++, &table); // g_in_variance_sample_count
+				(passThrough ? m_convergedTileList : m_spatialFilterTileList).CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
 
 				m_radiance[1 - i].CreateUAV(tableSlot++, &table); // g_out_radiance
-				m_variance[1 - i].CreateUAV(tableSlot++, &table); // g_out_variance
-				m_sampleCount[1 - i].CreateUAV(tableSlot++, &table); // g_out_sample_count
+				m_varianceSampleCount[1 - i].CreateUAV(tableSlot++, &table); // g_out_variance_sample_count
 			}
 			//==============================ResolveTemporal==========================================
 			{
 				auto& table = m_resolveTemporalPass.descriptorTables_CBV_SRV_UAV[i];
 				int tableSlot = 0;
 
-				m_extractedRoughness.CreateSRV(tableSlot++, &table); // g_roughness
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table); // g_roughness
+				m_averageRadiance[i].CreateSRV(tableSlot++, &table); // g_average_radiance
+				m_radiance[1 - i].CreateSRV(tableSlot++, &table); // g_in_radiance
+				m_reprojectedRadiance.CreateSRV(tableSlot++, &table); // g_in_reprojected_radiance
+				m_varianceSampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_in_variance_sample_count
+				m_denoiserTileList.CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
+
+				m_radiance[i].CreateUAV(tableSlot++, &table); // g_out_radiance
+				m_varianceSampleCount[i].CreateUAV(tableSlot++, &table); // g_out_variance_sample_count
+			}
+			//==============================ResolveTemporalApply=====================================
+			{
+				auto& table = m_resolveTemporalApplyPass.descriptorTables_CBV_SRV_UAV[i];
+				int tableSlot = 0;
+
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table); // g_roughness
 				m_averageRadiance[i].CreateSRV(tableSlot++, &table); // g_average_radiance
 				m_radiance[1 - i].CreateSRV(tableSlot++, &table); // g_in_radiance
 				m_reprojectedRadiance.CreateSRV(tableSlot++, &table); // g_in_reprojected_radiance
-				m_variance[1 - i].CreateSRV(tableSlot++, &table); // g_in_variance
-				m_sampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_in_sample_count
+				m_varianceSampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_in_variance_sample_count
+				m_denoiserTileList.CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
+				input.NormalBuffer->CreateSRV(tableSlot++, &table); // g_normal
+				input.SpecularRoughness->CreateSRV(tableSlot++, &table); // g_specular_roughness
+				input.BrdfLut->CreateSRV(tableSlot++, &table); // g_brdf_lut
+
+				m_radiance[i].CreateUAV(tableSlot++, &table); // g_out_radiance
+				m_varianceSampleCount[i].CreateUAV(tableSlot++, &table); // g_out_variance_sample_count
+				input.HDR->CreateUAV(tableSlot++, &table); // g_lit_scene
+			}
+			//==============================FusedDenoiser==========================================
+			for (int applyReflections = 0; applyReflections < 2; ++applyReflections)
+			{
+				auto& table = applyReflections ? m_fusedDenoiserApplyPass.descriptorTables_CBV_SRV_UAV[i] : m_fusedDenoiserPass.descriptorTables_CBV_SRV_UAV[i];
+				int tableSlot = 0;
+
+				input.DepthBuffer->CreateSRV(tableSlot++, &table); // g_depth_buffer
+				m_extractedRoughness[i].CreateSRV(tableSlot++, &table); // g_roughness
+				input.NormalBuffer->CreateSRV(tableSlot++, &table); // g_normal
+				m_depthHistory[1 - i].CreateSRV(tableSlot++, &table); // g_depth_buffer_history
+				m_extractedRoughness[1 - i].CreateSRV(tableSlot++, &table); // g_roughness_history
+				m_normalHistory[1 - i].CreateSRV(tableSlot++, &table); // g_normal_history
+				m_radiance[i].CreateSRV(tableSlot++, &table); // g_in_radiance
+				m_radiance[1 - i].CreateSRV(tableSlot++, &table); // g_radiance_history
+				input.MotionVectors->CreateSRV(tableSlot++, &table); // g_motion_vector
+				m_varianceSampleCount[1 - i].CreateSRV(tableSlot++, &table); // g_variance_sample_count_history
+				m_denoiserTileList.CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
+				if (applyReflections)
+				{
+					input.SpecularRoughness->CreateSRV(tableSlot++, &table); // g_specular_roughness
+					input.BrdfLut->CreateSRV(tableSlot++, &table); // g_brdf_lut
+				}
+
+				m_reprojectedRadiance.CreateUAV(tableSlot++, &table); // g_out_radiance
+				m_averageRadiance[i].CreateUAV(tableSlot++, &table); // g_out_average_radiance
+				m_varianceSampleCount[i].CreateUAV(tableSlot++, &table); // g_out_variance_sample_count
+				if (applyReflections)
+				{
+					input.HDR->CreateUAV(tableSlot++, &table); // g_lit_scene
+				}
+			}
+			//==============================CopyDenoiserTiles==========================================
+			{
+				auto& table = m_copyDenoiserTilesPass.descriptorTables_CBV_SRV_UAV[i];
+				int tableSlot = 0;
+
+				m_reprojectedRadiance.CreateSRV(tableSlot++, &table); // g_in_radiance
 				m_denoiserTileList.CreateSRV(tableSlot++, &table); // g_denoiser_tile_list
 
 				m_radiance[i].CreateUAV(tableSlot++, &table); // g_out_radiance
-				m_variance[i].CreateUAV(tableSlot++, &table); // g_out_variance
-				m_sampleCount[i].CreateUAV(tableSlot++, &table); // g_out_sample_count
 			}
 		}
+
+		// ClearUnorderedAccessViewFloat takes both a shader visible and a CPU visible descriptor.
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			m_accumulatedRadiance.CreateUAV(0, &m_accumulatedRadianceUAV);
+			m_accumulatedRadiance.CreateUAV(0, &m_accumulatedRadianceCpuUAV);
+		}
 	}
 }
\ No newline at end of file
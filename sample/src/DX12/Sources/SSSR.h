@@ -28,6 +28,10 @@ THE SOFTWARE.
 #include "BufferDX12.h"
 #include "ShaderPass.h"
 #include "BlueNoiseSampler.h"
+#include "../../Common/BlueNoiseAsset.h"
+#include "../../Common/ShaderBlobLibrary.h"
+#include "../../Common/PipelineCacheFile.h"
+#include "../../Common/RenderGraph.h"
 
 using namespace CAULDRON_DX12;
 namespace SSSR_SAMPLE_DX12
@@ -37,14 +41,38 @@ namespace SSSR_SAMPLE_DX12
 	struct SSSRCreationInfo {
 		Texture* HDR;
 		Texture* DepthHierarchy;
+		// Mip 0 of the depth hierarchy. Either the depth buffer itself or, if the hierarchy stores linear depth, its first mip.
+		Texture* DepthBuffer;
+		// Only used if the tile classification builds the depth hierarchy. Single counter of the downsampling lib.
+		Texture* DepthHierarchyAtomicCounter;
+		uint32_t DepthHierarchyMipCount;
+		// Only used if the tile classification builds the depth hierarchy. Single texel bound in place of the mips past the last one.
+		Texture* DepthHierarchyDummy;
 		Texture* MotionVectors;
 		Texture* NormalBuffer;
 		Texture* SpecularRoughness;
+		Texture* BrdfLut;
 		SkyDome* SkyDome;
 		uint32_t outputWidth;
 		uint32_t outputHeight;
+		// Stores the depth history in 16 instead of 32 bits and the octahedral normal history in 2x8 instead of 2x16 bits.
+		bool lowPrecisionHistory;
 	};
 
+	// Tiles are sorted into one of these classes by the roughness of their reflective pixels. Must match Common.hlsl.
+	enum TileClass
+	{
+		TILE_CLASS_MIRROR,
+		TILE_CLASS_GLOSSY,
+		TILE_CLASS_ROUGH,
+		TILE_CLASS_COUNT
+	};
+
+	// Maximum number of mips in the depth hierarchy. This is the limit of the downsampling lib (4096x4096). Must match Common.hlsl.
+	static const uint32_t DEPTH_HIERARCHY_MAX_MIP_COUNT = 13;
+	// Number of frames in the baked blue noise texture array. The shaders read the frame count from the texture.
+	static const uint32_t BLUE_NOISE_FRAME_COUNT = 256;
+
 	struct SSSRConstants
 	{
 		Vectormath::Matrix4 invViewProjection;
@@ -58,27 +86,71 @@ namespace SSSR_SAMPLE_DX12
 		float temporalStabilityFactor;
 		float depthBufferThickness;
 		float roughnessThreshold;
+		// Glossy reflections above this fraction of the roughness threshold are traced starting from a coarser depth mip.
+		float roughReflectionFraction;
 		float varianceThreshold;
+		// Caps the number of samples the temporal accumulation of both denoiser paths averages over.
+		uint32_t maxSampleCount;
+		// Tuning of the fused denoiser. Its reprojection and spatial filter have no separate passes to read them from.
+		float disocclusionThreshold;
+		float spatialFilterNormalSigma;
+		float spatialFilterDepthSigma;
+		float spatialFilterLuminanceSigma;
+		float neighborhoodClampSigma;
 		uint32_t frameIndex;
 		uint32_t maxTraversalIntersections;
+		// Active lanes per 32 below which a wave stops the traversal, scaled to the actual wave width by Intersect.hlsl.
 		uint32_t minTraversalOccupancy;
 		uint32_t mostDetailedMip;
 		uint32_t samplesPerQuad;
 		uint32_t temporalVarianceGuidedTracingEnabled;
+		uint32_t applyReflectionsInResolve;
+		uint32_t convergedRaySkippingEnabled;
+		// Depth distance a ray may fall behind a low precision hierarchy before it counts as a hit.
+		float depthHierarchyTolerance;
+		// Screen space depth = linearDepthParameters[0] + linearDepthParameters[1] / linear depth. Used by the linear depth hierarchy.
+		float linearDepthParameters[2];
+		float linearFarDepth;
+		// Coarsest mip of the depth hierarchy. The traversal never climbs past it.
+		uint32_t maxTraversalMip;
+		// Counts the rays by the coarsest mip their traversal reached, see GetMipUsage.
+		uint32_t mipUsageStatisticsEnabled;
 	};
 
 	class SSSR
 	{
 	public:
 		SSSR();
-		void OnCreate(Device* pDevice, StaticResourceViewHeap& cpuVisibleHeap, ResourceViewHeaps& resourceHeap, UploadHeap& uploadHeap, DynamicBufferRing& constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters);
+		void OnCreate(Device* pDevice, StaticResourceViewHeap& cpuVisibleHeap, ResourceViewHeaps& resourceHeap, UploadHeap& uploadHeap, DynamicBufferRing& constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters, bool linearDepthHierarchy, bool halfPrecisionDepthHierarchy, bool fusedDepthDownsample, uint32_t blueNoiseSamplesPerPixel, bool spatiotemporalBlueNoise, uint32_t accumulationSamplesPerPixel, AsyncPool* pAsyncPool);
 		void OnCreateWindowSizeDependentResources(const SSSRCreationInfo& input);
 
 		void OnDestroy();
 		void OnDestroyWindowSizeDependentResources();
+		// Blocks until the pipelines compiled on the async pool are done and submits the uploads of OnCreate. Called by the first Draw.
+		void WaitForCreation();
 
-		void Draw(ID3D12GraphicsCommandList* pCommandList, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult);
+		// If reuseStaticFrames is set, skips all work and keeps the last output if the scene is static and the constants did not change for a while.
+		// If accumulate is set and the accumulation mode was enabled at creation, the output is instead the average of all samples traced since the scene or the constants last changed.
+		// sceneRevision changes whenever something the reflections depend on changed that the constants do not describe, like the lighting.
+		void Draw(ID3D12GraphicsCommandList* pCommandList, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult, bool useFusedDenoiser, bool isSceneStatic, bool reuseStaticFrames, uint32_t sceneRevision, bool accumulate);
 		Texture* GetOutputTexture(int frame);
+		// Index of the output texture written by the last frame that ran the effect.
+		uint32_t GetOutputIndex() const;
+		// Only the tiles in this list contain reflections. The draw arguments cover them with one quad of six vertices per tile.
+		Texture* GetReflectionTileList();
+		ID3D12Resource* GetReflectionTileDrawArgs();
+		UINT64 GetReflectionTileDrawArgsOffset() const;
+		// Number of rays per coarsest depth hierarchy mip their traversal reached. Lags a few frames behind and is only updated while mipUsageStatisticsEnabled is set.
+		const uint32_t* GetMipUsage() const;
+		// Samples per traced pixel averaged by the accumulation mode so far. Zero if the accumulation mode is disabled.
+		uint32_t GetAccumulatedSampleCount() const;
+		// Pipelines created since OnCreate, split by whether the persistent pipeline library already had them.
+		const SSSR_SAMPLE_COMMON::PipelineCacheStatistics& GetPipelineCacheStatistics() const;
+		// Copies the output of the next frame that runs the effect into host memory, see GetOutputReadback.
+		void RequestOutputReadback();
+		// The output copied since the last RequestOutputReadback as RGBA16F rows of rowPitch bytes.
+		// Null until the copy has finished, which takes as many frames as there are frames in flight.
+		const uint16_t* GetOutputReadback(uint32_t* pRowPitch) const;
 		void Recompile();
 
 	private:
@@ -88,11 +160,40 @@ namespace SSSR_SAMPLE_DX12
 		void SetupClassifyTilesPass(bool allocateDescriptorTable);
 		void SetupPrepareIndirectArgsPass(bool allocateDescriptorTable);
 		void SetupIntersectionPass(bool allocateDescriptorTable);
+		void SetupEnvironmentMapPass(bool allocateDescriptorTable);
 		void SetupResolveTemporalPass(bool allocateDescriptorTable);
 		void SetupPrefilterPass(bool allocateDescriptorTable);
 		void SetupReprojectPass(bool allocateDescriptorTable);
-		void SetupBlueNoisePass(bool allocateDescriptorTable);
+		void SetupFusedDenoiserPass(bool allocateDescriptorTable);
+		void SetupCopyDenoiserTilesPass(bool allocateDescriptorTable);
+		void SetupBlueNoisePass(ShaderPass& shaderpass, bool sampleSet);
+		// Bakes a blue noise texture from the sampler of the blue noise asset that is optimized for samplesPerPixel.
+		// Either one slice per frame or, if sampleSet is set, one slice per sample of the sampler. Returns the sample count of the sampler used.
+		uint32_t BakeBlueNoiseTexture(Texture& texture, uint32_t samplesPerPixel, bool sampleSet);
+		// Opens the spatiotemporal blue noise asset and returns the upload heap space its slices take. Returns false if the asset is missing or invalid.
+		bool OpenSpatiotemporalBlueNoiseAsset(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset, SIZE_T* pUploadSize);
+		// Uploads the opened spatiotemporal blue noise asset into the blue noise texture.
+		void LoadSpatiotemporalBlueNoiseTexture(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset);
+		void CompilePassShader(const char* shader, DefineList& defines, D3D12_SHADER_BYTECODE* pShaderByteCode);
+		// Loads the pipeline library of the last run. The runtime rejects it if it was written by another device or driver.
+		void CreatePipelineLibrary();
+		void SavePipelineLibrary();
+		// Loads the pipeline from the pipeline library or creates it and adds it to the library.
+		ID3D12PipelineState* CreatePipelineState(const D3D12_COMPUTE_PIPELINE_STATE_DESC& desc, const std::string& name);
+		// Returns the permutation of the pass that matches the options of the constants. Compiles it on first use.
+		ID3D12PipelineState* GetPipeline(ShaderPass& pass, const SSSRConstants& sssrConstants);
+		ID3D12PipelineState* CreatePipeline(const ShaderPass& pass, const DefineList& defines, const std::string& name);
+		// Returns the wave size a pass written for preferredWaveSize lanes is compiled with, see WAVE_SIZE in Common.hlsl. Zero if the driver picks it.
+		uint32_t GetWaveSize(uint32_t preferredWaveSize) const;
+		// Compiles the pipeline of the pass on the async pool, see WaitForCreation.
+		void CreatePipelineAsync(ShaderPass& pass);
 		void InitializeDescriptorTableData(const SSSRCreationInfo& input);
+		bool IsStaticFrame(const SSSRConstants& sssrConstants, bool showIntersectResult, bool isSceneStatic);
+		// Registers the resources that Draw schedules with the render graph, in the states they are created in.
+		void AddGraphResources();
+		void IssueBarriers(ID3D12GraphicsCommandList* pCommandList, const SSSR_SAMPLE_COMMON::RenderGraphBarrier* pBarriers, uint32_t barrierCount);
+		void CopyMipUsage(ID3D12GraphicsCommandList* pCommandList, uint32_t readbackIndex);
+		void CopyOutput(ID3D12GraphicsCommandList* pCommandList, uint32_t frameIndex);
 
 		Device* m_pDevice;
 		DynamicBufferRing* m_pConstantBufferRing;
@@ -100,49 +201,125 @@ namespace SSSR_SAMPLE_DX12
 		ResourceViewHeaps* m_pResourceViewHeaps;
 		UploadHeap* m_pUploadHeap;
 		UploadHeapBuffersDX12 m_uploadHeapBuffers;
+		// DXIL of the permutations compiled at build time. Everything else is compiled on first use.
+		SSSR_SAMPLE_COMMON::ShaderBlobLibrary m_shaderBlobs;
+		// Persisted across runs, see g_pipelineLibraryPath. Null if the device does not support pipeline libraries.
+		ID3D12PipelineLibrary* m_pPipelineLibrary = nullptr;
+		// The library references the data it was created from.
+		std::vector<uint8_t> m_pipelineLibraryData;
+		SSSR_SAMPLE_COMMON::PipelineCacheStatistics m_pipelineCacheStatistics;
+		// Pipelines are created from several threads.
+		std::mutex m_pipelineCacheStatisticsMutex;
+
+		// Compiles the pipelines of OnCreate. Null if they are compiled on the calling thread.
+		AsyncPool* m_pAsyncPool = nullptr;
+		// Counts the pipelines that are still being compiled.
+		Sync m_pipelineSync;
+		// Set from OnCreate until WaitForCreation.
+		bool m_creationPending = false;
+
+		// A blue noise texture that WaitForCreation bakes once the pipeline of its pass is compiled.
+		struct BlueNoiseBake
+		{
+			Texture* pTexture;
+			uint32_t sliceCount;
+			ShaderPass pass;
+			BlueNoiseSamplerD3D12 sampler;
+		};
+		// The blue noise and the accumulation noise texture.
+		BlueNoiseBake m_blueNoiseBakes[2];
+		uint32_t m_blueNoiseBakeCount = 0;
 
 		uint32_t m_screenWidth;
 		uint32_t m_screenHeight;
 
-		// Containing all rays that need to be traced.
-		Texture m_rayList;
+		// Containing all rays that need to be traced. One list per tile class.
+		Texture m_rayList[TILE_CLASS_COUNT];
 		Texture m_denoiserTileList;
+		// Containing all reflective pixels that are too rough to be traced and fall back to the environment map.
+		Texture m_environmentMapList;
+		// Per tile history of the last two frames that wrote reflections into it.
+		Texture m_tileHistory;
+		// Containing all tiles with reflections. The radiance outside of these tiles must not be read.
+		Texture m_reflectionTileList;
+		// Denoiser tiles split by the reprojection. Only the tiles that did not converge yet are spatially filtered.
+		Texture m_spatialFilterTileList;
+		Texture m_convergedTileList;
 		// Contains the number of rays that we trace.
 		Texture m_rayCounter;
-		// Indirect arguments for intersection pass.
+		// Copies of the mip usage counters, one slot per frame in flight.
+		ID3D12Resource* m_pMipUsageReadback = nullptr;
+		bool m_mipUsageReadbackPending[8] = {};
+		uint32_t m_mipUsage[DEPTH_HIERARCHY_MAX_MIP_COUNT] = {};
+		// Copy of the output, see RequestOutputReadback. Created by the first request and kept mapped.
+		ID3D12Resource* m_pOutputReadback = nullptr;
+		uint16_t* m_pOutputReadbackData = nullptr;
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT m_outputReadbackFootprint = {};
+		bool m_outputReadbackRequested = false;
+		bool m_outputReadbackPending = false;
+		bool m_outputReadbackReady = false;
+		uint32_t m_outputReadbackFrameIndex = 0;
+		uint32_t m_frameCountBeforeReuse = 0;
+		// Indirect arguments for the intersection passes of each tile class followed by the denoiser and the environment map arguments, the reflection tile draw arguments and the two prefilter arguments.
 		Texture m_intersectionPassIndirectArgs;
 
-		// Depth buffer of this frame
-		Texture* m_depthBuffer;
-		// Normal buffer of this frame
-		Texture* m_normalBuffer;
-		// Extracted roughness values. 
-		Texture m_extractedRoughness;
-		// Depth buffer copy from last frame.
-		Texture m_depthHistory;
-		// Normal buffer copy from last frame.
-		Texture m_normalHistory;
-		// Roughness buffer copy from last frame.
-		Texture m_roughnessHistory;
+		// Lit scene the reflections are applied to if the temporal resolve does so.
+		Texture* m_hdr;
+		// Extracted roughness values. Ping ponging to keep the roughness of the last frame around.
+		Texture m_extractedRoughness[2];
+		// Packed depth and normals written during tile classification. Read as history by the next frame.
+		Texture m_depthHistory[2];
+		Texture m_normalHistory[2];
+		bool m_lowPrecisionHistory;
+		// The depth hierarchy stores linear depth. All passes are compiled with LINEAR_DEPTH_HIERARCHY.
+		bool m_linearDepthHierarchy = false;
+		bool m_halfPrecisionDepthHierarchy = false;
+		// The tile classification also builds the depth hierarchy, see FUSED_DEPTH_DOWNSAMPLE in ClassifyTiles.hlsl.
+		// The application then skips its own downsampling and leaves the hierarchy in D3D12_RESOURCE_STATE_UNORDERED_ACCESS.
+		bool m_fusedDepthDownsample = false;
+		Texture* m_depthHierarchy = nullptr;
+		// Wave sizes [WaveSize] can request. Both zero if the device does not support shader model 6.6.
+		uint32_t m_minWaveLaneCount = 0;
+		uint32_t m_maxWaveLaneCount = 0;
 
 		// Resources produced by the denoiser and intersection pass. Ping ponging to keep history around.
 		Texture m_radiance[2];
-		Texture m_variance[2];
-		Texture m_sampleCount[2];
+		// Variance in x, number of accumulated samples in y.
+		Texture m_varianceSampleCount[2];
 		Texture m_averageRadiance[2];
+		// Also receives the output of the fused denoiser before it is copied back into m_radiance.
 		Texture m_reprojectedRadiance;
 
-		// Hold the blue noise buffers.
-		BlueNoiseSamplerD3D12 m_blueNoiseSampler;
+		// Blue noise of BLUE_NOISE_FRAME_COUNT frames, one per array slice. Baked once at creation.
+		// Holds the spatiotemporal blue noise asset instead if that is enabled, whose size and frame count may differ.
 		Texture m_blueNoiseTexture;
-		ShaderPass m_blueNoisePass;
+
+		// Only created if the accumulation mode is enabled. Each dispatch traces the whole sample set of the blue noise sampler per pixel.
+		uint32_t m_accumulationSamplesPerPixel = 0;
+		ShaderPass m_accumulatePass[TILE_CLASS_COUNT];
+		// The sample set of the sampler, one sample per array slice.
+		Texture m_accumulationNoiseTexture;
+		// Sum of the samples in xyz and their number in w. Kept in full precision to sum up thousands of samples.
+		Texture m_accumulatedRadiance;
+		// Shader visible and CPU visible UAV of the accumulated radiance, both needed to clear it.
+		CBV_SRV_UAV m_accumulatedRadianceUAV;
+		CBV_SRV_UAV m_accumulatedRadianceCpuUAV;
+		// The accumulated radiance is cleared whenever this drops to zero.
+		uint32_t m_accumulatedBatchCount = 0;
 
 		ShaderPass m_classifyTilesPass;
 		ShaderPass m_prepareIndirectArgsPass;
-		ShaderPass m_intersectPass;
+		ShaderPass m_preparePrefilterArgsPass;
+		ShaderPass m_intersectPass[TILE_CLASS_COUNT];
+		ShaderPass m_environmentMapPass;
 		ShaderPass m_resolveTemporalPass;
+		ShaderPass m_resolveTemporalApplyPass;
 		ShaderPass m_prefilterPass;
+		ShaderPass m_prefilterPassThroughPass;
 		ShaderPass m_reprojectPass;
+		ShaderPass m_fusedDenoiserPass;
+		ShaderPass m_fusedDenoiserApplyPass;
+		ShaderPass m_copyDenoiserTilesPass;
 
 		D3D12_SAMPLER_DESC m_environmentMapSamplerDesc;
 
@@ -151,6 +328,39 @@ namespace SSSR_SAMPLE_DX12
 
 		CBV_SRV_UAV m_environmentMapSRV;
 
+		// Ping pong index of the denoiser resources. Only advances on frames that run the effect.
 		uint32_t m_bufferIndex;
+		// Constants of the previous frame and the number of consecutive frames they did not change.
+		SSSRConstants m_previousConstants;
+		uint32_t m_staticFrameCount;
+		// Scene revision passed to the previous Draw.
+		uint32_t m_previousSceneRevision;
+
+		// Derives the barriers between the passes of Draw from the resources they read and write.
+		SSSR_SAMPLE_COMMON::RenderGraph m_renderGraph;
+		struct GraphResources
+		{
+			SSSR_SAMPLE_COMMON::RenderGraphResource rayCounter;
+			SSSR_SAMPLE_COMMON::RenderGraphResource intersectionPassIndirectArgs;
+			SSSR_SAMPLE_COMMON::RenderGraphResource rayList[TILE_CLASS_COUNT];
+			SSSR_SAMPLE_COMMON::RenderGraphResource denoiserTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource environmentMapList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource tileHistory;
+			SSSR_SAMPLE_COMMON::RenderGraphResource reflectionTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource spatialFilterTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource convergedTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource radiance[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource reprojectedRadiance;
+			SSSR_SAMPLE_COMMON::RenderGraphResource averageRadiance[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource varianceSampleCount[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource extractedRoughness[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource depthHistory[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource normalHistory[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource accumulatedRadiance;
+			SSSR_SAMPLE_COMMON::RenderGraphResource hdr;
+			SSSR_SAMPLE_COMMON::RenderGraphResource depthHierarchy;
+		} m_graphResources = {};
+		// Indexed by graph resource.
+		std::vector<ID3D12Resource*> m_graphResourceObjects;
 	};
 }
\ No newline at end of file
@@ -33,6 +33,11 @@ namespace SSSR_SAMPLE_DX12
 		{
 			pPipeline->Release();
 		}
+		for (auto& permutation : permutations)
+		{
+			permutation.second->Release();
+		}
+		permutations.clear();
 	}
 	void ShaderPass::OnDestroy()
 	{
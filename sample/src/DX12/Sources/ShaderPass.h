@@ -20,7 +20,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ********************************************************************/
 #pragma once
+#include <map>
+#include <string>
 #include "Base/ResourceViewHeaps.h"
+#include "Base/ShaderCompilerHelper.h"
 
 namespace SSSR_SAMPLE_DX12
 {
@@ -29,6 +32,14 @@ namespace SSSR_SAMPLE_DX12
 		ID3D12PipelineState* pPipeline = nullptr;
 		CBV_SRV_UAV descriptorTables_CBV_SRV_UAV[2];
 		SAMPLER descriptorTables_Sampler[2];
+		// Options of the constant buffer that are compiled into the shader, see SSSR::GetPipeline. Zero if the pass has a single pipeline.
+		uint32_t permutationMask = 0;
+		// Kept around to compile the permutations on first use.
+		std::string shader;
+		std::string pipelineName;
+		DefineList defines;
+		// Pipelines of the permutations compiled so far by their permutation key. All share the root signature of the pass.
+		std::map<uint32_t, ID3D12PipelineState*> permutations;
 
 		void DestroyPipeline();
 		void OnDestroy();
@@ -356,14 +356,28 @@ void SssrSample::BuildUI()
         ImGui::Checkbox("Apply Screen Space Reflections", &m_UIState.bApplyScreenSpaceReflections);
         ImGui::Checkbox("Show Reflection Target", &m_UIState.bShowReflectionTarget);
         ImGui::Checkbox("Show Intersection Results", &m_UIState.bShowIntersectionResults);
+        ImGui::Checkbox("Apply Reflections In Temporal Resolve", &m_UIState.bApplyReflectionsInResolve);
+        ImGui::Checkbox("Use Fused Denoiser", &m_UIState.bUseFusedDenoiser);
+        ImGui::Checkbox("Skip Converged Rays", &m_UIState.bSkipConvergedRays);
+        ImGui::Checkbox("Reuse Static Frames", &m_UIState.bReuseStaticFrames);
         ImGui::SliderFloat("Target Frametime in ms", &m_UIState.targetFrameTime, 0.0f, 50.0f);
         ImGui::SliderInt("Max Traversal Iterations", &m_UIState.maxTraversalIterations, 0, 256);
         ImGui::SliderInt("Min Traversal Occupancy", &m_UIState.minTraversalOccupancy, 0, 32);
         ImGui::SliderInt("Most Detailed Level", &m_UIState.mostDetailedDepthHierarchyMipLevel, 0, 5);
         ImGui::SliderFloat("Depth Buffer Thickness", &m_UIState.depthBufferThickness, 0.0f, 0.03f);
         ImGui::SliderFloat("Roughness Threshold", &m_UIState.roughnessThreshold, 0.0f, 1.f);
+        ImGui::SliderFloat("Rough Reflection Fraction", &m_UIState.roughReflectionFraction, 0.0f, 1.f);
         ImGui::SliderFloat("Temporal Stability", &m_UIState.temporalStability, 0.0f, 1.0f);
         ImGui::SliderFloat("Temporal Variance Threshold", &m_UIState.temporalVarianceThreshold, 0.0f, 0.01f);
+        ImGui::SliderInt("Max Sample Count", &m_UIState.maxSampleCount, 16, 128);
+        if (m_UIState.bUseFusedDenoiser)
+        {
+            ImGui::SliderFloat("Disocclusion Threshold", &m_UIState.disocclusionThreshold, 0.0f, 1.0f);
+            ImGui::SliderFloat("Spatial Filter Normal Sigma", &m_UIState.spatialFilterNormalSigma, 1.0f, 256.0f);
+            ImGui::SliderFloat("Spatial Filter Depth Sigma", &m_UIState.spatialFilterDepthSigma, 0.001f, 0.2f);
+            ImGui::SliderFloat("Spatial Filter Luminance Sigma", &m_UIState.spatialFilterLuminanceSigma, 0.1f, 16.0f);
+            ImGui::SliderFloat("Neighborhood Clamp Sigma", &m_UIState.neighborhoodClampSigma, 0.5f, 4.0f);
+        }
         ImGui::Checkbox("Enable Variance Guided Tracing", &m_UIState.bEnableTemporalVarianceGuidedTracing);
 
         ImGui::Text("Samples Per Quad"); ImGui::SameLine();
@@ -371,6 +385,37 @@ void SssrSample::BuildUI()
         ImGui::RadioButton("2", &m_UIState.samplesPerQuad, 2); ImGui::SameLine();
         ImGui::RadioButton("4", &m_UIState.samplesPerQuad, 4);
 
+        if (m_pRenderer->IsAccumulationAvailable())
+        {
+            // Pause the animation to accumulate. Moving the camera or changing any setting starts over.
+            ImGui::Checkbox("Accumulate Samples", &m_UIState.bAccumulateSamples);
+            if (m_UIState.bAccumulateSamples)
+            {
+                ImGui::Text("Accumulated Samples: %u", m_pRenderer->GetAccumulatedSampleCount());
+            }
+        }
+
+        const SSSR_SAMPLE_COMMON::PipelineCacheStatistics& pipelineCacheStatistics = m_pRenderer->GetPipelineCacheStatistics();
+        ImGui::Text("Pipeline Cache: %u hits, %u misses, %.1f ms", pipelineCacheStatistics.hits, pipelineCacheStatistics.misses, pipelineCacheStatistics.creationMilliseconds);
+
+        ImGui::Checkbox("Collect Depth Mip Usage", &m_UIState.bCollectMipUsageStatistics);
+        if (m_UIState.bCollectMipUsageStatistics)
+        {
+            // Rays are counted by the coarsest mip their traversal climbed up to.
+            const uint32_t* pMipUsage = m_pRenderer->GetDepthHierarchyMipUsage();
+            const uint32_t maxMip = m_pRenderer->GetDepthHierarchyMaxMip();
+            uint32_t rayCount = 0;
+            for (uint32_t mip = 0; mip <= maxMip; ++mip)
+            {
+                rayCount += pMipUsage[mip];
+            }
+            for (uint32_t mip = 0; mip <= maxMip; ++mip)
+            {
+                float percentage = rayCount > 0 ? 100.0f * pMipUsage[mip] / rayCount : 0.0f;
+                ImGui::Text("Mip %2u: %8u rays (%5.1f%%)", mip, pMipUsage[mip], percentage);
+            }
+        }
+
         ImGui::End();
     }
 }
@@ -402,14 +447,29 @@ void UIState::Initialize()
     this->bShowIntersectionResults = false;
     this->bEnableTemporalVarianceGuidedTracing = true;
     this->bShowReflectionTarget = false;
+    this->bApplyReflectionsInResolve = false;
+    this->bUseFusedDenoiser = false;
+    this->bSkipConvergedRays = true;
+    this->bReuseStaticFrames = true;
+    this->bDisableStaticFrameReuse = false;
+    this->bCollectMipUsageStatistics = false;
+    this->bAccumulateSamples = false;
+    this->bIsAnimationPlaying = true;
     this->targetFrameTime = 0;
     this->maxTraversalIterations = 128;
     this->mostDetailedDepthHierarchyMipLevel = 0;
     this->minTraversalOccupancy = 4;
     this->depthBufferThickness = 0.015f;
     this->roughnessThreshold = 0.2f;
+    this->roughReflectionFraction = 0.5f;
     this->temporalStability = 0.7f;
     this->temporalVarianceThreshold = 0.0f;
+    this->maxSampleCount = 32;
+    this->disocclusionThreshold = 0.9f;
+    this->spatialFilterNormalSigma = 64.0f;
+    this->spatialFilterDepthSigma = 0.05f;
+    this->spatialFilterLuminanceSigma = 4.0f;
+    this->neighborhoodClampSigma = 1.5f;
     this->samplesPerQuad = 1;
 }
 
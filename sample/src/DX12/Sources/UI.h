@@ -83,14 +83,30 @@ struct UIState
     bool    bShowIntersectionResults;
     bool    bEnableTemporalVarianceGuidedTracing;
     bool    bShowReflectionTarget;
+    bool    bApplyReflectionsInResolve;
+    bool    bUseFusedDenoiser;
+    bool    bSkipConvergedRays;
+    bool    bReuseStaticFrames;
+    // Set by the sample to make SSSR trace every frame regardless of bReuseStaticFrames.
+    bool    bDisableStaticFrameReuse;
+    bool    bCollectMipUsageStatistics;
+    bool    bAccumulateSamples;
+    bool    bIsAnimationPlaying;
     float   targetFrameTime;
     int     maxTraversalIterations;
     int     mostDetailedDepthHierarchyMipLevel;
     int     minTraversalOccupancy;
     float   depthBufferThickness;
     float   roughnessThreshold;
+    float   roughReflectionFraction;
     float   temporalStability;
     float   temporalVarianceThreshold;
+    int     maxSampleCount;
+    float   disocclusionThreshold;
+    float   spatialFilterNormalSigma;
+    float   spatialFilterDepthSigma;
+    float   spatialFilterLuminanceSigma;
+    float   neighborhoodClampSigma;
     int     samplesPerQuad;
 
     // -----------------------------------------------
@@ -179,25 +179,14 @@ namespace SSSR_SAMPLE_DX12
 		m_toBarrierIntoShaderResource.push_back(RBDesc);
 	}
 
-	//--------------------------------------------------------------------------------------
-	//
-	// FlushAndFinish
-	//
-	//--------------------------------------------------------------------------------------
-	void UploadHeapBuffersDX12::FlushAndFinish()
+	void UploadHeapBuffersDX12::RecordCopies()
 	{
-		// make sure another thread is not already flushing
-		flushing.Wait();
-
-		// begins a critical section, and make sure no allocations happen while a thread is inside it
-		flushing.Inc();
-
-		// wait for pending allocations to finish
-		allocating.Wait();
-
 		std::unique_lock<std::mutex> lock(m_mutex);
-		Trace("flushing %i, %i", m_textureCopies.size(), m_bufferCopies.size());
+		RecordCopiesLocked();
+	}
 
+	void UploadHeapBuffersDX12::RecordCopiesLocked()
+	{
 		//issue copies
 		for (TextureCopy c : m_textureCopies)
 		{
@@ -217,6 +206,28 @@ namespace SSSR_SAMPLE_DX12
 			m_pCommandList->ResourceBarrier((UINT)m_toBarrierIntoShaderResource.size(), m_toBarrierIntoShaderResource.data());
 			m_toBarrierIntoShaderResource.clear();
 		}
+	}
+
+	//--------------------------------------------------------------------------------------
+	//
+	// FlushAndFinish
+	//
+	//--------------------------------------------------------------------------------------
+	void UploadHeapBuffersDX12::FlushAndFinish()
+	{
+		// make sure another thread is not already flushing
+		flushing.Wait();
+
+		// begins a critical section, and make sure no allocations happen while a thread is inside it
+		flushing.Inc();
+
+		// wait for pending allocations to finish
+		allocating.Wait();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		Trace("flushing %i, %i", m_textureCopies.size(), m_bufferCopies.size());
+
+		RecordCopiesLocked();
 
 		// Close & submit
 		ThrowIfFailed(m_pCommandList->Close());
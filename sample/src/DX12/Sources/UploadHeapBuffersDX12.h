@@ -69,9 +69,14 @@ namespace SSSR_SAMPLE_DX12
 
 		void AddBarrier(ID3D12Resource* pRes);
 
+		// Records the copies and barriers added so far into the command list without submitting it.
+		// Commands recorded into the command list afterwards are executed after the copies.
+		void RecordCopies();
 		void FlushAndFinish();
 
 	private:
+		void RecordCopiesLocked();
+
 		Device* m_pDevice;
 		ID3D12Resource* m_pUploadHeap = nullptr;
 
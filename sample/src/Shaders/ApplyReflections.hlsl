@@ -24,6 +24,7 @@ THE SOFTWARE.
 [[vk::binding(1, 1)]] Texture2D<float4> normalsTexture                : register(t1);
 [[vk::binding(2, 1)]] Texture2D<float4> specularRoughnessTexture      : register(t2);
 [[vk::binding(3, 1)]] Texture2D<float4> brdfTexture                   : register(t3);
+[[vk::binding(5, 1)]] Buffer<uint> reflectionTileList                 : register(t4);
 
 [[vk::binding(4, 1)]] SamplerState linearSampler : register(s0);
 
@@ -36,6 +37,7 @@ THE SOFTWARE.
 struct VertexInput
 {
     uint vertexId : SV_VertexID;
+    uint instanceId : SV_InstanceID;
 };
 
 struct VertexOut
@@ -44,10 +46,21 @@ struct VertexOut
     float2 texcoord : TEXCOORD0;
 };
 
+// Two triangles covering one 8x8 tile.
+static const uint2 quadCorners[6] = { uint2(0, 0), uint2(1, 0), uint2(0, 1), uint2(0, 1), uint2(1, 0), uint2(1, 1) };
+
+// Each instance covers one tile that contains reflections. Tiles without any are never touched.
 VertexOut vs_main(VertexInput input){
+    uint2 dimensions;
+    reflectionTarget.GetDimensions(dimensions.x, dimensions.y);
+
+    uint packedTile = reflectionTileList[input.instanceId];
+    uint2 tileOrigin = uint2(packedTile & 0xffffu, packedTile >> 16);
+    uint2 pixel = min(tileOrigin + 8 * quadCorners[input.vertexId], dimensions);
+
     VertexOut output;
-    output.texcoord = float2((input.vertexId << 1) & 2, input.vertexId & 2);
-    output.position = float4(output.texcoord.xy * 2.0 - 1.0, 0.0, 1.0);
+    output.texcoord = float2(pixel) / float2(dimensions);
+    output.position = float4(2.0 * output.texcoord.x - 1.0, 1.0 - 2.0 * output.texcoord.y, 0.0, 1.0);
     return output;
 }
 
@@ -64,7 +77,6 @@ float3 getIBLContribution(float perceptualRoughness, float3 specularColor, float
 
 float4 ps_main(VertexOut input) : SV_Target0
 {
-    input.texcoord.y = 1 - input.texcoord.y;
     float3 radiance = reflectionTarget.Sample(linearSampler, input.texcoord).xyz;
     float4 specularRoughness = specularRoughnessTexture.Sample(linearSampler, input.texcoord);
     float3 specularColor = specularRoughness.xyz;
@@ -25,39 +25,93 @@ THE SOFTWARE.
 
 [[vk::binding(0, 1)]] Texture2D<float4> g_roughness                         : register(t0);
 [[vk::binding(1, 1)]] Texture2D<float> g_depth_buffer                       : register(t1);
-[[vk::binding(2, 1)]] Texture2D<float> g_variance_history                   : register(t2);
-[[vk::binding(3, 1)]] Texture2D<float4> g_normal                            : register(t3);
-[[vk::binding(4, 1)]] TextureCube g_environment_map                         : register(t4);
+[[vk::binding(2, 1)]] Texture2D<float2> g_variance_sample_count_history     : register(t2); // x: variance, y: sample count
+[[vk::binding(3, 1)]] Texture2D<float2> g_motion_vector                     : register(t3);
+[[vk::binding(4, 1)]] Texture2D<float4> g_radiance_history                  : register(t4);
+
+[[vk::binding(5, 1)]] RWBuffer<uint> g_ray_list_mirror                      : register(u0);
+[[vk::binding(6, 1)]] RWBuffer<uint> g_ray_list_glossy                      : register(u1);
+[[vk::binding(7, 1)]] RWBuffer<uint> g_ray_list_rough                       : register(u2);
+[[vk::binding(8, 1)]] globallycoherent RWBuffer<uint> g_ray_counter         : register(u3);
+[[vk::binding(9, 1)]] RWTexture2D<float4> g_intersection_output             : register(u4);
+[[vk::binding(10, 1)]] RWTexture2D<float> g_extracted_roughness            : register(u5);
+
+[[vk::binding(11, 1)]] RWBuffer<uint> g_denoiser_tile_list                 : register(u6);
+[[vk::binding(12, 1)]] RWBuffer<uint> g_environment_map_list               : register(u7);
+[[vk::binding(13, 1)]] RWBuffer<uint> g_tile_history                       : register(u8);
+[[vk::binding(14, 1)]] RWBuffer<uint> g_reflection_tile_list               : register(u9);
+
+// Depth and normals of this frame are kept around as history for the reprojection of the next frame.
+// Both are packed, see EncodeHistoryDepth and EncodeOctahedralNormal.
+[[vk::binding(15, 1)]] Texture2D<float4> g_normal                           : register(t5);
+[[vk::binding(16, 1)]] RWTexture2D<float> g_depth_history_output           : register(u10);
+[[vk::binding(17, 1)]] RWTexture2D<float2> g_normal_history_output         : register(u11);
+
+#ifdef FUSED_DEPTH_DOWNSAMPLE
+// The fused pass also builds the depth hierarchy, see DepthDownsample.hlsl.
+[[vk::binding(18, 1)]] RWTexture2D<float> g_downsampled_depth_buffer[13]   : register(u12);
+[[vk::binding(19, 1)]] RWBuffer<uint> g_global_atomic                      : register(u25);
+#include "DepthDownsample.hlsl"
+
+// Each group owns the 64x64 region of one depth downsample group and classifies its 8x8 tiles four at a time.
+#define CLASSIFY_TILES_PER_GROUP 4
+#else
+#define CLASSIFY_TILES_PER_GROUP 1
+#endif
+
+// Marks tiles containing pixels that fall back to the environment map. Lives above the tile class bits of g_pixel_class_mask.
+static const uint g_environment_map_bit = 1u << TILE_CLASS_COUNT;
+static const uint g_tile_class_bits = g_environment_map_bit - 1;
+
+// Converged quads reuse their history instead of tracing, but still trace once within this many frames. Must be a power of two.
+#define CONVERGED_RAY_REFRESH_INTERVAL 8
+
+void IncrementRayCounter(uint tile_class, uint value, out uint original_value) {
+    InterlockedAdd(g_ray_counter[2 * tile_class], value, original_value);
+}
 
-[[vk::binding(5, 1)]] SamplerState g_environment_map_sampler                : register(s0);
+void IncrementDenoiserTileCounter(out uint original_value) {
+    InterlockedAdd(g_ray_counter[DENOISER_TILE_COUNTER], 1, original_value);
+}
 
-[[vk::binding(6, 1)]] RWBuffer<uint> g_ray_list                             : register(u0);
-[[vk::binding(7, 1)]] globallycoherent RWBuffer<uint> g_ray_counter         : register(u1);
-[[vk::binding(8, 1)]] RWTexture2D<float4> g_intersection_output             : register(u2);
-[[vk::binding(9, 1)]] RWTexture2D<float> g_extracted_roughness              : register(u3);
+void StoreRay(uint tile_class, int index, uint2 ray_coord, bool copy_horizontal, bool copy_vertical, bool copy_diagonal) {
+    uint packed = PackRayCoords(ray_coord, copy_horizontal, copy_vertical, copy_diagonal); // Store out pixel to trace
+    switch (tile_class) {
+    case TILE_CLASS_MIRROR:
+        g_ray_list_mirror[index] = packed;
+        break;
+    case TILE_CLASS_ROUGH:
+        g_ray_list_rough[index] = packed;
+        break;
+    default: // case TILE_CLASS_GLOSSY:
+        g_ray_list_glossy[index] = packed;
+        break;
+    }
+}
 
-[[vk::binding(10, 1)]] RWBuffer<uint> g_denoiser_tile_list                  : register(u4);
+void StoreDenoiserTile(int index, uint2 tile_coord) {
+    g_denoiser_tile_list[index] = ((tile_coord.y& 0xffffu) << 16) | ((tile_coord.x& 0xffffu) << 0); // Store out pixel to trace
+}
 
-void IncrementRayCounter(uint value, out uint original_value) {
-    InterlockedAdd(g_ray_counter[0], value, original_value);
+void IncrementReflectionTileCounter(out uint original_value) {
+    InterlockedAdd(g_ray_counter[REFLECTION_TILE_COUNTER], 1, original_value);
 }
 
-void IncrementDenoiserTileCounter(out uint original_value) {
-    InterlockedAdd(g_ray_counter[2], 1, original_value);
+void StoreReflectionTile(int index, uint2 tile_coord) {
+    g_reflection_tile_list[index] = ((tile_coord.y & 0xffffu) << 16) | ((tile_coord.x & 0xffffu) << 0);
 }
 
-void StoreRay(int index, uint2 ray_coord, bool copy_horizontal, bool copy_vertical, bool copy_diagonal) {
-    g_ray_list[index] = PackRayCoords(ray_coord, copy_horizontal, copy_vertical, copy_diagonal); // Store out pixel to trace
+void IncrementEnvironmentMapCounter(uint value, out uint original_value) {
+    InterlockedAdd(g_ray_counter[ENVIRONMENT_MAP_COUNTER], value, original_value);
 }
 
-void StoreDenoiserTile(int index, uint2 tile_coord) {
-    g_denoiser_tile_list[index] = ((tile_coord.y& 0xffffu) << 16) | ((tile_coord.x& 0xffffu) << 0); // Store out pixel to trace
+void StoreEnvironmentMapPixel(int index, uint2 pixel_coord) {
+    g_environment_map_list[index] = ((pixel_coord.y & 0xffffu) << 16) | ((pixel_coord.x & 0xffffu) << 0);
 }
 
 bool IsReflectiveSurface(int2 pixel_coordinate, float roughness)
 {
-    const float far_plane = 1.0f; // g_depth_buffer is NDC, and Cauldron does not use reverse Z. Thus the far plane is at 1 in NDC.
-    return g_depth_buffer[pixel_coordinate] < far_plane;
+    return g_depth_buffer[pixel_coordinate] < FAR_PLANE_DEPTH;
 }
 
 bool IsBaseRay(uint2 dispatch_thread_id, uint samples_per_quad) {
@@ -71,85 +125,213 @@ bool IsBaseRay(uint2 dispatch_thread_id, uint samples_per_quad) {
     }
 }
 
-groupshared uint g_TileCount;
+// Converged pixels don't move and have accumulated enough low variance samples that a new ray hardly changes the result.
+bool IsConverged(uint2 pixel_coordinate) {
+    float2 motion_in_pixels = abs(g_motion_vector.Load(int3(pixel_coordinate, 0)) * 0.5 * g_buffer_dimensions);
+    float2 variance_sample_count = g_variance_sample_count_history.Load(int3(pixel_coordinate, 0));
+    return all(motion_in_pixels < 0.01)
+        && variance_sample_count.y >= CONVERGED_SAMPLE_COUNT
+        && variance_sample_count.x <= g_temporal_variance_threshold;
+}
 
-float3 SampleEnvironmentMap(uint2 dispatch_thread_id, float roughness) {
-    float2 uv = (dispatch_thread_id + 0.5) * g_inv_buffer_dimensions;
-    float3 world_space_normal = normalize(2.0 * g_normal.Load(int3(dispatch_thread_id, 0)).xyz - 1.0);
-    float  z = g_depth_buffer.Load(int3(dispatch_thread_id, 0));
-    float3 screen_uv_space_ray_origin = float3(uv, z);
-    float3 view_space_ray = FFX_DNSR_Reflections_ScreenSpaceToViewSpace(screen_uv_space_ray_origin);
-    float3 view_space_ray_direction = normalize(view_space_ray);
-    float3 view_space_surface_normal = mul(g_view, float4(world_space_normal, 0)).xyz;
-    float3 view_space_reflected_direction = reflect(view_space_ray_direction, view_space_surface_normal);
-    float3 world_space_reflected_direction = mul(g_inv_view, float4(view_space_reflected_direction, 0)).xyz;
+// Staggers the refresh of converged quads across frames to spread the cost.
+bool IsRefreshFrame(uint2 dispatch_thread_id) {
+    uint2 quad_coordinate = dispatch_thread_id / 2;
+    uint phase = quad_coordinate.x * 3 + quad_coordinate.y * 5;
+    return ((g_frame_index + phase) & (CONVERGED_RAY_REFRESH_INTERVAL - 1)) == 0;
+}
+
+uint GetPixelClass(float roughness) {
+    if (FFX_DNSR_Reflections_IsMirrorReflection(roughness)) {
+        return TILE_CLASS_MIRROR;
+    }
+    return roughness > g_rough_reflection_fraction * g_roughness_threshold ? TILE_CLASS_ROUGH : TILE_CLASS_GLOSSY;
+}
 
-    const float mip_count = 10;
-    return g_environment_map.SampleLevel(g_environment_map_sampler, world_space_reflected_direction, roughness * (mip_count - 1)).xyz;
+// A tile is only specialized if all of its glossy pixels agree on the class. Mixed tiles fall back to the generic glossy path.
+uint GetTileClass(uint pixel_class_mask) {
+    pixel_class_mask &= g_tile_class_bits;
+    if (pixel_class_mask == (1u << TILE_CLASS_MIRROR)) {
+        return TILE_CLASS_MIRROR;
+    }
+    if (pixel_class_mask == (1u << TILE_CLASS_ROUGH)) {
+        return TILE_CLASS_ROUGH;
+    }
+    return TILE_CLASS_GLOSSY;
+}
+
+// One mask per tile processed by the group at a time.
+groupshared uint g_pixel_class_mask[CLASSIFY_TILES_PER_GROUP];
+
+// Returns the value of the horizontal, the vertical and the diagonal neighbor within the quad of the pixel. Has to be called from uniform control flow.
+#if WAVE_SIZE_PINNED
+// The lanes of a quad are neighbors, as FFX_DNSR_Reflections_RemapLane8x8 arranges four neighboring lanes in a quad pattern.
+uint3 ReadQuadNeighbors(uint value, uint2 group_thread_id, uint tile_slot) {
+    return uint3(
+        WaveReadLaneAt(value, WaveGetLaneIndex() ^ 0b01),  // QuadReadAcrossX
+        WaveReadLaneAt(value, WaveGetLaneIndex() ^ 0b10),  // QuadReadAcrossY
+        WaveReadLaneAt(value, WaveGetLaneIndex() ^ 0b11)); // QuadReadAcrossDiagonal
+}
+#else
+// The lanes of a quad are unknown, so the values are exchanged through group shared memory instead.
+groupshared uint g_quad_values[CLASSIFY_TILES_PER_GROUP * 64];
+
+uint GetQuadValueIndex(uint2 group_thread_id, uint tile_slot) {
+    return tile_slot * 64 + group_thread_id.y * 8 + group_thread_id.x;
+}
+
+uint3 ReadQuadNeighbors(uint value, uint2 group_thread_id, uint tile_slot) {
+    GroupMemoryBarrierWithGroupSync(); // Wait until the values of the previous call are read
+    g_quad_values[GetQuadValueIndex(group_thread_id, tile_slot)] = value;
+    GroupMemoryBarrierWithGroupSync();
+    return uint3(
+        g_quad_values[GetQuadValueIndex(group_thread_id ^ uint2(1, 0), tile_slot)],
+        g_quad_values[GetQuadValueIndex(group_thread_id ^ uint2(0, 1), tile_slot)],
+        g_quad_values[GetQuadValueIndex(group_thread_id ^ uint2(1, 1), tile_slot)]);
+}
+#endif
+
+// Compacts the rays of the active lanes of the wave and appends them all at once to the ray list of the tile class.
+void AppendRays(uint tile_class, bool needs_ray, uint2 dispatch_thread_id, bool copy_horizontal, bool copy_vertical, bool copy_diagonal) {
+    uint local_ray_index_in_wave = WavePrefixCountBits(needs_ray);
+    uint wave_ray_count = WaveActiveCountBits(needs_ray);
+    uint base_ray_index;
+    if (WaveIsFirstLane()) {
+        IncrementRayCounter(tile_class, wave_ray_count, base_ray_index);
+    }
+    base_ray_index = WaveReadLaneFirst(base_ray_index);
+    if (needs_ray) {
+        int ray_index = base_ray_index + local_ray_index_in_wave;
+        StoreRay(tile_class, ray_index, dispatch_thread_id, copy_horizontal, copy_vertical, copy_diagonal);
+    }
 }
 
-void ClassifyTiles(uint2 dispatch_thread_id, uint2 group_thread_id, float roughness) {
-    g_TileCount = 0;
+void ClassifyTiles(uint2 dispatch_thread_id, uint2 group_thread_id, uint tile_slot, float roughness) {
+    g_pixel_class_mask[tile_slot] = 0;
 
     bool is_first_lane_of_wave = WaveIsFirstLane();
 
     // First we figure out on a per thread basis if we need to shoot a reflection ray.
     // Disable offscreen pixels
-    bool needs_ray = !(dispatch_thread_id.x >= g_buffer_dimensions.x || dispatch_thread_id.y >= g_buffer_dimensions.y);
+    bool is_on_screen = !(dispatch_thread_id.x >= g_buffer_dimensions.x || dispatch_thread_id.y >= g_buffer_dimensions.y);
 
     // Dont shoot a ray on very rough surfaces.
-    bool is_reflective_surface = IsReflectiveSurface(dispatch_thread_id, roughness);
+    bool is_reflective_surface = is_on_screen && IsReflectiveSurface(dispatch_thread_id, roughness);
     bool is_glossy_reflection = FFX_DNSR_Reflections_IsGlossyReflection(roughness);
-    needs_ray = needs_ray && is_glossy_reflection && is_reflective_surface;
+    bool needs_ray = is_glossy_reflection && is_reflective_surface;
+
+    // Very rough surfaces fall back to the environment map. They are shaded in a separate pass to keep cube map fetches out of this one.
+    bool needs_environment_map = is_reflective_surface && !is_glossy_reflection;
 
     // Also we dont need to run the denoiser on mirror reflections.
     bool needs_denoiser = needs_ray && !FFX_DNSR_Reflections_IsMirrorReflection(roughness);
 
     // Decide which ray to keep
-    bool is_base_ray = IsBaseRay(dispatch_thread_id, g_samples_per_quad);
+    bool is_base_ray = IsBaseRay(dispatch_thread_id, SAMPLES_PER_QUAD);
     needs_ray = needs_ray && (!needs_denoiser || is_base_ray); // Make sure to not deactivate mirror reflection rays.
 
-    if (g_temporal_variance_guided_tracing_enabled && needs_denoiser && !needs_ray) {
-        bool has_temporal_variance = g_variance_history.Load(int3(dispatch_thread_id, 0)) > g_temporal_variance_threshold;
+    if (TEMPORAL_VARIANCE_GUIDED_TRACING_ENABLED && needs_denoiser && !needs_ray) {
+        bool has_temporal_variance = g_variance_sample_count_history.Load(int3(dispatch_thread_id, 0)).x > g_temporal_variance_threshold;
         needs_ray = needs_ray || has_temporal_variance;
     }
 
-    GroupMemoryBarrierWithGroupSync(); // Wait until g_TileCount is cleared - allow some computations before and after
+    // Quads whose denoised pixels all converged skip their rays and feed the history back into the denoiser instead.
+    // The whole quad has to agree, as the rays of a quad also provide the values of the pixels that are not traced.
+    bool reuses_history = false;
+    if (CONVERGED_RAY_SKIPPING_ENABLED) {
+        bool allows_reuse = !needs_denoiser || IsConverged(dispatch_thread_id);
+        bool quad_allows_reuse = allows_reuse && all(ReadQuadNeighbors(allows_reuse ? 1 : 0, group_thread_id, tile_slot) != 0);
+        reuses_history = needs_denoiser && quad_allows_reuse && !IsRefreshFrame(dispatch_thread_id);
+        needs_ray = needs_ray && !reuses_history;
+    }
+
+    // Fetch the tile history before the first lane overwrites it below.
+    // The fused pass also covers tiles past the screen edge. Their index would alias a tile of the next row.
+    bool is_tile_on_screen = all(dispatch_thread_id - group_thread_id < g_buffer_dimensions);
+    uint tile_index = FFX_DNSR_Reflections_GetTileMetaDataIndex(dispatch_thread_id, g_buffer_dimensions.x);
+    uint tile_history = is_tile_on_screen ? g_tile_history[tile_index] : 0;
+
+    GroupMemoryBarrierWithGroupSync(); // Wait until g_pixel_class_mask is cleared - allow some computations before and after
 
     // Now we know for each thread if it needs to shoot a ray and wether or not a denoiser pass has to run on this pixel.
 
-    if (is_glossy_reflection && is_reflective_surface) InterlockedAdd(g_TileCount, 1);
+    if (is_glossy_reflection && is_reflective_surface) InterlockedOr(g_pixel_class_mask[tile_slot], 1u << GetPixelClass(roughness));
+    if (needs_environment_map) InterlockedOr(g_pixel_class_mask[tile_slot], g_environment_map_bit);
 
     // Next we have to figure out for which pixels that ray is creating the values for. Thus, if we have to copy its value horizontal, vertical or across.
-    bool require_copy = !needs_ray && needs_denoiser; // Our pixel only requires a copy if we want to run a denoiser on it but don't want to shoot a ray for it.
-    bool copy_horizontal = (g_samples_per_quad != 4) && is_base_ray && WaveReadLaneAt(require_copy, WaveGetLaneIndex() ^ 0b01); // QuadReadAcrossX
-    bool copy_vertical = (g_samples_per_quad == 1) && is_base_ray && WaveReadLaneAt(require_copy, WaveGetLaneIndex() ^ 0b10); // QuadReadAcrossY
-    bool copy_diagonal = (g_samples_per_quad == 1) && is_base_ray && WaveReadLaneAt(require_copy, WaveGetLaneIndex() ^ 0b11); // QuadReadAcrossDiagonal
-
-    // Thus, we need to compact the rays and append them all at once to the ray list.
-    uint local_ray_index_in_wave = WavePrefixCountBits(needs_ray);
-    uint wave_ray_count = WaveActiveCountBits(needs_ray);
-    uint base_ray_index;
-    if (is_first_lane_of_wave) {
-        IncrementRayCounter(wave_ray_count, base_ray_index);
+    bool require_copy = !needs_ray && needs_denoiser && !reuses_history; // Our pixel only requires a copy if we want to run a denoiser on it but don't want to shoot a ray for it.
+    // The other way around: Does one of our quad neighbors shoot a ray and copy its result over to us?
+    bool is_traced_base_ray = is_base_ray && needs_ray;
+    uint3 quad_neighbors = ReadQuadNeighbors((require_copy ? 1 : 0) | (is_traced_base_ray ? 2 : 0), group_thread_id, tile_slot);
+
+    bool copy_horizontal = (SAMPLES_PER_QUAD != 4) && is_base_ray && (quad_neighbors.x & 1) != 0;
+    bool copy_vertical = (SAMPLES_PER_QUAD == 1) && is_base_ray && (quad_neighbors.y & 1) != 0;
+    bool copy_diagonal = (SAMPLES_PER_QUAD == 1) && is_base_ray && (quad_neighbors.z & 1) != 0;
+
+    bool traced_horizontal = (quad_neighbors.x & 2) != 0;
+    bool traced_vertical = (quad_neighbors.y & 2) != 0;
+    bool traced_diagonal = (quad_neighbors.z & 2) != 0;
+    bool is_copy_target = require_copy && (
+        ((SAMPLES_PER_QUAD != 4) && traced_horizontal) ||
+        ((SAMPLES_PER_QUAD == 1) && (traced_vertical || traced_diagonal)));
+
+    GroupMemoryBarrierWithGroupSync(); // Wait until g_pixel_class_mask is complete
+
+    uint pixel_class_mask = g_pixel_class_mask[tile_slot];
+    uint tile_class = GetTileClass(pixel_class_mask);
+
+#if defined(FUSED_DEPTH_DOWNSAMPLE) && !WAVE_SIZE_PINNED
+    // A wave may span tiles of different classes unless its lanes follow the threads. Each class gets an append of its own then.
+    for (;;) {
+        uint wave_tile_class = WaveReadLaneFirst(tile_class);
+        if (tile_class == wave_tile_class) {
+            AppendRays(tile_class, needs_ray, dispatch_thread_id, copy_horizontal, copy_vertical, copy_diagonal);
+            break;
+        }
     }
-    base_ray_index = WaveReadLaneFirst(base_ray_index);
-    if (needs_ray) {
-        int ray_index = base_ray_index + local_ray_index_in_wave;
-        StoreRay(ray_index, dispatch_thread_id, copy_horizontal, copy_vertical, copy_diagonal);
+#else
+    // The tile class is uniform across the tile, so all rays of a wave end up in the same list.
+    AppendRays(tile_class, needs_ray, dispatch_thread_id, copy_horizontal, copy_vertical, copy_diagonal);
+#endif
+
+    // Same compaction for the pixels falling back to the environment map.
+    uint local_environment_map_index_in_wave = WavePrefixCountBits(needs_environment_map);
+    uint wave_environment_map_count = WaveActiveCountBits(needs_environment_map);
+    uint base_environment_map_index = 0;
+    if (is_first_lane_of_wave && wave_environment_map_count > 0) {
+        IncrementEnvironmentMapCounter(wave_environment_map_count, base_environment_map_index);
+    }
+    base_environment_map_index = WaveReadLaneFirst(base_environment_map_index);
+    if (needs_environment_map) {
+        int environment_map_index = base_environment_map_index + local_environment_map_index_in_wave;
+        StoreEnvironmentMapPixel(environment_map_index, dispatch_thread_id);
     }
 
-    float4 intersection_output = 0;
-    if (is_reflective_surface && !is_glossy_reflection)
-    {
-        // Fall back to environment map without preparing a ray
-        intersection_output.xyz = SampleEnvironmentMap(dispatch_thread_id, roughness);
+    // Only tiles with reflections are written. Within those, clear the pixels no other pass is going to write.
+    // Tiles that just ran out of reflections get cleared once, as the radiance targets still hold their output from the previous two frames.
+    bool is_tile_occupied = pixel_class_mask != 0;
+    bool is_written_later = needs_ray || is_copy_target || needs_environment_map;
+    if (reuses_history) {
+        g_intersection_output[dispatch_thread_id] = g_radiance_history.Load(int3(dispatch_thread_id, 0));
+    } else if (!is_written_later && (is_tile_occupied || tile_history != 0)) {
+        g_intersection_output[dispatch_thread_id] = 0;
     }
-    g_intersection_output[dispatch_thread_id] = intersection_output;
 
-    GroupMemoryBarrierWithGroupSync(); // Wait until g_TileCount
+    if (all(group_thread_id == 0) && is_tile_on_screen) {
+        g_tile_history[tile_index] = ((tile_history << 1) | (is_tile_occupied ? 1 : 0)) & 0b11;
+    }
+
+    // Reflections are only applied to the tiles in this list. Everything outside of it is never read.
+    // Denoised tiles are left out if the temporal resolve applies their reflections itself.
+    bool is_denoiser_tile = (pixel_class_mask & g_tile_class_bits) != 0;
+    if (all(group_thread_id == 0) && is_tile_occupied && !(APPLY_REFLECTIONS_IN_RESOLVE && is_denoiser_tile)) {
+        uint tile_offset;
+        IncrementReflectionTileCounter(tile_offset);
+        StoreReflectionTile(tile_offset, dispatch_thread_id.xy);
+    }
 
-    if (all(group_thread_id == 0) && g_TileCount > 0) {
+    // Mirror tiles stay in the list, so their history and variance are kept up to date for the tracing decisions of the next frame.
+    if (all(group_thread_id == 0) && is_denoiser_tile) {
         uint tile_offset;
         IncrementDenoiserTileCounter(tile_offset);
         StoreDenoiserTile(tile_offset, dispatch_thread_id.xy);
@@ -158,15 +340,44 @@ void ClassifyTiles(uint2 dispatch_thread_id, uint2 group_thread_id, float roughn
 }
 
 
-[numthreads(8, 8, 1)]
-void main(uint2 group_id : SV_GroupID, uint group_index : SV_GroupIndex) {
-    uint2 group_thread_id = FFX_DNSR_Reflections_RemapLane8x8(group_index); // Remap lanes to ensure four neighboring lanes are arranged in a quad pattern
-    uint2 dispatch_thread_id = group_id * 8 + group_thread_id;
-
+void ClassifyPixel(uint2 dispatch_thread_id, uint2 group_thread_id, uint tile_slot) {
     float roughness = g_roughness.Load(int3(dispatch_thread_id, 0)).w;
 
-    ClassifyTiles(dispatch_thread_id, group_thread_id, roughness);
+    ClassifyTiles(dispatch_thread_id, group_thread_id, tile_slot, roughness);
 
     // Extract only the channel containing the roughness to avoid loading all 4 channels in the follow up passes.
     g_extracted_roughness[dispatch_thread_id] = roughness;
-}
\ No newline at end of file
+
+    // This pass touches every pixel anyway, so it also fills the history targets instead of copying them at the end of the frame.
+    float2 uv = (dispatch_thread_id + 0.5) * g_inv_buffer_dimensions;
+    g_depth_history_output[dispatch_thread_id] = EncodeHistoryDepth(uv, g_depth_buffer.Load(int3(dispatch_thread_id, 0)));
+    g_normal_history_output[dispatch_thread_id] = EncodeOctahedralNormal(normalize(2.0 * g_normal.Load(int3(dispatch_thread_id, 0)).xyz - 1.0));
+}
+
+#ifdef FUSED_DEPTH_DOWNSAMPLE
+WAVE_SIZE_ATTRIBUTE
+[numthreads(256, 1, 1)]
+void main(uint2 group_id : SV_GroupID, uint group_index : SV_GroupIndex) {
+    uint tile_slot = group_index / 64;
+    uint2 group_thread_id = FFX_DNSR_Reflections_RemapLane8x8(group_index % 64); // Remap lanes to ensure four neighboring lanes are arranged in a quad pattern
+
+    for (uint tile = tile_slot; tile < 64; tile += CLASSIFY_TILES_PER_GROUP) {
+        uint2 dispatch_thread_id = group_id * 64 + uint2(tile % 8, tile / 8) * 8 + group_thread_id;
+        ClassifyPixel(dispatch_thread_id, group_thread_id, tile_slot);
+        GroupMemoryBarrierWithGroupSync(); // The next tile clears g_pixel_class_mask again
+    }
+
+    // The depth of the region is still in the cache, so the downsampling picks it up cheaply.
+    DownsampleDepth(group_id, group_index);
+}
+#else
+// With a pinned wave width, the quad reads above use lane i of a wave as thread i of the group, so the lanes are remapped by hand from a one-dimensional group.
+// This also lets Vulkan require full subgroups of up to 64 lanes.
+WAVE_SIZE_ATTRIBUTE
+[numthreads(64, 1, 1)]
+void main(uint2 group_id : SV_GroupID, uint group_index : SV_GroupIndex) {
+    uint2 group_thread_id = FFX_DNSR_Reflections_RemapLane8x8(group_index); // Remap lanes to ensure four neighboring lanes are arranged in a quad pattern
+    uint2 dispatch_thread_id = group_id * 8 + group_thread_id;
+    ClassifyPixel(dispatch_thread_id, group_thread_id, 0);
+}
+#endif
@@ -24,6 +24,40 @@ static const float g_roughness_sigma_min = 0.01f;
 static const float g_roughness_sigma_max = 0.02f;
 static const float g_depth_sigma = 0.02f;
 
+// Tiles are classified by the roughness of their reflective pixels. Each class owns a ray list and a pair of ray counters.
+#define TILE_CLASS_MIRROR                   0
+#define TILE_CLASS_GLOSSY                   1
+#define TILE_CLASS_ROUGH                    2
+#define TILE_CLASS_COUNT                    3
+
+// Maximum number of mips in the depth hierarchy. This is the limit of the downsampling lib (4096x4096).
+#define DEPTH_HIERARCHY_MAX_MIP_COUNT       13
+
+// Layout of g_ray_counter:
+//  [2 * tile_class + 0] rays appended during tile classification.
+//  [2 * tile_class + 1] rays consumed by the intersection pass of that class.
+//  [DENOISER_TILE_COUNTER + 0] tiles appended during tile classification.
+//  [DENOISER_TILE_COUNTER + 1] tiles consumed by the denoiser passes.
+//  [ENVIRONMENT_MAP_COUNTER + 0] pixels appended for the environment map fallback during tile classification.
+//  [ENVIRONMENT_MAP_COUNTER + 1] pixels consumed by the environment map pass.
+//  [REFLECTION_TILE_COUNTER + 0] tiles containing reflections appended during tile classification.
+//  [REFLECTION_TILE_COUNTER + 1] tiles consumed when applying the reflections.
+//  [SPATIAL_FILTER_TILE_COUNTER + 0] denoiser tiles appended by the reprojection that still need the spatial filter.
+//  [SPATIAL_FILTER_TILE_COUNTER + 1] tiles consumed by the prefilter pass.
+//  [CONVERGED_TILE_COUNTER + 0] denoiser tiles appended by the reprojection whose history has converged.
+//  [CONVERGED_TILE_COUNTER + 1] tiles consumed by the prefilter pass through.
+//  [MIP_USAGE_COUNTER + mip] rays whose traversal climbed up to this mip of the depth hierarchy. Only written if g_mip_usage_statistics_enabled is set.
+#define DENOISER_TILE_COUNTER               (2 * TILE_CLASS_COUNT)
+#define ENVIRONMENT_MAP_COUNTER             (DENOISER_TILE_COUNTER + 2)
+#define REFLECTION_TILE_COUNTER             (ENVIRONMENT_MAP_COUNTER + 2)
+#define SPATIAL_FILTER_TILE_COUNTER         (REFLECTION_TILE_COUNTER + 2)
+#define CONVERGED_TILE_COUNTER              (SPATIAL_FILTER_TILE_COUNTER + 2)
+#define MIP_USAGE_COUNTER                   (CONVERGED_TILE_COUNTER + 2)
+#define RAY_COUNTER_ELEMENT_COUNT           (MIP_USAGE_COUNTER + DEPTH_HIERARCHY_MAX_MIP_COUNT)
+
+// Pixels need at least this many accumulated samples and a variance below g_temporal_variance_threshold to count as converged.
+#define CONVERGED_SAMPLE_COUNT              16
+
 [[vk::binding(0, 0)]] cbuffer Constants : register(b0) {
     float4x4 g_inv_view_proj;
     float4x4 g_proj;
@@ -36,15 +70,78 @@ static const float g_depth_sigma = 0.02f;
     float g_temporal_stability_factor;
     float g_depth_buffer_thickness;
     float g_roughness_threshold;
+    float g_rough_reflection_fraction;
     float g_temporal_variance_threshold;
+    uint g_max_sample_count;
+    float g_disocclusion_threshold;
+    float g_spatial_filter_normal_sigma;
+    float g_spatial_filter_depth_sigma;
+    float g_spatial_filter_luminance_sigma;
+    float g_neighborhood_clamp_sigma;
     uint g_frame_index;
     uint g_max_traversal_intersections;
     uint g_min_traversal_occupancy;
     uint g_most_detailed_mip;
     uint g_samples_per_quad;
     uint g_temporal_variance_guided_tracing_enabled;
+    uint g_apply_reflections_in_resolve;
+    uint g_converged_ray_skipping_enabled;
+    float g_depth_hierarchy_tolerance;
+    float2 g_linear_depth_parameters;
+    float g_linear_far_depth;
+    uint g_max_traversal_mip;
+    uint g_mip_usage_statistics_enabled;
 };
 
+// Options that are usually compiled into the permutations of a pass, see SSSR::GetPipeline. Their dead branches then disappear.
+// Passes compiled without these defines read the options from the constant buffer instead.
+#ifndef SAMPLES_PER_QUAD
+#define SAMPLES_PER_QUAD                            g_samples_per_quad
+#endif
+#ifndef TEMPORAL_VARIANCE_GUIDED_TRACING_ENABLED
+#define TEMPORAL_VARIANCE_GUIDED_TRACING_ENABLED    g_temporal_variance_guided_tracing_enabled
+#endif
+#ifndef APPLY_REFLECTIONS_IN_RESOLVE
+#define APPLY_REFLECTIONS_IN_RESOLVE                g_apply_reflections_in_resolve
+#endif
+#ifndef CONVERGED_RAY_SKIPPING_ENABLED
+#define CONVERGED_RAY_SKIPPING_ENABLED              g_converged_ray_skipping_enabled
+#endif
+#ifndef MIP_USAGE_STATISTICS_ENABLED
+#define MIP_USAGE_STATISTICS_ENABLED                g_mip_usage_statistics_enabled
+#endif
+
+// Pins the wave width of a pass, see SSSR::GetWaveSize. Only DX12 defines WAVE_SIZE, as [WaveSize] needs shader model 6.6.
+// Vulkan sets the subgroup size on the pipeline instead and only defines SUBGROUP_SIZE once it also requires full subgroups.
+#ifdef WAVE_SIZE
+#define WAVE_SIZE_ATTRIBUTE                         [WaveSize(WAVE_SIZE)]
+#else
+#define WAVE_SIZE_ATTRIBUTE
+#endif
+
+// Lane i of a wave is thread i of a one-dimensional group only if the wave width is pinned. Otherwise the driver is free to map the threads to lanes.
+#if defined(WAVE_SIZE) || defined(SUBGROUP_SIZE)
+#define WAVE_SIZE_PINNED                            1
+#else
+#define WAVE_SIZE_PINNED                            0
+#endif
+
+// With LINEAR_DEPTH_HIERARCHY the depth hierarchy stores linear depth instead of screen space depth, see DepthDownsample.hlsl.
+// All depth values passed between the shaders and the denoiser callbacks below are then linear as well.
+#ifdef LINEAR_DEPTH_HIERARCHY
+#define FAR_PLANE_DEPTH                     g_linear_far_depth
+#else
+#define FAR_PLANE_DEPTH                     1.0f // Cauldron does not use reverse Z. Thus the far plane is at 1 in NDC.
+#endif
+
+// Mip level stored in the first level of the depth hierarchy. Must match DepthDownsample.hlsl.
+// Screen space depth reads mip 0 straight from the depth buffer, only linear depth needs its own copy.
+#ifdef LINEAR_DEPTH_HIERARCHY
+#define DEPTH_HIERARCHY_FIRST_MIP           0
+#else
+#define DEPTH_HIERARCHY_FIRST_MIP           1
+#endif
+
 //=== Common functions of the SssrSample ===
 
 uint PackFloat16(min16float2 v) {
@@ -102,6 +199,80 @@ float3 InvProjectPosition(float3 coord, float4x4 mat) {
     return projected.xyz;
 }
 
+//=== Linear depth ===
+
+// Linear depth is the clip space w, i.e. the distance from the camera plane.
+// Screen space depth is a hyperbolic function of it: depth = g_linear_depth_parameters.x + g_linear_depth_parameters.y / linear_depth.
+float LinearDepthToScreenSpaceDepth(float linear_depth) {
+    return g_linear_depth_parameters.x + g_linear_depth_parameters.y * rcp(linear_depth);
+}
+
+float ScreenSpaceDepthToLinearDepth(float depth) {
+    return g_linear_depth_parameters.y * rcp(depth - g_linear_depth_parameters.x);
+}
+
+// Cheaper than InvProjectPosition. Assumes a perspective projection whose x and y only depend on their own axis and the depth, which holds with the TAA jitter.
+float3 LinearDepthToViewSpace(float2 uv, float linear_depth) {
+    float2 ndc = float2(2.0 * uv.x - 1.0, 1.0 - 2.0 * uv.y);
+    float view_space_z = (linear_depth - g_proj[3][3]) / g_proj[3][2];
+    float2 view_space_xy = (ndc * linear_depth - g_proj._m02_m12 * view_space_z - g_proj._m03_m13) / float2(g_proj[0][0], g_proj[1][1]);
+    return float3(view_space_xy, view_space_z);
+}
+
+//=== Packed history ===
+
+// Maps a unit vector to the [0, 1] square. Keeps the error uniform over the sphere, so two 8 bit channels are enough for the history.
+float2 EncodeOctahedralNormal(float3 normal) {
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    float2 signs = float2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    float2 encoded = normal.z >= 0.0 ? normal.xy : (1.0 - abs(normal.yx)) * signs;
+    return 0.5 * encoded + 0.5;
+}
+
+float3 DecodeOctahedralNormal(float2 encoded) {
+    encoded = 2.0 * encoded - 1.0;
+    float3 normal = float3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    float t = saturate(-normal.z);
+    normal.xy += float2(normal.x >= 0.0 ? -t : t, normal.y >= 0.0 ? -t : t);
+    return normalize(normal);
+}
+
+// The depth history stores view space depth which survives 16 bit storage much better than the hyperbolic depth buffer values.
+// Clamped to the largest half float so that the far plane does not turn into infinity.
+float EncodeHistoryDepth(float2 uv, float depth) {
+#ifdef LINEAR_DEPTH_HIERARCHY
+    float view_space_depth = (depth - g_proj[3][3]) / g_proj[3][2];
+#else
+    float view_space_depth = InvProjectPosition(float3(uv, depth), g_inv_proj).z;
+#endif
+    return clamp(view_space_depth, -65504.0, 65504.0);
+}
+
+// Returns the depth hierarchy value of the view space depth written by EncodeHistoryDepth.
+// A cleared history texel would divide by zero and maps to zero instead, like a cleared depth buffer.
+float DecodeHistoryDepth(float view_space_depth) {
+    float2 projected = mul(g_proj, float4(0.0, 0.0, view_space_depth, 1.0)).zw;
+#ifdef LINEAR_DEPTH_HIERARCHY
+    return projected.y;
+#else
+    return projected.y != 0.0 ? projected.x / projected.y : 0.0;
+#endif
+}
+
+//=== Applying the reflections ===
+
+// Returns the lit scene with the reflected radiance added. Same as ps_main of ApplyReflections.hlsl, which the passes
+// compiled with APPLY_REFLECTIONS replace for their tiles. The normal is the unpacked G-buffer normal.
+float3 ApplyReflection(float3 lit_scene, float3 radiance, float4 specular_roughness, float3 normal, Texture2D<float2> brdf_lut, SamplerState linear_sampler) {
+    float perceptual_roughness = sqrt(specular_roughness.w); // specular_roughness.w contains alpha roughness
+    float3 view = mul(g_inv_view, float4(0, 0, 1, 0)).xyz; // Camera direction, same as the one ApplyReflections receives.
+
+    float n_dot_v = saturate(dot(normal, view));
+    float2 brdf = brdf_lut.SampleLevel(linear_sampler, saturate(float2(n_dot_v, perceptual_roughness)), 0);
+    float3 specular = radiance * (specular_roughness.xyz * brdf.x + brdf.y);
+    return lit_scene + 2.0 * specular;
+}
+
 //=== FFX_DNSR_Reflections_ override functions ===
 
 bool FFX_DNSR_Reflections_IsGlossyReflection(float roughness) {
@@ -113,7 +284,11 @@ bool FFX_DNSR_Reflections_IsMirrorReflection(float roughness) {
 }
 
 float3 FFX_DNSR_Reflections_ScreenSpaceToViewSpace(float3 screen_uv_coord) {
+#ifdef LINEAR_DEPTH_HIERARCHY
+    return LinearDepthToViewSpace(screen_uv_coord.xy, screen_uv_coord.z);
+#else
     return InvProjectPosition(screen_uv_coord, g_inv_proj);
+#endif
 }
 
 float3 FFX_DNSR_Reflections_ViewSpaceToWorldSpace(float4 view_space_coord) {
@@ -121,12 +296,22 @@ float3 FFX_DNSR_Reflections_ViewSpaceToWorldSpace(float4 view_space_coord) {
 }
 
 float3 FFX_DNSR_Reflections_WorldSpaceToScreenSpacePrevious(float3 world_space_pos) {
+#ifdef LINEAR_DEPTH_HIERARCHY
+    float4 projected = mul(g_prev_view_proj, float4(world_space_pos, 1));
+    float2 uv = 0.5 * projected.xy / projected.w + 0.5;
+    return float3(uv.x, 1 - uv.y, projected.w);
+#else
     return ProjectPosition(world_space_pos, g_prev_view_proj);
+#endif
 }
 
 float FFX_DNSR_Reflections_GetLinearDepth(float2 uv, float depth) {
+#ifdef LINEAR_DEPTH_HIERARCHY
+    return depth;
+#else
     const float3 view_space_pos = InvProjectPosition(float3(uv, depth), g_inv_proj);
     return abs(view_space_pos.z);
+#endif
 }
 
 uint FFX_DNSR_Reflections_RoundedDivide(uint value, uint divisor) {
@@ -0,0 +1,38 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "Common.hlsl"
+
+[[vk::binding(0, 1)]] Texture2D<float4> g_in_radiance                       : register(t0);
+[[vk::binding(1, 1)]] Buffer<uint> g_denoiser_tile_list                     : register(t1);
+
+[[vk::binding(2, 1)]] RWTexture2D<float4> g_out_radiance                    : register(u0);
+
+// The fused denoiser reads a halo around each tile, so it can't write its results over the intersection results in place.
+// This copies the denoised tiles back into the radiance target afterwards.
+[numthreads(8, 8, 1)]
+void main(int2 group_thread_id : SV_GroupThreadID, uint group_id : SV_GroupID) {
+    uint packed_coords = g_denoiser_tile_list[group_id];
+    int2 pixel_coordinate = int2(packed_coords & 0xffffu, (packed_coords >> 16) & 0xffffu) + group_thread_id;
+
+    g_out_radiance[pixel_coordinate] = g_in_radiance.Load(int3(pixel_coordinate, 0));
+}
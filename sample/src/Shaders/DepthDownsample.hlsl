@@ -20,10 +20,45 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ********************************************************************/
 
+// With FUSED_DEPTH_DOWNSAMPLE this file is included by ClassifyTiles.hlsl, which declares the resources and provides the entry point.
+#ifndef FUSED_DEPTH_DOWNSAMPLE
 [[vk::binding(0)]] Texture2D<float> g_depth_buffer : register(t0);
-[[vk::binding(1)]] RWTexture2D<float> g_downsampled_depth_buffer[13] : register(u0); // 12 is the maximum amount of supported mips by the downsampling lib (4096x4096). We copy the depth buffer over for simplicity.
+[[vk::binding(1)]] RWTexture2D<float> g_downsampled_depth_buffer[13] : register(u0); // 12 is the maximum amount of supported mips by the downsampling lib (4096x4096). Index 0 holds DEPTH_HIERARCHY_FIRST_MIP.
 [[vk::binding(2)]] RWBuffer<uint> g_global_atomic : register(u13); // Single atomic counter that stores the number of remaining threadgroups to process.
 
+#ifdef LINEAR_DEPTH_HIERARCHY
+struct LinearDepthConstants {
+    float2 parameters; // Screen space depth = parameters.x + parameters.y / linear depth.
+    float far_depth;
+};
+[[vk::push_constant]] ConstantBuffer<LinearDepthConstants> g_linear_depth_constants : register(b0);
+#endif
+#else
+#ifdef LINEAR_DEPTH_HIERARCHY
+#error The tile classification reads mip 0 of a linear depth hierarchy, so it cannot build the hierarchy at the same time.
+#endif
+// The fused pass takes the mip count from the SSSR constants instead.
+#define DEPTH_HIERARCHY_MAX_MIP g_max_traversal_mip
+#endif
+
+// Mip level stored at index 0 of g_downsampled_depth_buffer. Must match Common.hlsl.
+// The SSSR passes read mip 0 straight from the depth buffer. Only linear depth differs from it and needs its own copy.
+#ifndef DEPTH_HIERARCHY_FIRST_MIP
+#ifdef LINEAR_DEPTH_HIERARCHY
+#define DEPTH_HIERARCHY_FIRST_MIP 0
+#else
+#define DEPTH_HIERARCHY_FIRST_MIP 1
+#endif
+#endif
+
+// Coarsest mip that is built. Set by the application to skip mips the traversal never reaches.
+#ifndef DEPTH_HIERARCHY_MAX_MIP
+#define DEPTH_HIERARCHY_MAX_MIP 12
+#endif
+#if !defined(FUSED_DEPTH_DOWNSAMPLE) && DEPTH_HIERARCHY_MAX_MIP - DEPTH_HIERARCHY_FIRST_MIP > 12
+#error The coarsest mip does not fit g_downsampled_depth_buffer.
+#endif
+
 #define A_GPU
 #define A_HLSL
 #include "ffx_a.h"
@@ -33,10 +68,30 @@ groupshared uint g_group_shared_counter;
 
 #define DS_FALLBACK
 
+// Linear depth is monotonic in screen space depth, so the min reduction stays valid.
+// The far plane is written exactly so that the traversal can still recognize the background.
+float TransformDepth(float depth) {
+#ifdef LINEAR_DEPTH_HIERARCHY
+    return depth < 1.0 ? g_linear_depth_constants.parameters.y / (depth - g_linear_depth_constants.parameters.x) : g_linear_depth_constants.far_depth;
+#else
+    return depth;
+#endif
+}
+
+// The 16 bit UNORM hierarchy would round depth to the nearest step, possibly pushing surfaces away from the camera.
+// Rounding down instead keeps every texel in front of the true surface. The traversal compensates with g_depth_hierarchy_tolerance.
+float QuantizeDepth(float depth) {
+#ifdef HALF_PRECISION_DEPTH_HIERARCHY
+    return floor(depth * 65535.0) / 65535.0;
+#else
+    return depth;
+#endif
+}
+
 // Define fetch and store functions
-AF4 SpdLoadSourceImage(ASU2 index, AU1 slice) { return g_depth_buffer[index].xxxx; }
-AF4 SpdLoad(ASU2 index, AU1 slice) { return g_downsampled_depth_buffer[6][index].xxxx; } // 5 -> 6 as we store a copy of the depth buffer at index 0
-void SpdStore(ASU2 pix, AF4 outValue, AU1 index, AU1 slice) { g_downsampled_depth_buffer[index + 1][pix] = outValue.x; } // + 1 as we store a copy of the depth buffer at index 0
+AF4 SpdLoadSourceImage(ASU2 index, AU1 slice) { return TransformDepth(g_depth_buffer[index]).xxxx; }
+AF4 SpdLoad(ASU2 index, AU1 slice) { return g_downsampled_depth_buffer[6 - DEPTH_HIERARCHY_FIRST_MIP][index].xxxx; } // SPD mip 5 is mip 6 of the hierarchy
+void SpdStore(ASU2 pix, AF4 outValue, AU1 index, AU1 slice) { g_downsampled_depth_buffer[index + 1 - DEPTH_HIERARCHY_FIRST_MIP][pix] = QuantizeDepth(outValue.x); } // SPD starts writing at mip 1
 void SpdResetAtomicCounter(AU1 slice) { g_global_atomic[0] = 0; }
 void SpdIncreaseAtomicCounter(AU1 slice) { InterlockedAdd(g_global_atomic[0], 1, g_group_shared_counter); }
 AU1 SpdGetAtomicCounter() { return g_group_shared_counter; }
@@ -54,19 +109,22 @@ uint GetThreadgroupCount(uint2 image_size){
 	return ((image_size.x + 63) / 64) * ((image_size.y + 63) / 64);
 }
 
-// Returns mips count of a texture with specified size
-float GetMipsCount(float2 texture_size){
+// Returns the number of mips the downsampling lib generates below mip 0. SpdStore writes its mip i to mip i + 1 of the hierarchy,
+// so this is also the coarsest hierarchy mip. It must not exceed the mips the application created.
+uint GetGeneratedMipsCount(float2 texture_size){
     float max_dim = max(texture_size.x, texture_size.y);
-    return 1.0 + floor(log2(max_dim));
+    return min(uint(floor(log2(max_dim))), uint(DEPTH_HIERARCHY_MAX_MIP));
 }
 
-[numthreads(32, 8, 1)]
-void main(uint3 dispatch_thread_id : SV_DispatchThreadID, uint3 group_id : SV_GroupID, uint group_index : SV_GroupIndex){
+// Each group of 256 threads reduces a 64x64 region.
+void DownsampleDepth(uint2 group_id, uint group_index) {
 	float2 depth_image_size = 0;
 	g_depth_buffer.GetDimensions(depth_image_size.x, depth_image_size.y);
 
+#if DEPTH_HIERARCHY_FIRST_MIP == 0
     // Copy most detailed level into the hierarchy and transform it.
 	uint2 u_depth_image_size = uint2(depth_image_size);
+	uint2 dispatch_thread_id = group_id * uint2(32, 8) + uint2(group_index % 32, group_index / 32);
 	for (int i = 0; i < 2; ++i)
 	{
 		for (int j = 0; j < 8; ++j)
@@ -74,20 +132,27 @@ void main(uint3 dispatch_thread_id : SV_DispatchThreadID, uint3 group_id : SV_Gr
 			uint2 idx = uint2(2 * dispatch_thread_id.x + i, 8 * dispatch_thread_id.y + j);
 			if (idx.x < u_depth_image_size.x && idx.y < u_depth_image_size.y)
 			{
-				g_downsampled_depth_buffer[0][idx] = g_depth_buffer[idx];
+				g_downsampled_depth_buffer[0][idx] = QuantizeDepth(TransformDepth(g_depth_buffer[idx]));
 			}
 		}
 	}
 
-    float2 image_size = 0;
-    g_downsampled_depth_buffer[0].GetDimensions(image_size.x, image_size.y);
-    float mips_count = GetMipsCount(image_size);
-    uint threadgroup_count = GetThreadgroupCount(image_size);
+#endif
+
+    uint mips_count = GetGeneratedMipsCount(depth_image_size);
+    uint threadgroup_count = GetThreadgroupCount(depth_image_size);
 
     SpdDownsample(
-		AU2(group_id.xy),
+		AU2(group_id),
 		AU1(group_index),
 		AU1(mips_count),
 		AU1(threadgroup_count),
 		0);
-}
\ No newline at end of file
+}
+
+#ifndef FUSED_DEPTH_DOWNSAMPLE
+[numthreads(32, 8, 1)]
+void main(uint3 group_id : SV_GroupID, uint group_index : SV_GroupIndex) {
+	DownsampleDepth(group_id.xy, group_index);
+}
+#endif
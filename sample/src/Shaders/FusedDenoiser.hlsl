@@ -0,0 +1,296 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "Common.hlsl"
+
+// Inputs
+[[vk::binding( 0, 1)]] Texture2D<float> g_depth_buffer                          : register(t0);
+[[vk::binding( 1, 1)]] Texture2D<float> g_roughness                             : register(t1);
+[[vk::binding( 2, 1)]] Texture2D<float4> g_normal                               : register(t2);
+[[vk::binding( 3, 1)]] Texture2D<float> g_depth_buffer_history                  : register(t3); // View space depth, see EncodeHistoryDepth
+[[vk::binding( 4, 1)]] Texture2D<float> g_roughness_history                     : register(t4);
+[[vk::binding( 5, 1)]] Texture2D<float2> g_normal_history                       : register(t5); // Octahedral, see EncodeOctahedralNormal
+[[vk::binding( 6, 1)]] Texture2D<float4> g_in_radiance                          : register(t6);
+[[vk::binding( 7, 1)]] Texture2D<float4> g_radiance_history                     : register(t7);
+[[vk::binding( 8, 1)]] Texture2D<float2> g_motion_vector                        : register(t8);
+[[vk::binding( 9, 1)]] Texture2D<float2> g_variance_sample_count_history        : register(t9); // x: variance, y: sample count
+
+// Samplers
+[[vk::binding(10, 1)]] SamplerState g_linear_sampler                            : register(s0);
+
+// Outputs
+[[vk::binding(11, 1)]] RWTexture2D<float4> g_out_radiance                       : register(u0);
+[[vk::binding(12, 1)]] RWTexture2D<float3> g_out_average_radiance               : register(u1);
+[[vk::binding(13, 1)]] RWTexture2D<float2> g_out_variance_sample_count          : register(u2);
+
+[[vk::binding(14, 1)]] Buffer<uint> g_denoiser_tile_list                        : register(t10);
+
+#ifdef APPLY_REFLECTIONS
+// Composite the resolved reflections directly into the lit scene, like ResolveTemporal.hlsl does.
+[[vk::binding(15, 1)]] Texture2D<float4> g_specular_roughness                   : register(t11);
+[[vk::binding(16, 1)]] Texture2D<float2> g_brdf_lut                             : register(t12);
+[[vk::binding(17, 1)]] RWTexture2D<float4> g_lit_scene                          : register(u3);
+
+void ApplyReflection(int2 pixel_coordinate, float3 radiance) {
+    float4 specular_roughness = g_specular_roughness.Load(int3(pixel_coordinate, 0));
+    float3 normal = 2 * g_normal.Load(int3(pixel_coordinate, 0)).xyz - 1;
+    float4 lit_scene = g_lit_scene[pixel_coordinate];
+    g_lit_scene[pixel_coordinate] = float4(ApplyReflection(lit_scene.xyz, radiance, specular_roughness, normal, g_brdf_lut, g_linear_sampler), lit_scene.w);
+}
+#endif // APPLY_REFLECTIONS
+
+// Runs reprojection, spatial filtering and temporal resolve for one denoiser tile without going through memory in between.
+// Each stage needs a neighborhood of the previous one, so the group loads its 8x8 tile plus a halo into groupshared memory:
+//  - the spatial filter reaches SPATIAL_FILTER_RADIUS pixels into the intersection results,
+//  - the neighborhood clamp of the temporal resolve reaches NEIGHBORHOOD_RADIUS pixels into the spatially filtered results.
+#define SPATIAL_FILTER_RADIUS               2
+#define NEIGHBORHOOD_RADIUS                 1
+#define HALO_SIZE                           (SPATIAL_FILTER_RADIUS + NEIGHBORHOOD_RADIUS)
+#define REGION_SIZE                         (8 + 2 * HALO_SIZE)
+#define FILTERED_REGION_SIZE                (8 + 2 * NEIGHBORHOOD_RADIUS)
+
+// Intersection results of the whole region. Radiance is stored as (r, g) and (b, luminance), normals as (x, y) and (z, roughness).
+groupshared uint g_shared_radiance[2][REGION_SIZE * REGION_SIZE];
+groupshared uint g_shared_normal_roughness[2][REGION_SIZE * REGION_SIZE];
+groupshared float g_shared_depth[REGION_SIZE * REGION_SIZE];
+// Spatially filtered radiance of the tile and the ring around it required by the neighborhood clamp.
+groupshared uint g_shared_filtered_radiance[2][FILTERED_REGION_SIZE * FILTERED_REGION_SIZE];
+// Per row sums of the intersection results of the tile to compute its average radiance.
+groupshared float3 g_shared_row_radiance[8];
+
+float Luminance(float3 color) {
+    return max(dot(color, float3(0.299f, 0.587f, 0.114f)), 0.001f);
+}
+
+uint RegionIndex(int2 region_coord) {
+    return region_coord.y * REGION_SIZE + region_coord.x;
+}
+
+uint FilteredRegionIndex(int2 filtered_region_coord) {
+    return filtered_region_coord.y * FILTERED_REGION_SIZE + filtered_region_coord.x;
+}
+
+float3 LoadSharedRadiance(int2 region_coord) {
+    uint index = RegionIndex(region_coord);
+    return float3(UnpackFloat16(g_shared_radiance[0][index]), UnpackFloat16(g_shared_radiance[1][index]).x);
+}
+
+float LoadSharedLuminance(int2 region_coord) {
+    return UnpackFloat16(g_shared_radiance[1][RegionIndex(region_coord)]).y;
+}
+
+float3 LoadSharedNormal(int2 region_coord) {
+    uint index = RegionIndex(region_coord);
+    return float3(UnpackFloat16(g_shared_normal_roughness[0][index]), UnpackFloat16(g_shared_normal_roughness[1][index]).x);
+}
+
+float LoadSharedRoughness(int2 region_coord) {
+    return UnpackFloat16(g_shared_normal_roughness[1][RegionIndex(region_coord)]).y;
+}
+
+float3 LoadSharedFilteredRadiance(int2 filtered_region_coord) {
+    uint index = FilteredRegionIndex(filtered_region_coord);
+    return float3(UnpackFloat16(g_shared_filtered_radiance[0][index]), UnpackFloat16(g_shared_filtered_radiance[1][index]).x);
+}
+
+void StoreSharedFilteredRadiance(int2 filtered_region_coord, float3 radiance) {
+    uint index = FilteredRegionIndex(filtered_region_coord);
+    g_shared_filtered_radiance[0][index] = PackFloat16((min16float2)radiance.xy);
+    g_shared_filtered_radiance[1][index] = PackFloat16((min16float2)float2(radiance.z, 0));
+}
+
+void InitializeGroupSharedMemory(int2 region_origin, uint group_index) {
+    for (uint index = group_index; index < REGION_SIZE * REGION_SIZE; index += 64) {
+        int2 region_coord = int2(index % REGION_SIZE, index / REGION_SIZE);
+        int2 pixel_coordinate = clamp(region_origin + region_coord, 0, int2(g_buffer_dimensions) - 1);
+
+        float3 radiance = g_in_radiance.Load(int3(pixel_coordinate, 0)).xyz;
+        float3 normal = normalize(2.0 * g_normal.Load(int3(pixel_coordinate, 0)).xyz - 1.0);
+        float roughness = g_roughness.Load(int3(pixel_coordinate, 0));
+        float2 uv = (pixel_coordinate + 0.5) * g_inv_buffer_dimensions;
+        float depth = FFX_DNSR_Reflections_GetLinearDepth(uv, g_depth_buffer.Load(int3(pixel_coordinate, 0)));
+
+        g_shared_radiance[0][index] = PackFloat16((min16float2)radiance.xy);
+        g_shared_radiance[1][index] = PackFloat16((min16float2)float2(radiance.z, Luminance(radiance)));
+        g_shared_normal_roughness[0][index] = PackFloat16((min16float2)normal.xy);
+        g_shared_normal_roughness[1][index] = PackFloat16((min16float2)float2(normal.z, roughness));
+        g_shared_depth[index] = depth;
+    }
+}
+
+// Edge aware blur of the intersection results. Its footprint grows with the roughness of the center pixel.
+float3 FilterRadiance(int2 center) {
+    float3 center_radiance = LoadSharedRadiance(center);
+    float3 center_normal = LoadSharedNormal(center);
+    float center_depth = g_shared_depth[RegionIndex(center)];
+    float center_luminance = LoadSharedLuminance(center);
+    float center_roughness = LoadSharedRoughness(center);
+
+    // The local luminance deviation decides how strongly differing luminances are rejected.
+    float luminance_sum = 0;
+    float luminance_squared_sum = 0;
+    for (int y = -SPATIAL_FILTER_RADIUS; y <= SPATIAL_FILTER_RADIUS; ++y) {
+        for (int x = -SPATIAL_FILTER_RADIUS; x <= SPATIAL_FILTER_RADIUS; ++x) {
+            float luminance = LoadSharedLuminance(center + int2(x, y));
+            luminance_sum += luminance;
+            luminance_squared_sum += luminance * luminance;
+        }
+    }
+    const float tap_count = (2 * SPATIAL_FILTER_RADIUS + 1) * (2 * SPATIAL_FILTER_RADIUS + 1);
+    float luminance_mean = luminance_sum / tap_count;
+    float luminance_deviation = sqrt(max(luminance_squared_sum / tap_count - luminance_mean * luminance_mean, 0.0));
+
+    float spatial_sigma = lerp(0.5, SPATIAL_FILTER_RADIUS, saturate(center_roughness / g_roughness_threshold));
+    float3 radiance_sum = center_radiance;
+    float weight_sum = 1.0;
+    for (int y = -SPATIAL_FILTER_RADIUS; y <= SPATIAL_FILTER_RADIUS; ++y) {
+        for (int x = -SPATIAL_FILTER_RADIUS; x <= SPATIAL_FILTER_RADIUS; ++x) {
+            if (x == 0 && y == 0) {
+                continue;
+            }
+            int2 neighbor = center + int2(x, y);
+            float normal_weight = pow(saturate(dot(center_normal, LoadSharedNormal(neighbor))), g_spatial_filter_normal_sigma);
+            float depth_weight = exp(-abs(center_depth - g_shared_depth[RegionIndex(neighbor)]) / max(center_depth * g_spatial_filter_depth_sigma, 0.0001));
+            float luminance_weight = exp(-abs(center_luminance - LoadSharedLuminance(neighbor)) / (g_spatial_filter_luminance_sigma * luminance_deviation + 0.0001));
+            float spatial_weight = exp(-float(x * x + y * y) / (2.0 * spatial_sigma * spatial_sigma));
+            float weight = normal_weight * depth_weight * luminance_weight * spatial_weight;
+            radiance_sum += weight * LoadSharedRadiance(neighbor);
+            weight_sum += weight;
+        }
+    }
+    return radiance_sum / weight_sum;
+}
+
+float GetDisocclusionFactor(float3 normal, float3 history_normal, float linear_depth, float history_linear_depth) {
+    return exp(-abs(1.0 - max(0.0, dot(normal, history_normal))) * 1.4)
+        * exp(-abs(history_linear_depth - linear_depth) / linear_depth);
+}
+
+float ComputeTemporalVariance(float3 history_radiance, float3 radiance) {
+    float history_luminance = Luminance(history_radiance);
+    float luminance = Luminance(radiance);
+    float difference = abs(history_luminance - luminance) / max(max(history_luminance, luminance), 0.5);
+    return difference * difference;
+}
+
+void Denoise(int2 tile_origin, int2 group_thread_id, uint group_index) {
+    InitializeGroupSharedMemory(tile_origin - HALO_SIZE, group_index);
+    GroupMemoryBarrierWithGroupSync();
+
+    // Spatial filter over the tile and the ring around it.
+    for (uint index = group_index; index < FILTERED_REGION_SIZE * FILTERED_REGION_SIZE; index += 64) {
+        int2 filtered_region_coord = int2(index % FILTERED_REGION_SIZE, index / FILTERED_REGION_SIZE);
+        StoreSharedFilteredRadiance(filtered_region_coord, FilterRadiance(filtered_region_coord + SPATIAL_FILTER_RADIUS));
+    }
+    if (group_index < 8) {
+        float3 row_radiance = 0;
+        for (int x = 0; x < 8; ++x) {
+            row_radiance += LoadSharedRadiance(int2(x, group_index) + HALO_SIZE);
+        }
+        g_shared_row_radiance[group_index] = row_radiance;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    int2 pixel_coordinate = tile_origin + group_thread_id;
+    int2 center = group_thread_id + HALO_SIZE;
+    float3 radiance = LoadSharedRadiance(center);
+    float roughness = LoadSharedRoughness(center);
+
+    if (group_index == 0) {
+        float3 tile_radiance = 0;
+        for (int y = 0; y < 8; ++y) {
+            tile_radiance += g_shared_row_radiance[y];
+        }
+        g_out_average_radiance[tile_origin / 8] = tile_radiance / 64.0;
+    }
+
+    // Mirror reflections and the environment map fallback are not denoised. They are passed through as is.
+    if (!FFX_DNSR_Reflections_IsGlossyReflection(roughness) || FFX_DNSR_Reflections_IsMirrorReflection(roughness)) {
+        g_out_radiance[pixel_coordinate] = radiance.xyzz;
+        g_out_variance_sample_count[pixel_coordinate] = 0;
+#ifdef APPLY_REFLECTIONS
+        ApplyReflection(pixel_coordinate, radiance);
+#endif // APPLY_REFLECTIONS
+        return;
+    }
+
+    float3 filtered_radiance = LoadSharedFilteredRadiance(group_thread_id + NEIGHBORHOOD_RADIUS);
+
+    // Reproject the surface and reject history that belongs to a different surface.
+    float2 uv = (pixel_coordinate + 0.5) * g_inv_buffer_dimensions;
+    float2 motion_vector = g_motion_vector.Load(int3(pixel_coordinate, 0)) * float2(0.5, -0.5);
+    float2 history_uv = uv - motion_vector;
+    float3 history_normal = DecodeOctahedralNormal(g_normal_history.SampleLevel(g_linear_sampler, history_uv, 0.0f));
+    float history_depth = abs(g_depth_buffer_history.SampleLevel(g_linear_sampler, history_uv, 0.0f));
+    float history_roughness = g_roughness_history.SampleLevel(g_linear_sampler, history_uv, 0.0f);
+    float disocclusion_factor = GetDisocclusionFactor(LoadSharedNormal(center), history_normal, g_shared_depth[RegionIndex(center)], history_depth);
+    bool is_history_valid = all(history_uv > 0) && all(history_uv < 1)
+        && disocclusion_factor > g_disocclusion_threshold
+        && abs(history_roughness - roughness) < g_roughness_sigma_max;
+
+    float3 history_radiance = filtered_radiance;
+    float history_variance = 1.0;
+    float sample_count = 1.0;
+    if (is_history_valid) {
+        history_radiance = g_radiance_history.SampleLevel(g_linear_sampler, history_uv, 0.0f).xyz;
+        float2 history_variance_sample_count = g_variance_sample_count_history.SampleLevel(g_linear_sampler, history_uv, 0.0f);
+        history_variance = history_variance_sample_count.x;
+        sample_count = min(float(g_max_sample_count), history_variance_sample_count.y * disocclusion_factor + 1.0);
+    }
+
+    // Clamp the history to the spatially filtered neighborhood to suppress ghosting.
+    float3 neighborhood_sum = 0;
+    float3 neighborhood_squared_sum = 0;
+    for (int y = -NEIGHBORHOOD_RADIUS; y <= NEIGHBORHOOD_RADIUS; ++y) {
+        for (int x = -NEIGHBORHOOD_RADIUS; x <= NEIGHBORHOOD_RADIUS; ++x) {
+            float3 neighbor = LoadSharedFilteredRadiance(group_thread_id + NEIGHBORHOOD_RADIUS + int2(x, y));
+            neighborhood_sum += neighbor;
+            neighborhood_squared_sum += neighbor * neighbor;
+        }
+    }
+    const float neighborhood_size = (2 * NEIGHBORHOOD_RADIUS + 1) * (2 * NEIGHBORHOOD_RADIUS + 1);
+    float3 neighborhood_mean = neighborhood_sum / neighborhood_size;
+    float3 neighborhood_deviation = sqrt(max(neighborhood_squared_sum / neighborhood_size - neighborhood_mean * neighborhood_mean, 0.0));
+    float3 clamped_history_radiance = clamp(history_radiance,
+        neighborhood_mean - g_neighborhood_clamp_sigma * neighborhood_deviation,
+        neighborhood_mean + g_neighborhood_clamp_sigma * neighborhood_deviation);
+
+    float history_weight = is_history_valid ? min(g_temporal_stability_factor, 1.0 - 1.0 / sample_count) : 0.0;
+    float3 resolved_radiance = lerp(filtered_radiance, clamped_history_radiance, history_weight);
+    float variance = is_history_valid ? lerp(ComputeTemporalVariance(history_radiance, radiance), history_variance, history_weight) : 1.0;
+
+    g_out_radiance[pixel_coordinate] = resolved_radiance.xyzz;
+    g_out_variance_sample_count[pixel_coordinate] = float2(variance, sample_count);
+#ifdef APPLY_REFLECTIONS
+    ApplyReflection(pixel_coordinate, resolved_radiance);
+#endif // APPLY_REFLECTIONS
+}
+
+[numthreads(8, 8, 1)]
+void main(int2 group_thread_id      : SV_GroupThreadID,
+                uint group_index    : SV_GroupIndex,
+                uint    group_id    : SV_GroupID) {
+    uint packed_coords = g_denoiser_tile_list[group_id];
+    int2 tile_origin = int2(packed_coords & 0xffffu, (packed_coords >> 16) & 0xffffu);
+
+    Denoise(tile_origin, group_thread_id, group_index);
+}
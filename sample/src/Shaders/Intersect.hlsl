@@ -22,12 +22,17 @@ THE SOFTWARE.
 
 #include "Common.hlsl"
 
+// Each tile class compiles its own permutation of this pass. See ClassifyTiles.hlsl.
+#ifndef TILE_CLASS
+#define TILE_CLASS TILE_CLASS_GLOSSY
+#endif
+
 [[vk::binding(0, 1)]] Texture2D<float4> g_lit_scene                                         : register(t0);
 [[vk::binding(1, 1)]] Texture2D<float> g_depth_buffer_hierarchy                             : register(t1);
 [[vk::binding(2, 1)]] Texture2D<float4> g_normal                                            : register(t2);
 [[vk::binding(3, 1)]] Texture2D<float> g_roughness                                          : register(t3);
 [[vk::binding(4, 1)]] TextureCube g_environment_map                                         : register(t4);
-[[vk::binding(5, 1)]] Texture2D<float2> g_blue_noise_texture                                : register(t5);
+[[vk::binding(5, 1)]] Texture2DArray<float2> g_blue_noise_texture                           : register(t5);
 [[vk::binding(6, 1)]] Buffer<uint> g_ray_list                                               : register(t6);
 
 [[vk::binding(7, 1)]] SamplerState g_environment_map_sampler                                : register(s0);
@@ -35,20 +40,46 @@ THE SOFTWARE.
 [[vk::binding(8, 1)]] RWTexture2D<float4> g_intersection_output                             : register(u0);
 [[vk::binding(9, 1)]] RWBuffer<uint> g_ray_counter                                          : register(u1);
 
+// Mip 0 of the depth hierarchy. g_depth_buffer_hierarchy starts at DEPTH_HIERARCHY_FIRST_MIP.
+[[vk::binding(10, 1)]] Texture2D<float> g_depth_buffer                                      : register(t7);
+
+#ifdef ACCUMULATION_SAMPLE_COUNT
+// Sum of all samples traced since the last reset in xyz, their number in w.
+[[vk::binding(11, 1)]] RWTexture2D<float4> g_accumulated_radiance                           : register(u2);
+#endif
+
 #define M_PI                               3.14159265358979f
+#define GOLDEN_RATIO                       1.61803398875f
 
 float3 FFX_SSSR_LoadWorldSpaceNormal(int2 pixel_coordinate) {
     return normalize(2 * g_normal.Load(int3(pixel_coordinate, 0)).xyz - 1);
 }
 
 float FFX_SSSR_LoadDepth(int2 pixel_coordinate, int mip) {
-    return g_depth_buffer_hierarchy.Load(int3(pixel_coordinate, mip));
+#if DEPTH_HIERARCHY_FIRST_MIP == 1
+    if (mip == 0) {
+        return g_depth_buffer.Load(int3(pixel_coordinate, 0));
+    }
+#endif
+    return g_depth_buffer_hierarchy.Load(int3(pixel_coordinate, mip - DEPTH_HIERARCHY_FIRST_MIP));
 }
 
 float3 FFX_SSSR_ScreenSpaceToViewSpace(float3 screen_space_position) {
     return InvProjectPosition(screen_space_position, g_inv_proj);
 }
 
+float FFX_SSSR_LinearDepthToScreenSpaceDepth(float linear_depth) {
+    return LinearDepthToScreenSpaceDepth(linear_depth);
+}
+
+float FFX_SSSR_ScreenSpaceDepthToLinearDepth(float depth) {
+    return ScreenSpaceDepthToLinearDepth(depth);
+}
+
+float3 FFX_SSSR_LinearDepthToViewSpace(float2 uv, float linear_depth) {
+    return LinearDepthToViewSpace(uv, linear_depth);
+}
+
 float3 ScreenSpaceToWorldSpace(float3 screen_space_position) {
     return InvProjectPosition(screen_space_position, g_inv_view_proj);
 }
@@ -106,15 +137,24 @@ float3x3 CreateTBN(float3 N) {
 }
 
 float2 SampleRandomVector2D(uint2 pixel) {
-    return g_blue_noise_texture.Load(int3(pixel.xy % 128, 0));
+    // Either the baked noise or the spatiotemporal blue noise asset. Both tile in space and repeat over their slices.
+    uint3 dimensions;
+    g_blue_noise_texture.GetDimensions(dimensions.x, dimensions.y, dimensions.z);
+    return g_blue_noise_texture.Load(int4(pixel.xy % dimensions.xy, g_frame_index % dimensions.z, 0));
+}
+
+#ifdef ACCUMULATION_SAMPLE_COUNT
+// The blue noise texture holds the whole sample set of the sampler, one sample per slice.
+// Every batch traces the full set. Successive batches shift it by the golden ratio (Cranley-Patterson rotation).
+float2 SampleRandomVector2D(uint2 pixel, uint sample_index, uint batch_index) {
+    return frac(g_blue_noise_texture.Load(int4(pixel.xy % 128, sample_index, 0)) + batch_index * GOLDEN_RATIO);
 }
+#endif
 
-float3 SampleReflectionVector(float3 view_direction, float3 normal, float roughness, int2 dispatch_thread_id) {
+float3 SampleReflectionVector(float3 view_direction, float3 normal, float roughness, float2 u) {
     float3x3 tbn_transform = CreateTBN(normal);
     float3 view_direction_tbn = mul(-view_direction, tbn_transform);
 
-    float2 u = SampleRandomVector2D(dispatch_thread_id);
-    
     float3 sampled_normal_tbn = Sample_GGX_VNDF_Hemisphere(view_direction_tbn, roughness, u.x, u.y);
     #ifdef PERFECT_REFLECTIONS
         sampled_normal_tbn = float3(0, 0, 1); // Overwrite normal sample to produce perfect reflection.
@@ -135,13 +175,63 @@ bool IsMirrorReflection(float roughness) {
     return roughness < 0.0001;
 }
 
+// Zero unless the depth hierarchy is stored with reduced precision.
+#define FFX_SSSR_DEPTH_TOLERANCE g_depth_hierarchy_tolerance
+#ifdef LINEAR_DEPTH_HIERARCHY
+#define FFX_SSSR_LINEAR_DEPTH_HIERARCHY
+#define FFX_SSSR_LINEAR_FAR_DEPTH g_linear_far_depth
+#endif
+
+// Coarsest mip of the depth hierarchy. Might be capped below the full mip chain, see Renderer::OnCreate.
+#define FFX_SSSR_MAX_MIP g_max_traversal_mip
+
+#define FFX_SSSR_TRACK_MIP_USAGE
+void FFX_SSSR_TrackMipUsage(int coarsest_mip) {
+    if (MIP_USAGE_STATISTICS_ENABLED) {
+        InterlockedAdd(g_ray_counter[MIP_USAGE_COUNTER + min(coarsest_mip, DEPTH_HIERARCHY_MAX_MIP_COUNT - 1)], 1);
+    }
+}
 #include "ffx_sssr.h"
 
-[numthreads(8, 8, 1)]
+// Returns the radiance along the reflected ray in xyz and the world space length of the ray in w.
+float4 TraceReflection(float2 uv, float3 screen_uv_space_ray_origin, float3 view_space_ray, float3 view_space_reflected_direction, bool is_mirror, int most_detailed_mip) {
+    const uint2 screen_size = g_buffer_dimensions;
+    float3 screen_space_ray_direction = ProjectDirection(view_space_ray, view_space_reflected_direction, screen_uv_space_ray_origin, g_proj);
+
+    //====SSSR====
+    bool valid_hit = false;
+    // The occupancy threshold is given per 32 lanes, so it keeps its meaning on wider waves.
+    uint min_traversal_occupancy = g_min_traversal_occupancy * WaveGetLaneCount() / 32;
+    float3 hit = FFX_SSSR_HierarchicalRaymarch(screen_uv_space_ray_origin, screen_space_ray_direction, is_mirror, screen_size, most_detailed_mip, min_traversal_occupancy, g_max_traversal_intersections, valid_hit);
+
+    float3 world_space_origin   = ScreenSpaceToWorldSpace(screen_uv_space_ray_origin);
+    float3 world_space_hit      = ScreenSpaceToWorldSpace(hit);
+    float3 world_space_ray      = world_space_hit - world_space_origin.xyz;
+
+    float confidence = valid_hit ? FFX_SSSR_ValidateHit(hit, uv, world_space_ray, screen_size, g_depth_buffer_thickness) : 0;
+    float world_ray_length = max(0, length(world_space_ray));
+
+    float3 reflection_radiance = 0;
+    if (confidence > 0) {
+        // Found an intersection with the depth buffer -> We can lookup the color from lit scene.
+        reflection_radiance = g_lit_scene.Load(int3(screen_size * hit.xy, 0)).xyz;
+    }
+
+    // Sample environment map.
+    float3 world_space_reflected_direction = mul(g_inv_view, float4(view_space_reflected_direction, 0)).xyz;
+    float3 environment_lookup = SampleEnvironmentMap(world_space_reflected_direction);
+    reflection_radiance = lerp(environment_lookup, reflection_radiance, confidence);
+
+    return float4(reflection_radiance, world_ray_length);
+}
+
+// The rays are a flat list, so the group is one-dimensional. This lets Vulkan require full subgroups of up to 64 lanes.
+WAVE_SIZE_ATTRIBUTE
+[numthreads(64, 1, 1)]
 void main(uint group_index : SV_GroupIndex, uint group_id : SV_GroupID) {
     
     uint ray_index = group_id * 64 + group_index;
-    if (ray_index >= g_ray_counter[1]) return;
+    if (ray_index >= g_ray_counter[2 * TILE_CLASS + 1]) return;
     uint packed_coords = g_ray_list[ray_index];
     
     int2 coords;
@@ -155,44 +245,57 @@ void main(uint group_index : SV_GroupIndex, uint group_id : SV_GroupID) {
     float2 uv = (coords + 0.5) * g_inv_buffer_dimensions;
 
     float3 world_space_normal = FFX_SSSR_LoadWorldSpaceNormal(coords);
+#if TILE_CLASS == TILE_CLASS_MIRROR
+    // Mirror tiles only contain mirror reflections. Skip the roughness lookup and trace at full detail without the occupancy based early exit.
+    const bool is_mirror = true;
+    int most_detailed_mip = 0;
+#elif TILE_CLASS == TILE_CLASS_ROUGH
+    // Rough tiles never contain mirror reflections. Their reflections get blurred heavily anyway, so start the traversal one mip coarser.
+    float roughness = g_roughness.Load(int3(coords, 0));
+    const bool is_mirror = false;
+    int most_detailed_mip = g_most_detailed_mip + 1;
+#else
     float roughness = g_roughness.Load(int3(coords, 0));
     bool is_mirror = IsMirrorReflection(roughness);
-
     int most_detailed_mip = is_mirror ? 0 : g_most_detailed_mip;
+#endif
     float2 mip_resolution = FFX_SSSR_GetMipResolution(screen_size, most_detailed_mip);
     float z = FFX_SSSR_LoadDepth(uv * mip_resolution, most_detailed_mip);
 
+    float3 view_space_ray = FFX_DNSR_Reflections_ScreenSpaceToViewSpace(float3(uv, z));
+#ifdef LINEAR_DEPTH_HIERARCHY
+    float3 screen_uv_space_ray_origin = float3(uv, LinearDepthToScreenSpaceDepth(z));
+#else
     float3 screen_uv_space_ray_origin = float3(uv, z);
-    float3 view_space_ray = FFX_DNSR_Reflections_ScreenSpaceToViewSpace(screen_uv_space_ray_origin);
+#endif
     float3 view_space_ray_direction = normalize(view_space_ray);
 
     float3 view_space_surface_normal = mul(g_view, float4(world_space_normal, 0)).xyz;
-    float3 view_space_reflected_direction = SampleReflectionVector(view_space_ray_direction, view_space_surface_normal, roughness, coords);
-    float3 screen_space_ray_direction = ProjectDirection(view_space_ray, view_space_reflected_direction, screen_uv_space_ray_origin, g_proj);
-    
-    //====SSSR====
-    bool valid_hit = false;
-    float3 hit = FFX_SSSR_HierarchicalRaymarch(screen_uv_space_ray_origin, screen_space_ray_direction, is_mirror, screen_size, most_detailed_mip, g_min_traversal_occupancy, g_max_traversal_intersections, valid_hit);
-
-    float3 world_space_origin   = ScreenSpaceToWorldSpace(screen_uv_space_ray_origin);
-    float3 world_space_hit      = ScreenSpaceToWorldSpace(hit);
-    float3 world_space_ray      = world_space_hit - world_space_origin.xyz;
-
-    float confidence = valid_hit ? FFX_SSSR_ValidateHit(hit, uv, world_space_ray, screen_size, g_depth_buffer_thickness) : 0;
-    float world_ray_length = max(0, length(world_space_ray));
-
-    float3 reflection_radiance = 0;
-    if (confidence > 0) {
-        // Found an intersection with the depth buffer -> We can lookup the color from lit scene.
-        reflection_radiance = g_lit_scene.Load(int3(screen_size * hit.xy, 0)).xyz;  
+#if TILE_CLASS == TILE_CLASS_MIRROR
+    float3 view_space_reflected_direction = reflect(view_space_ray_direction, view_space_surface_normal);
+    float4 new_sample = TraceReflection(uv, screen_uv_space_ray_origin, view_space_ray, view_space_reflected_direction, is_mirror, most_detailed_mip);
+    const uint sample_count = 1;
+#elif defined(ACCUMULATION_SAMPLE_COUNT)
+    uint batch_index = g_accumulated_radiance[coords].w / ACCUMULATION_SAMPLE_COUNT;
+    float4 new_sample = 0;
+    [loop]
+    for (uint sample_index = 0; sample_index < ACCUMULATION_SAMPLE_COUNT; ++sample_index) {
+        float2 u = SampleRandomVector2D(coords, sample_index, batch_index);
+        float3 view_space_reflected_direction = SampleReflectionVector(view_space_ray_direction, view_space_surface_normal, roughness, u);
+        new_sample += TraceReflection(uv, screen_uv_space_ray_origin, view_space_ray, view_space_reflected_direction, is_mirror, most_detailed_mip);
     }
-
-    // Sample environment map.
-    float3 world_space_reflected_direction = mul(g_inv_view, float4(view_space_reflected_direction, 0)).xyz;
-    float3 environment_lookup = SampleEnvironmentMap(world_space_reflected_direction);
-    reflection_radiance = lerp(environment_lookup, reflection_radiance, confidence);
-
-    float4 new_sample = float4(reflection_radiance, world_ray_length);
+    const uint sample_count = ACCUMULATION_SAMPLE_COUNT;
+#else
+    float3 view_space_reflected_direction = SampleReflectionVector(view_space_ray_direction, view_space_surface_normal, roughness, SampleRandomVector2D(coords));
+    float4 new_sample = TraceReflection(uv, screen_uv_space_ray_origin, view_space_ray, view_space_reflected_direction, is_mirror, most_detailed_mip);
+#endif
+
+#ifdef ACCUMULATION_SAMPLE_COUNT
+    // Mirror reflections are deterministic, so a single sample per batch suffices for them.
+    float4 accumulated_radiance = g_accumulated_radiance[coords] + float4(new_sample.xyz, sample_count);
+    g_accumulated_radiance[coords] = accumulated_radiance;
+    new_sample = float4(accumulated_radiance.xyz / accumulated_radiance.w, new_sample.w / sample_count);
+#endif
     g_intersection_output[coords] = new_sample;
 
     uint2 copy_target = coords ^ 0b1; // Flip last bit to find the mirrored coords along the x and y axis within a quad.
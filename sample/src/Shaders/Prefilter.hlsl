@@ -27,18 +27,17 @@ THE SOFTWARE.
 [[vk::binding( 2, 1)]] Texture2D<float3> g_normal						    : register(t2);
 [[vk::binding( 3, 1)]] Texture2D<float3> g_average_radiance                 : register(t3);
 [[vk::binding( 4, 1)]] Texture2D<float4> g_in_radiance                      : register(t4);
-[[vk::binding( 5, 1)]] Texture2D<float> g_in_variance						: register(t5);
-[[vk::binding( 6, 1)]] Texture2D<float> g_in_sample_count					: register(t6);
+[[vk::binding( 5, 1)]] Texture2D<float2> g_in_variance_sample_count       : register(t5); // x: variance, y: sample count
 
 // Samplers
-[[vk::binding( 7, 1)]] SamplerState g_linear_sampler                        : register(s0);
+[[vk::binding( 6, 1)]] SamplerState g_linear_sampler                        : register(s0);
 
 // Outputs
-[[vk::binding( 8, 1)]] RWTexture2D<float4> g_out_radiance                   : register(u0);
-[[vk::binding( 9, 1)]] RWTexture2D<float> g_out_variance                    : register(u1);
-[[vk::binding(10, 1)]] RWTexture2D<float> g_out_sample_count                : register(u2);
+[[vk::binding( 7, 1)]] RWTexture2D<float4> g_out_radiance                   : register(u0);
+[[vk::binding( 8, 1)]] RWTexture2D<float2> g_out_variance_sample_count      : register(u1);
 
-[[vk::binding(11, 1)]] Buffer<uint> g_denoiser_tile_list                    : register(t7);
+// Either the tiles that need the spatial filter or, with PASS_THROUGH, the tiles whose history has converged.
+[[vk::binding( 9, 1)]] Buffer<uint> g_denoiser_tile_list                    : register(t6);
 
 min16float3 FFX_DNSR_Reflections_SampleAverageRadiance(float2 uv) {
     return (min16float3)g_average_radiance.SampleLevel(g_linear_sampler, uv, 0.0f).xyz;
@@ -57,7 +56,7 @@ void FFX_DNSR_Reflections_LoadNeighborhood(
     int2 screen_size) {
     
     radiance = (min16float3)g_in_radiance.Load(int3(pixel_coordinate, 0)).xyz;
-    variance = (min16float)g_in_variance.Load(int3(pixel_coordinate, 0)).x;
+    variance = (min16float)g_in_variance_sample_count.Load(int3(pixel_coordinate, 0)).x;
 
     normal = normalize(2.0 * (min16float3)g_normal.Load(int3(pixel_coordinate, 0)) - 1.0);
 
@@ -67,7 +66,9 @@ void FFX_DNSR_Reflections_LoadNeighborhood(
 
 void FFX_DNSR_Reflections_StorePrefilteredReflections(int2 pixel_coordinate, min16float3 radiance, min16float variance) {
     g_out_radiance[pixel_coordinate] = radiance.xyzz;
-    g_out_variance[pixel_coordinate] = variance.x;
+    // The sample count is forwarded unchanged, it shares the texel with the variance.
+    float sample_count = g_in_variance_sample_count.Load(int3(pixel_coordinate, 0)).y;
+    g_out_variance_sample_count[pixel_coordinate] = float2(variance.x, sample_count);
 }
 
 #include "ffx_denoiser_reflections_prefilter.h"
@@ -82,5 +83,12 @@ void main(int2 group_thread_id      : SV_GroupThreadID,
     uint2 remapped_group_thread_id    = FFX_DNSR_Reflections_RemapLane8x8(group_index);
     uint2 remapped_dispatch_thread_id = dispatch_group_id * 8 + remapped_group_thread_id;
 
+#ifdef PASS_THROUGH
+    // Converged tiles skip the spatial filter and forward the reprojected values to the temporal resolve.
+    min16float3 radiance = (min16float3)g_in_radiance.Load(int3(remapped_dispatch_thread_id, 0)).xyz;
+    min16float variance = (min16float)g_in_variance_sample_count.Load(int3(remapped_dispatch_thread_id, 0)).x;
+    FFX_DNSR_Reflections_StorePrefilteredReflections(remapped_dispatch_thread_id, radiance, variance);
+#else
     FFX_DNSR_Reflections_Prefilter(remapped_dispatch_thread_id, remapped_group_thread_id, g_buffer_dimensions);
+#endif
 }
\ No newline at end of file
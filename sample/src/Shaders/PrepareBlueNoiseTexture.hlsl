@@ -20,13 +20,11 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ********************************************************************/
 
-#include "Common.hlsl"
-
 [[vk::binding(0, 1)]] Buffer<uint> g_sobol_buffer                                           : register(t0);
 [[vk::binding(1, 1)]] Buffer<uint> g_ranking_tile_buffer                                    : register(t1);
 [[vk::binding(2, 1)]] Buffer<uint> g_scrambling_tile_buffer                                 : register(t2);
 
-[[vk::binding(3, 1)]] RWTexture2D<float2> g_blue_noise_texture                              : register(u0);
+[[vk::binding(3, 1)]] RWTexture2DArray<float2> g_blue_noise_texture                         : register(u0);
 
 #define GOLDEN_RATIO                       1.61803398875f
 
@@ -51,14 +49,21 @@ float SampleRandomNumber(uint pixel_i, uint pixel_j, uint sample_index, uint sam
     return (value + 0.5f) / 256.0f;
 }
 
-float2 SampleRandomVector2D(uint2 pixel) {
+float2 SampleRandomVector2D(uint2 pixel, uint frame) {
     float2 u = float2(
-        fmod(SampleRandomNumber(pixel.x, pixel.y, 0, 0u) + (g_frame_index & 0xFFu) * GOLDEN_RATIO, 1.0f),
-        fmod(SampleRandomNumber(pixel.x, pixel.y, 0, 1u) + (g_frame_index & 0xFFu) * GOLDEN_RATIO, 1.0f));
+        fmod(SampleRandomNumber(pixel.x, pixel.y, 0, 0u) + frame * GOLDEN_RATIO, 1.0f),
+        fmod(SampleRandomNumber(pixel.x, pixel.y, 0, 1u) + frame * GOLDEN_RATIO, 1.0f));
     return u;
 }
 
+// Runs once at startup with one dispatch slice per frame. Frame n is read from slice n % BLUE_NOISE_FRAME_COUNT.
+// With SAMPLE_SET defined, slice n holds sample n of the set the sampler is optimized for instead. See the accumulation mode in Intersect.hlsl.
 [numthreads(8, 8, 1)]
-void main(uint2 dispatch_thread_id : SV_DispatchThreadID) {
-    g_blue_noise_texture[dispatch_thread_id] = SampleRandomVector2D(dispatch_thread_id);
+void main(uint3 dispatch_thread_id : SV_DispatchThreadID) {
+#ifdef SAMPLE_SET
+    uint3 id = dispatch_thread_id;
+    g_blue_noise_texture[id] = float2(SampleRandomNumber(id.x, id.y, id.z, 0u), SampleRandomNumber(id.x, id.y, id.z, 1u));
+#else
+    g_blue_noise_texture[dispatch_thread_id] = SampleRandomVector2D(dispatch_thread_id.xy, dispatch_thread_id.z);
+#endif
 }
\ No newline at end of file
@@ -20,29 +20,83 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ********************************************************************/
 
+#include "Common.hlsl"
+
 [[vk::binding(0, 1)]] RWBuffer<uint> g_ray_counter      : register(u0);
 [[vk::binding(1, 1)]] RWBuffer<uint> g_intersect_args   : register(u1);
 
 [numthreads(1, 1, 1)]
 void main() {
-    { // Prepare intersection args
-        uint ray_count = g_ray_counter[0];
-        
-        g_intersect_args[0] = (ray_count + 63) / 64;
-        g_intersect_args[1] = 1;
-        g_intersect_args[2] = 1;
-
-        g_ray_counter[0] = 0;
-        g_ray_counter[1] = ray_count;
+#ifdef PREPARE_PREFILTER_ARGS
+    // Runs after the reprojection has split the denoiser tiles by their convergence.
+    { // Prepare the prefilter args for the tiles that still need the spatial filter
+        uint tile_count = g_ray_counter[SPATIAL_FILTER_TILE_COUNTER + 0];
+
+        g_intersect_args[3 * TILE_CLASS_COUNT + 10] = tile_count;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 11] = 1;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 12] = 1;
+
+        g_ray_counter[SPATIAL_FILTER_TILE_COUNTER + 0] = 0;
+        g_ray_counter[SPATIAL_FILTER_TILE_COUNTER + 1] = tile_count;
+    }
+    { // Prepare the prefilter pass through args for the converged tiles
+        uint tile_count = g_ray_counter[CONVERGED_TILE_COUNTER + 0];
+
+        g_intersect_args[3 * TILE_CLASS_COUNT + 13] = tile_count;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 14] = 1;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 15] = 1;
+
+        g_ray_counter[CONVERGED_TILE_COUNTER + 0] = 0;
+        g_ray_counter[CONVERGED_TILE_COUNTER + 1] = tile_count;
+    }
+#else
+    // Prepare intersection args. Each tile class gets its own set of dispatch arguments.
+    for (uint tile_class = 0; tile_class < TILE_CLASS_COUNT; ++tile_class) {
+        uint ray_count = g_ray_counter[2 * tile_class + 0];
+
+        g_intersect_args[3 * tile_class + 0] = (ray_count + 63) / 64;
+        g_intersect_args[3 * tile_class + 1] = 1;
+        g_intersect_args[3 * tile_class + 2] = 1;
+
+        g_ray_counter[2 * tile_class + 0] = 0;
+        g_ray_counter[2 * tile_class + 1] = ray_count;
     }
     { // Prepare denoiser args
-        uint tile_count = g_ray_counter[2];
+        uint tile_count = g_ray_counter[DENOISER_TILE_COUNTER + 0];
     
-        g_intersect_args[3] = tile_count;
-        g_intersect_args[4] = 1;
-        g_intersect_args[5] = 1;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 0] = tile_count;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 1] = 1;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 2] = 1;
+
+        g_ray_counter[DENOISER_TILE_COUNTER + 0] = 0;
+        g_ray_counter[DENOISER_TILE_COUNTER + 1] = tile_count;
+    }
+    { // Prepare environment map args
+        uint pixel_count = g_ray_counter[ENVIRONMENT_MAP_COUNTER + 0];
+
+        g_intersect_args[3 * TILE_CLASS_COUNT + 3] = (pixel_count + 63) / 64;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 4] = 1;
+        g_intersect_args[3 * TILE_CLASS_COUNT + 5] = 1;
 
-        g_ray_counter[2] = 0;
-        g_ray_counter[3] = tile_count;
+        g_ray_counter[ENVIRONMENT_MAP_COUNTER + 0] = 0;
+        g_ray_counter[ENVIRONMENT_MAP_COUNTER + 1] = pixel_count;
+    }
+    { // Prepare the draw args to apply the reflections. One instanced quad per tile.
+        uint tile_count = g_ray_counter[REFLECTION_TILE_COUNTER + 0];
+
+        g_intersect_args[3 * TILE_CLASS_COUNT + 6] = 6; // VertexCountPerInstance
+        g_intersect_args[3 * TILE_CLASS_COUNT + 7] = tile_count; // InstanceCount
+        g_intersect_args[3 * TILE_CLASS_COUNT + 8] = 0; // StartVertexLocation
+        g_intersect_args[3 * TILE_CLASS_COUNT + 9] = 0; // StartInstanceLocation
+
+        g_ray_counter[REFLECTION_TILE_COUNTER + 0] = 0;
+        g_ray_counter[REFLECTION_TILE_COUNTER + 1] = tile_count;
+    }
+    // Reset the mip usage of the last frame. It has been copied out at the end of the last frame already.
+    if (MIP_USAGE_STATISTICS_ENABLED) {
+        for (uint mip = 0; mip < DEPTH_HIERARCHY_MAX_MIP_COUNT; ++mip) {
+            g_ray_counter[MIP_USAGE_COUNTER + mip] = 0;
+        }
     }
+#endif
 }
\ No newline at end of file
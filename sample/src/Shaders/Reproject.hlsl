@@ -25,52 +25,68 @@ THE SOFTWARE.
 [[vk::binding( 0, 1)]] Texture2D<float> g_depth_buffer							: register(t0);
 [[vk::binding( 1, 1)]] Texture2D<float> g_roughness						        : register(t1);
 [[vk::binding( 2, 1)]] Texture2D<float3> g_normal							    : register(t2);
-[[vk::binding( 3, 1)]] Texture2D<float> g_depth_buffer_history					: register(t3);
+[[vk::binding( 3, 1)]] Texture2D<float> g_depth_buffer_history					: register(t3); // View space depth, see EncodeHistoryDepth
 [[vk::binding( 4, 1)]] Texture2D<float> g_roughness_history				        : register(t4);
-[[vk::binding( 5, 1)]] Texture2D<float3> g_normal_history					    : register(t5);
+[[vk::binding( 5, 1)]] Texture2D<float2> g_normal_history					    : register(t5); // Octahedral, see EncodeOctahedralNormal
 
 [[vk::binding( 6, 1)]] Texture2D<float4> g_in_radiance					        : register(t6);
 [[vk::binding( 7, 1)]] Texture2D<float4> g_radiance_history				        : register(t7);
 [[vk::binding( 8, 1)]] Texture2D<float2> g_motion_vector				        : register(t8);
 
 [[vk::binding( 9, 1)]] Texture2D<float3> g_average_radiance_history		        : register(t9);
-[[vk::binding(10, 1)]] Texture2D<float> g_variance_history		                : register(t10);
-[[vk::binding(11, 1)]] Texture2D<float> g_sample_count_history			        : register(t11);
-[[vk::binding(12, 1)]] Texture2D<float2> g_blue_noise_texture                   : register(t12);
+[[vk::binding(10, 1)]] Texture2D<float2> g_variance_sample_count_history       : register(t10); // x: variance, y: sample count
+[[vk::binding(11, 1)]] Texture2DArray<float2> g_blue_noise_texture              : register(t11);
 
 // Samplers
-[[vk::binding(13, 1)]] SamplerState g_linear_sampler                            : register(s0);
+[[vk::binding(12, 1)]] SamplerState g_linear_sampler                            : register(s0);
 
 // Outputs
-[[vk::binding(14, 1)]] RWTexture2D<float3> g_out_reprojected_radiance		    : register(u0);
-[[vk::binding(15, 1)]] RWTexture2D<float3> g_out_average_radiance	            : register(u1);
-[[vk::binding(16, 1)]] RWTexture2D<float> g_out_variance		                : register(u2);
-[[vk::binding(17, 1)]] RWTexture2D<float> g_out_sample_count		            : register(u3);
+[[vk::binding(13, 1)]] RWTexture2D<float3> g_out_reprojected_radiance		    : register(u0);
+[[vk::binding(14, 1)]] RWTexture2D<float3> g_out_average_radiance	            : register(u1);
+[[vk::binding(15, 1)]] RWTexture2D<float2> g_out_variance_sample_count         : register(u2);
 
-[[vk::binding(18, 1)]] Buffer<uint> g_denoiser_tile_list                        : register(t13);
+[[vk::binding(16, 1)]] Buffer<uint> g_denoiser_tile_list                        : register(t12);
 
-float FFX_DNSR_Reflections_GetRandom(int2 pixel_coordinate) { return g_blue_noise_texture.Load(int3(pixel_coordinate.xy % 128, 0)).x; }
+// Denoiser tiles are split by the convergence of their history. Only the tiles in g_spatial_filter_tile_list are prefiltered.
+[[vk::binding(17, 1)]] RWBuffer<uint> g_ray_counter                             : register(u3);
+[[vk::binding(18, 1)]] RWBuffer<uint> g_spatial_filter_tile_list                : register(u4);
+[[vk::binding(19, 1)]] RWBuffer<uint> g_converged_tile_list                     : register(u5);
+
+// A tile has converged once all of its pixels have. See CONVERGED_SAMPLE_COUNT.
+groupshared uint g_tile_needs_spatial_filter;
+
+// Written by the store callbacks below. Pixels that are never stored are not reflective and don't keep the tile from converging.
+// Variance and sample count share one texel, so they are only written to g_out_variance_sample_count once both are known.
+static float s_variance = 0.0;
+static float s_sample_count = CONVERGED_SAMPLE_COUNT;
+static bool s_is_variance_sample_count_stored = false;
+
+float FFX_DNSR_Reflections_GetRandom(int2 pixel_coordinate) {
+    uint3 dimensions;
+    g_blue_noise_texture.GetDimensions(dimensions.x, dimensions.y, dimensions.z);
+    return g_blue_noise_texture.Load(int4(pixel_coordinate.xy % dimensions.xy, g_frame_index % dimensions.z, 0)).x;
+}
 float FFX_DNSR_Reflections_LoadDepth(int2 pixel_coordinate) { return g_depth_buffer.Load(int3(pixel_coordinate, 0)); }
-float FFX_DNSR_Reflections_LoadDepthHistory(int2 pixel_coordinate) { return g_depth_buffer_history.Load(int3(pixel_coordinate, 0)); }
-float FFX_DNSR_Reflections_SampleDepthHistory(float2 uv) { return g_depth_buffer_history.SampleLevel(g_linear_sampler, uv, 0.0f); }
+float FFX_DNSR_Reflections_LoadDepthHistory(int2 pixel_coordinate) { return DecodeHistoryDepth(g_depth_buffer_history.Load(int3(pixel_coordinate, 0))); }
+float FFX_DNSR_Reflections_SampleDepthHistory(float2 uv) { return DecodeHistoryDepth(g_depth_buffer_history.SampleLevel(g_linear_sampler, uv, 0.0f)); }
 min16float3 FFX_DNSR_Reflections_LoadRadiance(int2 pixel_coordinate) { return (min16float3)g_in_radiance.Load(int3(pixel_coordinate, 0)).xyz; }
 min16float3 FFX_DNSR_Reflections_LoadRadianceHistory(int2 pixel_coordinate) { return (min16float3)g_radiance_history.Load(int3(pixel_coordinate, 0)).xyz; }
 min16float3 FFX_DNSR_Reflections_SampleRadianceHistory(float2 uv) { return (min16float3)g_radiance_history.SampleLevel(g_linear_sampler, uv, 0.0f).xyz; }
-min16float FFX_DNSR_Reflections_SampleNumSamplesHistory(float2 uv) { return (min16float)g_sample_count_history.SampleLevel(g_linear_sampler, uv, 0.0f).x; }
+min16float FFX_DNSR_Reflections_SampleNumSamplesHistory(float2 uv) { return (min16float)g_variance_sample_count_history.SampleLevel(g_linear_sampler, uv, 0.0f).y; }
 min16float3 FFX_DNSR_Reflections_LoadWorldSpaceNormal(int2 pixel_coordinate) { return normalize(2.0 * (min16float3)g_normal.Load(int3(pixel_coordinate, 0)) - 1.0); }
-min16float3 FFX_DNSR_Reflections_LoadWorldSpaceNormalHistory(int2 pixel_coordinate) { return normalize(2.0 * (min16float3)g_normal_history.Load(int3(pixel_coordinate, 0)) - 1.0); }
-min16float3 FFX_DNSR_Reflections_SampleWorldSpaceNormalHistory(float2 uv) { return normalize(2.0 * (min16float3)g_normal_history.SampleLevel(g_linear_sampler, uv, 0.0f) - 1.0); }
+min16float3 FFX_DNSR_Reflections_LoadWorldSpaceNormalHistory(int2 pixel_coordinate) { return (min16float3)DecodeOctahedralNormal(g_normal_history.Load(int3(pixel_coordinate, 0))); }
+min16float3 FFX_DNSR_Reflections_SampleWorldSpaceNormalHistory(float2 uv) { return (min16float3)DecodeOctahedralNormal(g_normal_history.SampleLevel(g_linear_sampler, uv, 0.0f)); }
 min16float FFX_DNSR_Reflections_LoadRoughness(int2 pixel_coordinate) { return (min16float)g_roughness.Load(int3(pixel_coordinate, 0)); }
 min16float FFX_DNSR_Reflections_SampleRoughnessHistory(float2 uv) { return (min16float)g_roughness_history.SampleLevel(g_linear_sampler, uv, 0.0f); }
 min16float FFX_DNSR_Reflections_LoadRoughnessHistory(int2 pixel_coordinate) { return (min16float)g_roughness_history.Load(int3(pixel_coordinate, 0)); }
 float2 FFX_DNSR_Reflections_LoadMotionVector(int2 pixel_coordinate) { return g_motion_vector.Load(int3(pixel_coordinate, 0)) * float2(0.5, -0.5); }
 min16float3 FFX_DNSR_Reflections_SamplePreviousAverageRadiance(float2 uv) { return (min16float3)g_average_radiance_history.SampleLevel(g_linear_sampler, uv, 0.0f).xyz; }
-min16float FFX_DNSR_Reflections_SampleVarianceHistory(float2 uv) { return (min16float)g_variance_history.SampleLevel(g_linear_sampler, uv, 0.0f).x; }
+min16float FFX_DNSR_Reflections_SampleVarianceHistory(float2 uv) { return (min16float)g_variance_sample_count_history.SampleLevel(g_linear_sampler, uv, 0.0f).x; }
 min16float FFX_DNSR_Reflections_LoadRayLength(int2 pixel_coordinate) { return (min16float)g_in_radiance.Load(int3(pixel_coordinate, 0)).w; }
 void FFX_DNSR_Reflections_StoreRadianceReprojected(int2 pixel_coordinate, min16float3 value) { g_out_reprojected_radiance[pixel_coordinate] = value; }
 void FFX_DNSR_Reflections_StoreAverageRadiance(int2 pixel_coordinate, min16float3 value) { g_out_average_radiance[pixel_coordinate] = value; }
-void FFX_DNSR_Reflections_StoreVariance(int2 pixel_coordinate, min16float value) { g_out_variance[pixel_coordinate] = value; }
-void FFX_DNSR_Reflections_StoreNumSamples(int2 pixel_coordinate, min16float value) { g_out_sample_count[pixel_coordinate] = value; }
+void FFX_DNSR_Reflections_StoreVariance(int2 pixel_coordinate, min16float value) { s_variance = value; s_is_variance_sample_count_stored = true; }
+void FFX_DNSR_Reflections_StoreNumSamples(int2 pixel_coordinate, min16float value) { s_sample_count = value; s_is_variance_sample_count_stored = true; }
 #include "ffx_denoiser_reflections_reproject.h"
 
 [numthreads(8, 8, 1)]
@@ -83,5 +99,29 @@ void main(int2 group_thread_id      : SV_GroupThreadID,
     uint2 remapped_group_thread_id    = FFX_DNSR_Reflections_RemapLane8x8(group_index);
     uint2 remapped_dispatch_thread_id = dispatch_group_id * 8 + remapped_group_thread_id;
 
-    FFX_DNSR_Reflections_Reproject(remapped_dispatch_thread_id, remapped_group_thread_id, g_buffer_dimensions, g_temporal_stability_factor, 32);
+    if (group_index == 0) {
+        g_tile_needs_spatial_filter = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    FFX_DNSR_Reflections_Reproject(remapped_dispatch_thread_id, remapped_group_thread_id, g_buffer_dimensions, g_temporal_stability_factor, g_max_sample_count);
+    if (s_is_variance_sample_count_stored) {
+        g_out_variance_sample_count[remapped_dispatch_thread_id] = float2(s_variance, s_sample_count);
+    }
+
+    if (s_variance > g_temporal_variance_threshold || s_sample_count < CONVERGED_SAMPLE_COUNT) {
+        InterlockedOr(g_tile_needs_spatial_filter, 1);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    if (group_index == 0) {
+        uint tile_index;
+        if (g_tile_needs_spatial_filter) {
+            InterlockedAdd(g_ray_counter[SPATIAL_FILTER_TILE_COUNTER], 1, tile_index);
+            g_spatial_filter_tile_list[tile_index] = packed_coords;
+        } else {
+            InterlockedAdd(g_ray_counter[CONVERGED_TILE_COUNTER], 1, tile_index);
+            g_converged_tile_list[tile_index] = packed_coords;
+        }
+    }
 }
\ No newline at end of file
@@ -26,28 +26,44 @@ THE SOFTWARE.
 [[vk::binding( 1, 1)]] Texture2D<float3> g_average_radiance                     : register(t1);
 [[vk::binding( 2, 1)]] Texture2D<float4> g_in_radiance                          : register(t2);
 [[vk::binding( 3, 1)]] Texture2D<float4> g_in_reprojected_radiance              : register(t3);
-[[vk::binding( 4, 1)]] Texture2D<float> g_in_variance                           : register(t4);
-[[vk::binding( 5, 1)]] Texture2D<float> g_in_sample_count                       : register(t5);
+[[vk::binding( 4, 1)]] Texture2D<float2> g_in_variance_sample_count           : register(t4); // x: variance, y: sample count
 
 // Samplers
-[[vk::binding( 6, 1)]] SamplerState g_linear_sampler                            : register(s0);
+[[vk::binding( 5, 1)]] SamplerState g_linear_sampler                            : register(s0);
 
 // Outputs
-[[vk::binding( 7, 1)]] RWTexture2D<float4> g_out_radiance                       : register(u0);
-[[vk::binding( 8, 1)]] RWTexture2D<float> g_out_variance                        : register(u1);
-[[vk::binding( 9, 1)]] RWTexture2D<float> g_out_sample_count                    : register(u2);
+[[vk::binding( 6, 1)]] RWTexture2D<float4> g_out_radiance                       : register(u0);
+[[vk::binding( 7, 1)]] RWTexture2D<float2> g_out_variance_sample_count          : register(u1);
 
-[[vk::binding(10, 1)]] Buffer<uint> g_denoiser_tile_list                        : register(t6);
+[[vk::binding( 8, 1)]] Buffer<uint> g_denoiser_tile_list                        : register(t5);
+
+#ifdef APPLY_REFLECTIONS
+// Composite the resolved reflections directly into the lit scene.
+[[vk::binding( 9, 1)]] Texture2D<float4> g_normal                               : register(t6);
+[[vk::binding(10, 1)]] Texture2D<float4> g_specular_roughness                   : register(t7);
+[[vk::binding(11, 1)]] Texture2D<float2> g_brdf_lut                             : register(t8);
+[[vk::binding(12, 1)]] RWTexture2D<float4> g_lit_scene                          : register(u2);
+
+void ApplyReflection(int2 pixel_coordinate, float3 radiance) {
+    float4 specular_roughness = g_specular_roughness.Load(int3(pixel_coordinate, 0));
+    float3 normal = 2 * g_normal.Load(int3(pixel_coordinate, 0)).xyz - 1;
+    float4 lit_scene = g_lit_scene[pixel_coordinate];
+    g_lit_scene[pixel_coordinate] = float4(ApplyReflection(lit_scene.xyz, radiance, specular_roughness, normal, g_brdf_lut, g_linear_sampler), lit_scene.w);
+}
+#endif // APPLY_REFLECTIONS
 
 min16float3 FFX_DNSR_Reflections_SampleAverageRadiance(float2 uv) { return (min16float3)g_average_radiance.SampleLevel(g_linear_sampler, uv, 0.0f).xyz; }
 min16float3 FFX_DNSR_Reflections_LoadRadiance(int2 pixel_coordinate) { return (min16float3)g_in_radiance.Load(int3(pixel_coordinate, 0)).xyz; }
 min16float3 FFX_DNSR_Reflections_LoadRadianceReprojected(int2 pixel_coordinate) { return (min16float3)g_in_reprojected_radiance.Load(int3(pixel_coordinate, 0)).xyz; }
 min16float FFX_DNSR_Reflections_LoadRoughness(int2 pixel_coordinate) { return (min16float)g_roughness.Load(int3(pixel_coordinate, 0)); }
-min16float FFX_DNSR_Reflections_LoadVariance(int2 pixel_coordinate) { return (min16float)g_in_variance.Load(int3(pixel_coordinate, 0)).x; }
-min16float FFX_DNSR_Reflections_LoadNumSamples(int2 pixel_coordinate) { return (min16float)g_in_sample_count.Load(int3(pixel_coordinate, 0)).x; }
+min16float FFX_DNSR_Reflections_LoadVariance(int2 pixel_coordinate) { return (min16float)g_in_variance_sample_count.Load(int3(pixel_coordinate, 0)).x; }
+min16float FFX_DNSR_Reflections_LoadNumSamples(int2 pixel_coordinate) { return (min16float)g_in_variance_sample_count.Load(int3(pixel_coordinate, 0)).y; }
 void FFX_DNSR_Reflections_StoreTemporalAccumulation(int2 pixel_coordinate, min16float3 radiance, min16float variance) {
     g_out_radiance[pixel_coordinate] = radiance.xyzz;
-    g_out_variance[pixel_coordinate] = variance.x;
+    g_out_variance_sample_count[pixel_coordinate] = float2(variance.x, FFX_DNSR_Reflections_LoadNumSamples(pixel_coordinate));
+#ifdef APPLY_REFLECTIONS
+    ApplyReflection(pixel_coordinate, radiance);
+#endif // APPLY_REFLECTIONS
 }
 
 #include "ffx_denoiser_reflections_resolve_temporal.h"
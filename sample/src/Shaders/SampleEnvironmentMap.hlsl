@@ -0,0 +1,62 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+#include "Common.hlsl"
+
+[[vk::binding(0, 1)]] Texture2D<float> g_roughness                          : register(t0);
+[[vk::binding(1, 1)]] Texture2D<float> g_depth_buffer                       : register(t1);
+[[vk::binding(2, 1)]] Texture2D<float4> g_normal                            : register(t2);
+[[vk::binding(3, 1)]] TextureCube g_environment_map                         : register(t3);
+[[vk::binding(4, 1)]] Buffer<uint> g_environment_map_list                   : register(t4);
+
+[[vk::binding(5, 1)]] SamplerState g_environment_map_sampler                : register(s0);
+
+[[vk::binding(6, 1)]] RWTexture2D<float4> g_intersection_output             : register(u0);
+[[vk::binding(7, 1)]] RWBuffer<uint> g_ray_counter                          : register(u1);
+
+float3 SampleEnvironmentMap(uint2 dispatch_thread_id, float roughness) {
+    float2 uv = (dispatch_thread_id + 0.5) * g_inv_buffer_dimensions;
+    float3 world_space_normal = normalize(2.0 * g_normal.Load(int3(dispatch_thread_id, 0)).xyz - 1.0);
+    float  z = g_depth_buffer.Load(int3(dispatch_thread_id, 0));
+    float3 screen_uv_space_ray_origin = float3(uv, z);
+    float3 view_space_ray = FFX_DNSR_Reflections_ScreenSpaceToViewSpace(screen_uv_space_ray_origin);
+    float3 view_space_ray_direction = normalize(view_space_ray);
+    float3 view_space_surface_normal = mul(g_view, float4(world_space_normal, 0)).xyz;
+    float3 view_space_reflected_direction = reflect(view_space_ray_direction, view_space_surface_normal);
+    float3 world_space_reflected_direction = mul(g_inv_view, float4(view_space_reflected_direction, 0)).xyz;
+
+    const float mip_count = 10;
+    return g_environment_map.SampleLevel(g_environment_map_sampler, world_space_reflected_direction, roughness * (mip_count - 1)).xyz;
+}
+
+// Shades the reflective pixels that are too rough to be traced. ClassifyTiles appends them to g_environment_map_list.
+[numthreads(8, 8, 1)]
+void main(uint group_index : SV_GroupIndex, uint group_id : SV_GroupID) {
+    uint pixel_index = group_id * 64 + group_index;
+    if (pixel_index >= g_ray_counter[ENVIRONMENT_MAP_COUNTER + 1]) return;
+
+    uint packed_coords = g_environment_map_list[pixel_index];
+    uint2 coords = uint2(packed_coords & 0xffffu, (packed_coords >> 16) & 0xffffu);
+
+    float roughness = g_roughness.Load(int3(coords, 0));
+    g_intersection_output[coords] = float4(SampleEnvironmentMap(coords, roughness), 0);
+}
@@ -0,0 +1,142 @@
+# Compiles the shader permutations of the SSSR passes ahead of time, so the sample does not have to run DXC at startup.
+# Writes one blob per permutation and a manifest that maps the shader and the defines of each permutation to its blob,
+# see Common/ShaderBlobLibrary.h. The permutations missing from the manifest are still compiled at runtime.
+
+option(SSSR_OFFLINE_SHADERS "Compile the shader permutations at build time" ON)
+find_program(DXC_EXECUTABLE dxc HINTS $ENV{VULKAN_SDK}/bin $ENV{VULKAN_SDK}/Bin)
+
+set(SSSR_SHADER_DIR ${CMAKE_CURRENT_LIST_DIR})
+set(SSSR_SHADER_INCLUDE_DIRS
+	${SSSR_SHADER_DIR}
+	${SSSR_SHADER_DIR}/../../../ffx-sssr
+	${SSSR_SHADER_DIR}/../../../ffx-dnsr/ffx-reflection-dnsr
+	${SSSR_SHADER_DIR}/../../../ffx-spd/ffx-spd
+)
+
+# Lists every permutation that SSSR::SetupShaderPass and SSSR::GetPipeline may request as "<shader> [<define>=<value> ...]".
+# Must be kept in sync with the defines of the passes. The accumulation passes are left out, as they depend on the sample count.
+# With SSSR_WAVE_SIZE_PERMUTATIONS the tile classification and the intersection are also compiled with the wave size of SSSR::GetWaveSize.
+# SSSR_SUBGROUP_SIZE_PERMUTATIONS does the same with the subgroup size Vulkan pins, see SSSR::SetupShaderPass.
+function(sssr_shader_permutations outVar)
+	set(permutations)
+	set(intersectWaveSizes "")
+	set(classifyTilesWaveSizes "")
+	if(SSSR_WAVE_SIZE_PERMUTATIONS)
+		set(intersectWaveSizes "WAVE_SIZE=32")
+		set(classifyTilesWaveSizes "WAVE_SIZE=64")
+	elseif(SSSR_SUBGROUP_SIZE_PERMUTATIONS)
+		set(intersectWaveSizes "SUBGROUP_SIZE=32")
+		set(classifyTilesWaveSizes "SUBGROUP_SIZE=64")
+	endif()
+	foreach(linearDepthHierarchy 0 1)
+		set(base "")
+		set(classifyTilesVariants "")
+		if(linearDepthHierarchy)
+			set(base "LINEAR_DEPTH_HIERARCHY=1")
+		else()
+			# The tile classification cannot build a linear depth hierarchy.
+			list(APPEND classifyTilesVariants "FUSED_DEPTH_DOWNSAMPLE=1" "FUSED_DEPTH_DOWNSAMPLE=1 HALF_PRECISION_DEPTH_HIERARCHY=1")
+		endif()
+
+		list(APPEND permutations
+			"PrepareIndirectArgs.hlsl ${base}"
+			"PrepareIndirectArgs.hlsl ${base} PREPARE_PREFILTER_ARGS=1"
+			"SampleEnvironmentMap.hlsl ${base}"
+			"ResolveTemporal.hlsl ${base}"
+			"ResolveTemporal.hlsl ${base} APPLY_REFLECTIONS=1"
+			"Prefilter.hlsl ${base}"
+			"Prefilter.hlsl ${base} PASS_THROUGH=1"
+			"Reproject.hlsl ${base}"
+			"FusedDenoiser.hlsl ${base}"
+			"FusedDenoiser.hlsl ${base} APPLY_REFLECTIONS=1"
+			"CopyDenoiserTiles.hlsl ${base}"
+			"PrepareBlueNoiseTexture.hlsl ${base}"
+			"PrepareBlueNoiseTexture.hlsl ${base} SAMPLE_SET=1"
+		)
+
+		foreach(waveSize "" ${intersectWaveSizes})
+			foreach(tileClass MIRROR GLOSSY ROUGH)
+				foreach(mipUsageStatistics 0 1)
+					list(APPEND permutations "Intersect.hlsl ${base} ${waveSize} TILE_CLASS=TILE_CLASS_${tileClass} MIP_USAGE_STATISTICS_ENABLED=${mipUsageStatistics}")
+				endforeach()
+			endforeach()
+		endforeach()
+
+		# The empty variant classifies the tiles without building the depth hierarchy.
+		foreach(waveSize "" ${classifyTilesWaveSizes})
+			foreach(variant "" ${classifyTilesVariants})
+				foreach(samplesPerQuad 1 2 4)
+					foreach(varianceGuidedTracing 0 1)
+						foreach(applyReflections 0 1)
+							foreach(convergedRaySkipping 0 1)
+								list(APPEND permutations "ClassifyTiles.hlsl ${base} ${waveSize} ${variant} SAMPLES_PER_QUAD=${samplesPerQuad} TEMPORAL_VARIANCE_GUIDED_TRACING_ENABLED=${varianceGuidedTracing} APPLY_REFLECTIONS_IN_RESOLVE=${applyReflections} CONVERGED_RAY_SKIPPING_ENABLED=${convergedRaySkipping}")
+							endforeach()
+						endforeach()
+					endforeach()
+				endforeach()
+			endforeach()
+		endforeach()
+	endforeach()
+	set(${outVar} ${permutations} PARENT_SCOPE)
+endfunction()
+
+# Compiles all permutations into blobDir before target is built. The remaining arguments are passed on to DXC.
+function(add_shader_blobs target blobDir extension)
+	if(NOT SSSR_OFFLINE_SHADERS)
+		return()
+	endif()
+	if(NOT DXC_EXECUTABLE)
+		message(STATUS "DXC not found. The shaders of ${target} are compiled at runtime.")
+		return()
+	endif()
+
+	file(GLOB_RECURSE shaderDependencies ${SSSR_SHADER_DIR}/*.hlsl ${SSSR_SHADER_DIR}/*.h)
+	foreach(includeDir ${SSSR_SHADER_INCLUDE_DIRS})
+		file(GLOB includeFiles ${includeDir}/*.h ${includeDir}/*.hlsl)
+		list(APPEND shaderDependencies ${includeFiles})
+	endforeach()
+	set(includeArgs)
+	foreach(includeDir ${SSSR_SHADER_INCLUDE_DIRS})
+		list(APPEND includeArgs -I ${includeDir})
+	endforeach()
+
+	sssr_shader_permutations(permutations)
+	set(manifest "")
+	set(blobs)
+	set(index 0)
+	foreach(permutation ${permutations})
+		separate_arguments(tokens UNIX_COMMAND "${permutation}")
+		list(GET tokens 0 shader)
+		list(REMOVE_AT tokens 0)
+		get_filename_component(shaderName ${shader} NAME_WE)
+		set(blob ${shaderName}_${index}${extension})
+
+		set(defineArgs)
+		foreach(define ${tokens})
+			list(APPEND defineArgs -D ${define})
+		endforeach()
+		string(REPLACE ";" " " defines "${tokens}")
+		# [WaveSize] needs shader model 6.6.
+		set(profile cs_6_2)
+		if(defines MATCHES "WAVE_SIZE=")
+			set(profile cs_6_6)
+		endif()
+
+		add_custom_command(
+			OUTPUT ${blobDir}/${blob}
+			COMMAND ${CMAKE_COMMAND} -E make_directory ${blobDir}
+			COMMAND ${DXC_EXECUTABLE} -T ${profile} -E main -enable-16bit-types ${ARGN} ${includeArgs} ${defineArgs} -Fo ${blobDir}/${blob} ${SSSR_SHADER_DIR}/${shader}
+			DEPENDS ${shaderDependencies}
+			COMMENT "Compiling ${shader} ${defines}"
+			VERBATIM
+		)
+		list(APPEND blobs ${blobDir}/${blob})
+		string(APPEND manifest "${blob} ${shader} ${defines}\n")
+		math(EXPR index "${index} + 1")
+	endforeach()
+
+	# The manifest only changes with the permutations, so it is written at configure time.
+	file(WRITE ${blobDir}/ShaderPermutations.txt "${manifest}")
+	add_custom_target(${target}_ShaderBlobs DEPENDS ${blobs})
+	add_dependencies(${target} ${target}_ShaderBlobs)
+endfunction()
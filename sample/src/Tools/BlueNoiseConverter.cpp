@@ -0,0 +1,265 @@
+/**********************************************************************
+Copyright (c) 2021 Advanced Micro Devices, Inc. All rights reserved.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+********************************************************************/
+
+// Converts the blue noise samplers of sample/libs/samplerCPP into the binary asset loaded by the sample.
+// Usage: BlueNoiseConverter <output file>
+//
+// Also wraps a precomputed spatiotemporal blue noise texture into the asset of the spatiotemporal blue noise mode.
+// The input holds the raw slices back to back, two UNORM8 channels per texel, e.g. the vec2 slices of NVIDIA's STBN dataset stripped of their image headers.
+// Usage: BlueNoiseConverter --stbn <input file> <width> <height> <frame count> <output file>
+//
+// The layouts are described in Common/BlueNoiseAsset.h.
+
+#include "../Common/BlueNoiseAsset.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace _1spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_1spp.cpp"
+}
+namespace _2spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_2spp.cpp"
+}
+namespace _4spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_4spp.cpp"
+}
+namespace _8spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_8spp.cpp"
+}
+namespace _16spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_16spp.cpp"
+}
+namespace _32spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_32spp.cpp"
+}
+namespace _64spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_64spp.cpp"
+}
+namespace _128spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_128spp.cpp"
+}
+namespace _256spp
+{
+#include "../../libs/samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_256spp.cpp"
+}
+
+using namespace SSSR_SAMPLE_COMMON;
+
+struct SamplerTables
+{
+	uint32_t samplesPerPixel;
+	const int (&sobolBuffer)[256 * 256];
+	const int (&rankingTileBuffer)[128 * 128 * 8];
+	const int (&scramblingTileBuffer)[128 * 128 * 8];
+};
+
+// In ascending order of the sample count, as promised by BlueNoiseAsset.
+static const SamplerTables g_samplers[] = {
+	{ 1, _1spp::sobol_256spp_256d, _1spp::rankingTile, _1spp::scramblingTile },
+	{ 2, _2spp::sobol_256spp_256d, _2spp::rankingTile, _2spp::scramblingTile },
+	{ 4, _4spp::sobol_256spp_256d, _4spp::rankingTile, _4spp::scramblingTile },
+	{ 8, _8spp::sobol_256spp_256d, _8spp::rankingTile, _8spp::scramblingTile },
+	{ 16, _16spp::sobol_256spp_256d, _16spp::rankingTile, _16spp::scramblingTile },
+	{ 32, _32spp::sobol_256spp_256d, _32spp::rankingTile, _32spp::scramblingTile },
+	{ 64, _64spp::sobol_256spp_256d, _64spp::rankingTile, _64spp::scramblingTile },
+	{ 128, _128spp::sobol_256spp_256d, _128spp::rankingTile, _128spp::scramblingTile },
+	{ 256, _256spp::sobol_256spp_256d, _256spp::rankingTile, _256spp::scramblingTile },
+};
+
+// Narrows a table to bytes. Fails if an entry does not fit.
+template<size_t N>
+static bool AppendTable(std::vector<uint8_t>& data, const int (&table)[N])
+{
+	for (int value : table)
+	{
+		if (value < 0 || value > 255)
+		{
+			return false;
+		}
+		data.push_back(static_cast<uint8_t>(value));
+	}
+	return true;
+}
+
+template<typename T>
+static void AppendStruct(std::vector<uint8_t>& data, const T& value)
+{
+	const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&value);
+	data.insert(data.end(), pBytes, pBytes + sizeof(T));
+}
+
+static bool WriteFile(const char* path, const std::vector<uint8_t>& data)
+{
+	FILE* pFile = fopen(path, "wb");
+	if (!pFile)
+	{
+		fprintf(stderr, "Cannot open %s for writing.\n", path);
+		return false;
+	}
+	bool written = fwrite(data.data(), 1, data.size(), pFile) == data.size();
+	written = (fclose(pFile) == 0) && written;
+	if (!written)
+	{
+		fprintf(stderr, "Failed to write %s.\n", path);
+		return false;
+	}
+	return true;
+}
+
+static int ConvertSamplers(const char* outputPath)
+{
+	const uint32_t variantCount = sizeof(g_samplers) / sizeof(g_samplers[0]);
+
+	// All samplers share the same Sobol sequence, so it is stored once.
+	for (const SamplerTables& sampler : g_samplers)
+	{
+		for (uint32_t i = 0; i < BLUE_NOISE_SOBOL_SIZE; ++i)
+		{
+			if (sampler.sobolBuffer[i] != g_samplers[0].sobolBuffer[i])
+			{
+				fprintf(stderr, "The Sobol sequence of the %u spp sampler differs from the others.\n", sampler.samplesPerPixel);
+				return 1;
+			}
+		}
+	}
+
+	BlueNoiseAssetHeader header = {};
+	header.magic = BLUE_NOISE_ASSET_MAGIC;
+	header.version = BLUE_NOISE_ASSET_VERSION;
+	header.variantCount = variantCount;
+	header.sobolOffset = sizeof(BlueNoiseAssetHeader) + variantCount * sizeof(BlueNoiseAssetVariant);
+
+	std::vector<uint8_t> data;
+	AppendStruct(data, header);
+
+	uint32_t offset = header.sobolOffset + BLUE_NOISE_SOBOL_SIZE;
+	for (const SamplerTables& sampler : g_samplers)
+	{
+		BlueNoiseAssetVariant variant = {};
+		variant.samplesPerPixel = sampler.samplesPerPixel;
+		variant.rankingTileOffset = offset;
+		variant.scramblingTileOffset = offset + BLUE_NOISE_TILE_SIZE;
+		AppendStruct(data, variant);
+		offset += 2 * BLUE_NOISE_TILE_SIZE;
+	}
+
+	bool fits = AppendTable(data, g_samplers[0].sobolBuffer);
+	for (const SamplerTables& sampler : g_samplers)
+	{
+		fits = fits && AppendTable(data, sampler.rankingTileBuffer) && AppendTable(data, sampler.scramblingTileBuffer);
+	}
+	if (!fits || data.size() != offset)
+	{
+		fprintf(stderr, "The sampler tables do not fit the asset layout.\n");
+		return 1;
+	}
+
+	if (!WriteFile(outputPath, data))
+	{
+		return 1;
+	}
+
+	printf("Wrote %u blue noise samplers (%zu bytes) to %s\n", variantCount, data.size(), outputPath);
+	return 0;
+}
+
+static int ConvertSpatiotemporal(const char* inputPath, uint32_t width, uint32_t height, uint32_t frameCount, const char* outputPath)
+{
+	if (width == 0 || height == 0 || frameCount == 0)
+	{
+		fprintf(stderr, "The spatiotemporal blue noise must have at least one texel and one frame.\n");
+		return 1;
+	}
+
+	const uint64_t sliceSize = (uint64_t)width * height * SPATIOTEMPORAL_BLUE_NOISE_CHANNEL_COUNT;
+	const uint64_t dataSize = sliceSize * frameCount;
+	if (sizeof(SpatiotemporalBlueNoiseAssetHeader) + dataSize > UINT32_MAX)
+	{
+		fprintf(stderr, "The spatiotemporal blue noise does not fit the asset layout.\n");
+		return 1;
+	}
+
+	FILE* pFile = fopen(inputPath, "rb");
+	if (!pFile)
+	{
+		fprintf(stderr, "Cannot open %s for reading.\n", inputPath);
+		return 1;
+	}
+
+	SpatiotemporalBlueNoiseAssetHeader header = {};
+	header.magic = SPATIOTEMPORAL_BLUE_NOISE_ASSET_MAGIC;
+	header.version = SPATIOTEMPORAL_BLUE_NOISE_ASSET_VERSION;
+	header.width = width;
+	header.height = height;
+	header.frameCount = frameCount;
+	header.channelCount = SPATIOTEMPORAL_BLUE_NOISE_CHANNEL_COUNT;
+	header.dataOffset = sizeof(SpatiotemporalBlueNoiseAssetHeader);
+
+	std::vector<uint8_t> data;
+	AppendStruct(data, header);
+	data.resize(header.dataOffset + dataSize);
+
+	// The input must hold exactly the given number of slices.
+	bool read = fread(data.data() + header.dataOffset, 1, dataSize, pFile) == dataSize;
+	read = read && fgetc(pFile) == EOF;
+	fclose(pFile);
+	if (!read)
+	{
+		fprintf(stderr, "%s does not hold %u slices of %ux%u texels with %u channels.\n", inputPath, frameCount, width, height, SPATIOTEMPORAL_BLUE_NOISE_CHANNEL_COUNT);
+		return 1;
+	}
+
+	if (!WriteFile(outputPath, data))
+	{
+		return 1;
+	}
+
+	printf("Wrote %u slices of %ux%u spatiotemporal blue noise (%zu bytes) to %s\n", frameCount, width, height, data.size(), outputPath);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 2)
+	{
+		return ConvertSamplers(argv[1]);
+	}
+	if (argc == 7 && strcmp(argv[1], "--stbn") == 0)
+	{
+		return ConvertSpatiotemporal(argv[2], strtoul(argv[3], nullptr, 10), strtoul(argv[4], nullptr, 10), strtoul(argv[5], nullptr, 10), argv[6]);
+	}
+
+	fprintf(stderr, "Usage: BlueNoiseConverter <output file>\n");
+	fprintf(stderr, "       BlueNoiseConverter --stbn <input file> <width> <height> <frame count> <output file>\n");
+	return 1;
+}
@@ -108,7 +108,7 @@ namespace SSSR_SAMPLE_VK
 		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i)
 		{
 			const VkMemoryType& memoryType = memoryProperties.memoryTypes[i];
-			bool hasRequiredProperties = memoryType.propertyFlags & createInfo.memoryPropertyFlags;
+			bool hasRequiredProperties = (memoryType.propertyFlags & createInfo.memoryPropertyFlags) == createInfo.memoryPropertyFlags;
 			bool isRequiredMemoryType = memoryRequirements.memoryTypeBits & (1 << i);
 			if (hasRequiredProperties && isRequiredMemoryType)
 			{
@@ -33,6 +33,7 @@ namespace SSSR_SAMPLE_VK
 		, m_texture()
 		, m_view(VK_NULL_HANDLE)
 		, m_currentLayout(VK_IMAGE_LAYOUT_UNDEFINED)
+		, m_arrayLayers(1)
 	{
 	}
 
@@ -64,12 +65,13 @@ namespace SSSR_SAMPLE_VK
 	*/
 	ImageVK::ImageVK(Device* pDevice, const CreateInfo& createInfo, const char* name)
 		: m_device(pDevice->GetDevice())
+		, m_arrayLayers(std::max(createInfo.arrayLayers, 1u))
 	{
 		VkImageCreateInfo imgCreateInfo = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
 		imgCreateInfo.pNext = nullptr;
 		imgCreateInfo.flags = 0;
 		imgCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-		imgCreateInfo.arrayLayers = 1;
+		imgCreateInfo.arrayLayers = m_arrayLayers;
 		imgCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imgCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
 		imgCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -96,6 +98,7 @@ namespace SSSR_SAMPLE_VK
 		, m_texture(other.m_texture)
 		, m_view(other.m_view)
 		, m_currentLayout(other.m_currentLayout)
+		, m_arrayLayers(other.m_arrayLayers)
 	{
 		other.m_device = VK_NULL_HANDLE;
 		other.m_texture = {};
@@ -117,6 +120,7 @@ namespace SSSR_SAMPLE_VK
 			m_texture = other.m_texture;
 			m_view = other.m_view;
 			m_currentLayout = other.m_currentLayout;
+			m_arrayLayers = other.m_arrayLayers;
 
 			other.m_device = VK_NULL_HANDLE;
 			other.m_texture = {};
@@ -184,7 +188,7 @@ namespace SSSR_SAMPLE_VK
 		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount = 1;
+		barrier.subresourceRange.layerCount = m_arrayLayers;
 		barrier.subresourceRange.baseMipLevel = 0;
 		barrier.subresourceRange.levelCount = 1;
 
@@ -38,6 +38,8 @@ namespace SSSR_SAMPLE_VK
 			VkFormat format;
 			uint32_t width;
 			uint32_t height;
+			// Creates a 2D array if larger than one. Zero is treated as one.
+			uint32_t arrayLayers;
 		};
 
 		ImageVK();
@@ -58,5 +60,6 @@ namespace SSSR_SAMPLE_VK
 		Texture m_texture;
 		VkImageView m_view;
 		VkImageLayout m_currentLayout;
+		uint32_t m_arrayLayers;
 	};
 }
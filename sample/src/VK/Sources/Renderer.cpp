@@ -26,14 +26,37 @@ THE SOFTWARE.
 #undef min
 #undef max
 
+/**
+	Screen space depth is a hyperbolic function of the linear depth (the clip space w): depth = parameters[0] + parameters[1] / w.
+	parameters[2] receives the linear depth of the far plane.
+*/
+static void GetLinearDepthParameters(const math::Matrix4& proj, float parameters[3])
+{
+	// Matrix4::getElem takes the column first.
+	const float p22 = proj.getElem(2, 2);
+	const float p23 = proj.getElem(3, 2);
+	const float p32 = proj.getElem(2, 3);
+	const float p33 = proj.getElem(3, 3);
+	parameters[0] = p22 / p32;
+	parameters[1] = p23 - p22 * p33 / p32;
+	parameters[2] = parameters[1] / (1.0f - parameters[0]);
+}
+
 //--------------------------------------------------------------------------------------
 //
 // OnCreate
 //
 //--------------------------------------------------------------------------------------
-void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize)
+void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize, bool HalfPrecisionDepthHierarchy, bool LinearDepthHierarchy, uint32_t MaxDepthHierarchyMipLevel, bool FusedDepthDownsample, uint32_t BlueNoiseSamplesPerPixel, bool SpatiotemporalBlueNoise, uint32_t AccumulationSamplesPerPixel, bool LowPrecisionHistory, bool SubgroupSizeControlEnabled, bool PipelineCreationFeedbackEnabled)
 {
 	m_pDevice = pDevice;
+	m_bHalfPrecisionDepthHierarchy = HalfPrecisionDepthHierarchy && !LinearDepthHierarchy;
+	m_bLinearDepthHierarchy = LinearDepthHierarchy;
+	m_bFusedDepthDownsample = FusedDepthDownsample && !LinearDepthHierarchy;
+	m_bAccumulationAvailable = AccumulationSamplesPerPixel > 0;
+	m_bLowPrecisionHistory = LowPrecisionHistory;
+	// Rough tiles start the traversal one mip above the most detailed one, so keep at least mip 1 around.
+	m_MaxDepthHierarchyMipLevel = std::max(1u, std::min(MaxDepthHierarchyMipLevel, DEPTH_HIERARCHY_MAX_MIP_COUNT - 1));
 	m_FrameIndex = 0;
 
 	// Initialize helpers
@@ -147,7 +170,7 @@ void Renderer::OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize)
 	}
 
 	VkCommandBuffer cb1 = BeginNewCommandBuffer();
-	m_Sssr.OnCreate(pDevice, cb1, &m_ResourceViewHeaps, &m_ConstantBufferRing, backBufferCount, true);
+	m_Sssr.OnCreate(pDevice, cb1, &m_ResourceViewHeaps, &m_ConstantBufferRing, backBufferCount, true, m_bLinearDepthHierarchy, m_bHalfPrecisionDepthHierarchy, m_bFusedDepthDownsample, BlueNoiseSamplesPerPixel, SpatiotemporalBlueNoise, AccumulationSamplesPerPixel, SubgroupSizeControlEnabled, PipelineCreationFeedbackEnabled, &m_AsyncPool);
 	// Wait for the upload to finish;
 	SubmitCommandBuffer(cb1);
 	m_pDevice->GPUFlush();
@@ -308,11 +331,17 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 
 	// Depth downsampling pass with single CS
 	{
-		m_DepthMipLevelCount = static_cast<uint32_t>(std::log2(std::max(m_Width, m_Height))) + 1;
+		// The SSSR passes read mip 0 from the depth buffer. Only linear depth differs from it and needs its own copy.
+		m_DepthHierarchyFirstMip = m_bLinearDepthHierarchy ? 0 : 1;
+		m_DepthMipLevelCount = std::min(static_cast<uint32_t>(std::log2(std::max(m_Width, m_Height))) + 1, m_MaxDepthHierarchyMipLevel + 1) - m_DepthHierarchyFirstMip;
+		const uint32_t hierarchyWidth = std::max(m_Width >> m_DepthHierarchyFirstMip, 1u);
+		const uint32_t hierarchyHeight = std::max(m_Height >> m_DepthHierarchyFirstMip, 1u);
 
 		// Downsampled depth buffer
-		imageCreateInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageCreateInfo.format = m_bHalfPrecisionDepthHierarchy ? VK_FORMAT_R16_UNORM : VK_FORMAT_R32_SFLOAT;
 		imageCreateInfo.mipLevels = m_DepthMipLevelCount;
+		imageCreateInfo.extent.width = hierarchyWidth;
+		imageCreateInfo.extent.height = hierarchyHeight;
 		m_DepthHierarchy.Init(m_pDevice, &imageCreateInfo, "m_DepthHierarchy");
 		for (UINT i = 0; i < std::min(13u, m_DepthMipLevelCount); ++i)
 		{
@@ -320,6 +349,14 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 		}
 		m_DepthHierarchy.CreateSRV(&m_DepthHierarchySRV);
 
+		imageCreateInfo.mipLevels = 1;
+		imageCreateInfo.extent.width = 1;
+		imageCreateInfo.extent.height = 1;
+		m_DepthHierarchyDummy.Init(m_pDevice, &imageCreateInfo, "m_DepthHierarchyDummy");
+		m_DepthHierarchyDummy.CreateSRV(&m_DepthHierarchyDummyView);
+		// The downsampling writes up to the coarsest mip, which is the last one created.
+		assert(std::min(static_cast<uint32_t>(std::log2(std::max(m_Width, m_Height))), m_MaxDepthHierarchyMipLevel) == GetDepthHierarchyMaxMip());
+
 		// Atomic counter
 
 		VkBufferCreateInfo bufferCreateInfo = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
@@ -360,14 +397,24 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 	sssrInput.HDRView = m_GBuffer.m_HDRSRV;
 	sssrInput.DepthHierarchy = &m_DepthHierarchy;
 	sssrInput.DepthHierarchyView = m_DepthHierarchySRV;
+	sssrInput.DepthBufferView = m_DepthHierarchyFirstMip == 0 ? m_DepthHierarchySRV : m_GBuffer.m_DepthBufferDSV;
+	for (uint32_t i = 0; i < DEPTH_HIERARCHY_MAX_MIP_COUNT; ++i)
+	{
+		sssrInput.DepthHierarchyMipViews[i] = i < m_DepthMipLevelCount ? m_DepthHierarchyDescriptors[i] : m_DepthHierarchyDummyView;
+	}
+	sssrInput.DepthHierarchyMipCount = m_DepthMipLevelCount;
+	sssrInput.DepthHierarchyAtomicCounterView = m_AtomicCounterUAV;
 	sssrInput.MotionVectorsView = m_GBuffer.m_MotionVectorsSRV;
 	sssrInput.NormalBuffer = &m_GBuffer.m_NormalBuffer;
 	sssrInput.NormalBufferView = m_GBuffer.m_NormalBufferSRV;
 	sssrInput.SpecularRoughnessView = m_GBuffer.m_SpecularRoughnessSRV;
+	sssrInput.HDR = &m_GBuffer.m_HDR;
+	sssrInput.BrdfLutView = m_BrdfLutSRV;
 	sssrInput.EnvironmentMapView = m_SkyDome.GetCubeSpecularTextureView();
 	sssrInput.EnvironmentMapSampler = m_SkyDome.GetCubeSpecularTextureSampler();
 	sssrInput.outputWidth = m_Width;
 	sssrInput.outputHeight = m_Height;
+	sssrInput.lowPrecisionHistory = m_bLowPrecisionHistory;
 	m_Sssr.OnCreateWindowSizeDependentResources(cb, sssrInput);
 
 	for (int i = 0; i < 2; ++i)
@@ -390,7 +437,9 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 		applyReflectionsImageInfos[4].imageView = VK_NULL_HANDLE;
 		applyReflectionsImageInfos[4].sampler = m_LinearSampler;
 
-		VkWriteDescriptorSet applyReflectionsWriteDescSets[5];
+		VkBufferView applyReflectionsTileListView = m_Sssr.GetReflectionTileListView();
+
+		VkWriteDescriptorSet applyReflectionsWriteDescSets[6];
 		applyReflectionsWriteDescSets[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		applyReflectionsWriteDescSets[0].pNext = nullptr;
 		applyReflectionsWriteDescSets[0].descriptorCount = 1;
@@ -436,6 +485,15 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 		applyReflectionsWriteDescSets[4].dstBinding = 4;
 		applyReflectionsWriteDescSets[4].pImageInfo = &applyReflectionsImageInfos[4];
 
+		applyReflectionsWriteDescSets[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		applyReflectionsWriteDescSets[5].pNext = nullptr;
+		applyReflectionsWriteDescSets[5].descriptorCount = 1;
+		applyReflectionsWriteDescSets[5].dstArrayElement = 0;
+		applyReflectionsWriteDescSets[5].dstSet = m_ApplyPipelineDescriptorSet[i];
+		applyReflectionsWriteDescSets[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+		applyReflectionsWriteDescSets[5].dstBinding = 5;
+		applyReflectionsWriteDescSets[5].pTexelBufferView = &applyReflectionsTileListView;
+
 		vkUpdateDescriptorSets(m_pDevice->GetDevice(), _countof(applyReflectionsWriteDescSets), applyReflectionsWriteDescSets, 0, nullptr);
 	}
 
@@ -445,12 +503,13 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 	downsampleImageInfos[0].imageView = m_GBuffer.m_DepthBufferDSV;
 	downsampleImageInfos[0].sampler = VK_NULL_HANDLE;
 
+	// The mips past the last one are mapped to the dummy
 	uint32_t i = 0;
-	for (; i < m_DepthMipLevelCount; ++i)
+	for (; i < 13; ++i)
 	{
 		uint32_t idx = i + 1;
 		downsampleImageInfos[idx].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
-		downsampleImageInfos[idx].imageView = m_DepthHierarchyDescriptors[i];
+		downsampleImageInfos[idx].imageView = i < m_DepthMipLevelCount ? m_DepthHierarchyDescriptors[i] : m_DepthHierarchyDummyView;
 		downsampleImageInfos[idx].sampler = VK_NULL_HANDLE;
 	}
 
@@ -465,20 +524,6 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 	depthDownsampleWriteDescSets[0].pImageInfo = &downsampleImageInfos[0];
 
 	i = 0;
-	for (; i < m_DepthMipLevelCount; ++i)
-	{
-		uint32_t idx = i + 1;
-		depthDownsampleWriteDescSets[idx].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		depthDownsampleWriteDescSets[idx].pNext = nullptr;
-		depthDownsampleWriteDescSets[idx].descriptorCount = 1;
-		depthDownsampleWriteDescSets[idx].dstArrayElement = i;
-		depthDownsampleWriteDescSets[idx].dstSet = m_DepthDownsampleDescriptorSet;
-		depthDownsampleWriteDescSets[idx].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-		depthDownsampleWriteDescSets[idx].dstBinding = 1;
-		depthDownsampleWriteDescSets[idx].pImageInfo = &downsampleImageInfos[idx];
-	}
-
-	// Map the remaining mip levels to the lowest mip
 	for (; i < 13; ++i)
 	{
 		uint32_t idx = i + 1;
@@ -489,7 +534,7 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 		depthDownsampleWriteDescSets[idx].dstSet = m_DepthDownsampleDescriptorSet;
 		depthDownsampleWriteDescSets[idx].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 		depthDownsampleWriteDescSets[idx].dstBinding = 1;
-		depthDownsampleWriteDescSets[idx].pImageInfo = &downsampleImageInfos[m_DepthMipLevelCount];
+		depthDownsampleWriteDescSets[idx].pImageInfo = &downsampleImageInfos[idx];
 	}
 
 	depthDownsampleWriteDescSets[14].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -506,6 +551,7 @@ void Renderer::OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint3
 	// Initial layout transitions
 	Barriers(cb, {
 		Transition(m_DepthHierarchy.Resource(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT, m_DepthMipLevelCount),
+		Transition(m_DepthHierarchyDummy.Resource(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL),
 		Transition(m_DownSample.GetTexture()->Resource(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, 6),
 		});
 
@@ -543,9 +589,11 @@ void Renderer::OnDestroyWindowSizeDependentResources()
 		m_DepthHierarchyDescriptors[i] = VK_NULL_HANDLE;
 	}
 	vkDestroyImageView(device, m_DepthHierarchySRV, nullptr);
+	vkDestroyImageView(device, m_DepthHierarchyDummyView, nullptr);
 	vkDestroyBufferView(device, m_AtomicCounterUAV, nullptr);
 
 	m_DepthHierarchy.OnDestroy();
+	m_DepthHierarchyDummy.OnDestroy();
 
 	vkDestroyFramebuffer(device, m_ApplyFramebuffer, nullptr);
 
@@ -699,6 +747,9 @@ int Renderer::LoadScene(GLTFCommon* pGLTFCommon, int Stage)
 //--------------------------------------------------------------------------------------
 void Renderer::UnloadScene()
 {
+	// The next scene must not reuse the reflections of this one.
+	++m_SceneRevision;
+
 	// wait for all the async loading operations to finish
 	m_AsyncPool.Flush();
 
@@ -967,12 +1018,15 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 			Transition(m_GBuffer.m_DepthBuffer.Resource(),			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,	VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
 			});
 
-		// Downsample depth buffer
-		DownsampleDepthBuffer(cmdBuf1);
+		// Downsample depth buffer. If it is fused into the tile classification, SSSR transitions the hierarchy itself.
+		if (!m_bFusedDepthDownsample)
+		{
+			DownsampleDepthBuffer(cmdBuf1, Cam);
 
-		Barriers(cmdBuf1, {
-			Transition(m_DepthHierarchy.Resource(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, m_DepthMipLevelCount),
-		});
+			Barriers(cmdBuf1, {
+				Transition(m_DepthHierarchy.Resource(), VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, m_DepthMipLevelCount),
+			});
+		}
 
 		// Stochastic SSR
 		RenderScreenSpaceReflections(cmdBuf1, Cam, pPerFrame, pState);
@@ -980,14 +1034,18 @@ void Renderer::OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSw
 		// Apply the result of SSR
 		ApplyReflectionTarget(cmdBuf1, Cam, pState);
 
-		Barriers(cmdBuf1, {
-			Transition(m_DepthHierarchy.Resource(),					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL,							VK_IMAGE_ASPECT_COLOR_BIT, m_DepthMipLevelCount),
+		std::vector<VkImageMemoryBarrier> postReflectionBarriers = {
 			Transition(m_GBuffer.m_DepthBuffer.Resource(),			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
 			Transition(m_GBuffer.m_HDR.Resource(),					VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
 			Transition(m_GBuffer.m_NormalBuffer.Resource(),			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
 			Transition(m_GBuffer.m_MotionVectors.Resource(),		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
 			Transition(m_GBuffer.m_SpecularRoughness.Resource(),	VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
-		});
+		};
+		if (!m_bFusedDepthDownsample)
+		{
+			postReflectionBarriers.push_back(Transition(m_DepthHierarchy.Resource(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT, m_DepthMipLevelCount));
+		}
+		Barriers(cmdBuf1, postReflectionBarriers);
 
 		// draw object's bounding boxes
 		{
@@ -1361,7 +1419,7 @@ void Renderer::CreateApplyReflectionsPipeline()
 {
 	VkDevice device = m_pDevice->GetDevice();
 
-	VkDescriptorSetLayoutBinding bindings[6];
+	VkDescriptorSetLayoutBinding bindings[7];
 	bindings[0].binding = 0;
 	bindings[0].descriptorCount = 1;
 	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
@@ -1392,22 +1450,28 @@ void Renderer::CreateApplyReflectionsPipeline()
 	bindings[4].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT;
 	bindings[4].pImmutableSamplers = nullptr;
 
-	bindings[5].binding = 0;
+	bindings[5].binding = 5;
 	bindings[5].descriptorCount = 1;
-	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	bindings[5].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	bindings[5].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+	bindings[5].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	bindings[5].pImmutableSamplers = nullptr;
 
+	bindings[6].binding = 0;
+	bindings[6].descriptorCount = 1;
+	bindings[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	bindings[6].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_VERTEX_BIT;
+	bindings[6].pImmutableSamplers = nullptr;
+
 	VkDescriptorSetLayoutCreateInfo descSetLayoutCreateInfo[2];
 	descSetLayoutCreateInfo[0].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	descSetLayoutCreateInfo[0].pNext = nullptr;
 	descSetLayoutCreateInfo[0].bindingCount = 1;
-	descSetLayoutCreateInfo[0].pBindings = &bindings[5];
+	descSetLayoutCreateInfo[0].pBindings = &bindings[6];
 	descSetLayoutCreateInfo[0].flags = 0;
 
 	descSetLayoutCreateInfo[1].sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	descSetLayoutCreateInfo[1].pNext = nullptr;
-	descSetLayoutCreateInfo[1].bindingCount = 5;
+	descSetLayoutCreateInfo[1].bindingCount = 6;
 	descSetLayoutCreateInfo[1].pBindings = &bindings[0];
 	descSetLayoutCreateInfo[1].flags = 0;
 
@@ -1591,8 +1655,14 @@ void Renderer::CreateDepthDownsamplePipeline()
 	pipelineLayoutCreateInfo.pNext = nullptr;
 	pipelineLayoutCreateInfo.setLayoutCount = 1;
 	pipelineLayoutCreateInfo.pSetLayouts = &m_DepthDownsampleDescriptorSetLayout;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
+
+	// Parameters to linearize the depth, see GetLinearDepthParameters.
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = 3 * sizeof(float);
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
 
 	if (VK_SUCCESS != vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &m_DepthDownsamplePipelineLayout))
 	{
@@ -1600,6 +1670,11 @@ void Renderer::CreateDepthDownsamplePipeline()
 	}
 
 	DefineList defines;
+	if (m_bHalfPrecisionDepthHierarchy)
+		defines["HALF_PRECISION_DEPTH_HIERARCHY"] = "1";
+	if (m_bLinearDepthHierarchy)
+		defines["LINEAR_DEPTH_HIERARCHY"] = "1";
+	defines["DEPTH_HIERARCHY_MAX_MIP"] = std::to_string(m_MaxDepthHierarchyMipLevel);
 	VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfo;
 	VKCompileFromFile(device, VK_SHADER_STAGE_COMPUTE_BIT, "DepthDownsample.hlsl", "main", "-T cs_6_0", &defines, &pipelineShaderStageCreateInfo);
 
@@ -1715,12 +1790,16 @@ void Renderer::SubmitCommandBuffer(VkCommandBuffer cb, VkSemaphore* waitSemaphor
 	assert(res == VK_SUCCESS);
 }
 
-void Renderer::DownsampleDepthBuffer(VkCommandBuffer cb)
+void Renderer::DownsampleDepthBuffer(VkCommandBuffer cb, const Camera& Cam)
 {
 	SetPerfMarkerBegin(cb, "Downsample Depth");
 
+	float linearDepthParameters[3];
+	GetLinearDepthParameters(Cam.GetProjection(), linearDepthParameters);
+
 	vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_DepthDownsamplePipeline);
 	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, m_DepthDownsamplePipelineLayout, 0, 1, &m_DepthDownsampleDescriptorSet, 0, nullptr);
+	vkCmdPushConstants(cb, m_DepthDownsamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(linearDepthParameters), linearDepthParameters);
 
 	// Each threadgroup works on 64x64 texels
 	uint32_t dimX = (m_Width + 63) / 64;
@@ -1741,17 +1820,40 @@ void Renderer::RenderScreenSpaceReflections(VkCommandBuffer cb, const Camera& Ca
 	sssrConstants.frameIndex = m_FrameIndex;
 	sssrConstants.maxTraversalIntersections = pState->maxTraversalIterations;
 	sssrConstants.minTraversalOccupancy = pState->minTraversalOccupancy;
-	sssrConstants.mostDetailedMip = pState->mostDetailedDepthHierarchyMipLevel;
+	sssrConstants.maxTraversalMip = GetDepthHierarchyMaxMip();
+	// Rough tiles start one mip above the most detailed one, which has to exist.
+	sssrConstants.mostDetailedMip = std::min<uint32_t>(pState->mostDetailedDepthHierarchyMipLevel, sssrConstants.maxTraversalMip - 1);
+	sssrConstants.mipUsageStatisticsEnabled = pState->bCollectMipUsageStatistics ? 1 : 0;
 	sssrConstants.temporalStabilityFactor = pState->temporalStability;
 	sssrConstants.depthBufferThickness = pState->depthBufferThickness;
-	sssrConstants.samplesPerQuad = pState->samplesPerQuad;
-	sssrConstants.temporalVarianceGuidedTracingEnabled = pState->bEnableTemporalVarianceGuidedTracing ? 1 : 0;
+	// The accumulation traces every reflective pixel in every frame and skips the denoiser.
+	const bool accumulate = pState->bAccumulateSamples && m_bAccumulationAvailable;
+	sssrConstants.samplesPerQuad = accumulate ? 4 : pState->samplesPerQuad;
+	sssrConstants.temporalVarianceGuidedTracingEnabled = pState->bEnableTemporalVarianceGuidedTracing && !accumulate ? 1 : 0;
 	sssrConstants.varianceThreshold = pState->temporalVarianceThreshold;
+	sssrConstants.maxSampleCount = pState->maxSampleCount;
+	sssrConstants.disocclusionThreshold = pState->disocclusionThreshold;
+	sssrConstants.spatialFilterNormalSigma = pState->spatialFilterNormalSigma;
+	sssrConstants.spatialFilterDepthSigma = pState->spatialFilterDepthSigma;
+	sssrConstants.spatialFilterLuminanceSigma = pState->spatialFilterLuminanceSigma;
+	sssrConstants.neighborhoodClampSigma = pState->neighborhoodClampSigma;
 	sssrConstants.roughnessThreshold = pState->roughnessThreshold;
+	sssrConstants.roughReflectionFraction = pState->roughReflectionFraction;
+	// The debug views rely on the separate apply pass.
+	sssrConstants.applyReflectionsInResolve = pState->bApplyReflectionsInResolve && pState->bApplyScreenSpaceReflections && !pState->bShowReflectionTarget && !pState->bShowIntersectionResults && !accumulate ? 1 : 0;
+	sssrConstants.convergedRaySkippingEnabled = pState->bSkipConvergedRays && !accumulate ? 1 : 0;
+	// One step of the 16 bit UNORM hierarchy. DepthDownsample.hlsl rounds towards the camera by at most this much.
+	sssrConstants.depthHierarchyTolerance = m_bHalfPrecisionDepthHierarchy ? 1.0f / 65535.0f : 0.0f;
 
 	math::Matrix4 view = Cam.GetView();
 	math::Matrix4 proj = Cam.GetProjection();
 
+	float linearDepthParameters[3];
+	GetLinearDepthParameters(proj, linearDepthParameters);
+	sssrConstants.linearDepthParameters[0] = linearDepthParameters[0];
+	sssrConstants.linearDepthParameters[1] = linearDepthParameters[1];
+	sssrConstants.linearFarDepth = linearDepthParameters[2];
+
 	sssrConstants.projection = proj;
 	sssrConstants.invProjection = math::inverse(proj);
 	sssrConstants.view = view;
@@ -1759,11 +1861,46 @@ void Renderer::RenderScreenSpaceReflections(VkCommandBuffer cb, const Camera& Ca
 	sssrConstants.prevViewProjection = pPerFrame->mCameraPrevViewProj;
 	sssrConstants.invViewProjection = pPerFrame->mInverseCameraCurrViewProj;
 
-	m_Sssr.Draw(cb, sssrConstants, m_GPUTimer, pState->bShowIntersectionResults);
+	// Without animations only camera movement, lighting and UI changes alter the reflections. SSSR detects changed constants on its own, the lighting is tracked by the scene revision.
+	// The accumulation has to know about animations even if static frames are not reused.
+	bool isSceneStatic = !pState->bIsAnimationPlaying;
+	bool reuseStaticFrames = pState->bReuseStaticFrames && !pState->bDisableStaticFrameReuse;
+	UpdateSceneRevision(pPerFrame);
+	m_Sssr.Draw(cb, sssrConstants, m_GPUTimer, pState->bShowIntersectionResults, pState->bUseFusedDenoiser, isSceneStatic, reuseStaticFrames, m_SceneRevision, accumulate);
+}
+
+void Renderer::UpdateSceneRevision(const per_frame* pPerFrame)
+{
+	// Everything the shading of a static scene depends on apart from the camera, which SSSR compares on its own.
+	const size_t lightsSize = pPerFrame->lightCount * sizeof(pPerFrame->lights[0]);
+	m_Lighting.swap(m_PreviousLighting);
+	m_Lighting.resize(2 * sizeof(float) + lightsSize);
+	memcpy(m_Lighting.data(), &pPerFrame->iblFactor, sizeof(float));
+	memcpy(m_Lighting.data() + sizeof(float), &pPerFrame->emmisiveFactor, sizeof(float));
+	memcpy(m_Lighting.data() + 2 * sizeof(float), pPerFrame->lights, lightsSize);
+	if (m_Lighting != m_PreviousLighting)
+	{
+		++m_SceneRevision;
+	}
 }
 
 void Renderer::ApplyReflectionTarget(VkCommandBuffer cb, const Camera& Cam, const UIState* pState)
 {
+	// The reflection tile list is consumed by the vertex shader and its draw arguments by the indirect draw below.
+	{
+		VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		barrier.pNext = nullptr;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(cb,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			0,
+			1, &barrier,
+			0, nullptr,
+			0, nullptr);
+	}
+
 	VkRenderPassBeginInfo beginInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
 	beginInfo.pNext = nullptr;
 	beginInfo.clearValueCount = 0;
@@ -1803,13 +1940,26 @@ void Renderer::ApplyReflectionTarget(VkCommandBuffer cb, const Camera& Cam, cons
 		vkUpdateDescriptorSets(m_pDevice->GetDevice(), 1, &writeSet, 0, nullptr);
 	}
 
-	VkDescriptorSet sets[] = { uniformBufferDescriptorSet, m_ApplyPipelineDescriptorSet[m_FrameIndex % 2] };
+	VkDescriptorSet sets[] = { uniformBufferDescriptorSet, m_ApplyPipelineDescriptorSet[m_Sssr.GetOutputIndex()] };
 	vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ApplyPipeline);
 	vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, m_ApplyPipelineLayout, 0, _countof(sets), sets, 0, nullptr);
 	vkCmdSetViewport(cb, 0, 1, &m_Viewport);
 	vkCmdSetScissor(cb, 0, 1, &m_RectScissor);
 
-	vkCmdDraw(cb, 3, 1, 0, 0);
+	// Only tiles containing reflections are drawn. Clear the rest of the screen when showing the reflection target alone.
+	if (pState->bShowReflectionTarget)
+	{
+		VkClearAttachment clearAttachment = {};
+		clearAttachment.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		clearAttachment.colorAttachment = 0;
+		VkClearRect clearRect = {};
+		clearRect.rect = { { 0, 0 }, { m_Width, m_Height } };
+		clearRect.baseArrayLayer = 0;
+		clearRect.layerCount = 1;
+		vkCmdClearAttachments(cb, 1, &clearAttachment, 1, &clearRect);
+	}
+
+	vkCmdDrawIndirect(cb, m_Sssr.GetReflectionTileDrawArgsBuffer(), m_Sssr.GetReflectionTileDrawArgsOffset(), 1, sizeof(VkDrawIndirectCommand));
 
 	m_GPUTimer.GetTimeStamp(cb, "Apply Reflection View");
 	SetPerfMarkerEnd(cb);
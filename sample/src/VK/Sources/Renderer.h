@@ -43,7 +43,15 @@ using namespace SSSR_SAMPLE_VK;
 class Renderer
 {
 public:
-	void OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize);
+	// HalfPrecisionDepthHierarchy stores the depth hierarchy in 16 bit UNORM instead of 32 bit float.
+	// LinearDepthHierarchy stores linear instead of screen space depth. Takes precedence as linear depth does not fit into UNORM.
+	// MaxDepthHierarchyMipLevel is the coarsest mip that is built and traversed. Lower it if the rays never climb that far, see GetDepthHierarchyMipUsage.
+	// FusedDepthDownsample builds the depth hierarchy in the tile classification of SSSR instead of a separate pass. Not available with LinearDepthHierarchy.
+	// BlueNoiseSamplesPerPixel selects the sampler of the blue noise asset that is optimized for this sample count.
+	// SpatiotemporalBlueNoise loads the precomputed STBN.bin instead and only falls back to the sampler if that is missing.
+	// AccumulationSamplesPerPixel enables the offline accumulation mode, which traces this many samples per pixel and frame. Zero disables it.
+	// LowPrecisionHistory stores the depth and normal history of the denoiser in narrower formats.
+	void OnCreate(Device* pDevice, SwapChain* pSwapChain, float FontSize, bool HalfPrecisionDepthHierarchy, bool LinearDepthHierarchy, uint32_t MaxDepthHierarchyMipLevel, bool FusedDepthDownsample, uint32_t BlueNoiseSamplesPerPixel, bool SpatiotemporalBlueNoise, uint32_t AccumulationSamplesPerPixel, bool LowPrecisionHistory, bool SubgroupSizeControlEnabled, bool PipelineCreationFeedbackEnabled);
 	void OnDestroy();
 
 	void OnCreateWindowSizeDependentResources(SwapChain* pSwapChain, uint32_t Width, uint32_t Height);
@@ -58,6 +66,16 @@ public:
 	void AllocateShadowMaps(GLTFCommon* pGLTFCommon);
 
 	const std::vector<TimeStamp>& GetTimingValues() { return m_TimeStamps; }
+	// Number of rays per coarsest depth hierarchy mip their traversal reached, indexed by mip up to GetDepthHierarchyMaxMip.
+	const uint32_t* GetDepthHierarchyMipUsage() const { return m_Sssr.GetMipUsage(); }
+	uint32_t GetDepthHierarchyMaxMip() const { return m_DepthHierarchyFirstMip + m_DepthMipLevelCount - 1; }
+	bool IsAccumulationAvailable() const { return m_bAccumulationAvailable; }
+	// Samples per traced pixel averaged by the accumulation mode since the scene last changed.
+	uint32_t GetAccumulatedSampleCount() const { return m_Sssr.GetAccumulatedSampleCount(); }
+	const SSSR_SAMPLE_COMMON::PipelineCacheStatistics& GetPipelineCacheStatistics() const { return m_Sssr.GetPipelineCacheStatistics(); }
+	// Reflections as written by the effect, before they are applied to the scene. Used by the autotuner to score its candidates.
+	void RequestReflectionsReadback() { m_Sssr.RequestOutputReadback(); }
+	const uint16_t* GetReflectionsReadback(uint32_t* pRowPitch) const { return m_Sssr.GetOutputReadback(pRowPitch); }
 
 	void OnRender(const UIState* pState, const Camera& Cam, SwapChain* pSwapChain);
 
@@ -66,8 +84,10 @@ private:
 	void CreateDepthDownsamplePipeline();
 	void StallFrame(float targetFrametime);
 
-	void DownsampleDepthBuffer(VkCommandBuffer cb);
+	void DownsampleDepthBuffer(VkCommandBuffer cb, const Camera& Cam);
 	void RenderScreenSpaceReflections(VkCommandBuffer cb, const Camera& Cam, per_frame* pPerFrame, const UIState* pState);
+	// Advances m_SceneRevision if the lighting differs from the last frame.
+	void UpdateSceneRevision(const per_frame* pPerFrame);
 	void ApplyReflectionTarget(VkCommandBuffer cb, const Camera& Cam, const UIState* pState);
 
 	VkBufferMemoryBarrier BufferBarrier(VkBuffer buffer);
@@ -168,10 +188,25 @@ private:
 	VkImageView                     m_DepthHierarchyDescriptors[13];
 	Texture                         m_DepthHierarchy;
 	VkImageView                     m_DepthHierarchySRV;
+	// Bound to the descriptors past the last mip, so nothing the downsampling could write there lands in a real mip.
+	Texture                         m_DepthHierarchyDummy;
+	VkImageView                     m_DepthHierarchyDummyView;
 	VkBuffer                        m_AtomicCounter;
 	VmaAllocation                   m_AtomicCounterAllocation;
 	VkBufferView                    m_AtomicCounterUAV;
+	// Number of mips stored in m_DepthHierarchy, starting at m_DepthHierarchyFirstMip.
 	UINT                            m_DepthMipLevelCount = 0;
+	UINT                            m_DepthHierarchyFirstMip = 1;
+	UINT                            m_MaxDepthHierarchyMipLevel = DEPTH_HIERARCHY_MAX_MIP_COUNT - 1;
+	bool                            m_bHalfPrecisionDepthHierarchy = false;
+	bool                            m_bLinearDepthHierarchy = false;
+	bool                            m_bFusedDepthDownsample = false;
+	bool                            m_bAccumulationAvailable = false;
+	bool                            m_bLowPrecisionHistory = true;
+	// Passed to SSSR so a still camera does not keep reflections of a scene that was relit or reloaded.
+	uint32_t                        m_SceneRevision = 0;
+	std::vector<uint8_t>            m_Lighting;
+	std::vector<uint8_t>            m_PreviousLighting;
 
 	VkSampler                       m_LinearSampler;
 };
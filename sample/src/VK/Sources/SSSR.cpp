@@ -23,22 +23,101 @@ THE SOFTWARE.
 
 #include "SSSR.h"
 #include <cassert>
+#include <chrono>
+
+// Written next to the executable by BlueNoiseConverter.
+static const char* g_blueNoiseAssetPath = "BlueNoise.bin";
+// Not part of the repository. Created by BlueNoiseConverter --stbn from a precomputed spatiotemporal blue noise texture.
+static const char* g_spatiotemporalBlueNoiseAssetPath = "STBN.bin";
+// Written by the ShaderBlobs target of the build, see Shaders/ShaderPermutations.cmake.
+static const char* g_shaderBlobDirectory = "ShaderBlobsVK";
+// Written on exit, so the next run creates its pipelines without compiling them in the driver.
+static const char* g_pipelineCachePath = "SSSRPipelineCacheVK.bin";
+// Size of the upload heap used for the blue noise tables. The slices of the spatiotemporal blue noise are added on top.
+static const size_t g_uploadHeapSize = 1024 * 1024;
+// Alignment of every suballocation from the upload heap.
+static const size_t g_uploadAlignment = 512;
 
-namespace _1spp
-{
-#include "../../../samplerCPP/samplerBlueNoiseErrorDistribution_128x128_OptimizedFor_2d2d2d2d_1spp.cpp"
-}
+/**
+	Names and shader defines of the intersection pass permutations, indexed by tile class.
+*/
+static const char* g_tileClassNames[] = { "Mirror", "Glossy", "Rough" };
+static const char* g_tileClassDefines[] = { "TILE_CLASS_MIRROR", "TILE_CLASS_GLOSSY", "TILE_CLASS_ROUGH" };
+
+/**
+	Byte offset of the denoiser dispatch arguments. They follow the intersection arguments of every tile class.
+*/
+static const uint32_t g_denoiserIndirectArgsOffset = SSSR_SAMPLE_VK::TILE_CLASS_COUNT * sizeof(VkDispatchIndirectCommand);
+
+/**
+	Byte offset of the environment map dispatch arguments. They follow the denoiser arguments.
+*/
+static const uint32_t g_environmentMapIndirectArgsOffset = g_denoiserIndirectArgsOffset + sizeof(VkDispatchIndirectCommand);
+
+/**
+	Byte offset of the draw arguments covering the tiles that contain reflections. They follow the environment map arguments.
+*/
+static const uint32_t g_reflectionTileDrawArgsOffset = g_environmentMapIndirectArgsOffset + sizeof(VkDispatchIndirectCommand);
+
+/**
+	Byte offset of the prefilter dispatch arguments covering the tiles that still need the spatial filter. They follow the reflection tile draw arguments.
+*/
+static const uint32_t g_spatialFilterIndirectArgsOffset = g_reflectionTileDrawArgsOffset + sizeof(VkDrawIndirectCommand);
+
+/**
+	Byte offset of the prefilter pass through arguments covering the converged tiles. They follow the spatial filter arguments.
+*/
+static const uint32_t g_convergedIndirectArgsOffset = g_spatialFilterIndirectArgsOffset + sizeof(VkDispatchIndirectCommand);
+
+/**
+	Byte offset of the mip usage counters in the ray counter buffer. They follow the tile and pixel counters, see Common.hlsl.
+*/
+static const uint32_t g_mipUsageCounterOffset = (2 * SSSR_SAMPLE_VK::TILE_CLASS_COUNT + 10) * sizeof(uint32_t);
+
+/**
+	Options of the constant buffer that can be compiled into the permutations of a pass. A permutation key holds one bit per option,
+	except for the samples per quad that take two bits (0: 1, 1: 2, 2: 4 samples per quad).
+*/
+static const uint32_t g_permutationSamplesPerQuad = 0x3;
+static const uint32_t g_permutationTemporalVarianceGuidedTracing = 1 << 2;
+static const uint32_t g_permutationApplyReflectionsInResolve = 1 << 3;
+static const uint32_t g_permutationConvergedRaySkipping = 1 << 4;
+static const uint32_t g_permutationMipUsageStatistics = 1 << 5;
+
+/**
+	Options read by the tile classification and the intersection passes respectively.
+*/
+static const uint32_t g_classifyTilesPermutationMask = g_permutationSamplesPerQuad | g_permutationTemporalVarianceGuidedTracing | g_permutationApplyReflectionsInResolve | g_permutationConvergedRaySkipping;
+static const uint32_t g_intersectPermutationMask = g_permutationMipUsageStatistics;
+
+/**
+	Wave widths the tile classification and the intersection passes are written for, see SSSR::GetWaveSize. Must match ShaderPermutations.cmake.
+	The traversal loop of the intersection diverges a lot, so narrow waves retire their finished lanes sooner.
+	The tile classification appends its rays per wave, so wide waves need fewer atomics on the ray counters.
+*/
+static const uint32_t g_intersectWaveSize = 32;
+static const uint32_t g_classifyTilesWaveSize = 64;
+
+/**
+	Number of frames with unchanged inputs before the output is reused. Gives the history time to accumulate its samples.
+*/
+static const uint32_t g_staticFramesBeforeReuse = 32;
 
 /**
-	The available blue noise sampler with 2ssp sampling mode.
+	Checks if two frames have the same inputs. Only the view matrix is compared as the projection matrices change with the TAA jitter every frame.
 */
-struct
+static bool HasSameInputs(const SSSR_SAMPLE_VK::SSSRConstants& lhs, const SSSR_SAMPLE_VK::SSSRConstants& rhs)
 {
-	std::int32_t const (&m_sobolBuffer)[256 * 256];
-	std::int32_t const (&m_rankingTileBuffer)[128 * 128 * 8];
-	std::int32_t const (&scramblingTileBuffer)[128 * 128 * 8];
+	const size_t parametersBegin = offsetof(SSSR_SAMPLE_VK::SSSRConstants, bufferDimensions);
+	const size_t frameIndexBegin = offsetof(SSSR_SAMPLE_VK::SSSRConstants, frameIndex);
+	const size_t frameIndexEnd = frameIndexBegin + sizeof(lhs.frameIndex);
+	const size_t parametersEnd = offsetof(SSSR_SAMPLE_VK::SSSRConstants, maxTraversalMip) + sizeof(lhs.maxTraversalMip);
+	const char* pLhs = reinterpret_cast<const char*>(&lhs);
+	const char* pRhs = reinterpret_cast<const char*>(&rhs);
+	return memcmp(&lhs.view, &rhs.view, sizeof(lhs.view)) == 0
+		&& memcmp(pLhs + parametersBegin, pRhs + parametersBegin, frameIndexBegin - parametersBegin) == 0
+		&& memcmp(pLhs + frameIndexEnd, pRhs + frameIndexEnd, parametersEnd - frameIndexEnd) == 0;
 }
-const g_blueNoiseSamplerState = { _1spp::sobol_256spp_256d,  _1spp::rankingTile,  _1spp::scramblingTile };
 
 VkDescriptorSetLayoutBinding Bind(uint32_t binding, VkDescriptorType type)
 {
@@ -88,7 +167,7 @@ void SetDescriptorSetBuffer(VkDevice device, uint32_t index, VkBufferView buffer
 	vkUpdateDescriptorSets(device, 1, &write_set, 0, NULL);
 };
 
-void SetDescriptorSet(VkDevice device, uint32_t index, VkImageView imageView, VkDescriptorSet descriptorSet, VkDescriptorType type, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL)
+void SetDescriptorSet(VkDevice device, uint32_t index, VkImageView imageView, VkDescriptorSet descriptorSet, VkDescriptorType type, VkImageLayout layout = VK_IMAGE_LAYOUT_GENERAL, uint32_t arrayElement = 0)
 {
 	VkDescriptorImageInfo desc_image;
 	desc_image.sampler = VK_NULL_HANDLE;
@@ -104,7 +183,7 @@ void SetDescriptorSet(VkDevice device, uint32_t index, VkImageView imageView, Vk
 	write.descriptorType = type;
 	write.pImageInfo = &desc_image;
 	write.dstBinding = index;
-	write.dstArrayElement = 0;
+	write.dstArrayElement = arrayElement;
 
 	vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
 }
@@ -130,32 +209,100 @@ void SetDescriptorSetSampler(VkDevice device, uint32_t index, VkSampler sampler,
 	vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
 }
 
-void CopyToTexture(VkCommandBuffer cb, VkImage source, VkImage target, uint32_t width, uint32_t height)
+/**
+	Builds the permutation key of all options from the constants of a frame.
+*/
+static uint32_t GetPermutationKey(const SSSR_SAMPLE_VK::SSSRConstants& constants)
+{
+	uint32_t key = constants.samplesPerQuad >= 4 ? 2 : constants.samplesPerQuad >= 2 ? 1 : 0;
+	key |= constants.temporalVarianceGuidedTracingEnabled ? g_permutationTemporalVarianceGuidedTracing : 0;
+	key |= constants.applyReflectionsInResolve ? g_permutationApplyReflectionsInResolve : 0;
+	key |= constants.convergedRaySkippingEnabled ? g_permutationConvergedRaySkipping : 0;
+	key |= constants.mipUsageStatisticsEnabled ? g_permutationMipUsageStatistics : 0;
+	return key;
+}
+
+/**
+	Adds the defines of the options in mask, see Common.hlsl. The shaders read the remaining options from the constant buffer.
+*/
+static void AddPermutationDefines(uint32_t key, uint32_t mask, DefineList& defines)
+{
+	if (mask & g_permutationSamplesPerQuad)
+	{
+		defines["SAMPLES_PER_QUAD"] = std::to_string(1u << (key & g_permutationSamplesPerQuad));
+	}
+	if (mask & g_permutationTemporalVarianceGuidedTracing)
+	{
+		defines["TEMPORAL_VARIANCE_GUIDED_TRACING_ENABLED"] = (key & g_permutationTemporalVarianceGuidedTracing) ? "1" : "0";
+	}
+	if (mask & g_permutationApplyReflectionsInResolve)
+	{
+		defines["APPLY_REFLECTIONS_IN_RESOLVE"] = (key & g_permutationApplyReflectionsInResolve) ? "1" : "0";
+	}
+	if (mask & g_permutationConvergedRaySkipping)
+	{
+		defines["CONVERGED_RAY_SKIPPING_ENABLED"] = (key & g_permutationConvergedRaySkipping) ? "1" : "0";
+	}
+	if (mask & g_permutationMipUsageStatistics)
+	{
+		defines["MIP_USAGE_STATISTICS_ENABLED"] = (key & g_permutationMipUsageStatistics) ? "1" : "0";
+	}
+}
+
+using SSSR_SAMPLE_COMMON::BarrierPhase;
+using SSSR_SAMPLE_COMMON::RenderGraph;
+using SSSR_SAMPLE_COMMON::RenderGraphBarrier;
+using SSSR_SAMPLE_COMMON::ResourceState;
+
+/**
+	Image layout, accesses and pipeline stages of a render graph resource state. Buffers ignore the layout.
+*/
+struct ResourceStateInfo
+{
+	VkImageLayout layout;
+	VkAccessFlags accessMask;
+	VkPipelineStageFlags stageMask;
+};
+
+static ResourceStateInfo GetResourceStateInfo(ResourceState state)
 {
-	VkImageCopy region = {};
-	region.dstOffset = { 0, 0, 0 };
-	region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.dstSubresource.baseArrayLayer = 0;
-	region.dstSubresource.layerCount = 1;
-	region.dstSubresource.mipLevel = 0;
-	region.extent = { width, height, 1 };
-	region.srcOffset = { 0, 0, 0 };
-	region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.srcSubresource.baseArrayLayer = 0;
-	region.srcSubresource.layerCount = 1;
-	region.srcSubresource.mipLevel = 0;
-	vkCmdCopyImage(cb, source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, target, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	switch (state)
+	{
+	case ResourceState::ShaderResource:
+		return { VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+	case ResourceState::UnorderedAccess:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT };
+	case ResourceState::IndirectArgument:
+		return { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT };
+	case ResourceState::CopySource:
+		return { VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+	case ResourceState::CopyDestination:
+		return { VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT };
+	}
+	assert(false);
+	return { VK_IMAGE_LAYOUT_GENERAL, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
 }
 
+/**
+	Only writes have to be made available to later accesses. The other hazards are covered by the execution dependency.
+*/
+static const VkAccessFlags g_writeAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
 using namespace CAULDRON_VK;
 namespace SSSR_SAMPLE_VK
 {
-	void SSSR::OnCreate(Device* pDevice, VkCommandBuffer commandBuffer, ResourceViewHeaps* resourceHeap, DynamicBufferRing* constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters)
+	void SSSR::OnCreate(Device* pDevice, VkCommandBuffer commandBuffer, ResourceViewHeaps* resourceHeap, DynamicBufferRing* constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters, bool linearDepthHierarchy, bool halfPrecisionDepthHierarchy, bool fusedDepthDownsample, uint32_t blueNoiseSamplesPerPixel, bool spatiotemporalBlueNoise, uint32_t accumulationSamplesPerPixel, bool subgroupSizeControlEnabled, bool pipelineCreationFeedbackEnabled, AsyncPool* pAsyncPool)
 	{
 		m_pDevice = pDevice;
+		m_pAsyncPool = pAsyncPool;
 		m_pConstantBufferRing = constantBufferRing;
 		m_pResourceViewHeaps = resourceHeap;
 		m_frameCountBeforeReuse = frameCountBeforeReuse;
+		m_linearDepthHierarchy = linearDepthHierarchy;
+		m_halfPrecisionDepthHierarchy = halfPrecisionDepthHierarchy;
+		m_fusedDepthDownsample = fusedDepthDownsample;
+		// The tile classification reads mip 0 of a linear hierarchy, so it cannot build it at the same time.
+		assert(!(fusedDepthDownsample && linearDepthHierarchy));
 
 		VkPhysicalDevice physicalDevice = m_pDevice->GetPhysicalDevice();
 		VkDevice device = m_pDevice->GetDevice();
@@ -173,8 +320,48 @@ namespace SSSR_SAMPLE_VK
 		m_isSubgroupSizeControlExtensionAvailable = std::find_if(deviceExtensionProperties.begin(), deviceExtensionProperties.end(),
 			[](const VkExtensionProperties& extensionProps) -> bool { return strcmp(extensionProps.extensionName, VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME) == 0; })
 			!= deviceExtensionProperties.end();
+		// Chaining the feedback is only valid if the device was created with the extension enabled.
+		m_isPipelineCreationFeedbackEnabled = pipelineCreationFeedbackEnabled && std::find_if(deviceExtensionProperties.begin(), deviceExtensionProperties.end(),
+			[](const VkExtensionProperties& extensionProps) -> bool { return strcmp(extensionProps.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0; })
+			!= deviceExtensionProperties.end();
+
+		// The extension and its features also have to be enabled at device creation. Cauldron creates the device, so only the application knows if it did.
+		// Otherwise no pass requires a subgroup size and the driver picks the wave width of every pass.
+		if (subgroupSizeControlEnabled && m_isSubgroupSizeControlExtensionAvailable)
+		{
+			VkPhysicalDeviceSubgroupSizeControlFeaturesEXT subgroupSizeControlFeatures = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES_EXT };
+			subgroupSizeControlFeatures.pNext = nullptr;
+			VkPhysicalDeviceFeatures2 features = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+			features.pNext = &subgroupSizeControlFeatures;
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+			VkPhysicalDeviceSubgroupSizeControlPropertiesEXT subgroupSizeControlProperties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES_EXT };
+			subgroupSizeControlProperties.pNext = nullptr;
+			VkPhysicalDeviceProperties2 properties = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+			properties.pNext = &subgroupSizeControlProperties;
+			vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+			if (subgroupSizeControlFeatures.subgroupSizeControl && (subgroupSizeControlProperties.requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT))
+			{
+				m_minSubgroupSize = subgroupSizeControlProperties.minSubgroupSize;
+				m_maxSubgroupSize = subgroupSizeControlProperties.maxSubgroupSize;
+			}
+			m_isComputeFullSubgroupsSupported = subgroupSizeControlFeatures.computeFullSubgroups == VK_TRUE;
+		}
 
-		m_uploadHeap.OnCreate(m_pDevice, 1024 * 1024);
+		{
+			Profile p("SSSR - Open pipeline cache and shaders");
+			CreatePipelineCache();
+			if (!m_shaderBlobs.Open(g_shaderBlobDirectory))
+			{
+				Trace("No precompiled shaders in %s, compiling them at runtime", g_shaderBlobDirectory);
+			}
+		}
+		// All uploads of OnCreate have to fit at once. Otherwise the heap would flush and wait for the GPU in the middle of them.
+		SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset spatiotemporalBlueNoiseAsset;
+		size_t spatiotemporalBlueNoiseUploadSize = 0;
+		spatiotemporalBlueNoise = spatiotemporalBlueNoise && OpenSpatiotemporalBlueNoiseAsset(spatiotemporalBlueNoiseAsset, &spatiotemporalBlueNoiseUploadSize);
+		m_uploadHeap.OnCreate(m_pDevice, g_uploadHeapSize + spatiotemporalBlueNoiseUploadSize);
 
 		VkDescriptorSetLayoutBinding layoutBinding = {};
 		layoutBinding.binding = 0;
@@ -198,14 +385,111 @@ namespace SSSR_SAMPLE_VK
 			assert(bAllocDescriptor == true);
 		}
 
-		CreateResources(commandBuffer);
-		SetupClassifyTilesPass();
-		SetupBlueNoisePass();
-		SetupPrepareIndirectArgsPass();
-		SetupIntersectionPass();
-		SetupResolveTemporalPass();
-		SetupReprojectPass();
-		SetupPrefilterPass();
+		// From here on the pipelines are compiled on the async pool and the uploads are only recorded.
+		// WaitForCreation submits them in one go, so nothing below waits for the GPU.
+		m_creationPending = true;
+
+		// The accumulation passes are compiled for the sample count of the sampler that is actually available.
+		if (accumulationSamplesPerPixel > 0)
+		{
+			Profile p("SSSR - Accumulation noise");
+			m_accumulationSamplesPerPixel = BakeBlueNoiseTexture(m_accumulationNoiseTexture, accumulationSamplesPerPixel, true);
+		}
+
+		{
+			Profile p("SSSR - Create resources");
+			CreateResources(commandBuffer);
+		}
+		{
+			Profile p("SSSR - Setup passes");
+			SetupClassifyTilesPass();
+			SetupPrepareIndirectArgsPass();
+			SetupPreparePrefilterArgsPass();
+			SetupIntersectionPass();
+			SetupEnvironmentMapPass();
+			SetupResolveTemporalPass();
+			SetupReprojectPass();
+			SetupPrefilterPass();
+			SetupFusedDenoiserPass();
+			SetupCopyDenoiserTilesPass();
+		}
+		{
+			Profile p("SSSR - Blue noise");
+			if (spatiotemporalBlueNoise)
+			{
+				LoadSpatiotemporalBlueNoiseTexture(spatiotemporalBlueNoiseAsset);
+			}
+			else
+			{
+				BakeBlueNoiseTexture(m_blueNoiseTexture, blueNoiseSamplesPerPixel, false);
+			}
+		}
+	}
+
+	void SSSR::WaitForCreation()
+	{
+		if (!m_creationPending)
+		{
+			return;
+		}
+		m_creationPending = false;
+
+		{
+			Profile p("SSSR - Wait for pipelines");
+			m_pipelineSync.Wait();
+		}
+
+		Profile p("SSSR - Upload");
+		VkDevice device = m_pDevice->GetDevice();
+		VkCommandBuffer commandBuffer = m_uploadHeap.GetCommandList();
+		m_uploadHeap.RecordCopies();
+
+		// The post barriers of the upload heap only cover the fragment stage, so the transitions for the compute passes are recorded here.
+		std::vector<VkImageMemoryBarrier> barriers;
+		if (m_spatiotemporalBlueNoisePending)
+		{
+			VkImageMemoryBarrier barrier = m_blueNoiseTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barriers.push_back(barrier);
+			m_spatiotemporalBlueNoisePending = false;
+		}
+		for (uint32_t i = 0; i < m_blueNoiseBakeCount; ++i)
+		{
+			VkImageMemoryBarrier barrier = m_blueNoiseBakes[i].pTexture->Transition(VK_IMAGE_LAYOUT_GENERAL);
+			barrier.srcAccessMask = 0;
+			barriers.push_back(barrier);
+		}
+		VkMemoryBarrier memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		memoryBarrier.pNext = nullptr;
+		memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		memoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &memoryBarrier, 0, nullptr, (uint32_t)barriers.size(), barriers.data());
+
+		// The passes do not read the constants, so only their own set is bound.
+		barriers.clear();
+		for (uint32_t i = 0; i < m_blueNoiseBakeCount; ++i)
+		{
+			BlueNoiseBake& bake = m_blueNoiseBakes[i];
+			SetPerfMarkerBegin(commandBuffer, "FFX DNSR PrepareBlueNoise");
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bake.pass.pipeline);
+			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, bake.pass.pipelineLayout, 1, 1, &bake.pass.descriptorSets[0], 0, nullptr);
+			vkCmdDispatch(commandBuffer, 128u / 8u, 128u / 8u, bake.sliceCount);
+			SetPerfMarkerEnd(commandBuffer);
+			barriers.push_back(bake.pTexture->Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL));
+		}
+		if (!barriers.empty())
+		{
+			TransitionBarriers(commandBuffer, barriers.data(), (uint32_t)barriers.size());
+		}
+		m_uploadHeap.FlushAndFinish();
+
+		// The noise of all frames is baked now. The sampler tables and the passes are not needed anymore.
+		for (uint32_t i = 0; i < m_blueNoiseBakeCount; ++i)
+		{
+			m_blueNoiseBakes[i].pass.OnDestroy(device, m_pResourceViewHeaps);
+			m_blueNoiseBakes[i].sampler.OnDestroy();
+		}
+		m_blueNoiseBakeCount = 0;
 	}
 
 	void SSSR::OnCreateWindowSizeDependentResources(VkCommandBuffer commandBuffer, const SSSRCreationInfo& input)
@@ -214,49 +498,78 @@ namespace SSSR_SAMPLE_VK
 		assert(input.outputHeight != 0);
 		assert(input.DepthHierarchy);
 		assert(input.DepthHierarchyView != VK_NULL_HANDLE);
+		assert(input.DepthBufferView != VK_NULL_HANDLE);
 		assert(input.EnvironmentMapSampler != VK_NULL_HANDLE);
 		assert(input.EnvironmentMapView != VK_NULL_HANDLE);
+		assert(input.HDR);
 		assert(input.HDRView != VK_NULL_HANDLE);
 		assert(input.MotionVectorsView != VK_NULL_HANDLE);
 		assert(input.NormalBuffer);
 		assert(input.NormalBufferView != VK_NULL_HANDLE);
 		assert(input.SpecularRoughnessView != VK_NULL_HANDLE);
+		assert(input.BrdfLutView != VK_NULL_HANDLE);
+		assert(!m_fusedDepthDownsample || input.DepthHierarchyAtomicCounterView != VK_NULL_HANDLE);
 
 		m_outputWidth = input.outputWidth;
 		m_outputHeight = input.outputHeight;
+		m_hdr = input.HDR;
 		m_depthHierarchy = input.DepthHierarchy;
-		m_normalTexture = input.NormalBuffer;
+		m_depthHierarchyMipCount = input.DepthHierarchyMipCount;
+		m_lowPrecisionHistory = input.lowPrecisionHistory;
 
 		CreateWindowSizeDependentResources(commandBuffer);
 		InitializeResourceDescriptorSets(input);
+		AddGraphResources();
 	}
 
 	void SSSR::OnDestroy()
 	{
+		// The pipelines may still be compiling if no frame was drawn.
+		WaitForCreation();
+
 		VkDevice device = m_pDevice->GetDevice();
 		for (size_t i = 0; i < m_frameCountBeforeReuse; i++)
 		{
 			m_pResourceViewHeaps->FreeDescriptor(m_uniformBufferDescriptorSet[i]);
 		}
 		vkDestroyDescriptorSetLayout(device, m_uniformBufferDescriptorSetLayout, nullptr);
+		SavePipelineCache();
 
 		m_classifyTilesPass.OnDestroy(device, m_pResourceViewHeaps);
-		m_blueNoisePass.OnDestroy(device, m_pResourceViewHeaps);
 		m_prepareIndirectArgsPass.OnDestroy(device, m_pResourceViewHeaps);
-		m_intersectPass.OnDestroy(device, m_pResourceViewHeaps);
+		m_preparePrefilterArgsPass.OnDestroy(device, m_pResourceViewHeaps);
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			m_intersectPass[tileClass].OnDestroy(device, m_pResourceViewHeaps);
+			if (m_accumulationSamplesPerPixel > 0)
+			{
+				m_accumulatePass[tileClass].OnDestroy(device, m_pResourceViewHeaps);
+			}
+		}
+		m_environmentMapPass.OnDestroy(device, m_pResourceViewHeaps);
 		m_resolveTemporalPass.OnDestroy(device, m_pResourceViewHeaps);
+		m_resolveTemporalApplyPass.OnDestroy(device, m_pResourceViewHeaps);
 		m_reprojectPass.OnDestroy(device, m_pResourceViewHeaps);
 		m_prefilterPass.OnDestroy(device, m_pResourceViewHeaps);
+		m_prefilterPassThroughPass.OnDestroy(device, m_pResourceViewHeaps);
+		m_fusedDenoiserPass.OnDestroy(device, m_pResourceViewHeaps);
+		m_fusedDenoiserApplyPass.OnDestroy(device, m_pResourceViewHeaps);
+		m_copyDenoiserTilesPass.OnDestroy(device, m_pResourceViewHeaps);
 		m_uploadHeap.OnDestroy();
+		m_shaderBlobs.Close();
 
 		m_rayCounter.OnDestroy();
+		m_mipUsageReadback.OnDestroy();
 		m_intersectionPassIndirectArgs.OnDestroy();
 
 		vkDestroySampler(device, m_linearSampler, nullptr);
 		vkDestroySampler(device, m_previousDepthSampler, nullptr);
 
 		m_blueNoiseTexture.OnDestroy();
-		m_blueNoiseSampler.OnDestroy();
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			m_accumulationNoiseTexture.OnDestroy();
+		}
 	}
 
 	void SSSR::OnDestroyWindowSizeDependentResources()
@@ -265,28 +578,88 @@ namespace SSSR_SAMPLE_VK
 
 		m_radiance[0].OnDestroy();
 		m_radiance[1].OnDestroy();
-		m_variance[0].OnDestroy();
-		m_variance[1].OnDestroy();
-		m_sampleCount[0].OnDestroy();
-		m_sampleCount[1].OnDestroy();
+		m_varianceSampleCount[0].OnDestroy();
+		m_varianceSampleCount[1].OnDestroy();
 		m_averageRadiance[0].OnDestroy();
 		m_averageRadiance[1].OnDestroy();
 		m_reprojectedRadiance.OnDestroy();
-		m_roughnessTexture.OnDestroy();
-		m_roughnessHistoryTexture.OnDestroy();
-		m_normalHistoryTexture.OnDestroy();
-		m_depthHistoryTexture.OnDestroy();
-		m_rayList.OnDestroy();
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			m_accumulatedRadiance.OnDestroy();
+		}
+		m_roughnessTexture[0].OnDestroy();
+		m_roughnessTexture[1].OnDestroy();
+		m_normalHistoryTexture[0].OnDestroy();
+		m_normalHistoryTexture[1].OnDestroy();
+		m_depthHistoryTexture[0].OnDestroy();
+		m_depthHistoryTexture[1].OnDestroy();
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			m_rayList[tileClass].OnDestroy();
+		}
 		m_denoiserTileList.OnDestroy();
+		m_environmentMapList.OnDestroy();
+		m_reflectionTileList.OnDestroy();
+		m_spatialFilterTileList.OnDestroy();
+		m_convergedTileList.OnDestroy();
+		m_tileHistory.OnDestroy();
+		m_outputReadback.OnDestroy();
+		m_pOutputReadbackData = nullptr;
+		m_outputReadbackPending = false;
+		m_outputReadbackReady = false;
 	}
 
-	void SSSR::Draw(VkCommandBuffer commandBuffer, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult)
+	void SSSR::Draw(VkCommandBuffer commandBuffer, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult, bool useFusedDenoiser, bool isSceneStatic, bool reuseStaticFrames, uint32_t sceneRevision, bool accumulate)
 	{
+		WaitForCreation();
+
+		// The mip usage in this slot was copied m_frameCountBeforeReuse frames ago, so the copy has finished by now.
+		uint32_t readbackIndex = sssrConstants.frameIndex % m_frameCountBeforeReuse;
+		if (m_mipUsageReadbackPending[readbackIndex])
+		{
+			memcpy(m_mipUsage, m_pMipUsageReadbackData + readbackIndex * DEPTH_HIERARCHY_MAX_MIP_COUNT, sizeof(m_mipUsage));
+			m_mipUsageReadbackPending[readbackIndex] = false;
+		}
+		if (m_outputReadbackPending && sssrConstants.frameIndex - m_outputReadbackFrameIndex >= m_frameCountBeforeReuse)
+		{
+			m_outputReadbackPending = false;
+			m_outputReadbackReady = true;
+		}
+
+		// A new scene revision invalidates the last output and the accumulated samples just like changed constants.
+		const bool isSceneUnchanged = isSceneStatic && sceneRevision == m_previousSceneRevision;
+		m_previousSceneRevision = sceneRevision;
+
+		// The accumulation keeps refining a static frame, so it never reuses the last output. Any change starts it over.
+		const bool accumulating = accumulate && m_accumulationSamplesPerPixel > 0;
+		if (accumulating)
+		{
+			if (!isSceneUnchanged || !HasSameInputs(sssrConstants, m_previousConstants))
+			{
+				m_accumulatedBatchCount = 0;
+			}
+			m_previousConstants = sssrConstants;
+			m_staticFrameCount = 0;
+		}
+		else
+		{
+			m_accumulatedBatchCount = 0;
+
+			// Nothing moved for a while. The output of the last frame is still valid.
+			if (IsStaticFrame(sssrConstants, showIntersectResult, reuseStaticFrames && isSceneUnchanged))
+			{
+				return;
+			}
+		}
+
 		SetPerfMarkerBegin(commandBuffer, "FidelityFX SSSR");
 
-		uint32_t bufferIndex = sssrConstants.frameIndex % 2;
+		uint32_t bufferIndex = m_bufferIndex;
 		uint32_t uniformBufferIndex = sssrConstants.frameIndex % m_frameCountBeforeReuse;
 		VkDescriptorSet uniformBufferDescriptorSet = m_uniformBufferDescriptorSet[uniformBufferIndex];
+		// Optionally applies the reflections of the denoised tiles to the lit scene right away.
+		const bool applyReflections = sssrConstants.applyReflectionsInResolve != 0;
+		const GraphResources& resources = m_graphResources;
 
 		// Update descriptor to sliding window in upload buffer that contains the updated pass data
 		{
@@ -305,44 +678,40 @@ namespace SSSR_SAMPLE_VK
 			vkUpdateDescriptorSets(m_pDevice->GetDevice(), 1, &writeSet, 0, nullptr);
 		}
 
-		// Classify Tiles & Prepare Blue Noise Texture 
+		// The passes only declare the resources they access. The render graph places the barriers in between.
+		// Classify Tiles
 		{
-			VkImageMemoryBarrier barriers[] = {
-				m_variance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-				m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_blueNoiseTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
-			};
-			TransitionBarriers(commandBuffer, barriers, _countof(barriers));
-
-			SetPerfMarkerBegin(commandBuffer, "FFX DNSR ClassifyTiles");
-			VkDescriptorSet classifySets[] = { uniformBufferDescriptorSet,  m_classifyTilesPass.descriptorSets[bufferIndex] };
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_classifyTilesPass.pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_classifyTilesPass.pipelineLayout, 0, _countof(classifySets), classifySets, 0, nullptr);
-			uint32_t dim_x = DivideRoundingUp(m_outputWidth, 8u);
-			uint32_t dim_y = DivideRoundingUp(m_outputHeight, 8u);
-			vkCmdDispatch(commandBuffer, dim_x, dim_y, 1);
-			SetPerfMarkerEnd(commandBuffer);
-
-			SetPerfMarkerBegin(commandBuffer, "FFX DNSR PrepareBlueNoise");
-			VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_blueNoisePass.descriptorSets[bufferIndex] };
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_blueNoisePass.pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_blueNoisePass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
-			vkCmdDispatch(commandBuffer, 128u / 8u, 128u / 8u, 1);
-			SetPerfMarkerEnd(commandBuffer);
+			RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+			{
+				SetPerfMarkerBegin(commandBuffer, m_fusedDepthDownsample ? "FFX DNSR ClassifyTiles + Downsample Depth" : "FFX DNSR ClassifyTiles");
+				VkDescriptorSet classifySets[] = { uniformBufferDescriptorSet,  m_classifyTilesPass.descriptorSets[bufferIndex] };
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, GetPipeline(m_classifyTilesPass, sssrConstants));
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_classifyTilesPass.pipelineLayout, 0, _countof(classifySets), classifySets, 0, nullptr);
+				// The fused pass works on the 64x64 regions of the depth downsampling.
+				uint32_t tileSize = m_fusedDepthDownsample ? 64u : 8u;
+				uint32_t dim_x = DivideRoundingUp(m_outputWidth, tileSize);
+				uint32_t dim_y = DivideRoundingUp(m_outputHeight, tileSize);
+				vkCmdDispatch(commandBuffer, dim_x, dim_y, 1);
+				SetPerfMarkerEnd(commandBuffer);
 
-			gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR ClassifyTiles + PrepareBlueNoise");
+				gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR ClassifyTiles");
+			});
+			pass.Read(resources.varianceSampleCount[1 - bufferIndex]).Read(resources.radiance[1 - bufferIndex]);
+			pass.Write(resources.radiance[bufferIndex]).Write(resources.roughness[bufferIndex]).Write(resources.depthHistory[bufferIndex]).Write(resources.normalHistory[bufferIndex]);
+			pass.Write(resources.rayCounter).Write(resources.denoiserTileList).Write(resources.environmentMapList).Write(resources.tileHistory).Write(resources.reflectionTileList);
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+			{
+				pass.Write(resources.rayList[tileClass]);
+			}
+			if (m_fusedDepthDownsample)
+			{
+				pass.Write(resources.depthHierarchy);
+			}
 		}
 
-		// Prepare Indirect Args and Intersection
+		// Prepare Indirect Args
+		m_renderGraph.AddPass([&]()
 		{
-			VkImageMemoryBarrier barriers[] = {
-				m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-				m_blueNoiseTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-				m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-			};
-			TransitionBarriers(commandBuffer, barriers, _countof(barriers));
-
 			SetPerfMarkerBegin(commandBuffer, "FFX SSSR PrepareIndirectArgs");
 			VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_prepareIndirectArgsPass.descriptorSets[bufferIndex] };
 			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prepareIndirectArgsPass.pipeline);
@@ -350,165 +719,289 @@ namespace SSSR_SAMPLE_VK
 			vkCmdDispatch(commandBuffer, 1, 1, 1);
 			SetPerfMarkerEnd(commandBuffer);
 			gpuTimer.GetTimeStamp(commandBuffer, "FFX SSSR PrepareIndirectArgs");
+		}).Write(resources.rayCounter).Write(resources.intersectionPassIndirectArgs);
 
-			// Ensure that the arguments are written
-			IndirectArgumentsBarrier(commandBuffer);
-
-			SetPerfMarkerBegin(commandBuffer, "FFX SSSR Intersection");
-			VkDescriptorSet intersectionSets[] = { uniformBufferDescriptorSet,  m_intersectPass.descriptorSets[bufferIndex] };
-			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_intersectPass.pipeline);
-			vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_intersectPass.pipelineLayout, 0, _countof(intersectionSets), intersectionSets, 0, nullptr);
-			vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, 0);
-			SetPerfMarkerEnd(commandBuffer);
-			gpuTimer.GetTimeStamp(commandBuffer, "FFX SSSR Intersection");
-		}
-
-		if (showIntersectResult)
+		if (accumulating)
 		{
-			// Ensure that the intersection pass finished
+			if (m_accumulatedBatchCount == 0)
 			{
-				VkImageMemoryBarrier barriers[] = {
-					m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-				};
-				TransitionBarriers(commandBuffer, barriers, _countof(barriers));
+				m_renderGraph.AddPass([&]()
+				{
+					VkClearColorValue clearValue = {};
+					VkImageSubresourceRange subresourceRange = {};
+					subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+					subresourceRange.baseArrayLayer = 0;
+					subresourceRange.layerCount = 1;
+					subresourceRange.baseMipLevel = 0;
+					subresourceRange.levelCount = 1;
+					vkCmdClearColorImage(commandBuffer, m_accumulatedRadiance.Resource(), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &subresourceRange);
+				}).Write(resources.accumulatedRadiance, ResourceState::CopyDestination);
 			}
+			++m_accumulatedBatchCount;
 		}
-		else
-		{
-			uint32_t num_tilesX = DivideRoundingUp(m_outputWidth, 8u);
-			uint32_t num_tilesY = DivideRoundingUp(m_outputHeight, 8u);
 
-			// Reproject pass
+		// Intersection
+		{
+			RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
 			{
-				VkImageMemoryBarrier barriers[] = {
-					m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_depthHistoryTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_roughnessHistoryTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_normalHistoryTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_radiance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_averageRadiance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_variance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_sampleCount[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_blueNoiseTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_reprojectedRadiance.Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_averageRadiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_variance[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_sampleCount[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				};
-				TransitionBarriers(commandBuffer, barriers, _countof(barriers));
-
-				SetPerfMarkerBegin(commandBuffer, "FFX DNSR Reproject");
-				VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_reprojectPass.descriptorSets[bufferIndex] };
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reprojectPass.pipeline);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reprojectPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
-				vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, 12);
+				// One specialized dispatch per tile class. The passes write disjoint pixels, so no barriers are needed in between.
+				SetPerfMarkerBegin(commandBuffer, accumulating ? "FFX SSSR Accumulation" : "FFX SSSR Intersection");
+				for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+				{
+					ShaderPass& intersectPass = accumulating ? m_accumulatePass[tileClass] : m_intersectPass[tileClass];
+					SetPerfMarkerBegin(commandBuffer, g_tileClassNames[tileClass]);
+					VkDescriptorSet intersectionSets[] = { uniformBufferDescriptorSet,  intersectPass.descriptorSets[bufferIndex] };
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, GetPipeline(intersectPass, sssrConstants));
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, intersectPass.pipelineLayout, 0, _countof(intersectionSets), intersectionSets, 0, nullptr);
+					vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, tileClass * sizeof(VkDispatchIndirectCommand));
+					SetPerfMarkerEnd(commandBuffer);
+				}
 				SetPerfMarkerEnd(commandBuffer);
-				gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Reproject");
-			}
-
-			// Prefilter pass
-			{
-				VkImageMemoryBarrier barriers[] = {
-					m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_averageRadiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_variance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_sampleCount[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-
-					m_radiance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_variance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_sampleCount[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				};
-				TransitionBarriers(commandBuffer, barriers, _countof(barriers));
-
-				SetPerfMarkerBegin(commandBuffer, "FFX DNSR Prefilter");
-				VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_prefilterPass.descriptorSets[bufferIndex] };
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prefilterPass.pipeline);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prefilterPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
-				vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, 12);
+				gpuTimer.GetTimeStamp(commandBuffer, "FFX SSSR Intersection");
+
+				// Writes the pixels that are too rough to be traced. These are disjoint from the intersection results.
+				SetPerfMarkerBegin(commandBuffer, "FFX SSSR EnvironmentMap");
+				VkDescriptorSet environmentMapSets[] = { uniformBufferDescriptorSet,  m_environmentMapPass.descriptorSets[bufferIndex] };
+				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_environmentMapPass.pipeline);
+				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_environmentMapPass.pipelineLayout, 0, _countof(environmentMapSets), environmentMapSets, 0, nullptr);
+				vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_environmentMapIndirectArgsOffset);
 				SetPerfMarkerEnd(commandBuffer);
-				gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Prefilter");
+				gpuTimer.GetTimeStamp(commandBuffer, "FFX SSSR EnvironmentMap");
+			});
+			pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument);
+			pass.Read(resources.hdr).Read(resources.depthHierarchy).Read(resources.roughness[bufferIndex]).Read(resources.environmentMapList);
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+			{
+				pass.Read(resources.rayList[tileClass]);
 			}
-
-			// Temporal resolve pass
+			pass.Write(resources.radiance[bufferIndex]).Write(resources.rayCounter);
+			if (accumulating)
 			{
-				VkImageMemoryBarrier barriers[] = {
-					m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_averageRadiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_radiance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_reprojectedRadiance.Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_variance[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_sampleCount[1 - bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					
-					m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_variance[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-					m_sampleCount[bufferIndex].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				};
-				TransitionBarriers(commandBuffer, barriers, _countof(barriers));
-
-				SetPerfMarkerBegin(commandBuffer, "FFX DNSR Resolve Temporal");
-				VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_resolveTemporalPass.descriptorSets[bufferIndex] };
-				vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolveTemporalPass.pipeline);
-				vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolveTemporalPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
-				vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, 12);
-				SetPerfMarkerEnd(commandBuffer);
-				gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Resolve Temporal");
+				pass.Write(resources.accumulatedRadiance);
 			}
+		}
 
-			// Ensure that the temporal resolve pass finished
+		// The accumulated samples already converged, so they skip the denoiser just like the raw intersection results.
+		if (!showIntersectResult && !accumulating)
+		{
+			if (useFusedDenoiser)
 			{
-				VkImageMemoryBarrier barriers[] = {
-					m_radiance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_variance[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					m_sampleCount[bufferIndex].Transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-				};
-				TransitionBarriers(commandBuffer, barriers, _countof(barriers));
-			}
+				// Reprojection, spatial filter and temporal resolve in a single pass. The intermediate results never leave groupshared memory.
+				{
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						ShaderPass& fusedDenoiserPass = applyReflections ? m_fusedDenoiserApplyPass : m_fusedDenoiserPass;
+						SetPerfMarkerBegin(commandBuffer, "FFX DNSR Fused Denoiser");
+						VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  fusedDenoiserPass.descriptorSets[bufferIndex] };
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, fusedDenoiserPass.pipeline);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, fusedDenoiserPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+						vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_denoiserIndirectArgsOffset);
+						SetPerfMarkerEnd(commandBuffer);
+						gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Fused Denoiser");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList);
+					pass.Read(resources.roughness[bufferIndex]).Read(resources.roughness[1 - bufferIndex]).Read(resources.depthHistory[1 - bufferIndex]).Read(resources.normalHistory[1 - bufferIndex]);
+					pass.Read(resources.radiance[bufferIndex]).Read(resources.radiance[1 - bufferIndex]).Read(resources.varianceSampleCount[1 - bufferIndex]);
+					pass.Write(resources.reprojectedRadiance).Write(resources.averageRadiance[bufferIndex]).Write(resources.varianceSampleCount[bufferIndex]);
+					if (applyReflections)
+					{
+						pass.Write(resources.hdr);
+					}
+				}
 
-			// Optional depth copy to keep the depth buffer for the next frame. Skip this if your engine already keeps a copy around.
+				// Copy the denoised tiles over the intersection results
+				m_renderGraph.AddPass([&]()
+				{
+					SetPerfMarkerBegin(commandBuffer, "FFX DNSR Copy Denoiser Tiles");
+					VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_copyDenoiserTilesPass.descriptorSets[bufferIndex] };
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_copyDenoiserTilesPass.pipeline);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_copyDenoiserTilesPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+					vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_denoiserIndirectArgsOffset);
+					SetPerfMarkerEnd(commandBuffer);
+					gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Copy Denoiser Tiles");
+				}).Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList).Read(resources.reprojectedRadiance).Write(resources.radiance[bufferIndex]);
+			}
+			else
 			{
-				assert(m_depthHierarchy);
-				assert(m_normalTexture);
+				// Reproject pass
 				{
-					VkImageMemoryBarrier barriers[] = {
-						m_depthHistoryTexture.Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
-						Transition(m_depthHierarchy->Resource(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
-						m_normalHistoryTexture.Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
-						Transition(m_normalTexture->Resource(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
-						m_roughnessHistoryTexture.Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
-						m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
-					};
-					TransitionBarriers(commandBuffer, barriers, _countof(barriers));
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						SetPerfMarkerBegin(commandBuffer, "FFX DNSR Reproject");
+						VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_reprojectPass.descriptorSets[bufferIndex] };
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reprojectPass.pipeline);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_reprojectPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+						vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_denoiserIndirectArgsOffset);
+						SetPerfMarkerEnd(commandBuffer);
+						gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Reproject");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList);
+					pass.Read(resources.roughness[bufferIndex]).Read(resources.roughness[1 - bufferIndex]).Read(resources.depthHistory[1 - bufferIndex]).Read(resources.normalHistory[1 - bufferIndex]);
+					pass.Read(resources.radiance[bufferIndex]).Read(resources.radiance[1 - bufferIndex]).Read(resources.averageRadiance[1 - bufferIndex]).Read(resources.varianceSampleCount[1 - bufferIndex]);
+					pass.Write(resources.reprojectedRadiance).Write(resources.averageRadiance[bufferIndex]).Write(resources.varianceSampleCount[bufferIndex]);
+					pass.Write(resources.rayCounter).Write(resources.spatialFilterTileList).Write(resources.convergedTileList);
 				}
 
-				CopyToTexture(commandBuffer, m_depthHierarchy->Resource(), m_depthHistoryTexture.Resource(), m_outputWidth, m_outputHeight);
-				CopyToTexture(commandBuffer, m_normalTexture->Resource(), m_normalHistoryTexture.Resource(), m_outputWidth, m_outputHeight);
-				CopyToTexture(commandBuffer, m_roughnessTexture.Resource(), m_roughnessHistoryTexture.Resource(), m_outputWidth, m_outputHeight);
+				// Prepare the prefilter args from the tiles the reprojection split by their convergence
+				m_renderGraph.AddPass([&]()
+				{
+					SetPerfMarkerBegin(commandBuffer, "FFX DNSR PreparePrefilterArgs");
+					VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_preparePrefilterArgsPass.descriptorSets[bufferIndex] };
+					vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_preparePrefilterArgsPass.pipeline);
+					vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_preparePrefilterArgsPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+					vkCmdDispatch(commandBuffer, 1, 1, 1);
+					SetPerfMarkerEnd(commandBuffer);
+				}).Write(resources.rayCounter).Write(resources.intersectionPassIndirectArgs);
+
+				// Prefilter pass
+				{
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						// Converged tiles only forward their inputs. Both passes write disjoint tiles, so no barrier is needed in between.
+						SetPerfMarkerBegin(commandBuffer, "FFX DNSR Prefilter");
+						VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  m_prefilterPass.descriptorSets[bufferIndex] };
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prefilterPass.pipeline);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prefilterPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+						vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_spatialFilterIndirectArgsOffset);
+
+						sets[1] = m_prefilterPassThroughPass.descriptorSets[bufferIndex];
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prefilterPassThroughPass.pipeline);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_prefilterPassThroughPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+						vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_convergedIndirectArgsOffset);
+						SetPerfMarkerEnd(commandBuffer);
+						gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Prefilter");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.spatialFilterTileList).Read(resources.convergedTileList);
+					pass.Read(resources.roughness[bufferIndex]).Read(resources.averageRadiance[bufferIndex]).Read(resources.radiance[bufferIndex]).Read(resources.varianceSampleCount[bufferIndex]);
+					pass.Write(resources.radiance[1 - bufferIndex]).Write(resources.varianceSampleCount[1 - bufferIndex]);
+				}
 
+				// Temporal resolve pass
 				{
-					VkImageMemoryBarrier barriers[] = {
-						Transition(m_depthHierarchy->Resource(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-						Transition(m_normalTexture->Resource(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
-					};
-					TransitionBarriers(commandBuffer, barriers, _countof(barriers));
+					RenderGraph::Pass& pass = m_renderGraph.AddPass([&]()
+					{
+						ShaderPass& resolveTemporalPass = applyReflections ? m_resolveTemporalApplyPass : m_resolveTemporalPass;
+						SetPerfMarkerBegin(commandBuffer, "FFX DNSR Resolve Temporal");
+						VkDescriptorSet sets[] = { uniformBufferDescriptorSet,  resolveTemporalPass.descriptorSets[bufferIndex] };
+						vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolveTemporalPass.pipeline);
+						vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, resolveTemporalPass.pipelineLayout, 0, _countof(sets), sets, 0, nullptr);
+						vkCmdDispatchIndirect(commandBuffer, m_intersectionPassIndirectArgs.m_buffer, g_denoiserIndirectArgsOffset);
+						SetPerfMarkerEnd(commandBuffer);
+						gpuTimer.GetTimeStamp(commandBuffer, "FFX DNSR Resolve Temporal");
+					});
+					pass.Read(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument).Read(resources.denoiserTileList);
+					pass.Read(resources.roughness[bufferIndex]).Read(resources.averageRadiance[bufferIndex]).Read(resources.radiance[1 - bufferIndex]).Read(resources.reprojectedRadiance).Read(resources.varianceSampleCount[1 - bufferIndex]);
+					pass.Write(resources.radiance[bufferIndex]).Write(resources.varianceSampleCount[bufferIndex]);
+					if (applyReflections)
+					{
+						pass.Write(resources.hdr);
+					}
 				}
 			}
 		}
 
+		if (sssrConstants.mipUsageStatisticsEnabled)
+		{
+			m_renderGraph.AddPass([&]()
+			{
+				CopyMipUsage(commandBuffer, readbackIndex);
+			}).Read(resources.rayCounter, ResourceState::CopySource);
+		}
+
+		if (m_outputReadbackRequested)
+		{
+			m_renderGraph.AddPass([&]()
+			{
+				CopyOutput(commandBuffer, bufferIndex, sssrConstants.frameIndex);
+			}).Read(resources.radiance[bufferIndex], ResourceState::CopySource);
+		}
+
+		// The output is sampled and the reflection tiles are drawn by the caller. The lit scene and the depth hierarchy go back
+		// in the layouts the application handed them over in, and the ray counter in the one the next frame expects.
+		m_renderGraph.Export(resources.radiance[bufferIndex], ResourceState::ShaderResource);
+		m_renderGraph.Export(resources.reflectionTileList, ResourceState::ShaderResource);
+		m_renderGraph.Export(resources.intersectionPassIndirectArgs, ResourceState::IndirectArgument);
+		m_renderGraph.Export(resources.rayCounter, ResourceState::UnorderedAccess);
+		m_renderGraph.Export(resources.hdr, ResourceState::ShaderResource);
+		m_renderGraph.Export(resources.depthHierarchy, m_fusedDepthDownsample ? ResourceState::UnorderedAccess : ResourceState::ShaderResource);
+
+		m_renderGraph.Execute([&](const RenderGraphBarrier* pBarriers, uint32_t barrierCount)
+		{
+			IssueBarriers(commandBuffer, pBarriers, barrierCount);
+		});
+
+		m_bufferIndex = 1 - m_bufferIndex;
+
 		SetPerfMarkerEnd(commandBuffer);
 	}
 
+	bool SSSR::IsStaticFrame(const SSSRConstants& sssrConstants, bool showIntersectResult, bool isSceneStatic)
+	{
+		// Reflections applied by the temporal resolve end up in the lit scene, which is rendered anew every frame.
+		bool canReuseOutput = isSceneStatic && !showIntersectResult && sssrConstants.applyReflectionsInResolve == 0;
+		m_staticFrameCount = canReuseOutput && HasSameInputs(sssrConstants, m_previousConstants) ? std::min(m_staticFrameCount + 1, g_staticFramesBeforeReuse) : 0;
+		m_previousConstants = sssrConstants;
+		return m_staticFrameCount == g_staticFramesBeforeReuse;
+	}
+
 	void SSSR::GUI(int* pSlice)
 	{
 
 	}
 
+	const uint32_t* SSSR::GetMipUsage() const
+	{
+		return m_mipUsage;
+	}
+
+	uint32_t SSSR::GetAccumulatedSampleCount() const
+	{
+		return m_accumulatedBatchCount * m_accumulationSamplesPerPixel;
+	}
+
+	const SSSR_SAMPLE_COMMON::PipelineCacheStatistics& SSSR::GetPipelineCacheStatistics() const
+	{
+		return m_pipelineCacheStatistics;
+	}
+
+	void SSSR::RequestOutputReadback()
+	{
+		m_outputReadbackRequested = true;
+		m_outputReadbackPending = false;
+		m_outputReadbackReady = false;
+	}
+
+	const uint16_t* SSSR::GetOutputReadback(uint32_t* pRowPitch) const
+	{
+		*pRowPitch = m_outputWidth * 4 * sizeof(uint16_t);
+		return m_outputReadbackReady ? m_pOutputReadbackData : nullptr;
+	}
+
 	VkImageView SSSR::GetOutputTextureView(int frame) const
 	{
 		return m_radiance[frame % 2].View();
 	}
 
+	uint32_t SSSR::GetOutputIndex() const
+	{
+		return 1 - m_bufferIndex;
+	}
+
+	VkBufferView SSSR::GetReflectionTileListView() const
+	{
+		return m_reflectionTileList.m_bufferView;
+	}
+
+	VkBuffer SSSR::GetReflectionTileDrawArgsBuffer() const
+	{
+		return m_intersectionPassIndirectArgs.m_buffer;
+	}
+
+	uint32_t SSSR::GetReflectionTileDrawArgsOffset() const
+	{
+		return g_reflectionTileDrawArgsOffset;
+	}
+
 	void SSSR::CreateResources(VkCommandBuffer commandBuffer)
 	{
 		VkDevice device = m_pDevice->GetDevice();
@@ -516,20 +1009,34 @@ namespace SSSR_SAMPLE_VK
 
 		//==============================Create Tile Classification-related buffers============================================
 		{
-			uint32_t rayCounterElementCount = 4;
+			// Two counters per tile class plus two each for the denoiser tiles, the environment map pixels, the reflection tiles and the spatial filter and converged tiles, followed by the mip usage counters. See Common.hlsl.
+			uint32_t rayCounterElementCount = 2 * TILE_CLASS_COUNT + 10 + DEPTH_HIERARCHY_MAX_MIP_COUNT;
 
 			BufferVK::CreateInfo createInfo = {};
 			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 			createInfo.format = VK_FORMAT_R32_UINT;
-			createInfo.bufferUsage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			createInfo.bufferUsage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
 
 			createInfo.sizeInBytes = rayCounterElementCount * sizeof(uint32_t);
 			m_rayCounter = BufferVK(device, physicalDevice, createInfo, "SSSR - Ray Counter");
 		}
 
+		//==============================Create mip usage readback buffer============================================
+		{
+			// Coherent, so the counters written by the GPU are visible to the mapped pointer without invalidating it.
+			BufferVK::CreateInfo createInfo = {};
+			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			createInfo.format = VK_FORMAT_UNDEFINED;
+			createInfo.bufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+			createInfo.sizeInBytes = m_frameCountBeforeReuse * DEPTH_HIERARCHY_MAX_MIP_COUNT * sizeof(uint32_t);
+			m_mipUsageReadback = BufferVK(device, physicalDevice, createInfo, "SSSR - Mip Usage Readback");
+			m_mipUsageReadback.Map(reinterpret_cast<void**>(&m_pMipUsageReadbackData));
+		}
+
 		//==============================Create PrepareIndirectArgs-related buffers============================================
 		{
-			uint32_t intersectionPassIndirectArgsElementCount = 6;
+			uint32_t intersectionPassIndirectArgsElementCount = 3 * (TILE_CLASS_COUNT + 4) + 4;
 			BufferVK::CreateInfo createInfo = {};
 			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 			createInfo.format = VK_FORMAT_R32_UINT;
@@ -586,60 +1093,6 @@ namespace SSSR_SAMPLE_VK
 			VkResult res = vkCreateSampler(m_pDevice->GetDevice(), &samplerInfo, nullptr, &m_previousDepthSampler);
 			assert(VK_SUCCESS == res);
 		}
-
-		//==============================Create Blue Noise buffers============================================
-		{
-			auto const& samplerState = g_blueNoiseSamplerState;
-			BlueNoiseSamplerVK& sampler = m_blueNoiseSampler;
-
-			BufferVK::CreateInfo createInfo = {};
-			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-			createInfo.bufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
-			createInfo.format = VK_FORMAT_R32_UINT;
-
-			createInfo.sizeInBytes = sizeof(samplerState.m_sobolBuffer);
-			m_blueNoiseSampler.sobolBuffer = BufferVK(device, physicalDevice, createInfo, "SSSR - Sobol Buffer");
-
-			createInfo.sizeInBytes = sizeof(samplerState.m_rankingTileBuffer);
-			m_blueNoiseSampler.rankingTileBuffer = BufferVK(device, physicalDevice, createInfo, "SSSR - Ranking Tile Buffer");
-
-			createInfo.sizeInBytes = sizeof(samplerState.scramblingTileBuffer);
-			m_blueNoiseSampler.scramblingTileBuffer = BufferVK(device, physicalDevice, createInfo, "SSSR - Scrambling Tile Buffer");
-
-			VkBufferCopy copyInfo;
-			copyInfo.dstOffset = 0;
-			copyInfo.size = sizeof(samplerState.m_sobolBuffer);
-			copyInfo.srcOffset = 0;
-
-			uint8_t* destAddr;
-
-			destAddr = m_uploadHeap.BeginSuballocate(sizeof(samplerState.m_sobolBuffer), 512);
-			memcpy(destAddr, &samplerState.m_sobolBuffer, sizeof(samplerState.m_sobolBuffer));
-			m_uploadHeap.EndSuballocate();
-			m_uploadHeap.AddCopy(m_blueNoiseSampler.sobolBuffer.m_buffer, copyInfo);
-			m_uploadHeap.FlushAndFinish();
-
-			copyInfo.size = sizeof(samplerState.m_rankingTileBuffer);
-			copyInfo.srcOffset = 0;
-			destAddr = m_uploadHeap.BeginSuballocate(sizeof(samplerState.m_rankingTileBuffer), 512);
-			memcpy(destAddr, &samplerState.m_rankingTileBuffer, sizeof(samplerState.m_rankingTileBuffer));
-			m_uploadHeap.EndSuballocate();
-			m_uploadHeap.AddCopy(m_blueNoiseSampler.rankingTileBuffer.m_buffer, copyInfo);
-			m_uploadHeap.FlushAndFinish();
-
-			copyInfo.size = sizeof(samplerState.scramblingTileBuffer);
-			destAddr = m_uploadHeap.BeginSuballocate(sizeof(samplerState.scramblingTileBuffer), 512);
-			memcpy(destAddr, &samplerState.scramblingTileBuffer, sizeof(samplerState.scramblingTileBuffer));
-			m_uploadHeap.EndSuballocate();
-			m_uploadHeap.AddCopy(m_blueNoiseSampler.scramblingTileBuffer.m_buffer, copyInfo);
-			m_uploadHeap.FlushAndFinish();
-
-			ImageVK::CreateInfo blueNoiseCreateInfo = {};
-			blueNoiseCreateInfo.format = VK_FORMAT_R8G8_UNORM;
-			blueNoiseCreateInfo.width = 128;
-			blueNoiseCreateInfo.height = 128;
-			m_blueNoiseTexture = ImageVK(m_pDevice, blueNoiseCreateInfo, "Reflection Denoiser - Blue Noise Texture");
-		}
 	}
 
 	void SSSR::CreateWindowSizeDependentResources(VkCommandBuffer commandBuffer)
@@ -649,11 +1102,9 @@ namespace SSSR_SAMPLE_VK
 
 		//==============================Create Tile Classification-related buffers============================================
 		{
-			uint32_t numTiles = DivideRoundingUp(m_outputWidth, 8u) * DivideRoundingUp(m_outputHeight, 8u);
 			uint32_t numPixels = m_outputWidth * m_outputHeight;
 
 			uint32_t rayListElementCount = numPixels;
-			uint32_t rayCounterElementCount = 1;
 
 			BufferVK::CreateInfo createInfo = {};
 			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -661,14 +1112,14 @@ namespace SSSR_SAMPLE_VK
 			createInfo.bufferUsage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
 
 			createInfo.sizeInBytes = sizeof(uint32_t) * rayListElementCount;
-			m_rayList = BufferVK(device, physicalDevice, createInfo, "SSSR - Ray List");
+			m_rayList[TILE_CLASS_MIRROR] = BufferVK(device, physicalDevice, createInfo, "SSSR - Ray List Mirror");
+			m_rayList[TILE_CLASS_GLOSSY] = BufferVK(device, physicalDevice, createInfo, "SSSR - Ray List Glossy");
+			m_rayList[TILE_CLASS_ROUGH] = BufferVK(device, physicalDevice, createInfo, "SSSR - Ray List Rough");
 		}
 		{
-			uint32_t numTiles = DivideRoundingUp(m_outputWidth, 8u) * DivideRoundingUp(m_outputHeight, 8u);
 			uint32_t numPixels = m_outputWidth * m_outputHeight;
 
 			uint32_t denoiserTileListElementCount = numPixels;
-			uint32_t rayCounterElementCount = 1;
 
 			BufferVK::CreateInfo createInfo = {};
 			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
@@ -678,7 +1129,28 @@ namespace SSSR_SAMPLE_VK
 			createInfo.sizeInBytes = sizeof(uint32_t) * denoiserTileListElementCount;
 			m_denoiserTileList = BufferVK(device, physicalDevice, createInfo, "SSSR - Denoiser Tile List");
 		}
-
+		{
+			uint32_t numTiles = DivideRoundingUp(m_outputWidth, 8u) * DivideRoundingUp(m_outputHeight, 8u);
+			uint32_t numPixels = m_outputWidth * m_outputHeight;
+
+			BufferVK::CreateInfo createInfo = {};
+			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			createInfo.format = VK_FORMAT_R32_UINT;
+			createInfo.bufferUsage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
+
+			createInfo.sizeInBytes = sizeof(uint32_t) * numPixels;
+			m_environmentMapList = BufferVK(device, physicalDevice, createInfo, "SSSR - Environment Map List");
+
+			createInfo.sizeInBytes = sizeof(uint32_t) * numTiles;
+			m_reflectionTileList = BufferVK(device, physicalDevice, createInfo, "SSSR - Reflection Tile List");
+			m_spatialFilterTileList = BufferVK(device, physicalDevice, createInfo, "SSSR - Spatial Filter Tile List");
+			m_convergedTileList = BufferVK(device, physicalDevice, createInfo, "SSSR - Converged Tile List");
+
+			createInfo.bufferUsage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			createInfo.sizeInBytes = sizeof(uint32_t) * numTiles;
+			m_tileHistory = BufferVK(device, physicalDevice, createInfo, "SSSR - Tile History");
+		}
+
 		//==============================Create denoising-related resources==============================
 		{
 			ImageVK::CreateInfo radianceCreateInfo = {};
@@ -688,6 +1160,12 @@ namespace SSSR_SAMPLE_VK
 			m_radiance[0] = ImageVK(m_pDevice, radianceCreateInfo, "Reflection Denoiser - Radiance 0");
 			m_radiance[1] = ImageVK(m_pDevice, radianceCreateInfo, "Reflection Denoiser - Radiance 1");
 			m_reprojectedRadiance = ImageVK(m_pDevice, radianceCreateInfo, "Reflection Denoiser - Reprojected Radiance");
+
+			if (m_accumulationSamplesPerPixel > 0)
+			{
+				radianceCreateInfo.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+				m_accumulatedRadiance = ImageVK(m_pDevice, radianceCreateInfo, "SSSR - Accumulated Radiance");
+			}
 			
 			ImageVK::CreateInfo averageRadianceCreateInfo = {};
 			averageRadianceCreateInfo.format = VK_FORMAT_B10G11R11_UFLOAT_PACK32;
@@ -696,30 +1174,30 @@ namespace SSSR_SAMPLE_VK
 			m_averageRadiance[0] = ImageVK(m_pDevice, averageRadianceCreateInfo, "Reflection Denoiser - Average Radiance 0");
 			m_averageRadiance[1] = ImageVK(m_pDevice, averageRadianceCreateInfo, "Reflection Denoiser - Average Radiance 1");
 
-			ImageVK::CreateInfo varianceCreateInfo = {};
-			varianceCreateInfo.format = VK_FORMAT_R16_SFLOAT;
-			varianceCreateInfo.width = m_outputWidth;
-			varianceCreateInfo.height = m_outputHeight;
-			m_variance[0] = ImageVK(m_pDevice, varianceCreateInfo, "Reflection Denoiser - Variance 0");
-			m_variance[1] = ImageVK(m_pDevice, varianceCreateInfo, "Reflection Denoiser - Variance 1");
-			
-			ImageVK::CreateInfo sampleCountCreateInfo = varianceCreateInfo;
-			m_sampleCount[0] = ImageVK(m_pDevice, sampleCountCreateInfo, "Reflection Denoiser - Sample Count 0");
-			m_sampleCount[1] = ImageVK(m_pDevice, sampleCountCreateInfo, "Reflection Denoiser - Sample Count 1");
+			// Variance and sample count are read together, so they share one texel.
+			ImageVK::CreateInfo varianceSampleCountCreateInfo = {};
+			varianceSampleCountCreateInfo.format = VK_FORMAT_R16G16_SFLOAT;
+			varianceSampleCountCreateInfo.width = m_outputWidth;
+			varianceSampleCountCreateInfo.height = m_outputHeight;
+			m_varianceSampleCount[0] = ImageVK(m_pDevice, varianceSampleCountCreateInfo, "Reflection Denoiser - Variance and Sample Count 0");
+			m_varianceSampleCount[1] = ImageVK(m_pDevice, varianceSampleCountCreateInfo, "Reflection Denoiser - Variance and Sample Count 1");
 
 			ImageVK::CreateInfo imgCreateInfo = {};
 			imgCreateInfo.width = m_outputWidth;
 			imgCreateInfo.height = m_outputHeight;
 
 			imgCreateInfo.format = VK_FORMAT_R8_UNORM;
-			m_roughnessTexture = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Extracted Roughness");
-			m_roughnessHistoryTexture = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Extracted Roughness History");
+			m_roughnessTexture[0] = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Extracted Roughness 0");
+			m_roughnessTexture[1] = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Extracted Roughness 1");
 
-			imgCreateInfo.format = VK_FORMAT_R32_SFLOAT;
-			m_depthHistoryTexture = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Depth History");
+			// The history holds view space depth and octahedral normals. See EncodeHistoryDepth and EncodeOctahedralNormal in Common.hlsl.
+			imgCreateInfo.format = m_lowPrecisionHistory ? VK_FORMAT_R16_SFLOAT : VK_FORMAT_R32_SFLOAT;
+			m_depthHistoryTexture[0] = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Depth History 0");
+			m_depthHistoryTexture[1] = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Depth History 1");
 
-			imgCreateInfo.format = m_normalTexture->GetFormat();
-			m_normalHistoryTexture = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Normal History");
+			imgCreateInfo.format = m_lowPrecisionHistory ? VK_FORMAT_R8G8_UNORM : VK_FORMAT_R16G16_UNORM;
+			m_normalHistoryTexture[0] = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Normal History 0");
+			m_normalHistoryTexture[1] = ImageVK(m_pDevice, imgCreateInfo, "Reflection Denoiser - Normal History 1");
 		}
 
 		// Initial transitions for clearing
@@ -730,21 +1208,29 @@ namespace SSSR_SAMPLE_VK
 				m_reprojectedRadiance.Transition(VK_IMAGE_LAYOUT_GENERAL),
 				m_averageRadiance[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
 				m_averageRadiance[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_variance[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_variance[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_sampleCount[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_sampleCount[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_roughnessTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_roughnessHistoryTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_depthHistoryTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_normalHistoryTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
-				m_blueNoiseTexture.Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_varianceSampleCount[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_varianceSampleCount[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_roughnessTexture[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_roughnessTexture[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_depthHistoryTexture[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_depthHistoryTexture[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_normalHistoryTexture[0].Transition(VK_IMAGE_LAYOUT_GENERAL),
+				m_normalHistoryTexture[1].Transition(VK_IMAGE_LAYOUT_GENERAL),
 			};
 			TransitionBarriers(commandBuffer, imageBarriers, _countof(imageBarriers));
+
+			// Stays in the general layout. It is only ever cleared and accessed by the accumulation passes.
+			if (m_accumulationSamplesPerPixel > 0)
+			{
+				VkImageMemoryBarrier barrier = m_accumulatedRadiance.Transition(VK_IMAGE_LAYOUT_GENERAL);
+				TransitionBarriers(commandBuffer, &barrier, 1);
+			}
 		}
 
 		// Initial clear of the ray counter. Successive clears are handled by the indirect arguments pass. 
 		vkCmdFillBuffer(commandBuffer, m_rayCounter.m_buffer, 0, VK_WHOLE_SIZE, 0);
+		// The radiance targets are cleared below, so no tile holds any reflections yet.
+		vkCmdFillBuffer(commandBuffer, m_tileHistory.m_buffer, 0, VK_WHOLE_SIZE, 0);
 
 		VkClearColorValue clearValue = {};
 		clearValue.float32[0] = 0;
@@ -760,33 +1246,95 @@ namespace SSSR_SAMPLE_VK
 		subresourceRange.levelCount = 1;
 
 		// Initial resource clears
+		m_bufferIndex = 0;
+		m_staticFrameCount = 0;
+		m_accumulatedBatchCount = 0;
 		vkCmdClearColorImage(commandBuffer, m_radiance[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
 		vkCmdClearColorImage(commandBuffer, m_radiance[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
 		vkCmdClearColorImage(commandBuffer, m_reprojectedRadiance.Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
 		vkCmdClearColorImage(commandBuffer, m_averageRadiance[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
 		vkCmdClearColorImage(commandBuffer, m_averageRadiance[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_variance[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_variance[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_sampleCount[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_sampleCount[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_roughnessTexture.Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_roughnessHistoryTexture.Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_depthHistoryTexture.Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_normalHistoryTexture.Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
-		vkCmdClearColorImage(commandBuffer, m_blueNoiseTexture.Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_varianceSampleCount[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_varianceSampleCount[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_roughnessTexture[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_roughnessTexture[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_depthHistoryTexture[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_depthHistoryTexture[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_normalHistoryTexture[0].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
+		vkCmdClearColorImage(commandBuffer, m_normalHistoryTexture[1].Resource(), VK_IMAGE_LAYOUT_GENERAL, &clearValue, 1, &subresourceRange);
 	}
 
-	void SSSR::SetupShaderPass(ShaderPass& pass, const char* shader, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, VkPipelineShaderStageCreateFlags flags)
+	void SSSR::AddGraphResources()
 	{
-		VkPipelineShaderStageCreateInfo stageCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-		pass.bindingsCount = bindingsCount;
+		m_renderGraph.RemoveResources();
+		m_graphImages.clear();
 
-		//==============================Compile Shaders============================================
+		auto addBuffer = [this](ResourceState state)
 		{
-			DefineList defines;
-			VkResult vkResult = VKCompileFromFile(m_pDevice->GetDevice(), VK_SHADER_STAGE_COMPUTE_BIT, shader, "main", "-enable-16bit-types -T cs_6_2", &defines, &stageCreateInfo);
-			stageCreateInfo.flags = flags;
-			assert(vkResult == VK_SUCCESS);
+			m_graphImages.push_back({ nullptr, VK_NULL_HANDLE, 0 });
+			return m_renderGraph.AddResource(state);
+		};
+		// CreateWindowSizeDependentResources leaves all of them in the general layout.
+		auto addImage = [this](ImageVK& image)
+		{
+			m_graphImages.push_back({ &image, VK_NULL_HANDLE, 0 });
+			return m_renderGraph.AddResource(ResourceState::UnorderedAccess);
+		};
+
+		GraphResources& resources = m_graphResources;
+		// Draw leaves the ray counter and the indirect arguments in these states.
+		resources.rayCounter = addBuffer(ResourceState::UnorderedAccess);
+		resources.intersectionPassIndirectArgs = addBuffer(ResourceState::IndirectArgument);
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			resources.rayList[tileClass] = addBuffer(ResourceState::UnorderedAccess);
+		}
+		resources.denoiserTileList = addBuffer(ResourceState::UnorderedAccess);
+		resources.environmentMapList = addBuffer(ResourceState::UnorderedAccess);
+		resources.tileHistory = addBuffer(ResourceState::UnorderedAccess);
+		resources.reflectionTileList = addBuffer(ResourceState::UnorderedAccess);
+		resources.spatialFilterTileList = addBuffer(ResourceState::UnorderedAccess);
+		resources.convergedTileList = addBuffer(ResourceState::UnorderedAccess);
+
+		for (int i = 0; i < 2; ++i)
+		{
+			resources.radiance[i] = addImage(m_radiance[i]);
+			resources.varianceSampleCount[i] = addImage(m_varianceSampleCount[i]);
+			resources.averageRadiance[i] = addImage(m_averageRadiance[i]);
+			resources.roughness[i] = addImage(m_roughnessTexture[i]);
+			resources.depthHistory[i] = addImage(m_depthHistoryTexture[i]);
+			resources.normalHistory[i] = addImage(m_normalHistoryTexture[i]);
+		}
+		resources.reprojectedRadiance = addImage(m_reprojectedRadiance);
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			resources.accumulatedRadiance = addImage(m_accumulatedRadiance);
+		}
+
+		// The application hands these over in the same layouts every frame.
+		m_graphImages.push_back({ nullptr, m_hdr->Resource(), 1 });
+		resources.hdr = m_renderGraph.AddResource(ResourceState::ShaderResource);
+		m_graphImages.push_back({ nullptr, m_depthHierarchy->Resource(), m_depthHierarchyMipCount });
+		resources.depthHierarchy = m_renderGraph.AddResource(m_fusedDepthDownsample ? ResourceState::UnorderedAccess : ResourceState::ShaderResource);
+	}
+
+	void SSSR::SetupShaderPass(ShaderPass& pass, const char* shader, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const DefineList* pDefines, uint32_t waveSize, uint32_t permutationMask)
+	{
+		pass.bindingsCount = bindingsCount;
+		pass.permutationMask = permutationMask;
+		pass.shader = shader;
+		pass.defines = pDefines ? *pDefines : DefineList();
+		if (m_linearDepthHierarchy)
+		{
+			pass.defines["LINEAR_DEPTH_HIERARCHY"] = "1";
+		}
+		// The wave-level code of the passes with a wave size expects every lane of a subgroup to be active.
+		pass.requiredSubgroupSize = GetWaveSize(waveSize);
+		pass.stageFlags = (pass.requiredSubgroupSize != 0 && m_isComputeFullSubgroupsSupported) ? VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT : 0;
+		// Only full subgroups of a pinned size map the threads to lanes in order. Otherwise the shaders must not rely on which lane a thread runs on.
+		if (pass.stageFlags & VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT_EXT)
+		{
+			pass.defines["SUBGROUP_SIZE"] = std::to_string(pass.requiredSubgroupSize);
 		}
 
 		//==============================DescriptorSetLayout========================================
@@ -825,17 +1373,203 @@ namespace SSSR_SAMPLE_VK
 		}
 
 		//==============================Pipeline========================================
+		// The permutations are only compiled once they are used. All others are compiled on the async pool.
+		pass.pipeline = VK_NULL_HANDLE;
+		if (!permutationMask)
+		{
+			CreatePipelineAsync(pass);
+		}
+	}
+
+	uint32_t SSSR::GetWaveSize(uint32_t preferredWaveSize) const
+	{
+		if (preferredWaveSize < m_minSubgroupSize || preferredWaveSize > m_maxSubgroupSize)
+		{
+			return 0;
+		}
+		return preferredWaveSize;
+	}
+
+	void SSSR::CreatePipelineAsync(ShaderPass& pass)
+	{
+		// The pass itself is not touched by anyone else until WaitForCreation.
+		auto job = [this, &pass]()
+		{
+			pass.pipeline = CreatePipeline(pass, pass.defines);
+		};
+		if (m_pAsyncPool)
+		{
+			m_pAsyncPool->AddAsyncTask(job, &m_pipelineSync);
+		}
+		else
+		{
+			job();
+		}
+	}
+
+	void SSSR::CreatePipelineCache()
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(m_pDevice->GetPhysicalDevice(), &properties);
+
+		// Drivers should reject the data of another device or driver version themselves, but not all of them do.
+		// The cache UUID changes with the driver, the shaders are part of the keys within the cache.
+		std::vector<uint8_t> data;
+		if (SSSR_SAMPLE_COMMON::LoadPipelineCacheFile(g_pipelineCachePath, data))
+		{
+			VkPipelineCacheHeaderVersionOne header = {};
+			bool isValid = data.size() >= sizeof(header);
+			if (isValid)
+			{
+				memcpy(&header, data.data(), sizeof(header));
+				isValid = header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+					&& header.vendorID == properties.vendorID
+					&& header.deviceID == properties.deviceID
+					&& memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+			}
+			if (!isValid)
+			{
+				Trace("Discarding %s, it was written by another device or driver", g_pipelineCachePath);
+				data.clear();
+			}
+		}
+
+		VkPipelineCacheCreateInfo createInfo = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		createInfo.pNext = nullptr;
+		createInfo.flags = 0;
+		createInfo.initialDataSize = data.size();
+		createInfo.pInitialData = data.data();
+		VkResult vkResult = vkCreatePipelineCache(m_pDevice->GetDevice(), &createInfo, nullptr, &m_pipelineCache);
+		assert(vkResult == VK_SUCCESS);
+		m_pipelineCacheStatistics = {};
+		m_loadedPipelineCacheSize = data.size();
+		m_loadedPipelineCacheHash = SSSR_SAMPLE_COMMON::HashPipelineData(data.data(), data.size());
+	}
+
+	void SSSR::SavePipelineCache()
+	{
+		VkDevice device = m_pDevice->GetDevice();
+		Trace("SSSR pipeline cache: %u hits, %u misses, %u unknown, %.2f ms creating pipelines",
+			m_pipelineCacheStatistics.hits, m_pipelineCacheStatistics.misses, m_pipelineCacheStatistics.unknown, m_pipelineCacheStatistics.creationMilliseconds);
+
+		size_t size = 0;
+		VkResult vkResult = vkGetPipelineCacheData(device, m_pipelineCache, &size, nullptr);
+		std::vector<uint8_t> data(size);
+		if (vkResult == VK_SUCCESS && size > 0)
+		{
+			vkResult = vkGetPipelineCacheData(device, m_pipelineCache, &size, data.data());
+		}
+
+		// Nothing to write if the driver added nothing to the data loaded from the file.
+		bool isChanged = size != m_loadedPipelineCacheSize || SSSR_SAMPLE_COMMON::HashPipelineData(data.data(), size) != m_loadedPipelineCacheHash;
+		if (vkResult != VK_SUCCESS || size == 0 || (isChanged && !SSSR_SAMPLE_COMMON::SavePipelineCacheFile(g_pipelineCachePath, data.data(), size)))
+		{
+			Trace("Failed to save %s", g_pipelineCachePath);
+		}
+		vkDestroyPipelineCache(device, m_pipelineCache, nullptr);
+		m_pipelineCache = VK_NULL_HANDLE;
+	}
+
+	VkPipeline SSSR::CreatePipeline(const ShaderPass& pass, const DefineList& defines)
+	{
+		VkPipelineShaderStageCreateInfo stageCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+
+		//==============================Compile Shaders============================================
+		// The module of a precompiled blob is owned by this function. Cauldron keeps the modules it compiles itself.
+		const SSSR_SAMPLE_COMMON::MappedFile* pBlob = m_shaderBlobs.Find(pass.shader.c_str(), defines);
+		if (pBlob)
+		{
+			VkShaderModuleCreateInfo moduleCreateInfo = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+			moduleCreateInfo.codeSize = pBlob->Size();
+			moduleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(pBlob->Data());
+			VkResult vkResult = vkCreateShaderModule(m_pDevice->GetDevice(), &moduleCreateInfo, nullptr, &stageCreateInfo.module);
+			assert(vkResult == VK_SUCCESS);
+			stageCreateInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			stageCreateInfo.pName = "main";
+			stageCreateInfo.flags = pass.stageFlags;
+		}
+		else
+		{
+			DefineList shaderDefines = defines;
+			VkResult vkResult = VKCompileFromFile(m_pDevice->GetDevice(), VK_SHADER_STAGE_COMPUTE_BIT, pass.shader.c_str(), "main", "-enable-16bit-types -T cs_6_2", &shaderDefines, &stageCreateInfo);
+			stageCreateInfo.flags = pass.stageFlags;
+			assert(vkResult == VK_SUCCESS);
+		}
+
+		VkPipelineShaderStageRequiredSubgroupSizeCreateInfoEXT subgroupSizeCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO_EXT };
+		subgroupSizeCreateInfo.pNext = nullptr;
+		subgroupSizeCreateInfo.requiredSubgroupSize = pass.requiredSubgroupSize;
+		if (pass.requiredSubgroupSize != 0)
+		{
+			stageCreateInfo.pNext = &subgroupSizeCreateInfo;
+		}
+
+		//==============================Pipeline========================================
+		VkPipeline pipeline = VK_NULL_HANDLE;
 		{
+			VkPipelineCreationFeedbackEXT pipelineFeedback = {};
+			VkPipelineCreationFeedbackEXT stageFeedback = {};
+			VkPipelineCreationFeedbackCreateInfoEXT feedbackCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT };
+			feedbackCreateInfo.pNext = nullptr;
+			feedbackCreateInfo.pPipelineCreationFeedback = &pipelineFeedback;
+			feedbackCreateInfo.pipelineStageCreationFeedbackCount = 1;
+			feedbackCreateInfo.pPipelineStageCreationFeedbacks = &stageFeedback;
+
 			VkComputePipelineCreateInfo createInfo = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
-			createInfo.pNext = nullptr;
+			createInfo.pNext = m_isPipelineCreationFeedbackEnabled ? &feedbackCreateInfo : nullptr;
 			createInfo.basePipelineHandle = VK_NULL_HANDLE;
 			createInfo.basePipelineIndex = 0;
 			createInfo.flags = 0;
 			createInfo.layout = pass.pipelineLayout;
 			createInfo.stage = stageCreateInfo;
-			VkResult vkResult = vkCreateComputePipelines(m_pDevice->GetDevice(), VK_NULL_HANDLE, 1, &createInfo, nullptr, &pass.pipeline);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			VkResult vkResult = vkCreateComputePipelines(m_pDevice->GetDevice(), m_pipelineCache, 1, &createInfo, nullptr, &pipeline);
 			assert(vkResult == VK_SUCCESS);
+			double creationMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+			// The feedback is left untouched if the extension is not enabled. There is no other reliable way to tell hits and misses apart.
+			std::lock_guard<std::mutex> lock(m_pipelineCacheStatisticsMutex);
+			m_pipelineCacheStatistics.creationMilliseconds += creationMilliseconds;
+			if (!(pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+			{
+				++m_pipelineCacheStatistics.unknown;
+			}
+			else if (pipelineFeedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT)
+			{
+				++m_pipelineCacheStatistics.hits;
+			}
+			else
+			{
+				++m_pipelineCacheStatistics.misses;
+			}
+		}
+		if (pBlob)
+		{
+			vkDestroyShaderModule(m_pDevice->GetDevice(), stageCreateInfo.module, nullptr);
+		}
+		return pipeline;
+	}
+
+	VkPipeline SSSR::GetPipeline(ShaderPass& pass, const SSSRConstants& sssrConstants)
+	{
+		if (pass.permutationMask == 0)
+		{
+			return pass.pipeline;
+		}
+
+		uint32_t key = GetPermutationKey(sssrConstants) & pass.permutationMask;
+		auto it = pass.permutations.find(key);
+		if (it != pass.permutations.end())
+		{
+			return it->second;
 		}
+
+		DefineList defines = pass.defines;
+		AddPermutationDefines(key, pass.permutationMask, defines);
+		VkPipeline pipeline = CreatePipeline(pass, defines);
+		pass.permutations[key] = pipeline;
+		return pipeline;
 	}
 
 	void SSSR::SetupClassifyTilesPass()
@@ -844,32 +1578,203 @@ namespace SSSR_SAMPLE_VK
 		VkDescriptorSetLayoutBinding layoutBindings[] = {
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_roughness
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_depth_buffer
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_variance_history
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_environment_map
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLER), // g_environment_map_sampler
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_list
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_variance_sample_count_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_motion_vector
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_radiance_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_list_mirror
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_list_glossy
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_list_rough
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_counter
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_intersection_output
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_extracted_roughness
 
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_denoiser_tile_list
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_environment_map_list
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_tile_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_reflection_tile_list
+
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_depth_history_output
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_normal_history_output
+
+			// Only bound by the fused depth downsample
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_downsampled_depth_buffer
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_global_atomic
 		};
+		layoutBindings[binding - 2].descriptorCount = DEPTH_HIERARCHY_MAX_MIP_COUNT;
 
-		SetupShaderPass(m_classifyTilesPass, "ClassifyTiles.hlsl", layoutBindings, _countof(layoutBindings));
+		DefineList defines;
+		uint32_t bindingsCount = _countof(layoutBindings) - 2;
+		if (m_fusedDepthDownsample)
+		{
+			defines["FUSED_DEPTH_DOWNSAMPLE"] = "1";
+			if (m_halfPrecisionDepthHierarchy)
+			{
+				defines["HALF_PRECISION_DEPTH_HIERARCHY"] = "1";
+			}
+			bindingsCount = _countof(layoutBindings);
+		}
+
+		SetupShaderPass(m_classifyTilesPass, "ClassifyTiles.hlsl", layoutBindings, bindingsCount, &defines, g_classifyTilesWaveSize, g_classifyTilesPermutationMask);
 	}
 
-	void SSSR::SetupBlueNoisePass()
+	uint32_t SSSR::BakeBlueNoiseTexture(ImageVK& texture, uint32_t samplesPerPixel, bool sampleSet)
 	{
+		VkDevice device = m_pDevice->GetDevice();
+		VkPhysicalDevice physicalDevice = m_pDevice->GetPhysicalDevice();
+
+		// The noise of all frames is baked once. The sampler tables and the pass are only needed until then.
+		SSSR_SAMPLE_COMMON::BlueNoiseAsset asset;
+		if (!asset.Open(g_blueNoiseAssetPath))
+		{
+			Trace("Failed to open the blue noise asset %s", g_blueNoiseAssetPath);
+			assert(false);
+			return 0;
+		}
+		SSSR_SAMPLE_COMMON::BlueNoiseTables tables;
+		if (!asset.GetTables(samplesPerPixel, &tables))
+		{
+			Trace("No blue noise sampler for %u spp, falling back to %u spp", samplesPerPixel, asset.GetSamplesPerPixel(0));
+			asset.GetTables(asset.GetSamplesPerPixel(0), &tables);
+		}
+		const uint32_t sliceCount = sampleSet ? tables.samplesPerPixel : BLUE_NOISE_FRAME_COUNT;
+
+		// The baking itself is recorded by WaitForCreation, once the pipeline of the pass is compiled.
+		assert(m_blueNoiseBakeCount < _countof(m_blueNoiseBakes));
+		BlueNoiseBake& bake = m_blueNoiseBakes[m_blueNoiseBakeCount++];
+		bake.pTexture = &texture;
+		bake.sliceCount = sliceCount;
+
+		BlueNoiseSamplerVK& sampler = bake.sampler;
+		{
+			using SSSR_SAMPLE_COMMON::BLUE_NOISE_SOBOL_SIZE;
+			using SSSR_SAMPLE_COMMON::BLUE_NOISE_TILE_SIZE;
+
+			// The asset stores one byte per entry, which the shader reads as is through R8_UINT views.
+			BufferVK::CreateInfo createInfo = {};
+			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			createInfo.bufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT;
+			createInfo.format = VK_FORMAT_R8_UINT;
+
+			createInfo.sizeInBytes = BLUE_NOISE_SOBOL_SIZE;
+			sampler.sobolBuffer = BufferVK(device, physicalDevice, createInfo, "SSSR - Sobol Buffer");
+
+			createInfo.sizeInBytes = BLUE_NOISE_TILE_SIZE;
+			sampler.rankingTileBuffer = BufferVK(device, physicalDevice, createInfo, "SSSR - Ranking Tile Buffer");
+
+			createInfo.sizeInBytes = BLUE_NOISE_TILE_SIZE;
+			sampler.scramblingTileBuffer = BufferVK(device, physicalDevice, createInfo, "SSSR - Scrambling Tile Buffer");
+
+			VkBufferCopy copyInfo;
+			copyInfo.dstOffset = 0;
+
+			uint8_t* destAddr;
+
+			// The tables are copied straight out of the mapped file. All three fit into the upload heap at once.
+			copyInfo.size = BLUE_NOISE_SOBOL_SIZE;
+			destAddr = m_uploadHeap.BeginSuballocate(BLUE_NOISE_SOBOL_SIZE, g_uploadAlignment);
+			memcpy(destAddr, tables.sobolBuffer, BLUE_NOISE_SOBOL_SIZE);
+			m_uploadHeap.EndSuballocate();
+			copyInfo.srcOffset = destAddr - m_uploadHeap.BasePtr();
+			m_uploadHeap.AddCopy(sampler.sobolBuffer.m_buffer, copyInfo);
+
+			copyInfo.size = BLUE_NOISE_TILE_SIZE;
+			destAddr = m_uploadHeap.BeginSuballocate(BLUE_NOISE_TILE_SIZE, g_uploadAlignment);
+			memcpy(destAddr, tables.rankingTileBuffer, BLUE_NOISE_TILE_SIZE);
+			m_uploadHeap.EndSuballocate();
+			copyInfo.srcOffset = destAddr - m_uploadHeap.BasePtr();
+			m_uploadHeap.AddCopy(sampler.rankingTileBuffer.m_buffer, copyInfo);
+
+			destAddr = m_uploadHeap.BeginSuballocate(BLUE_NOISE_TILE_SIZE, g_uploadAlignment);
+			memcpy(destAddr, tables.scramblingTileBuffer, BLUE_NOISE_TILE_SIZE);
+			m_uploadHeap.EndSuballocate();
+			copyInfo.srcOffset = destAddr - m_uploadHeap.BasePtr();
+			m_uploadHeap.AddCopy(sampler.scramblingTileBuffer.m_buffer, copyInfo);
+		}
+		asset.Close();
+
+		// One slice per frame, which Intersect and Reproject pick by the frame index. Or one slice per sample for the accumulation passes.
+		ImageVK::CreateInfo blueNoiseCreateInfo = {};
+		blueNoiseCreateInfo.format = VK_FORMAT_R8G8_UNORM;
+		blueNoiseCreateInfo.width = 128;
+		blueNoiseCreateInfo.height = 128;
+		blueNoiseCreateInfo.arrayLayers = sliceCount;
+		texture = ImageVK(m_pDevice, blueNoiseCreateInfo, sampleSet ? "SSSR - Accumulation Noise Texture" : "Reflection Denoiser - Blue Noise Texture");
+
+		ShaderPass& blueNoisePass = bake.pass;
+		{
+			uint32_t binding = 0;
+			VkDescriptorSetLayoutBinding layoutBindings[] = {
+				Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_sobol_buffer
+				Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_ranking_tile_buffer
+				Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_scrambling_tile_buffer
+				Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_blue_noise_texture
+			};
+
+			DefineList defines;
+			if (sampleSet)
+			{
+				defines["SAMPLE_SET"] = "1";
+			}
+			SetupShaderPass(blueNoisePass, "PrepareBlueNoiseTexture.hlsl", layoutBindings, _countof(layoutBindings), &defines);
+		}
+
+		VkDescriptorSet targetSet = blueNoisePass.descriptorSets[0];
 		uint32_t binding = 0;
-		VkDescriptorSetLayoutBinding layoutBindings[] = {
-			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_sobol_buffer
-			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_ranking_tile_buffer
-			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_scrambling_tile_buffer
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_blue_noise_texture
-		};
+		SetDescriptorSetBuffer(device, binding++, sampler.sobolBuffer.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+		SetDescriptorSetBuffer(device, binding++, sampler.rankingTileBuffer.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+		SetDescriptorSetBuffer(device, binding++, sampler.scramblingTileBuffer.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+		SetDescriptorSet(device, binding++, texture.View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+		return tables.samplesPerPixel;
+	}
 
-		SetupShaderPass(m_blueNoisePass, "PrepareBlueNoiseTexture.hlsl", layoutBindings, _countof(layoutBindings));
+	bool SSSR::OpenSpatiotemporalBlueNoiseAsset(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset, size_t* pUploadSize)
+	{
+		if (!asset.Open(g_spatiotemporalBlueNoiseAssetPath))
+		{
+			Trace("Failed to open the spatiotemporal blue noise asset %s, falling back to the baked blue noise", g_spatiotemporalBlueNoiseAssetPath);
+			return false;
+		}
+		*pUploadSize = asset.GetFrameCount() * AlignUp((size_t)asset.GetSliceSize(), g_uploadAlignment);
+		return true;
+	}
+
+	void SSSR::LoadSpatiotemporalBlueNoiseTexture(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset)
+	{
+		// The asset already holds one slice per frame, so it is copied as is.
+		ImageVK::CreateInfo blueNoiseCreateInfo = {};
+		blueNoiseCreateInfo.format = VK_FORMAT_R8G8_UNORM;
+		blueNoiseCreateInfo.width = asset.GetWidth();
+		blueNoiseCreateInfo.height = asset.GetHeight();
+		blueNoiseCreateInfo.arrayLayers = asset.GetFrameCount();
+		m_blueNoiseTexture = ImageVK(m_pDevice, blueNoiseCreateInfo, "Reflection Denoiser - Spatiotemporal Blue Noise Texture");
+
+		VkImageMemoryBarrier barrier = m_blueNoiseTexture.Transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		m_uploadHeap.AddPreBarrier(barrier);
+
+		// The upload heap was sized for all slices in OnCreate.
+		const uint32_t sliceSize = asset.GetSliceSize();
+		for (uint32_t i = 0; i < asset.GetFrameCount(); ++i)
+		{
+			uint8_t* destAddr = m_uploadHeap.BeginSuballocate(sliceSize, g_uploadAlignment);
+			memcpy(destAddr, asset.GetSlice(i), sliceSize);
+			m_uploadHeap.EndSuballocate();
+
+			VkBufferImageCopy copyInfo = {};
+			copyInfo.bufferOffset = destAddr - m_uploadHeap.BasePtr();
+			copyInfo.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copyInfo.imageSubresource.mipLevel = 0;
+			copyInfo.imageSubresource.baseArrayLayer = i;
+			copyInfo.imageSubresource.layerCount = 1;
+			copyInfo.imageExtent = { asset.GetWidth(), asset.GetHeight(), 1 };
+			m_uploadHeap.AddCopy(m_blueNoiseTexture.Resource(), copyInfo);
+		}
+		asset.Close();
+
+		// The copies and the transition for the compute passes are submitted by WaitForCreation.
+		m_spatiotemporalBlueNoisePending = true;
 	}
 
 	void SSSR::SetupPrepareIndirectArgsPass()
@@ -882,6 +1787,19 @@ namespace SSSR_SAMPLE_VK
 		SetupShaderPass(m_prepareIndirectArgsPass, "PrepareIndirectArgs.hlsl", layoutBindings, _countof(layoutBindings));
 	}
 
+	void SSSR::SetupPreparePrefilterArgsPass()
+	{
+		uint32_t binding = 0;
+		VkDescriptorSetLayoutBinding layoutBindings[] = {
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_counter
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_intersect_args
+		};
+
+		DefineList defines;
+		defines["PREPARE_PREFILTER_ARGS"] = "1";
+		SetupShaderPass(m_preparePrefilterArgsPass, "PrepareIndirectArgs.hlsl", layoutBindings, _countof(layoutBindings), &defines);
+	}
+
 	void SSSR::SetupIntersectionPass()
 	{
 		uint32_t binding = 0;
@@ -901,8 +1819,52 @@ namespace SSSR_SAMPLE_VK
 			//Output
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_intersection_result
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_counter
+
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_depth_buffer
 		};
-		SetupShaderPass(m_intersectPass, "Intersect.hlsl", layoutBindings, _countof(layoutBindings));
+
+		// Specialized permutation per tile class
+		for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+		{
+			DefineList defines;
+			defines["TILE_CLASS"] = g_tileClassDefines[tileClass];
+			SetupShaderPass(m_intersectPass[tileClass], "Intersect.hlsl", layoutBindings, _countof(layoutBindings), &defines, g_intersectWaveSize, g_intersectPermutationMask);
+		}
+
+		if (m_accumulationSamplesPerPixel > 0)
+		{
+			std::vector<VkDescriptorSetLayoutBinding> accumulateLayoutBindings(layoutBindings, layoutBindings + _countof(layoutBindings));
+			accumulateLayoutBindings.push_back(Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE)); // g_accumulated_radiance
+
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
+			{
+				DefineList defines;
+				defines["TILE_CLASS"] = g_tileClassDefines[tileClass];
+				defines["ACCUMULATION_SAMPLE_COUNT"] = std::to_string(m_accumulationSamplesPerPixel);
+				SetupShaderPass(m_accumulatePass[tileClass], "Intersect.hlsl", accumulateLayoutBindings.data(), (uint32_t)accumulateLayoutBindings.size(), &defines, g_intersectWaveSize, g_intersectPermutationMask);
+			}
+		}
+	}
+
+	void SSSR::SetupEnvironmentMapPass()
+	{
+		uint32_t binding = 0;
+		VkDescriptorSetLayoutBinding layoutBindings[] = {
+			//Input
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_roughness
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_depth_buffer
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_environment_map
+			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_environment_map_list
+
+			//Samplers
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLER), // g_environment_map_sampler
+
+			//Output
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_intersection_output
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_counter
+		};
+		SetupShaderPass(m_environmentMapPass, "SampleEnvironmentMap.hlsl", layoutBindings, _countof(layoutBindings));
 	}
 
 	void SSSR::SetupResolveTemporalPass()
@@ -914,20 +1876,28 @@ namespace SSSR_SAMPLE_VK
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_average_radiance
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_radiance
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_reprojected_radiance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_variance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_sample_count
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_variance_sample_count
 			
 			//Samplers
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLER), // g_linear_sampler
 
 			//Output
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_radiance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_sample_count
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance_sample_count
 
 			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_denoiser_tile_list
+
+			// Only used by the permutation applying the reflections
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_specular_roughness
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_brdf_lut
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_lit_scene
 		};
-		SetupShaderPass(m_resolveTemporalPass, "ResolveTemporal.hlsl", layoutBindings, _countof(layoutBindings));
+		SetupShaderPass(m_resolveTemporalPass, "ResolveTemporal.hlsl", layoutBindings, _countof(layoutBindings) - 4);
+
+		DefineList defines;
+		defines["APPLY_REFLECTIONS"] = "1";
+		SetupShaderPass(m_resolveTemporalApplyPass, "ResolveTemporal.hlsl", layoutBindings, _countof(layoutBindings), &defines);
 	}
 
 	void SSSR::SetupPrefilterPass()
@@ -940,21 +1910,23 @@ namespace SSSR_SAMPLE_VK
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_average_radiance
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_radiance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_variance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_sample_count
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_variance_sample_count
 
 			//Samplers
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLER), // g_linear_sampler
 
 			//Output
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_radiance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_sample_count
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance_sample_count
 
 			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_denoiser_tile_list
 		};
 
 		SetupShaderPass(m_prefilterPass, "Prefilter.hlsl", layoutBindings, _countof(layoutBindings));
+
+		DefineList defines;
+		defines["PASS_THROUGH"] = "1";
+		SetupShaderPass(m_prefilterPassThroughPass, "Prefilter.hlsl", layoutBindings, _countof(layoutBindings), &defines);
 	}
 
 	void SSSR::SetupReprojectPass()
@@ -972,8 +1944,7 @@ namespace SSSR_SAMPLE_VK
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_radiance_history
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_motion_vector
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_average_radiance_history
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_variance_history
-			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_sample_count_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_variance_sample_count_history
 			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_blue_noise_texture
 
 			//Samplers
@@ -982,42 +1953,189 @@ namespace SSSR_SAMPLE_VK
 			//Output
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_reprojected_radiance
 			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_average_radiance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance
-			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_sample_count
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance_sample_count
 
 			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_denoiser_tile_list
+
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_ray_counter
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_spatial_filter_tile_list
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER), // g_converged_tile_list
 		};
 		SetupShaderPass(m_reprojectPass, "Reproject.hlsl", layoutBindings, _countof(layoutBindings));
 	}
 
-	void SSSR::ComputeBarrier(VkCommandBuffer commandBuffer) const
+	void SSSR::SetupFusedDenoiserPass()
 	{
-		VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
-		barrier.pNext = nullptr;
-		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		vkCmdPipelineBarrier(commandBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			0,
-			1, &barrier,
-			0, nullptr,
-			0, nullptr);
+		uint32_t binding = 0;
+		VkDescriptorSetLayoutBinding layoutBindings[] = {
+			//Input
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_depth_buffer
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_roughness
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_depth_buffer_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_roughness_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_normal_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_radiance
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_radiance_history
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_motion_vector
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_variance_sample_count_history
+
+			//Samplers
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLER), // g_linear_sampler
+
+			//Output
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_radiance
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_average_radiance
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_variance_sample_count
+
+			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_denoiser_tile_list
+
+			// Only used by the permutation applying the reflections
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_specular_roughness
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_brdf_lut
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_lit_scene
+		};
+		SetupShaderPass(m_fusedDenoiserPass, "FusedDenoiser.hlsl", layoutBindings, _countof(layoutBindings) - 3);
+
+		DefineList defines;
+		defines["APPLY_REFLECTIONS"] = "1";
+		SetupShaderPass(m_fusedDenoiserApplyPass, "FusedDenoiser.hlsl", layoutBindings, _countof(layoutBindings), &defines);
 	}
 
-	void SSSR::IndirectArgumentsBarrier(VkCommandBuffer commandBuffer) const
+	void SSSR::SetupCopyDenoiserTilesPass()
 	{
-		VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
-		barrier.pNext = nullptr;
-		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
-		vkCmdPipelineBarrier(commandBuffer,
-			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-			VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
-			0,
-			1, &barrier,
-			0, nullptr,
-			0, nullptr);
+		uint32_t binding = 0;
+		VkDescriptorSetLayoutBinding layoutBindings[] = {
+			//Input
+			Bind(binding++, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE), // g_in_radiance
+			Bind(binding++, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER), // g_denoiser_tile_list
+
+			//Output
+			Bind(binding++, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE), // g_out_radiance
+		};
+		SetupShaderPass(m_copyDenoiserTilesPass, "CopyDenoiserTiles.hlsl", layoutBindings, _countof(layoutBindings));
+	}
+
+	void SSSR::CopyMipUsage(VkCommandBuffer commandBuffer, uint32_t readbackIndex)
+	{
+		VkBufferCopy region = {};
+		region.srcOffset = g_mipUsageCounterOffset;
+		region.dstOffset = readbackIndex * DEPTH_HIERARCHY_MAX_MIP_COUNT * sizeof(uint32_t);
+		region.size = DEPTH_HIERARCHY_MAX_MIP_COUNT * sizeof(uint32_t);
+		vkCmdCopyBuffer(commandBuffer, m_rayCounter.m_buffer, m_mipUsageReadback.m_buffer, 1, &region);
+
+		VkBufferMemoryBarrier readbackBarrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		readbackBarrier.pNext = nullptr;
+		readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		readbackBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		readbackBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		readbackBarrier.buffer = m_mipUsageReadback.m_buffer;
+		readbackBarrier.offset = 0;
+		readbackBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &readbackBarrier, 0, nullptr);
+
+		m_mipUsageReadbackPending[readbackIndex] = true;
+	}
+
+	void SSSR::CopyOutput(VkCommandBuffer commandBuffer, uint32_t bufferIndex, uint32_t frameIndex)
+	{
+		if (!m_outputReadback.m_buffer)
+		{
+			// Coherent, so the copied output is visible to the mapped pointer without invalidating it.
+			BufferVK::CreateInfo createInfo = {};
+			createInfo.memoryPropertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			createInfo.format = VK_FORMAT_UNDEFINED;
+			createInfo.bufferUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+			createInfo.sizeInBytes = m_outputWidth * m_outputHeight * 4 * sizeof(uint16_t);
+			m_outputReadback = BufferVK(m_pDevice->GetDevice(), m_pDevice->GetPhysicalDevice(), createInfo, "SSSR - Output Readback");
+			m_outputReadback.Map(reinterpret_cast<void**>(&m_pOutputReadbackData));
+		}
+
+		VkBufferImageCopy region = {};
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageExtent = { m_outputWidth, m_outputHeight, 1 };
+		vkCmdCopyImageToBuffer(commandBuffer, m_radiance[bufferIndex].Resource(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_outputReadback.m_buffer, 1, &region);
+
+		VkBufferMemoryBarrier readbackBarrier = { VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		readbackBarrier.pNext = nullptr;
+		readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		readbackBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		readbackBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		readbackBarrier.buffer = m_outputReadback.m_buffer;
+		readbackBarrier.offset = 0;
+		readbackBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &readbackBarrier, 0, nullptr);
+
+		m_outputReadbackRequested = false;
+		m_outputReadbackPending = true;
+		m_outputReadbackFrameIndex = frameIndex;
+	}
+
+	void SSSR::IssueBarriers(VkCommandBuffer commandBuffer, const RenderGraphBarrier* pBarriers, uint32_t barrierCount)
+	{
+		VkPipelineStageFlags srcStageMask = 0;
+		VkPipelineStageFlags dstStageMask = 0;
+		// Buffers and images that keep their layout share one global memory barrier.
+		VkMemoryBarrier memoryBarrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		memoryBarrier.pNext = nullptr;
+		memoryBarrier.srcAccessMask = 0;
+		memoryBarrier.dstAccessMask = 0;
+		VkImageMemoryBarrier imageBarriers[32];
+		uint32_t imageBarrierCount = 0;
+
+		for (uint32_t i = 0; i < barrierCount; ++i)
+		{
+			const RenderGraphBarrier& barrier = pBarriers[i];
+			// A split barrier would take an event per transition, which does not pay off for back to back compute passes.
+			// The transition is done in full where the split barrier ends instead.
+			if (barrier.phase == BarrierPhase::Begin)
+			{
+				continue;
+			}
+
+			ResourceStateInfo before = GetResourceStateInfo(barrier.before);
+			ResourceStateInfo after = GetResourceStateInfo(barrier.after);
+			srcStageMask |= before.stageMask;
+			dstStageMask |= after.stageMask;
+
+			const GraphImage& image = m_graphImages[barrier.resource];
+			bool isImage = image.pImage || image.image != VK_NULL_HANDLE;
+			if (!isImage || before.layout == after.layout)
+			{
+				memoryBarrier.srcAccessMask |= before.accessMask & g_writeAccessMask;
+				memoryBarrier.dstAccessMask |= after.accessMask;
+				continue;
+			}
+
+			assert(imageBarrierCount < _countof(imageBarriers));
+			VkImageMemoryBarrier& imageBarrier = imageBarriers[imageBarrierCount++];
+			if (image.pImage)
+			{
+				imageBarrier = image.pImage->Transition(after.layout);
+				assert(imageBarrier.oldLayout == before.layout);
+			}
+			else
+			{
+				imageBarrier = Transition(image.image, before.layout, after.layout);
+				imageBarrier.subresourceRange.levelCount = image.mipCount;
+			}
+			imageBarrier.srcAccessMask = before.accessMask & g_writeAccessMask;
+			imageBarrier.dstAccessMask = after.accessMask;
+		}
+
+		if (srcStageMask == 0)
+		{
+			return;
+		}
+		// Hazards after reads only need the execution dependency.
+		uint32_t memoryBarrierCount = memoryBarrier.srcAccessMask != 0 ? 1 : 0;
+		vkCmdPipelineBarrier(commandBuffer, srcStageMask, dstStageMask, 0, memoryBarrierCount, &memoryBarrier, 0, nullptr, imageBarrierCount, imageBarriers);
 	}
 
 	void SSSR::TransitionBarriers(VkCommandBuffer commandBuffer, const VkImageMemoryBarrier* imageBarriers, uint32_t imageBarrierCount) const
@@ -1070,54 +2188,112 @@ namespace SSSR_SAMPLE_VK
 				binding = 0;
 
 				SetDescriptorSet(device, binding++, input.SpecularRoughnessView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, input.DepthHierarchyView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_variance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, input.EnvironmentMapView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSetSampler(device, binding++, input.EnvironmentMapSampler, targetSet); // g_environment_map_sampler
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.MotionVectorsView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_radiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-				SetDescriptorSetBuffer(device, binding++, m_rayList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_rayList[TILE_CLASS_MIRROR].m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_rayList[TILE_CLASS_GLOSSY].m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_rayList[TILE_CLASS_ROUGH].m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 				SetDescriptorSetBuffer(device, binding++, m_rayCounter.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_roughnessTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
 				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_environmentMapList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_tileHistory.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_reflectionTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+
+				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_depthHistoryTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_normalHistoryTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+
+				if (m_fusedDepthDownsample)
+				{
+					for (uint32_t mip = 0; mip < DEPTH_HIERARCHY_MAX_MIP_COUNT; ++mip)
+					{
+						SetDescriptorSet(device, binding, input.DepthHierarchyMipViews[mip], targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL, mip);
+					}
+					binding++;
+					SetDescriptorSetBuffer(device, binding++, input.DepthHierarchyAtomicCounterView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				}
 			}
 
-			// Blue Noise pass
+			// Indirect args pass
 			{
-				targetSet = m_blueNoisePass.descriptorSets[i];
+				targetSet = m_prepareIndirectArgsPass.descriptorSets[i];
 				binding = 0;
 
-				SetDescriptorSetBuffer(device, binding++, m_blueNoiseSampler.sobolBuffer.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
-				SetDescriptorSetBuffer(device, binding++, m_blueNoiseSampler.rankingTileBuffer.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
-				SetDescriptorSetBuffer(device, binding++, m_blueNoiseSampler.scramblingTileBuffer.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
-
-				SetDescriptorSet(device, binding++, m_blueNoiseTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSetBuffer(device, binding++, m_rayCounter.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_intersectionPassIndirectArgs.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 			}
 
-			// Indirect args pass
+			// Prefilter args pass
 			{
-				targetSet = m_prepareIndirectArgsPass.descriptorSets[i];
+				targetSet = m_preparePrefilterArgsPass.descriptorSets[i];
 				binding = 0;
 
 				SetDescriptorSetBuffer(device, binding++, m_rayCounter.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 				SetDescriptorSetBuffer(device, binding++, m_intersectionPassIndirectArgs.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 			}
 
-			// Intersection pass
+			// Intersection passes
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT; ++tileClass)
 			{
-				targetSet = m_intersectPass.descriptorSets[i];
+				targetSet = m_intersectPass[tileClass].descriptorSets[i];
 				binding = 0;
 
 				SetDescriptorSet(device, binding++, input.HDRView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, input.DepthHierarchyView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_roughnessTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, input.EnvironmentMapView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 				SetDescriptorSet(device, binding++, m_blueNoiseTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSetBuffer(device, binding++, m_rayList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_rayList[tileClass].m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+
+				SetDescriptorSetSampler(device, binding++, input.EnvironmentMapSampler, targetSet); // g_environment_map_sampler
+
+				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSetBuffer(device, binding++, m_rayCounter.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+			}
+
+			// Accumulation passes. Same as the intersection passes, but with the sample set instead of the per frame noise.
+			for (uint32_t tileClass = 0; tileClass < TILE_CLASS_COUNT && m_accumulationSamplesPerPixel > 0; ++tileClass)
+			{
+				targetSet = m_accumulatePass[tileClass].descriptorSets[i];
+				binding = 0;
+
+				SetDescriptorSet(device, binding++, input.HDRView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.DepthHierarchyView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.EnvironmentMapView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+				SetDescriptorSet(device, binding++, m_accumulationNoiseTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSetBuffer(device, binding++, m_rayList[tileClass].m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+
+				SetDescriptorSetSampler(device, binding++, input.EnvironmentMapSampler, targetSet); // g_environment_map_sampler
+
+				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSetBuffer(device, binding++, m_rayCounter.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_accumulatedRadiance.View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+			}
+
+			// Environment map pass
+			{
+				targetSet = m_environmentMapPass.descriptorSets[i];
+				binding = 0;
+
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.EnvironmentMapView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSetBuffer(device, binding++, m_environmentMapList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
 
 				SetDescriptorSetSampler(device, binding++, input.EnvironmentMapSampler, targetSet); // g_environment_map_sampler
 
@@ -1130,50 +2306,53 @@ namespace SSSR_SAMPLE_VK
 				targetSet = m_reprojectPass.descriptorSets[i];
 				binding = 0;
 
-				SetDescriptorSet(device, binding++, input.DepthHierarchyView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_roughnessTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_depthHistoryTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_roughnessHistoryTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_normalHistoryTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_depthHistoryTexture[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_normalHistoryTexture[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_radiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, input.MotionVectorsView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 				SetDescriptorSet(device, binding++, m_averageRadiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_variance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_sampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_blueNoiseTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
 				SetDescriptorSetSampler(device, binding++, m_linearSampler, targetSet);
 
 				SetDescriptorSet(device, binding++, m_reprojectedRadiance.View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
 				SetDescriptorSet(device, binding++, m_averageRadiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_variance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_sampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
 				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+
+				SetDescriptorSetBuffer(device, binding++, m_rayCounter.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_spatialFilterTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSetBuffer(device, binding++, m_convergedTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 			}
 
-			// Prefilter pass
+			// Prefilter passes. The pass through only differs in the tile list it consumes.
+			ShaderPass* prefilterPasses[] = { &m_prefilterPass, &m_prefilterPassThroughPass };
+			BufferVK* prefilterTileLists[] = { &m_spatialFilterTileList, &m_convergedTileList };
+			for (uint32_t pass = 0; pass < _countof(prefilterPasses); ++pass)
 			{
-				targetSet = m_prefilterPass.descriptorSets[i];
+				targetSet = prefilterPasses[pass]->descriptorSets[i];
 				binding = 0;
 
-				SetDescriptorSet(device, binding++, input.DepthHierarchyView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_roughnessTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_averageRadiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_variance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_sampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				
 				SetDescriptorSetSampler(device, binding++, m_linearSampler, targetSet);
 
 				SetDescriptorSet(device, binding++, m_radiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_variance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_sampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSetBuffer(device, binding++, prefilterTileLists[pass]->m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
 			}
 
 			// Temporal denoising pass
@@ -1181,20 +2360,83 @@ namespace SSSR_SAMPLE_VK
 				targetSet = m_resolveTemporalPass.descriptorSets[i];
 				binding = 0;
 
-				SetDescriptorSet(device, binding++, m_roughnessTexture.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_averageRadiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_radiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				SetDescriptorSet(device, binding++, m_reprojectedRadiance.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_variance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-				SetDescriptorSet(device, binding++, m_sampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 				
 				SetDescriptorSetSampler(device, binding++, m_linearSampler, targetSet);
 
 				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_variance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
-				SetDescriptorSet(device, binding++, m_sampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
 				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
 			}
+
+			// Temporal denoising pass applying the reflections to the lit scene
+			{
+				targetSet = m_resolveTemporalApplyPass.descriptorSets[i];
+				binding = 0;
+
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_averageRadiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_radiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_reprojectedRadiance.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+				SetDescriptorSetSampler(device, binding++, m_linearSampler, targetSet);
+
+				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+
+				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.SpecularRoughnessView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.BrdfLutView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.HDRView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+			}
+
+			// Fused denoiser passes
+			for (ShaderPass* pass : { &m_fusedDenoiserPass, &m_fusedDenoiserApplyPass })
+			{
+				targetSet = pass->descriptorSets[i];
+				binding = 0;
+
+				SetDescriptorSet(device, binding++, input.DepthBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.NormalBufferView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_depthHistoryTexture[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_roughnessTexture[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_normalHistoryTexture[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_radiance[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, input.MotionVectorsView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[1 - i].View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+				SetDescriptorSetSampler(device, binding++, m_linearSampler, targetSet);
+
+				SetDescriptorSet(device, binding++, m_reprojectedRadiance.View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_averageRadiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSet(device, binding++, m_varianceSampleCount[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+
+				if (pass == &m_fusedDenoiserApplyPass)
+				{
+					SetDescriptorSet(device, binding++, input.SpecularRoughnessView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+					SetDescriptorSet(device, binding++, input.BrdfLutView, targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+					SetDescriptorSet(device, binding++, input.HDRView, targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+				}
+			}
+
+			// Copy of the fused denoiser results
+			{
+				targetSet = m_copyDenoiserTilesPass.descriptorSets[i];
+				binding = 0;
+
+				SetDescriptorSet(device, binding++, m_reprojectedRadiance.View(), targetSet, VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+				SetDescriptorSetBuffer(device, binding++, m_denoiserTileList.m_bufferView, targetSet, VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+				SetDescriptorSet(device, binding++, m_radiance[i].View(), targetSet, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_IMAGE_LAYOUT_GENERAL);
+			}
 		}
 	}
 }
\ No newline at end of file
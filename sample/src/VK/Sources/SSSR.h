@@ -33,22 +33,50 @@ THE SOFTWARE.
 
 #include "ShaderPass.h"
 #include "BlueNoiseSampler.h"
+#include "../../Common/BlueNoiseAsset.h"
+#include "../../Common/ShaderBlobLibrary.h"
+#include "../../Common/PipelineCacheFile.h"
+#include "../../Common/RenderGraph.h"
 
 using namespace CAULDRON_VK;
 namespace SSSR_SAMPLE_VK
 {
+	// Maximum number of mips in the depth hierarchy. This is the limit of the downsampling lib (4096x4096). Must match Common.hlsl.
+	static const uint32_t DEPTH_HIERARCHY_MAX_MIP_COUNT = 13;
+	// Number of frames in the baked blue noise texture array. The shaders read the frame count from the texture.
+	static const uint32_t BLUE_NOISE_FRAME_COUNT = 256;
+
 	struct SSSRCreationInfo {
+		Texture* HDR;
 		VkImageView HDRView;
 		Texture* DepthHierarchy;
 		VkImageView DepthHierarchyView;
+		// Mip 0 of the depth hierarchy. Either the depth buffer itself or, if the hierarchy stores linear depth, its first mip.
+		VkImageView DepthBufferView;
+		// Only used if the tile classification builds the depth hierarchy. One storage view per mip, the entries past the last mip point at a single texel dummy.
+		VkImageView DepthHierarchyMipViews[DEPTH_HIERARCHY_MAX_MIP_COUNT];
+		uint32_t DepthHierarchyMipCount;
+		VkBufferView DepthHierarchyAtomicCounterView;
 		VkImageView MotionVectorsView;
 		Texture* NormalBuffer;
 		VkImageView NormalBufferView;
 		VkImageView SpecularRoughnessView;
 		VkImageView EnvironmentMapView;
 		VkSampler EnvironmentMapSampler;
+		VkImageView BrdfLutView;
 		uint32_t outputWidth;
 		uint32_t outputHeight;
+		// Stores the depth history in 16 instead of 32 bits and the octahedral normal history in 2x8 instead of 2x16 bits.
+		bool lowPrecisionHistory;
+	};
+
+	// Tiles are sorted into one of these classes by the roughness of their reflective pixels. Must match Common.hlsl.
+	enum TileClass
+	{
+		TILE_CLASS_MIRROR,
+		TILE_CLASS_GLOSSY,
+		TILE_CLASS_ROUGH,
+		TILE_CLASS_COUNT
 	};
 
 	struct SSSRConstants
@@ -64,45 +92,114 @@ namespace SSSR_SAMPLE_VK
 		float temporalStabilityFactor;
 		float depthBufferThickness;
 		float roughnessThreshold;
+		// Glossy reflections above this fraction of the roughness threshold are traced starting from a coarser depth mip.
+		float roughReflectionFraction;
 		float varianceThreshold;
+		// Caps the number of samples the temporal accumulation of both denoiser paths averages over.
+		uint32_t maxSampleCount;
+		// Tuning of the fused denoiser. Its reprojection and spatial filter have no separate passes to read them from.
+		float disocclusionThreshold;
+		float spatialFilterNormalSigma;
+		float spatialFilterDepthSigma;
+		float spatialFilterLuminanceSigma;
+		float neighborhoodClampSigma;
 		uint32_t frameIndex;
 		uint32_t maxTraversalIntersections;
+		// Active lanes per 32 below which a wave stops the traversal, scaled to the actual wave width by Intersect.hlsl.
 		uint32_t minTraversalOccupancy;
 		uint32_t mostDetailedMip;
 		uint32_t samplesPerQuad;
 		uint32_t temporalVarianceGuidedTracingEnabled;
+		uint32_t applyReflectionsInResolve;
+		uint32_t convergedRaySkippingEnabled;
+		// Depth distance a ray may fall behind a low precision hierarchy before it counts as a hit.
+		float depthHierarchyTolerance;
+		// Screen space depth = linearDepthParameters[0] + linearDepthParameters[1] / linear depth. Used by the linear depth hierarchy.
+		float linearDepthParameters[2];
+		float linearFarDepth;
+		// Coarsest mip of the depth hierarchy. The traversal never climbs past it.
+		uint32_t maxTraversalMip;
+		// Counts the rays by the coarsest mip their traversal reached, see GetMipUsage.
+		uint32_t mipUsageStatisticsEnabled;
 	};
 
 	class SSSR
 	{
 	public:
-		void OnCreate(Device* pDevice, VkCommandBuffer commandBuffer, ResourceViewHeaps* resourceHeap, DynamicBufferRing* constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters);
+		void OnCreate(Device* pDevice, VkCommandBuffer commandBuffer, ResourceViewHeaps* resourceHeap, DynamicBufferRing* constantBufferRing, uint32_t frameCountBeforeReuse, bool enablePerformanceCounters, bool linearDepthHierarchy, bool halfPrecisionDepthHierarchy, bool fusedDepthDownsample, uint32_t blueNoiseSamplesPerPixel, bool spatiotemporalBlueNoise, uint32_t accumulationSamplesPerPixel, bool subgroupSizeControlEnabled, bool pipelineCreationFeedbackEnabled, AsyncPool* pAsyncPool);
 		void OnCreateWindowSizeDependentResources(VkCommandBuffer commandBuffer, const SSSRCreationInfo& input);
 
 		void OnDestroy();
 		void OnDestroyWindowSizeDependentResources();
+		// Blocks until the pipelines compiled on the async pool are done and submits the uploads of OnCreate. Called by the first Draw.
+		void WaitForCreation();
 
-		void Draw(VkCommandBuffer commandBuffer, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult);
+		// If reuseStaticFrames is set, skips all work and keeps the last output if the scene is static and the constants did not change for a while.
+		// If accumulate is set and the accumulation mode was enabled at creation, the output is instead the average of all samples traced since the scene or the constants last changed.
+		// sceneRevision changes whenever something the reflections depend on changed that the constants do not describe, like the lighting.
+		void Draw(VkCommandBuffer commandBuffer, const SSSRConstants& sssrConstants, GPUTimestamps& gpuTimer, bool showIntersectResult, bool useFusedDenoiser, bool isSceneStatic, bool reuseStaticFrames, uint32_t sceneRevision, bool accumulate);
 		void GUI(int* pSlice);
 		VkImageView GetOutputTextureView(int frame) const;
+		// Index of the output texture written by the last frame that ran the effect.
+		uint32_t GetOutputIndex() const;
+		// Only the tiles in this list contain reflections. The draw arguments cover them with one quad of six vertices per tile.
+		VkBufferView GetReflectionTileListView() const;
+		VkBuffer GetReflectionTileDrawArgsBuffer() const;
+		uint32_t GetReflectionTileDrawArgsOffset() const;
+		// Number of rays per coarsest depth hierarchy mip their traversal reached. Lags a few frames behind and is only updated while mipUsageStatisticsEnabled is set.
+		const uint32_t* GetMipUsage() const;
+		// Samples per traced pixel averaged by the accumulation mode so far. Zero if the accumulation mode is disabled.
+		uint32_t GetAccumulatedSampleCount() const;
+		// Pipelines created since OnCreate, split by whether the persistent pipeline cache already had them.
+		const SSSR_SAMPLE_COMMON::PipelineCacheStatistics& GetPipelineCacheStatistics() const;
+		// Copies the output of the next frame that runs the effect into host memory, see GetOutputReadback.
+		void RequestOutputReadback();
+		// The output copied since the last RequestOutputReadback as RGBA16F rows of rowPitch bytes.
+		// Null until the copy has finished, which takes as many frames as there are frames in flight.
+		const uint16_t* GetOutputReadback(uint32_t* pRowPitch) const;
 
 	private:
 		void CreateResources(VkCommandBuffer commandBuffer);
 		void CreateWindowSizeDependentResources(VkCommandBuffer commandBuffer);
 
-		void SetupShaderPass(ShaderPass& pass, const char* shader, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, VkPipelineShaderStageCreateFlags flags = 0);
+		// Loads the pipeline cache of the last run if it was written by the same device and driver.
+		void CreatePipelineCache();
+		void SavePipelineCache();
+		// Passes with a permutationMask compile their pipelines lazily, see GetPipeline.
+		void SetupShaderPass(ShaderPass& pass, const char* shader, const VkDescriptorSetLayoutBinding* bindings, uint32_t bindingsCount, const DefineList* pDefines = nullptr, uint32_t waveSize = 0, uint32_t permutationMask = 0);
+		VkPipeline CreatePipeline(const ShaderPass& pass, const DefineList& defines);
+		// Returns the subgroup size a pass written for preferredWaveSize lanes is compiled with. Zero if the driver picks it.
+		uint32_t GetWaveSize(uint32_t preferredWaveSize) const;
+		// Compiles the pipeline of the pass on the async pool, see WaitForCreation.
+		void CreatePipelineAsync(ShaderPass& pass);
+		// Returns the permutation of the pass that matches the options of the constants. Compiles it on first use.
+		VkPipeline GetPipeline(ShaderPass& pass, const SSSRConstants& sssrConstants);
 		void SetupClassifyTilesPass();
-		void SetupBlueNoisePass();
 		void SetupPrepareIndirectArgsPass();
+		void SetupPreparePrefilterArgsPass();
 		void SetupIntersectionPass();
+		void SetupEnvironmentMapPass();
 		void SetupResolveTemporalPass();
 		void SetupPrefilterPass();
 		void SetupReprojectPass();
+		void SetupFusedDenoiserPass();
+		void SetupCopyDenoiserTilesPass();
+		// Bakes a blue noise texture from the sampler of the blue noise asset that is optimized for samplesPerPixel.
+		// Either one slice per frame or, if sampleSet is set, one slice per sample of the sampler. Returns the sample count of the sampler used.
+		uint32_t BakeBlueNoiseTexture(ImageVK& texture, uint32_t samplesPerPixel, bool sampleSet);
+		// Opens the spatiotemporal blue noise asset and returns the upload heap space its slices take. Returns false if the asset is missing or invalid.
+		bool OpenSpatiotemporalBlueNoiseAsset(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset, size_t* pUploadSize);
+		// Uploads the opened spatiotemporal blue noise asset into the blue noise texture.
+		void LoadSpatiotemporalBlueNoiseTexture(SSSR_SAMPLE_COMMON::SpatiotemporalBlueNoiseAsset& asset);
 
 		void InitializeResourceDescriptorSets(const SSSRCreationInfo& input);
+		bool IsStaticFrame(const SSSRConstants& sssrConstants, bool showIntersectResult, bool isSceneStatic);
 
-		void ComputeBarrier(VkCommandBuffer commandBuffer) const;
-		void IndirectArgumentsBarrier(VkCommandBuffer commandBuffer) const;
+		// Registers the resources that Draw schedules with the render graph, in the states they are in after creation.
+		void AddGraphResources();
+		void IssueBarriers(VkCommandBuffer commandBuffer, const SSSR_SAMPLE_COMMON::RenderGraphBarrier* pBarriers, uint32_t barrierCount);
+		void CopyMipUsage(VkCommandBuffer commandBuffer, uint32_t readbackIndex);
+		void CopyOutput(VkCommandBuffer commandBuffer, uint32_t bufferIndex, uint32_t frameIndex);
 		void TransitionBarriers(VkCommandBuffer commandBuffer, const VkImageMemoryBarrier* imageBarriers, uint32_t imageBarrierCount) const;
 		VkImageMemoryBarrier Transition(VkImage image, VkImageLayout before, VkImageLayout after) const;
 
@@ -110,6 +207,37 @@ namespace SSSR_SAMPLE_VK
 		DynamicBufferRing* m_pConstantBufferRing;
 		ResourceViewHeaps* m_pResourceViewHeaps;
 		UploadHeapVK m_uploadHeap;
+		// SPIR-V of the permutations compiled at build time. Everything else is compiled on first use.
+		SSSR_SAMPLE_COMMON::ShaderBlobLibrary m_shaderBlobs;
+		// Persisted across runs, see g_pipelineCachePath.
+		VkPipelineCache m_pipelineCache = VK_NULL_HANDLE;
+		// Size and hash of the data the cache was created from. The file is only rewritten if the data changed.
+		size_t m_loadedPipelineCacheSize = 0;
+		uint64_t m_loadedPipelineCacheHash = 0;
+		SSSR_SAMPLE_COMMON::PipelineCacheStatistics m_pipelineCacheStatistics;
+		// Pipelines are created from several threads.
+		std::mutex m_pipelineCacheStatisticsMutex;
+
+		// Compiles the pipelines of OnCreate. Null if they are compiled on the calling thread.
+		AsyncPool* m_pAsyncPool = nullptr;
+		// Counts the pipelines that are still being compiled.
+		Sync m_pipelineSync;
+		// Set from OnCreate until WaitForCreation.
+		bool m_creationPending = false;
+		// The spatiotemporal blue noise is transitioned for the compute passes once its copies are recorded.
+		bool m_spatiotemporalBlueNoisePending = false;
+
+		// A blue noise texture that WaitForCreation bakes once the pipeline of its pass is compiled.
+		struct BlueNoiseBake
+		{
+			ImageVK* pTexture;
+			uint32_t sliceCount;
+			ShaderPass pass;
+			BlueNoiseSamplerVK sampler;
+		};
+		// The blue noise and the accumulation noise texture.
+		BlueNoiseBake m_blueNoiseBakes[2];
+		uint32_t m_blueNoiseBakeCount = 0;
 
 		uint32_t m_outputWidth;
 		uint32_t m_outputHeight;
@@ -117,51 +245,139 @@ namespace SSSR_SAMPLE_VK
 		VkDescriptorSetLayout m_uniformBufferDescriptorSetLayout;
 		VkDescriptorSet m_uniformBufferDescriptorSet[8];
 
-		// Containing all rays that need to be traced.
-		BufferVK m_rayList;
+		// Containing all rays that need to be traced. One list per tile class.
+		BufferVK m_rayList[TILE_CLASS_COUNT];
 		BufferVK m_denoiserTileList;
+		// Containing all reflective pixels that are too rough to be traced and fall back to the environment map.
+		BufferVK m_environmentMapList;
+		// Per tile history of the last two frames that wrote reflections into it.
+		BufferVK m_tileHistory;
+		// Containing all tiles with reflections. The radiance outside of these tiles must not be read.
+		BufferVK m_reflectionTileList;
+		// Denoiser tiles split by the reprojection. Only the tiles that did not converge yet are spatially filtered.
+		BufferVK m_spatialFilterTileList;
+		BufferVK m_convergedTileList;
 		BufferVK m_rayCounter;
-		// Indirect arguments for intersection pass.
+		// Copies of the mip usage counters, one slot per frame in flight.
+		BufferVK m_mipUsageReadback;
+		uint32_t* m_pMipUsageReadbackData = nullptr;
+		bool m_mipUsageReadbackPending[8] = {};
+		uint32_t m_mipUsage[DEPTH_HIERARCHY_MAX_MIP_COUNT] = {};
+		// Copy of the output, see RequestOutputReadback. Created by the first request.
+		BufferVK m_outputReadback;
+		uint16_t* m_pOutputReadbackData = nullptr;
+		bool m_outputReadbackRequested = false;
+		bool m_outputReadbackPending = false;
+		bool m_outputReadbackReady = false;
+		uint32_t m_outputReadbackFrameIndex = 0;
+		// Indirect arguments for the intersection passes of each tile class followed by the denoiser and the environment map arguments, the reflection tile draw arguments and the two prefilter arguments.
 		BufferVK m_intersectionPassIndirectArgs;
 
 		// Intermediate results of the denoiser passes.
 		ImageVK m_radiance[2];
-		ImageVK m_variance[2];
-		ImageVK m_sampleCount[2];
+		// Variance in x, number of accumulated samples in y.
+		ImageVK m_varianceSampleCount[2];
 		ImageVK m_averageRadiance[2];
+		// Also receives the output of the fused denoiser before it is copied back into m_radiance.
 		ImageVK m_reprojectedRadiance;
 
-		// Extracted roughness values
-		ImageVK m_roughnessTexture;
-
-		// Extracted roughness from last frame.
-		ImageVK m_roughnessHistoryTexture;
-
-		// Normal buffer from last frame.
-		ImageVK m_normalHistoryTexture;
+		// Extracted roughness values. Ping ponging to keep the roughness of the last frame around.
+		ImageVK m_roughnessTexture[2];
 
-		// Depth buffer from last frame.
-		ImageVK m_depthHistoryTexture;
+		// Packed normals and depth written during tile classification. Read as history by the next frame.
+		ImageVK m_normalHistoryTexture[2];
+		ImageVK m_depthHistoryTexture[2];
+		bool m_lowPrecisionHistory = true;
 
-		Texture* m_depthHierarchy;
-		Texture* m_normalTexture;
+		// Lit scene the reflections are applied to if the temporal resolve does so.
+		Texture* m_hdr;
 
-		// Blue noise resources.
+		// Blue noise of BLUE_NOISE_FRAME_COUNT frames, one per array slice. Baked once at creation.
+		// Holds the spatiotemporal blue noise asset instead if that is enabled, whose size and frame count may differ.
 		ImageVK m_blueNoiseTexture;
-		BlueNoiseSamplerVK m_blueNoiseSampler;
+
+		// Only created if the accumulation mode is enabled. Each dispatch traces the whole sample set of the blue noise sampler per pixel.
+		uint32_t m_accumulationSamplesPerPixel = 0;
+		ShaderPass m_accumulatePass[TILE_CLASS_COUNT];
+		// The sample set of the sampler, one sample per array slice.
+		ImageVK m_accumulationNoiseTexture;
+		// Sum of the samples in xyz and their number in w. Kept in full precision to sum up thousands of samples.
+		ImageVK m_accumulatedRadiance;
+		// The accumulated radiance is cleared whenever this drops to zero.
+		uint32_t m_accumulatedBatchCount = 0;
 
 		ShaderPass m_classifyTilesPass;
 		ShaderPass m_prepareIndirectArgsPass;
-		ShaderPass m_intersectPass;
+		ShaderPass m_preparePrefilterArgsPass;
+		ShaderPass m_intersectPass[TILE_CLASS_COUNT];
+		ShaderPass m_environmentMapPass;
 		ShaderPass m_resolveTemporalPass;
+		ShaderPass m_resolveTemporalApplyPass;
 		ShaderPass m_reprojectPass;
 		ShaderPass m_prefilterPass;
-		ShaderPass m_blueNoisePass;
+		ShaderPass m_prefilterPassThroughPass;
+		ShaderPass m_fusedDenoiserPass;
+		ShaderPass m_fusedDenoiserApplyPass;
+		ShaderPass m_copyDenoiserTilesPass;
 
 		VkSampler m_linearSampler;
 		VkSampler m_previousDepthSampler;
 
 		uint32_t m_frameCountBeforeReuse = 0;
+		// Ping pong index of the denoiser resources. Only advances on frames that run the effect.
+		uint32_t m_bufferIndex = 0;
+		// Constants of the previous frame and the number of consecutive frames they did not change.
+		SSSRConstants m_previousConstants = {};
+		uint32_t m_staticFrameCount = 0;
+		// Scene revision passed to the previous Draw.
+		uint32_t m_previousSceneRevision = 0;
 		bool m_isSubgroupSizeControlExtensionAvailable = false;
+		// Subgroup sizes a compute pipeline can require. Both zero if the subgroup size cannot be controlled or the device was not created with the extension enabled.
+		uint32_t m_minSubgroupSize = 0;
+		uint32_t m_maxSubgroupSize = 0;
+		bool m_isComputeFullSubgroupsSupported = false;
+		// Reports pipeline cache hits exactly. Without it a pipeline counts as a hit if the cache did not grow.
+		bool m_isPipelineCreationFeedbackEnabled = false;
+		// The depth hierarchy stores linear depth. All passes are compiled with LINEAR_DEPTH_HIERARCHY.
+		bool m_linearDepthHierarchy = false;
+		bool m_halfPrecisionDepthHierarchy = false;
+		// The tile classification also builds the depth hierarchy, see FUSED_DEPTH_DOWNSAMPLE in ClassifyTiles.hlsl.
+		// The application then skips its own downsampling and leaves the hierarchy in VK_IMAGE_LAYOUT_GENERAL.
+		bool m_fusedDepthDownsample = false;
+		Texture* m_depthHierarchy = nullptr;
+		uint32_t m_depthHierarchyMipCount = 0;
+
+		// Derives the barriers between the passes of Draw from the resources they read and write.
+		SSSR_SAMPLE_COMMON::RenderGraph m_renderGraph;
+		struct GraphResources
+		{
+			SSSR_SAMPLE_COMMON::RenderGraphResource rayCounter;
+			SSSR_SAMPLE_COMMON::RenderGraphResource intersectionPassIndirectArgs;
+			SSSR_SAMPLE_COMMON::RenderGraphResource rayList[TILE_CLASS_COUNT];
+			SSSR_SAMPLE_COMMON::RenderGraphResource denoiserTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource environmentMapList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource tileHistory;
+			SSSR_SAMPLE_COMMON::RenderGraphResource reflectionTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource spatialFilterTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource convergedTileList;
+			SSSR_SAMPLE_COMMON::RenderGraphResource radiance[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource reprojectedRadiance;
+			SSSR_SAMPLE_COMMON::RenderGraphResource averageRadiance[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource varianceSampleCount[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource roughness[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource depthHistory[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource normalHistory[2];
+			SSSR_SAMPLE_COMMON::RenderGraphResource accumulatedRadiance;
+			SSSR_SAMPLE_COMMON::RenderGraphResource hdr;
+			SSSR_SAMPLE_COMMON::RenderGraphResource depthHierarchy;
+		} m_graphResources = {};
+		// Indexed by graph resource. Buffers have neither an image nor a handle; the images of the application only have a handle.
+		struct GraphImage
+		{
+			ImageVK* pImage;
+			VkImage image;
+			uint32_t mipCount;
+		};
+		std::vector<GraphImage> m_graphImages;
 	};
 }
\ No newline at end of file
@@ -27,6 +27,11 @@ namespace SSSR_SAMPLE_VK
 	{
 		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 		vkDestroyPipeline(device, pipeline, nullptr);
+		for (auto& permutation : permutations)
+		{
+			vkDestroyPipeline(device, permutation.second, nullptr);
+		}
+		permutations.clear();
 		vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
 
 		for (auto e : descriptorSets)
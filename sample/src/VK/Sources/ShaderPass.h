@@ -20,7 +20,10 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 ********************************************************************/
 #pragma once
+#include <map>
+#include <string>
 #include "Base/ResourceViewHeaps.h"
+#include "Base/ShaderCompilerHelper.h"
 
 namespace SSSR_SAMPLE_VK
 {
@@ -30,6 +33,16 @@ namespace SSSR_SAMPLE_VK
 		uint32_t						bindingsCount;
 		VkDescriptorSetLayout           descriptorSetLayout;
 		std::vector<VkDescriptorSet>	descriptorSets;
+		// Options of the constant buffer that are compiled into the shader, see SSSR::GetPipeline. Zero if the pass has a single pipeline.
+		uint32_t						permutationMask;
+		// Kept around to compile the permutations on first use.
+		std::string						shader;
+		DefineList						defines;
+		VkPipelineShaderStageCreateFlags stageFlags;
+		// Zero if the driver picks the subgroup size.
+		uint32_t						requiredSubgroupSize;
+		// Pipelines of the permutations compiled so far by their permutation key. All share the layout and descriptor sets of the pass.
+		std::map<uint32_t, VkPipeline>	permutations;
 		void OnDestroy(VkDevice device, ResourceViewHeaps* resourceHeap);
 	};
 }
\ No newline at end of file
@@ -25,6 +25,31 @@ THE SOFTWARE.
 
 #include "SssrSample.h"
 
+static const char* g_tuningProfilePath = "SSSRTuning.json";
+static const char* g_depthHierarchyErrorImagePath = "SSSRDepthHierarchyError.pgm";
+
+static SSSR_SAMPLE_COMMON::TuningSettings GetTuningSettings(const UIState& state)
+{
+	SSSR_SAMPLE_COMMON::TuningSettings settings;
+	settings.samplesPerQuad = state.samplesPerQuad;
+	settings.mostDetailedMip = state.mostDetailedDepthHierarchyMipLevel;
+	settings.maxTraversalIntersections = state.maxTraversalIterations;
+	settings.minTraversalOccupancy = state.minTraversalOccupancy;
+	settings.temporalVarianceGuidedTracing = state.bEnableTemporalVarianceGuidedTracing;
+	settings.skipConvergedRays = state.bSkipConvergedRays;
+	return settings;
+}
+
+static void SetTuningSettings(const SSSR_SAMPLE_COMMON::TuningSettings& settings, UIState& state)
+{
+	state.samplesPerQuad = settings.samplesPerQuad;
+	state.mostDetailedDepthHierarchyMipLevel = settings.mostDetailedMip;
+	state.maxTraversalIterations = settings.maxTraversalIntersections;
+	state.minTraversalOccupancy = settings.minTraversalOccupancy;
+	state.bEnableTemporalVarianceGuidedTracing = settings.temporalVarianceGuidedTracing;
+	state.bSkipConvergedRays = settings.skipConvergedRays;
+}
+
 SssrSample::SssrSample(LPCSTR name) : FrameworkWindows(name)
 {
 	m_time = 0;
@@ -41,7 +66,19 @@ void SssrSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
 	m_activeScene = 0; //load the first one by default
 	m_VsyncEnabled = false;
 	m_bIsBenchmarking = false;
+	m_bAutotune = false;
+	m_bCompareDepthHierarchyPrecision = false;
 	m_fontSize = 13.f; // default value overridden by a json file if available
+	m_halfPrecisionDepthHierarchy = false;
+	m_linearDepthHierarchy = false;
+	m_maxDepthHierarchyMipLevel = DEPTH_HIERARCHY_MAX_MIP_COUNT - 1;
+	m_fusedDepthDownsample = false;
+	m_blueNoiseSamplesPerPixel = 1;
+	m_spatiotemporalBlueNoise = false;
+	m_accumulationSamplesPerPixel = 0;
+	m_lowPrecisionHistory = true;
+	m_subgroupSizeControlEnabled = false;
+	m_pipelineCreationFeedbackEnabled = false;
 	m_isCpuValidationLayerEnabled = false;
 	m_isGpuValidationLayerEnabled = false;
 	m_activeCamera = 0;
@@ -60,8 +97,20 @@ void SssrSample::OnParseCommandLine(LPSTR lpCmdLine, uint32_t* pWidth, uint32_t*
 		m_VsyncEnabled = jData.value("vsync", m_VsyncEnabled);
 		m_FreesyncHDROptionEnabled = jData.value("FreesyncHDROptionEnabled", m_FreesyncHDROptionEnabled);
 		m_bIsBenchmarking = jData.value("benchmark", m_bIsBenchmarking);
+		m_bAutotune = jData.value("autotune", m_bAutotune);
+		m_bCompareDepthHierarchyPrecision = jData.value("compareDepthHierarchyPrecision", m_bCompareDepthHierarchyPrecision);
 		m_stablePowerState = jData.value("stablePowerState", m_stablePowerState);
 		m_fontSize = jData.value("fontsize", m_fontSize);
+		m_halfPrecisionDepthHierarchy = jData.value("halfPrecisionDepthHierarchy", m_halfPrecisionDepthHierarchy);
+		m_linearDepthHierarchy = jData.value("linearDepthHierarchy", m_linearDepthHierarchy);
+		m_maxDepthHierarchyMipLevel = jData.value("maxDepthHierarchyMipLevel", m_maxDepthHierarchyMipLevel);
+		m_fusedDepthDownsample = jData.value("fusedDepthDownsample", m_fusedDepthDownsample);
+		m_blueNoiseSamplesPerPixel = jData.value("blueNoiseSamplesPerPixel", m_blueNoiseSamplesPerPixel);
+		m_spatiotemporalBlueNoise = jData.value("spatiotemporalBlueNoise", m_spatiotemporalBlueNoise);
+		m_accumulationSamplesPerPixel = jData.value("accumulationSamplesPerPixel", m_accumulationSamplesPerPixel);
+		m_lowPrecisionHistory = jData.value("lowPrecisionHistory", m_lowPrecisionHistory);
+		m_subgroupSizeControlEnabled = jData.value("subgroupSizeControlEnabled", m_subgroupSizeControlEnabled);
+		m_pipelineCreationFeedbackEnabled = jData.value("pipelineCreationFeedbackEnabled", m_pipelineCreationFeedbackEnabled);
 	};
 
 	//read json globals from commandline
@@ -118,11 +167,12 @@ void SssrSample::OnCreate()
 
 	// Create a instance of the renderer and initialize it, we need to do that for each GPU
 	m_pRenderer = new Renderer();
-	m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize);
+	m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize, m_halfPrecisionDepthHierarchy, m_linearDepthHierarchy, m_maxDepthHierarchyMipLevel, m_fusedDepthDownsample, m_blueNoiseSamplesPerPixel, m_spatiotemporalBlueNoise, m_accumulationSamplesPerPixel, m_lowPrecisionHistory, m_subgroupSizeControlEnabled, m_pipelineCreationFeedbackEnabled);
 
 	// init GUI (non gfx stuff)
 	ImGUI_Init((void*)m_windowHwnd);
 	m_UIState.Initialize();
+	LoadTuningProfile();
 
 	OnResize(true);
 	OnUpdateDisplay();
@@ -211,7 +261,9 @@ void SssrSample::LoadScene(int sceneIndex)
 		m_pRenderer->OnDestroyWindowSizeDependentResources();
 		m_pRenderer->OnDestroy();
 		m_pGltfLoader->Unload();
-		m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize);
+		// The comparison picks the depth hierarchy of each of its runs.
+		bool halfPrecisionDepthHierarchy = m_depthHierarchyComparison.IsRunning() ? m_depthHierarchyComparison.IsHalfPrecision() : m_halfPrecisionDepthHierarchy;
+		m_pRenderer->OnCreate(&m_device, &m_swapChain, m_fontSize, halfPrecisionDepthHierarchy, m_linearDepthHierarchy, m_maxDepthHierarchyMipLevel, m_fusedDepthDownsample, m_blueNoiseSamplesPerPixel, m_spatiotemporalBlueNoise, m_accumulationSamplesPerPixel, m_lowPrecisionHistory, m_subgroupSizeControlEnabled, m_pipelineCreationFeedbackEnabled);
 		m_pRenderer->OnCreateWindowSizeDependentResources(&m_swapChain, m_Width, m_Height);
 	}
 
@@ -279,6 +331,164 @@ void SssrSample::LoadScene(int sceneIndex)
 	}
 }
 
+void SssrSample::LoadTuningProfile()
+{
+	std::ifstream f(g_tuningProfilePath);
+	if (!f)
+	{
+		return;
+	}
+
+	json profiles;
+	try
+	{
+		f >> profiles;
+	}
+	catch (json::parse_error)
+	{
+		Trace("Error parsing %s", g_tuningProfilePath);
+		return;
+	}
+
+	std::string deviceName;
+	std::string driverVersion;
+	m_device.GetDeviceInfo(&deviceName, &driverVersion);
+	for (const json& profile : profiles["profiles"])
+	{
+		if (profile.value("device", "") != deviceName || profile.value("driver", "") != driverVersion)
+		{
+			continue;
+		}
+
+		SSSR_SAMPLE_COMMON::TuningSettings settings = GetTuningSettings(m_UIState);
+		settings.samplesPerQuad = profile.value("samplesPerQuad", settings.samplesPerQuad);
+		settings.mostDetailedMip = profile.value("mostDetailedMip", settings.mostDetailedMip);
+		settings.maxTraversalIntersections = profile.value("maxTraversalIntersections", settings.maxTraversalIntersections);
+		settings.minTraversalOccupancy = profile.value("minTraversalOccupancy", settings.minTraversalOccupancy);
+		settings.temporalVarianceGuidedTracing = profile.value("temporalVarianceGuidedTracing", settings.temporalVarianceGuidedTracing);
+		settings.skipConvergedRays = profile.value("skipConvergedRays", settings.skipConvergedRays);
+		SetTuningSettings(settings, m_UIState);
+		return;
+	}
+}
+
+void SssrSample::SaveTuningProfile()
+{
+	// The profiles of the other devices and drivers are kept.
+	json profiles;
+	{
+		std::ifstream f(g_tuningProfilePath);
+		if (f)
+		{
+			try
+			{
+				f >> profiles;
+			}
+			catch (json::parse_error)
+			{
+				profiles = json();
+			}
+		}
+	}
+
+	std::string deviceName;
+	std::string driverVersion;
+	m_device.GetDeviceInfo(&deviceName, &driverVersion);
+	json& list = profiles["profiles"];
+	if (!list.is_array())
+	{
+		list = json::array();
+	}
+	for (auto it = list.begin(); it != list.end();)
+	{
+		bool isSameDevice = it->value("device", "") == deviceName && it->value("driver", "") == driverVersion;
+		it = isSameDevice ? list.erase(it) : it + 1;
+	}
+
+	const SSSR_SAMPLE_COMMON::TuningSettings& settings = m_autotuner.GetBestSettings();
+	json profile;
+	profile["device"] = deviceName;
+	profile["driver"] = driverVersion;
+	profile["samplesPerQuad"] = settings.samplesPerQuad;
+	profile["mostDetailedMip"] = settings.mostDetailedMip;
+	profile["maxTraversalIntersections"] = settings.maxTraversalIntersections;
+	profile["minTraversalOccupancy"] = settings.minTraversalOccupancy;
+	profile["temporalVarianceGuidedTracing"] = settings.temporalVarianceGuidedTracing;
+	profile["skipConvergedRays"] = settings.skipConvergedRays;
+	profile["microseconds"] = m_autotuner.GetBestMicroseconds();
+	profile["baselineMicroseconds"] = m_autotuner.GetBaselineMicroseconds();
+	list.push_back(profile);
+
+	std::ofstream f(g_tuningProfilePath);
+	if (!f)
+	{
+		Trace("Failed to save %s", g_tuningProfilePath);
+		return;
+	}
+	f << profiles.dump(4);
+}
+
+void SssrSample::UpdateAutotuner()
+{
+	float sssrMicroseconds = 0.0f;
+	for (const TimeStamp& timeStamp : m_pRenderer->GetTimingValues())
+	{
+		if (timeStamp.m_label.compare(0, 4, "FFX ") == 0)
+		{
+			sssrMicroseconds += timeStamp.m_microseconds;
+		}
+	}
+
+	uint32_t rowPitch = 0;
+	const uint16_t* pReadback = m_pRenderer->GetReflectionsReadback(&rowPitch);
+	m_autotuner.Update(sssrMicroseconds, pReadback, rowPitch, m_Width, m_Height);
+	SetTuningSettings(m_autotuner.GetSettings(), m_UIState);
+
+	// The candidates have to trace every frame instead of reusing the last output, or their timings would be meaningless.
+	m_UIState.bAccumulateSamples = m_autotuner.IsAccumulatingReference();
+	m_UIState.bDisableStaticFrameReuse = m_autotuner.IsRunning();
+	if (m_autotuner.NeedsReadback())
+	{
+		m_pRenderer->RequestReflectionsReadback();
+	}
+
+	if (!m_autotuner.IsRunning())
+	{
+		Trace("SSSR autotuner: %u candidates, %.1f us instead of %.1f us", m_autotuner.GetCandidateCount(), m_autotuner.GetBestMicroseconds(), m_autotuner.GetBaselineMicroseconds());
+		SaveTuningProfile();
+	}
+}
+
+void SssrSample::UpdateDepthHierarchyComparison()
+{
+	uint32_t rowPitch = 0;
+	const uint16_t* pReadback = m_pRenderer->GetReflectionsReadback(&rowPitch);
+	m_depthHierarchyComparison.Update(pReadback, rowPitch, m_Width, m_Height);
+
+	// Every run has to trace its own frames instead of reusing the last output.
+	m_UIState.bAccumulateSamples = m_depthHierarchyComparison.IsAccumulating();
+	m_UIState.bDisableStaticFrameReuse = m_depthHierarchyComparison.IsRunning();
+	if (m_depthHierarchyComparison.NeedsReadback())
+	{
+		m_pRenderer->RequestReflectionsReadback();
+	}
+
+	if (!m_depthHierarchyComparison.IsRunning())
+	{
+		Trace("SSSR depth hierarchy comparison: RMSE %g with the 16 bit hierarchy, %g between two runs with the 32 bit one", m_depthHierarchyComparison.GetHalfPrecisionError(), m_depthHierarchyComparison.GetErrorFloor());
+		if (!m_depthHierarchyComparison.IsErrorImageSaved())
+		{
+			Trace("Failed to save %s", g_depthHierarchyErrorImagePath);
+		}
+		// Back to the configured depth hierarchy.
+		LoadScene(m_activeScene);
+	}
+	else if (m_depthHierarchyComparison.NeedsRestart())
+	{
+		LoadScene(m_activeScene);
+	}
+}
+
 void SssrSample::OnUpdate()
 {
 	ImGuiIO& io = ImGui::GetIO();
@@ -307,6 +517,7 @@ void SssrSample::OnUpdate()
 	// Animation Update
 	if (m_bPlay)
 		m_time += (float)m_deltaTime / 1000.0f; // animation time in seconds
+	m_UIState.bIsAnimationPlaying = m_bPlay;
 
 	if (m_pGltfLoader)
 	{
@@ -387,8 +598,42 @@ void SssrSample::OnRender()
 		{
 			m_time = 0;
 			m_loadingScene = false;
+
+			if (m_bAutotune)
+			{
+				m_autotuner.Begin(GetTuningSettings(m_UIState), m_pRenderer->IsAccumulationAvailable());
+				// UpdateAutotuner runs instead of OnUpdate, so the camera and the animation time stand still until it is done.
+				m_UIState.bIsAnimationPlaying = false;
+				m_bAutotune = false;
+			}
+			else if (m_bCompareDepthHierarchyPrecision)
+			{
+				m_bCompareDepthHierarchyPrecision = false;
+				if (m_linearDepthHierarchy)
+				{
+					Trace("The linear depth hierarchy has no 16 bit format to compare against");
+				}
+				else
+				{
+					m_depthHierarchyComparison.Begin(m_pRenderer->IsAccumulationAvailable(), g_depthHierarchyErrorImagePath);
+					// UpdateDepthHierarchyComparison runs instead of OnUpdate, so the camera and the animation time stand still until it is done.
+					m_UIState.bIsAnimationPlaying = false;
+					// The reference starts from a freshly created renderer as well.
+					LoadScene(m_activeScene);
+				}
+			}
 		}
 	}
+	else if (m_pGltfLoader && m_autotuner.IsRunning())
+	{
+		// The autotuner renders the scene from its default camera until it is done
+		UpdateAutotuner();
+	}
+	else if (m_pGltfLoader && m_depthHierarchyComparison.IsRunning())
+	{
+		// The comparison renders the scene from its default camera as well
+		UpdateDepthHierarchyComparison();
+	}
 	else if (m_pGltfLoader && m_bIsBenchmarking)
 	{
 		// Benchmarking takes control of the time, and exits the app when the animation is done
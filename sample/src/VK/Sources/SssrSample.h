@@ -24,6 +24,8 @@ THE SOFTWARE.
 #include "base/FrameworkWindows.h"
 #include "Renderer.h"
 #include "UI.h"
+#include "../../Common/Autotuner.h"
+#include "../../Common/DepthHierarchyComparison.h"
 
 // This class encapsulates the 'application' and is responsible for handling window events and scene updates (simulation)
 // Rendering and rendering resource management is done by the Renderer class
@@ -48,9 +50,21 @@ public:
     void HandleInput(const ImGuiIO& io);
     void UpdateCamera(Camera& cam, const ImGuiIO& io);
 
+    // The tuning profiles are keyed by the device and the driver they were measured on.
+    void LoadTuningProfile();
+    void SaveTuningProfile();
+    void UpdateAutotuner();
+    void UpdateDepthHierarchyComparison();
+
 private:
 
     bool                        m_bIsBenchmarking;
+    // Sweeps the reflection settings once the scene is loaded and stores the best ones in the tuning profile.
+    bool                        m_bAutotune;
+    SSSR_SAMPLE_COMMON::Autotuner m_autotuner;
+    // Compares the reflections of the 16 bit depth hierarchy against the 32 bit one once the scene is loaded. Skipped when autotuning.
+    bool                        m_bCompareDepthHierarchyPrecision;
+    SSSR_SAMPLE_COMMON::DepthHierarchyComparison m_depthHierarchyComparison;
 
     GLTFCommon* m_pGltfLoader = NULL;
     bool                        m_loadingScene = false;
@@ -58,6 +72,18 @@ private:
     Renderer* m_pRenderer = NULL;
     UIState                     m_UIState;
     float                       m_fontSize;
+    bool                        m_halfPrecisionDepthHierarchy;
+    bool                        m_linearDepthHierarchy;
+    uint32_t                    m_maxDepthHierarchyMipLevel;
+    bool                        m_fusedDepthDownsample;
+    uint32_t                    m_blueNoiseSamplesPerPixel;
+    bool                        m_spatiotemporalBlueNoise;
+    uint32_t                    m_accumulationSamplesPerPixel;
+    bool                        m_lowPrecisionHistory;
+    // Set if the Cauldron build creates the device with VK_EXT_subgroup_size_control and its subgroupSizeControl and computeFullSubgroups features enabled.
+    bool                        m_subgroupSizeControlEnabled;
+    // Set if the Cauldron build creates the device with VK_EXT_pipeline_creation_feedback enabled.
+    bool                        m_pipelineCreationFeedbackEnabled;
     Camera                      m_camera;
 
     float                       m_time; // Time accumulator in seconds, used for animation.
@@ -243,26 +243,14 @@ namespace SSSR_SAMPLE_VK
 		assert(res == VK_SUCCESS);
 	}
 
-	//--------------------------------------------------------------------------------------
-	//
-	// FlushAndFinish
-	//
-	//--------------------------------------------------------------------------------------
-	void UploadHeapVK::FlushAndFinish(bool bDoBarriers)
+	void UploadHeapVK::RecordCopies()
 	{
-		// make sure another thread is not already flushing
-		flushing.Wait();
-
-		// begins a critical section, and make sure no allocations happen while a thread is inside it
-		flushing.Inc();
-
-		// wait for pending allocations to finish
-		allocating.Wait();
-
 		std::unique_lock<std::mutex> lock(m_mutex);
-		Flush();
-		Trace("flushing %i", m_copies.size() + m_copiesBuffer.size());
+		RecordCopiesLocked();
+	}
 
+	void UploadHeapVK::RecordCopiesLocked()
+	{
 		//apply pre barriers in one go
 		if (m_toPreBarrier.size() > 0)
 		{
@@ -288,7 +276,29 @@ namespace SSSR_SAMPLE_VK
 			vkCmdPipelineBarrier(GetCommandList(), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, (uint32_t)m_toPostBarrierBuffer.size(), m_toPostBarrierBuffer.data(), (uint32_t)m_toPostBarrier.size(), m_toPostBarrier.data());
 			m_toPostBarrier.clear();
 		}
+	}
+
+	//--------------------------------------------------------------------------------------
+	//
+	// FlushAndFinish
+	//
+	//--------------------------------------------------------------------------------------
+	void UploadHeapVK::FlushAndFinish(bool bDoBarriers)
+	{
+		// make sure another thread is not already flushing
+		flushing.Wait();
+
+		// begins a critical section, and make sure no allocations happen while a thread is inside it
+		flushing.Inc();
+
+		// wait for pending allocations to finish
+		allocating.Wait();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		Flush();
+		Trace("flushing %i", m_copies.size() + m_copiesBuffer.size());
 
+		RecordCopiesLocked();
 
 		// Close 
 		VkResult res = vkEndCommandBuffer(m_pCommandBuffer);
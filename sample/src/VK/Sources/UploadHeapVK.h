@@ -77,9 +77,13 @@ namespace SSSR_SAMPLE_VK
 		void AddPostBarrierBuffer(VkBufferMemoryBarrier imageMemoryBarrier);
 
 		void Flush();
+		// Records the copies and barriers added so far into the command list without submitting it.
+		// Commands recorded into the command list afterwards are executed after the copies.
+		void RecordCopies();
 		void FlushAndFinish(bool bDoBarriers = false);
 
 	private:
+		void RecordCopiesLocked();
 
 		Device* m_pDevice;
 